@@ -0,0 +1,63 @@
+#pragma once
+
+#include "renderer.h"
+#include "scene.h"
+#include "stress_scene.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace bench {
+
+struct Options {
+  uint32_t frames = 300;      // Measured frames per scene
+  uint32_t warmupFrames = 30; // Drawn before measuring, not reported
+  vk::Extent2D extent{800, 600};
+  std::vector<size_t> scenes; // 1-based scene numbers, empty for all
+  std::string output = "bench.json";
+  scene::StressConfig stress; // Shape of the stress scene, the last one
+};
+
+// Milliseconds over the measured frames of a scene
+struct Stats {
+  size_t samples = 0;
+  double mean = 0.0;
+  double min = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+struct SceneResult {
+  std::string name;
+  double setupMs;
+  Stats cpu; // Whole draw iteration: update, record, submit and slot waits
+  Stats gpu; // Outermost GPU zones of each frame
+};
+
+// Draws scenes offscreen on a headless renderer for a fixed number of frames
+// with a fixed time step, so runs on the same machine are comparable, and
+// writes the frame time percentiles as JSON
+class Bench {
+private:
+  Options options;
+  std::unique_ptr<render::Renderer> renderer;
+
+  SceneResult run_scene(render::Scene &scene);
+  std::string to_json(const std::vector<SceneResult> &results) const;
+
+public:
+  explicit Bench(Options options);
+  ~Bench();
+
+  // False if no scene ran or the report can't be written
+  bool run();
+
+  static Stats compute_stats(std::vector<double> samples);
+};
+
+} // namespace bench
@@ -0,0 +1,226 @@
+#include "bench.h"
+#include "config.h"
+#include "scene_list.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fixed simulation step, runs must not depend on how fast frames are drawn
+constexpr float timeStep = 1.0f / 60.0f;
+
+std::string json_escape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+std::string stats_json(const bench::Stats &stats) {
+  return std::format("{{\"samples\": {}, \"mean\": {:.4f}, \"min\": {:.4f}, "
+                     "\"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, "
+                     "\"max\": {:.4f}}}",
+                     stats.samples, stats.mean, stats.min, stats.p50,
+                     stats.p95, stats.p99, stats.max);
+}
+
+} // namespace
+
+bench::Bench::Bench(Options options)
+    : options(std::move(options)),
+      renderer(std::make_unique<render::Renderer>(this->options.extent)) {
+  // Every measured frame has to stay in the history until it is collected
+  const uint32_t maxFrames = general::Config::get_instance().get_max_frames();
+  for (uint32_t i = 0;; ++i) {
+    device::GpuProfiler *profiler = renderer->get_gpu_profiler(i);
+    if (!profiler) {
+      break;
+    }
+    profiler->set_history_size(this->options.frames + maxFrames);
+  }
+}
+
+bench::Bench::~Bench() { renderer.reset(); }
+
+bench::SceneResult bench::Bench::run_scene(render::Scene &scene) {
+  auto *objectMgr = renderer->get_object_manager();
+  auto &deviceMgr = renderer->get_device_manager();
+
+  SceneResult result{.name = scene.get_name()};
+  std::print("Bench - {} - setting up\n", result.name);
+
+  auto setupStart = Clock::now();
+  scene.setup();
+  deviceMgr.wait_idle();
+  result.setupMs = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                             setupStart)
+                       .count();
+
+  float totalTime = 0.0f;
+  auto draw = [&]() {
+    totalTime += timeStep;
+    scene.update(timeStep, totalTime);
+    objectMgr->publish_snapshots();
+    renderer->draw_frame();
+  };
+
+  for (uint32_t i = 0; i < options.warmupFrames; ++i) {
+    draw();
+  }
+
+  const uint64_t firstFrame = renderer->get_frame_count() + 1;
+  std::vector<double> cpuMs;
+  cpuMs.reserve(options.frames);
+  for (uint32_t i = 0; i < options.frames; ++i) {
+    auto start = Clock::now();
+    draw();
+    cpuMs.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  const uint64_t lastFrame = renderer->get_frame_count();
+
+  // Timestamps are read back when their frame slot is recorded again
+  const uint32_t maxFrames = general::Config::get_instance().get_max_frames();
+  for (uint32_t i = 0; i < maxFrames; ++i) {
+    draw();
+  }
+  deviceMgr.wait_idle();
+
+  std::vector<double> gpuMs;
+  if (auto *profiler = renderer->get_gpu_profiler()) {
+    for (const auto &frame :
+         profiler->get_frames(options.frames + maxFrames)) {
+      if (frame.frameNumber < firstFrame || frame.frameNumber > lastFrame) {
+        continue;
+      }
+      double milliseconds = 0.0;
+      for (const auto &zone : frame.zones) {
+        if (zone.depth == 0) {
+          milliseconds += zone.milliseconds;
+        }
+      }
+      gpuMs.push_back(milliseconds);
+    }
+  }
+
+  scene.cleanup();
+
+  result.cpu = compute_stats(std::move(cpuMs));
+  result.gpu = compute_stats(std::move(gpuMs));
+  std::print("Bench - {} - cpu p50 {:.3f} ms p99 {:.3f} ms, gpu p50 {:.3f} "
+             "ms p99 {:.3f} ms\n",
+             result.name, result.cpu.p50, result.cpu.p99, result.gpu.p50,
+             result.gpu.p99);
+  return result;
+}
+
+bench::Stats bench::Bench::compute_stats(std::vector<double> samples) {
+  if (samples.empty()) {
+    return {};
+  }
+  std::ranges::sort(samples);
+
+  // Nearest-rank percentiles
+  auto percentile = [&samples](double p) {
+    const auto rank = static_cast<size_t>(
+        std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+  };
+
+  return {.samples = samples.size(),
+          .mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                  static_cast<double>(samples.size()),
+          .min = samples.front(),
+          .p50 = percentile(50.0),
+          .p95 = percentile(95.0),
+          .p99 = percentile(99.0),
+          .max = samples.back()};
+}
+
+std::string
+bench::Bench::to_json(const std::vector<SceneResult> &results) const {
+  const auto &properties = renderer->get_device_manager()
+                               .get_primary_device()
+                               ->get_physical_device()
+                               ->get_properties();
+
+  std::string json = std::format(
+      "{{\n  \"device\": \"{}\",\n  \"deviceType\": \"{}\",\n"
+      "  \"width\": {},\n  \"height\": {},\n  \"frames\": {},\n"
+      "  \"warmupFrames\": {},\n"
+      "  \"stress\": {{\"objects\": {}, \"materials\": {}, "
+      "\"textures\": {}, \"dynamic\": {:.3f}, \"mix\": [{}, {}, {}]}},\n"
+      "  \"scenes\": [",
+      json_escape(properties.deviceName.data()),
+      vk::to_string(properties.deviceType), options.extent.width,
+      options.extent.height, options.frames, options.warmupFrames,
+      options.stress.objectCount, options.stress.materialCount,
+      options.stress.textureCount, options.stress.dynamicFraction,
+      options.stress.weight2D, options.stress.weight3D,
+      options.stress.weightSubmesh);
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const SceneResult &result = results[i];
+    json += std::format("{}\n    {{\"name\": \"{}\", \"setupMs\": {:.3f},\n"
+                        "     \"cpuFrameMs\": {},\n"
+                        "     \"gpuFrameMs\": {}}}",
+                        i == 0 ? "" : ",", json_escape(result.name),
+                        result.setupMs, stats_json(result.cpu),
+                        stats_json(result.gpu));
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
+
+bool bench::Bench::run() {
+  auto scenes = scene::create_scenes(*renderer, options.stress);
+
+  std::vector<SceneResult> results;
+  for (size_t i = 0; i < scenes.size(); ++i) {
+    if (!options.scenes.empty() &&
+        std::ranges::find(options.scenes, i + 1) == options.scenes.end()) {
+      continue;
+    }
+    results.push_back(run_scene(*scenes[i]));
+  }
+  scenes.clear();
+
+  if (results.empty()) {
+    std::print(stderr, "Bench - no scene matched the selection\n");
+    return false;
+  }
+
+  std::ofstream file(options.output);
+  if (!file.is_open()) {
+    std::print(stderr, "Bench - {} - can't open file for writing\n",
+               options.output);
+    return false;
+  }
+  file << to_json(results);
+  if (!file.good()) {
+    std::print(stderr, "Bench - {} - failed writing the report\n",
+               options.output);
+    return false;
+  }
+
+  std::print("Bench - wrote {} scenes to {}\n", results.size(),
+             options.output);
+  return true;
+}
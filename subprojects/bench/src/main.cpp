@@ -0,0 +1,100 @@
+#include "bench.h"
+#include <cstdint>
+#include <exception>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void print_usage() {
+  std::print(stderr,
+             "Usage: bench [--frames N] [--warmup N] [--width N] [--height N]"
+             " [--scene N]... [--output FILE]\n"
+             "             [--stress-objects N] [--stress-materials N]"
+             " [--stress-textures N]\n"
+             "             [--stress-dynamic FRACTION] [--stress-mix "
+             "2D:3D:SUBMESH]\n"
+             "Draws every scene offscreen, or only the selected 1-based scene"
+             " numbers,\nand writes CPU and GPU frame time percentiles as "
+             "JSON (default bench.json).\nThe stress scene is the last one, "
+             "its mix weights the quad, cube and\ntwo-material cube counts\n");
+}
+
+// "2D:3D:SUBMESH" relative weights
+void parse_mix(const std::string &value, scene::StressConfig &config) {
+  const size_t first = value.find(':');
+  const size_t second =
+      first == std::string::npos ? first : value.find(':', first + 1);
+  if (second == std::string::npos) {
+    throw std::invalid_argument("stress mix must be 2D:3D:SUBMESH");
+  }
+  config.weight2D = std::stof(value.substr(0, first));
+  config.weight3D = std::stof(value.substr(first + 1, second - first - 1));
+  config.weightSubmesh = std::stof(value.substr(second + 1));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bench::Options options;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg == "--help" || arg == "-h") {
+        print_usage();
+        return 0;
+      }
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("missing value for " + std::string(arg));
+      }
+      std::string value = argv[++i];
+
+      if (arg == "--frames") {
+        options.frames = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--warmup") {
+        options.warmupFrames = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--width") {
+        options.extent.width = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--height") {
+        options.extent.height = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--scene") {
+        options.scenes.push_back(std::stoul(value));
+      } else if (arg == "--output") {
+        options.output = value;
+      } else if (arg == "--stress-objects") {
+        options.stress.objectCount = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--stress-materials") {
+        options.stress.materialCount = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--stress-textures") {
+        options.stress.textureCount = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--stress-dynamic") {
+        options.stress.dynamicFraction = std::stof(value);
+      } else if (arg == "--stress-mix") {
+        parse_mix(value, options.stress);
+      } else {
+        throw std::invalid_argument("unknown option " + std::string(arg));
+      }
+    }
+  } catch (const std::exception &e) {
+    std::print(stderr, "Bench - {}\n", e.what());
+    print_usage();
+    return 1;
+  }
+
+  if (options.frames == 0 || options.extent.width == 0 ||
+      options.extent.height == 0) {
+    std::print(stderr, "Bench - frames and extent must not be 0\n");
+    return 1;
+  }
+
+  try {
+    bench::Bench runner(options);
+    return runner.run() ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::print(stderr, "Bench - {}\n", e.what());
+    return 1;
+  }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "trace.h"
 #include <BS_thread_pool.hpp>
 #include <cstdint>
 #include <future>
@@ -38,7 +39,16 @@ public:
 template <typename F>
 std::future<std::invoke_result_t<std::decay_t<F>>>
 Tasks::add_task(F &&func, const BS::priority_t priority) {
+#ifdef TRACING_ENABLED
+  return pool.submit_task(
+      [func = std::forward<F>(func)]() mutable {
+        TRACE_ZONE("Tasks job");
+        return func();
+      },
+      priority);
+#else
   return pool.submit_task(std::forward<F>(func), priority);
+#endif
 }
 
 } // namespace device
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace general {
+
+// CPU zones for diagnosing hitches after the fact. Every thread records into
+// its own ring buffer with a single writer, so recording takes no lock, and
+// dump writes the last seconds of all threads as Chrome/Perfetto trace JSON.
+// Use the TRACE_ macros, they compile to nothing without TRACING_ENABLED
+class Trace {
+public:
+  struct Event {
+    const char *name; // Static string, names are never copied
+    uint64_t start;   // Nanoseconds since the trace epoch
+    uint64_t duration;
+  };
+
+  // Records the time between construction and destruction
+  class Zone {
+    const char *name;
+    uint64_t start;
+
+  public:
+    explicit Zone(const char *name);
+    ~Zone();
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+  };
+
+private:
+  static constexpr size_t ringSize = 1 << 15; // Events kept per thread
+
+  // Ring slot, relaxed atomics so dump can read a slot the owner is writing
+  // without a data race, the head check tells whether it was torn
+  struct Slot {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> duration;
+  };
+
+  struct ThreadBuffer {
+    uint32_t threadId;
+    std::string threadName;
+    std::unique_ptr<Slot[]> events;
+    std::atomic<uint64_t> head; // Events written so far
+  };
+
+  // Registration and dumps only, recording never locks. Buffers outlive
+  // their thread so a dump still shows threads that already exited
+  mutable std::mutex buffersMutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::atomic<uint32_t> nextThreadId;
+  std::chrono::steady_clock::time_point epoch;
+
+  Trace();
+
+  ThreadBuffer &thread_buffer();
+
+public:
+  ~Trace();
+  Trace(Trace &&) = delete;
+  Trace &operator=(Trace &&) = delete;
+  Trace(const Trace &) = delete;
+  Trace &operator=(const Trace &) = delete;
+  static Trace &get_instance();
+
+  uint64_t now() const;
+  void record(const char *name, uint64_t start, uint64_t end);
+  void set_thread_name(std::string name);
+
+  // Write the zones that ended in the last seconds to a Chrome trace event
+  // file. False if tracing is compiled out or the file can't be written
+  bool dump(const std::string &path, double seconds) const;
+};
+
+} // namespace general
+
+#ifdef TRACING_ENABLED
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name)                                                       \
+  general::Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD_NAME(name)                                                \
+  general::Trace::get_instance().set_thread_name(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
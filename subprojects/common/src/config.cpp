@@ -107,7 +107,8 @@ general::Config::get_features(vk::raii::PhysicalDevice physicalDevice) {
     vk::StructureChain<PhysicalDeviceFeaturesList> featureChain = {
         {.features = deviceFeatures},  // vk::PhysicalDeviceFeatures2
         {},                            // vk::PhysicalDeviceVulkan11Features
-        {.bufferDeviceAddress = true}, // vk::PhysicalDeviceVulkan12Features
+        {.timelineSemaphore = true,
+         .bufferDeviceAddress = true}, // vk::PhysicalDeviceVulkan12Features
         {.synchronization2 = true,
          .dynamicRendering = true}, // vk::PhysicalDeviceVulkan13Features
         {.extendedDynamicState =
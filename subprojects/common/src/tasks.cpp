@@ -1,6 +1,9 @@
 #include "tasks.h"
 #include "BS_thread_pool.hpp"
+#include "trace.h"
+#include <cstddef>
 #include <cstdint>
+#include <format>
 #include <print>
 #include <stdexcept>
 #include <thread>
@@ -12,7 +15,9 @@ device::Tasks &device::Tasks::get_instance() {
 
 device::Tasks::Tasks()
     : num_threads(std::thread::hardware_concurrency() * 0.75), num_gpus(0),
-      pool(num_threads) {}
+      pool(num_threads, []([[maybe_unused]] std::size_t index) {
+        TRACE_THREAD_NAME(std::format("Tasks worker {}", index));
+      }) {}
 
 device::Tasks::~Tasks() {
   pool.wait();
@@ -0,0 +1,162 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Names are source literals, escaping keeps the file valid regardless
+std::string json_escape(const char *text) {
+  std::string escaped;
+  for (; *text; ++text) {
+    if (*text == '"' || *text == '\\') {
+      escaped += '\\';
+    }
+    escaped += *text;
+  }
+  return escaped;
+}
+
+} // namespace
+
+general::Trace::Zone::Zone(const char *name)
+    : name(name), start(Trace::get_instance().now()) {}
+
+general::Trace::Zone::~Zone() {
+  Trace &trace = Trace::get_instance();
+  trace.record(name, start, trace.now());
+}
+
+general::Trace &general::Trace::get_instance() {
+  static Trace instance;
+  return instance;
+}
+
+general::Trace::Trace()
+    : nextThreadId(1), epoch(std::chrono::steady_clock::now()) {}
+
+general::Trace::~Trace() = default;
+
+general::Trace::ThreadBuffer &general::Trace::thread_buffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    buffer->threadId = nextThreadId++;
+    buffer->threadName = std::format("thread {}", buffer->threadId);
+    buffer->events = std::make_unique<Slot[]>(ringSize);
+    buffer->head = 0;
+
+    std::lock_guard lock(buffersMutex);
+    buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+uint64_t general::Trace::now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void general::Trace::record(const char *name, uint64_t start, uint64_t end) {
+  ThreadBuffer &buffer = thread_buffer();
+  const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  // Pairs with the fence in dump: a reader that sees any of these stores
+  // also sees the head that came before them
+  std::atomic_thread_fence(std::memory_order_release);
+  Slot &slot = buffer.events[head % ringSize];
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(end - start, std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void general::Trace::set_thread_name(std::string name) {
+  ThreadBuffer &buffer = thread_buffer();
+  std::lock_guard lock(buffersMutex);
+  buffer.threadName = std::move(name);
+}
+
+bool general::Trace::dump(const std::string &path, double seconds) const {
+#ifndef TRACING_ENABLED
+  std::print(stderr, "Trace - {} - tracing is compiled out, configure with "
+                     "ENABLE_TRACING\n",
+             path);
+  return false;
+#endif
+
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::print(stderr, "Trace - {} - can't open file for writing\n", path);
+    return false;
+  }
+
+  const uint64_t end = now();
+  const uint64_t window = static_cast<uint64_t>(std::max(seconds, 0.0) * 1e9);
+  const uint64_t cutoff = end > window ? end - window : 0;
+
+  file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  size_t written = 0;
+
+  std::lock_guard lock(buffersMutex);
+  for (const auto &buffer : buffers) {
+    file << std::format(
+        "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+        "\"args\":{{\"name\":\"{}\"}}}}",
+        first ? "" : ",", buffer->threadId,
+        json_escape(buffer->threadName.c_str()));
+    first = false;
+
+    // The owning thread keeps writing, so this is a seqlock style read: copy
+    // first, then drop whatever it may have overwritten meanwhile. Slot
+    // newHead % ringSize may be mid-write, that is index newHead - ringSize,
+    // so the first valid index is one past it
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t oldest = head > ringSize ? head - ringSize : 0;
+    std::vector<Event> events(head - oldest);
+    for (uint64_t i = oldest; i < head; ++i) {
+      const Slot &slot = buffer->events[i % ringSize];
+      events[i - oldest] = {
+          .name = slot.name.load(std::memory_order_relaxed),
+          .start = slot.start.load(std::memory_order_relaxed),
+          .duration = slot.duration.load(std::memory_order_relaxed)};
+    }
+    // Keeps the slot loads above from moving past the second head load
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t newHead = buffer->head.load(std::memory_order_relaxed);
+    const uint64_t valid = newHead + 1 > ringSize ? newHead + 1 - ringSize : 0;
+
+    for (uint64_t i = std::max(oldest, valid); i < head; ++i) {
+      const Event &event = events[i - oldest];
+      if (event.start + event.duration < cutoff) {
+        continue;
+      }
+      // Chrome expects microseconds
+      file << std::format(",{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,"
+                          "\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                          json_escape(event.name), buffer->threadId,
+                          event.start / 1e3, event.duration / 1e3);
+      ++written;
+    }
+  }
+  file << "]}\n";
+
+  if (!file.good()) {
+    std::print(stderr, "Trace - {} - failed writing the trace\n", path);
+    return false;
+  }
+
+  std::print("Trace - wrote {} zones of the last {:.1f} s to {}\n", written,
+             seconds, path);
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace render {
+
+// Skyline bottom-left rectangle packer used to place many small images into
+// a shared atlas page. Only tracks space, pixels are copied by the caller
+class AtlasPacker {
+public:
+  struct Rect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+  };
+
+private:
+  struct SkylineNode {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+  };
+
+  uint32_t width;
+  uint32_t height;
+  uint64_t usedArea;
+
+  std::vector<SkylineNode> skyline;
+
+  bool fits(size_t nodeIndex, uint32_t rectWidth, uint32_t rectHeight,
+            uint32_t &outY) const;
+  void add_skyline_level(size_t nodeIndex, const Rect &rect);
+  void merge_skylines();
+
+public:
+  AtlasPacker(uint32_t width, uint32_t height);
+
+  // Reserve a rectangle, returns nullopt when the page is full
+  std::optional<Rect> pack(uint32_t rectWidth, uint32_t rectHeight);
+  void reset();
+
+  uint32_t get_width() const;
+  uint32_t get_height() const;
+  float get_occupancy() const;
+};
+
+} // namespace render
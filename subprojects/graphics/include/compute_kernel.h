@@ -0,0 +1,142 @@
+#pragma once
+
+#include "buffer.h"
+#include "image.h"
+#include "logical_device.h"
+#include "shader.h"
+#include "shader_reflection.h"
+#include "vulkan/vulkan.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace render {
+
+// Compute pipeline built from the COMPUTE stage of a Shader. The descriptor
+// layout, push constants and workgroup size come from the shader reflection,
+// so kernels only name the resources they bind
+class ComputeKernel {
+public:
+  struct ComputeKernelCreateInfo {
+    std::string identifier;
+
+    // Compiled shader with a COMPUTE stage (raw pointer, not owned)
+    Shader *shader = nullptr;
+  };
+
+  struct DeviceKernelResources {
+    vk::raii::Pipeline pipeline{nullptr};
+    vk::raii::PipelineLayout pipelineLayout{nullptr};
+    vk::raii::DescriptorSetLayout descriptorLayout{nullptr};
+  };
+
+  // Resources of a dispatch, one descriptor set per device written with the
+  // same buffers and images. Sets can't change while a dispatch using them is
+  // in flight, so keep one Bindings per frame when the resources change
+  class Bindings {
+    friend class ComputeKernel;
+
+    struct BufferResource {
+      uint32_t binding;
+      device::Buffer *buffer;
+    };
+
+    // Storage images are used in the general layout and returned to layout
+    // after the dispatch, sampled images must already be in it
+    struct ImageResource {
+      uint32_t binding;
+      Image *image;
+      vk::ImageLayout layout;
+    };
+
+    const ComputeKernel *kernel;
+    std::vector<vk::raii::DescriptorSet> descriptorSets; // One per device
+    std::vector<BufferResource> buffers;
+    std::vector<ImageResource> images;
+
+    explicit Bindings(const ComputeKernel *kernel);
+
+  public:
+    // False when the shader has no buffer at binding or it is not set up
+    bool set_buffer(uint32_t binding, device::Buffer *buffer);
+    bool set_image(uint32_t binding, Image *image,
+                   vk::ImageLayout layout =
+                       vk::ImageLayout::eShaderReadOnlyOptimal);
+
+    bool is_valid() const;
+  };
+
+  struct DispatchInfo {
+    vk::Extent3D groups{1, 1, 1};
+    std::span<const std::byte> pushConstants;
+    uint32_t deviceIndex = 0;
+    // Recorded on a queue without graphics support, barriers then only
+    // reach compute and transfer work
+    bool computeOnlyQueue = false;
+  };
+
+private:
+  mutable std::mutex kernelMutex;
+  std::atomic<bool> initialized;
+
+  std::string identifier;
+  std::vector<std::unique_ptr<DeviceKernelResources>> deviceResources;
+
+  // Shader reference (not owned by the kernel)
+  Shader *shader;
+  ShaderReflection reflection;
+
+  std::vector<device::LogicalDevice *> logicalDevices;
+
+  bool create_pipeline(device::LogicalDevice *device, uint32_t deviceIndex,
+                       DeviceKernelResources &resources);
+
+  // Wait for earlier work on the bound resources before the dispatch, and
+  // make its writes visible to later work after it
+  void record_barriers(vk::raii::CommandBuffer &commandBuffer,
+                       const Bindings &bindings, const DispatchInfo &info,
+                       bool afterDispatch) const;
+
+public:
+  ComputeKernel(const std::vector<device::LogicalDevice *> &devices,
+                const ComputeKernelCreateInfo &createInfo);
+  ~ComputeKernel();
+
+  // Thread-safe initialization
+  bool initialize();
+
+  // Descriptor sets for a new set of resources, allocated on every device
+  std::unique_ptr<Bindings> create_bindings() const;
+
+  // Record barriers, the push constants and the dispatch into a command
+  // buffer of any queue with compute support, the frame command buffer
+  // included
+  void dispatch(vk::raii::CommandBuffer &commandBuffer,
+                const Bindings &bindings, const DispatchInfo &info) const;
+
+  // Groups covering a grid of threads with the reflected workgroup size
+  vk::Extent3D get_group_count(vk::Extent3D threads) const;
+
+  // Record and submit a single dispatch on the async compute queue, or the
+  // graphics one without it, and wait for it. For setup work and CPU jobs
+  // moved to the GPU
+  bool run(const Bindings &bindings, const DispatchInfo &info);
+
+  bool is_initialized() const;
+
+  vk::raii::Pipeline &get_pipeline(uint32_t deviceIndex = 0);
+  vk::raii::PipelineLayout &get_pipeline_layout(uint32_t deviceIndex = 0);
+  vk::raii::DescriptorSetLayout &
+  get_descriptor_set_layout(uint32_t deviceIndex = 0);
+
+  const std::string &get_identifier() const;
+  Shader *get_shader() const;
+  const ShaderReflection &get_reflection() const;
+};
+
+} // namespace render
@@ -42,7 +42,10 @@ public:
   void switch_multi_GPU(bool enable);
   void wait_idle();
 
-  void create_swap_chains();
+  void create_swap_chains(SwapChain::PresentPolicy presentPolicy =
+                              SwapChain::PresentPolicy::MAILBOX);
+  // Offscreen swap chains for headless rendering, without a surface
+  void create_swap_chains(vk::SurfaceFormatKHR format, vk::Extent2D extent);
   void recreate_swap_chain();
 
   void create_command_pool();
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace device {
+
+class LogicalDevice;
+
+// GPU timings from timestamp queries. Every frame slot owns a query range
+// per queue, reset when a command buffer of the slot begins and read back
+// the next time the slot begins, when the GPU is already done with it. So
+// results arrive a few frames late but reading them never stalls
+class GpuProfiler {
+public:
+  enum class Queue { GRAPHICS, COMPUTE };
+
+  struct ZoneTiming {
+    std::string name;
+    double milliseconds;
+    uint32_t depth; // Nesting level, 0 for outermost zones
+  };
+
+  struct FrameTiming {
+    uint64_t frameNumber;
+    std::vector<ZoneTiming> zones;
+  };
+
+  // Timestamps around the commands recorded during its lifetime. Does
+  // nothing without a profiler or if the command buffer did not begin a
+  // profiled frame
+  class Zone {
+    GpuProfiler *profiler;
+    const vk::raii::CommandBuffer &commandBuffer;
+    int32_t index; // -1 when not recorded
+
+  public:
+    Zone(GpuProfiler *profiler, const vk::raii::CommandBuffer &commandBuffer,
+         std::string name);
+    ~Zone();
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+    // End before the scope does, the destructor then does nothing
+    void end();
+  };
+
+private:
+  static constexpr uint32_t queriesPerRegion = 256;
+
+  struct ZoneRecord {
+    std::string name;
+    uint32_t depth;
+  };
+
+  // Queries of one queue in one frame slot, zone i uses the queries 2i and
+  // 2i + 1 of the range
+  struct Region {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // Null when not profiled
+    uint64_t frameNumber = 0;
+    std::vector<ZoneRecord> zones;
+    uint32_t depth = 0;
+  };
+
+  vk::raii::QueryPool queryPool;
+  uint32_t frameSlots;
+  std::array<uint32_t, 2> validBits; // Timestamp bits of each queue
+  float timestampPeriod;             // Nanoseconds per tick
+  bool enabled;
+  std::vector<Region> regions;
+
+  mutable std::mutex historyMutex;
+  std::deque<FrameTiming> history; // Oldest frame first
+  size_t historySize;
+
+  uint32_t region_index(uint32_t frameIndex, Queue queue) const;
+  Region *find_region(const vk::raii::CommandBuffer &commandBuffer);
+  void read_back(uint32_t regionIndex, Queue queue);
+
+  int32_t begin_zone(const vk::raii::CommandBuffer &commandBuffer,
+                     std::string name);
+  void end_zone(const vk::raii::CommandBuffer &commandBuffer, int32_t index);
+
+public:
+  GpuProfiler(LogicalDevice *logicalDevice, uint32_t frameSlots);
+  ~GpuProfiler();
+
+  // Start the queries of a frame slot in a command buffer that just began.
+  // The slot's previous work on that queue must have completed, its results
+  // are read back first
+  void begin_frame(const vk::raii::CommandBuffer &commandBuffer,
+                   uint32_t frameIndex, uint64_t frameNumber,
+                   Queue queue = Queue::GRAPHICS);
+
+  // False when the graphics queue has no timestamps
+  bool is_supported() const;
+  void set_enabled(bool enable);
+  bool is_enabled() const;
+  void set_history_size(size_t frames);
+
+  // Frames read back so far, oldest first, at most the last count. Compute
+  // zones submitted ahead can join their frame one read back later
+  std::vector<FrameTiming> get_frames(size_t count) const;
+  // Average milliseconds of each zone name over the last count frames, a
+  // zone recorded several times in a frame counts with its sum
+  std::vector<std::pair<std::string, double>>
+  get_zone_averages(size_t count) const;
+};
+
+} // namespace device
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <string>
 
 namespace render {
@@ -73,9 +74,9 @@ std::string to_string(TextureId id);
 MaterialId material_id_from_string(const std::string &str);
 TextureId texture_id_from_string(const std::string &str);
 
-// Helper function to check if a material needs per-object UBO
-// Returns true for materials that require separate transform buffers per object
-bool material_needs_per_object_ubo(const std::string &materialIdentifier);
+// Helper function to get the texture a material samples by default
+// Returns nullopt for materials whose objects always name their texture
+std::optional<TextureId> material_default_texture(MaterialId id);
 
 // Helper function to check if a material uses textured vertices
 // Returns true for materials that expect Vertex3DTextured or Vertex2DTextured
@@ -1,34 +1,70 @@
 #pragma once
 
 #include "logical_device.h"
+#include "pixel_buffer.h"
+#include "stream_batch.h"
 #include "vulkan/vulkan.hpp"
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <glm/ext/vector_float4.hpp>
+#include <span>
 #include <string>
 
+namespace bench {
+class Microbench;
+} // namespace bench
+
 namespace render {
 
 class Image {
+  // Times the private pixel operations in isolation
+  friend class bench::Microbench;
+
 public:
+  // What happens to the CPU copy of the pixels once they are on the GPU
+  enum class Residency {
+    KEEP,    // Stays in memory (default)
+    RELEASE, // Dropped, decoded again from the source file for CPU edits
+    MAPPED   // Moved to a pixel cache file and paged back in on access
+  };
+
+  // Layout the pixels are stored and uploaded in. Grey layouts are sampled
+  // as (v, v, v, a) through the view swizzle, so shaders don't change. AUTO
+  // picks the narrowest layout that holds the source
+  enum class TexelFormat {
+    AUTO,
+    R8,      // Grey or mask
+    RG8,     // Grey and alpha
+    RGBA8,   // Colour, encoded as ImageCreateInfo::format
+    RGBA16F, // 16-bit or HDR source with alpha
+    RGB9E5   // 16-bit or HDR source without alpha
+  };
+
   struct ImageCreateInfo {
     std::string identifier;
     uint32_t width = 0;
     uint32_t height = 0;
     uint32_t channels = 4; // RGBA by default
+    // Format of RGBA8 data, grey layouts follow its sRGB encoding
     vk::Format format = vk::Format::eR8G8B8A8Srgb;
+    TexelFormat texelFormat = TexelFormat::AUTO;
     vk::ImageUsageFlags usage =
         vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
     vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
     vk::Filter filter = vk::Filter::eLinear;
     vk::SamplerAddressMode addressMode = vk::SamplerAddressMode::eRepeat;
     bool generateMipmaps = false;
+    Residency residency = Residency::KEEP;
   };
 
   struct ImageResources {
     VkImage image = VK_NULL_HANDLE;
     VmaAllocation allocation = VK_NULL_HANDLE;
     vk::raii::ImageView imageView{nullptr};
-    vk::raii::Sampler sampler{nullptr};
+    vk::Sampler sampler = nullptr; // Owned by the logical device cache
     std::vector<vk::raii::DescriptorSet> descriptorSets;
   };
 
@@ -40,9 +76,57 @@ private:
   uint32_t height;
   uint32_t channels;
   uint32_t mipLevels;
-  vk::Format format;
+  bool generateMipmaps;
+  TexelFormat requestedFormat;
+  TexelFormat texelFormat;
+  vk::Format colorFormat; // RGBA8 format from the create info
+  vk::Format format;      // Follows texelFormat
+  vk::Filter filter;
+  vk::SamplerAddressMode addressMode;
+
+  PixelBuffer pixelData;
+  std::vector<std::vector<unsigned char>> mipChain; // Levels 1..mipLevels-1
+
+  // CPU residency. Pixels edited since they were decoded can't be decoded
+  // again, so RELEASE falls back to MAPPED for them and for images that were
+  // not loaded from a file
+  Residency residency;
+  std::string sourcePath;
+  bool pixelsModified;
+  bool pixelsReleased;
+
+  // Set from the main thread, read by uploads on Tasks workers
+  static std::mutex pixelCacheMutex;
+  static std::string pixelCacheDirectory;
+
+  // Most detailed level on the GPU, samplers clamp minLod to it so levels
+  // that are still streaming are never read
+  uint32_t residentMip;
+
+  // Streaming state. The full chain is allocated into streamingResources
+  // and swapped in once the copy of its last level is done, until then the
+  // previous image keeps being sampled. Copies complete in batch order
+  struct StreamedLevel {
+    std::shared_ptr<const StreamBatch> batch;
+    uint32_t level;
+  };
+  bool streaming;
+  uint32_t recordedMip; // Most detailed level recorded into a batch
+  std::vector<std::unique_ptr<ImageResources>> streamingResources;
+  std::deque<StreamedLevel> streamedLevels;
 
-  std::vector<unsigned char> pixelData;
+  // Swapped out resources that submitted frames may still read, destroyed
+  // once the frame timeline reaches frame
+  struct RetiredResources {
+    size_t deviceIndex;
+    uint64_t frame;
+    std::unique_ptr<ImageResources> resources;
+  };
+  std::vector<RetiredResources> retiredResources;
+
+  // Bumped whenever the view or sampler changes, descriptor sets holding an
+  // older generation have to be rewritten before their next use
+  std::atomic<uint64_t> generation;
 
   std::vector<device::LogicalDevice *> logicalDevices;
   std::vector<std::unique_ptr<ImageResources>> deviceResources;
@@ -52,13 +136,55 @@ private:
   bool create_image_view(device::LogicalDevice *device,
                          ImageResources &resources,
                          const ImageCreateInfo &createInfo);
+  // minLevel is the most detailed level the sampler may read
   bool create_sampler(device::LogicalDevice *device, ImageResources &resources,
-                      const ImageCreateInfo &createInfo);
+                      const ImageCreateInfo &createInfo, uint32_t minLevel);
+  // Pixel data of consecutive mip levels
+  using UploadLevels = std::vector<std::span<const unsigned char>>;
+
   bool upload_data(device::LogicalDevice *device, ImageResources &resources,
-                   const void *data, uint32_t dataSize);
+                   const UploadLevels &levels, uint32_t firstLevel,
+                   vk::ImageLayout oldLayout);
+  static bool create_staging_buffer(device::LogicalDevice *device,
+                                    const UploadLevels &data,
+                                    VkBuffer &stagingBuffer,
+                                    VmaAllocation &stagingAllocation);
+  // Copies consecutive levels packed one after another in the staging
+  // buffer. Coming from an undefined layout every level is transitioned
+  void record_upload(vk::raii::CommandBuffer &commandBuffer,
+                     ImageResources &resources, VkBuffer stagingBuffer,
+                     uint32_t firstLevel, uint32_t levelCount,
+                     vk::ImageLayout oldLayout);
+  bool recreate_resources(size_t deviceIndex);
+
+  void build_mip_chain();
+  std::span<const unsigned char> get_level_data(uint32_t level) const;
+  vk::Extent3D get_level_extent(uint32_t level) const;
+  // Mip chain ready to upload in full, rebuilt from the current pixels
+  UploadLevels prepare_upload_levels();
   void destroy_image(device::LogicalDevice *device, ImageResources &resources);
 
-  void apply_color_tint(const glm::vec4 &tint);
+  // Decode a file (data == nullptr) or an encoded buffer into the requested
+  // texel format, or the one matching the source
+  bool decode_pixels(const std::string &path, const unsigned char *data,
+                     size_t size);
+  bool assign_pixels(std::vector<unsigned char> &&data, uint32_t w,
+                     uint32_t h, uint32_t c);
+  void set_texel_format(TexelFormat newFormat);
+  // RGBA8 in place of a grey layout whose sRGB format can't be sampled
+  TexelFormat sampleable_texel_format(TexelFormat target) const;
+  void convert_pixels(TexelFormat target);
+  vk::Format resolve_format() const;
+  bool supports_sampling(vk::Format candidate) const;
+  bool is_srgb() const;
+
+  // Bring released pixels back, and apply the residency after an upload
+  bool ensure_pixels();
+  void release_pixels();
+  void finish_upload();
+
+  // Large images are split across Tasks workers unless parallel is false
+  void apply_color_tint(const glm::vec4 &tint, bool parallel = true);
   void rotate_image_90(bool clockwise);
 
 public:
@@ -69,9 +195,17 @@ public:
   // Load image from file
   bool load_from_file(const std::string &filepath);
 
+  // Decode an encoded image file (PNG, JPG, ...) already read into memory.
+  // When sourceName is the file it was read from, RELEASE may drop the
+  // pixels and decode the file again later
+  bool load_from_encoded(const unsigned char *data, size_t size,
+                         const std::string &sourceName);
+
   // Load image from memory
   bool load_from_memory(const unsigned char *data, uint32_t width,
                         uint32_t height, uint32_t channels);
+  bool load_from_memory(std::vector<unsigned char> &&data, uint32_t width,
+                        uint32_t height, uint32_t channels);
 
   // Image manipulation
   void set_color_tint(const glm::vec4 &tint);
@@ -82,17 +216,69 @@ public:
   // Upload modified data to GPU
   bool update_gpu_data();
 
+  // Upload several images with one command buffer and a single wait per
+  // device instead of a submit and queue idle per image
+  static bool update_gpu_data_batch(const std::vector<Image *> &images);
+
+  // Overwrite a rectangle of an uploaded single level image in place, so its
+  // view and the descriptor sets holding it stay valid. The pixels are in
+  // the image's texel layout, the CPU copy is patched too when it is held
+  bool update_gpu_region(const unsigned char *pixels, uint32_t x, uint32_t y,
+                         uint32_t regionWidth, uint32_t regionHeight);
+
+  // Progressive upload, smallest mip first. prepare_streaming builds the CPU
+  // mip chain and can run on a worker. begin_streaming allocates the full
+  // chain and records the copy of its last level into the frame's batch,
+  // each stream_next_mip then records the next more detailed level and
+  // returns the bytes sent. Nothing waits for the GPU: update_streaming,
+  // called every frame, swaps the new chain in and lets the samplers reach
+  // a level once the batch that copied it is complete. It returns false if
+  // a batch failed, the image then stays at the levels it already has
+  bool prepare_streaming();
+  bool begin_streaming(const std::shared_ptr<StreamBatch> &batch);
+  uint64_t stream_next_mip(const std::shared_ptr<StreamBatch> &batch);
+  bool update_streaming();
+  // Size of the next level to record, 0 once every level is recorded
+  uint64_t get_next_mip_size() const;
+  bool is_fully_resident() const;
+  uint32_t get_resident_mip() const;
+  uint32_t get_mip_levels() const;
+  uint64_t get_generation() const;
+
+  // CPU residency, release_cpu_pixels applies it right away for images that
+  // are only used as a CPU source and never uploaded
+  void set_residency(Residency mode);
+  Residency get_residency() const;
+  void release_cpu_pixels();
+  bool has_cpu_pixels() const;
+  static void set_pixel_cache_directory(const std::string &directory);
+
   // Getters
   const std::string &get_identifier() const;
   uint32_t get_width() const;
   uint32_t get_height() const;
   uint32_t get_channels() const;
   vk::Format get_format() const;
-  const std::vector<unsigned char> &get_pixel_data() const;
+  TexelFormat get_texel_format() const;
+  uint32_t get_texel_size() const;
+  static uint32_t get_texel_size(TexelFormat layout);
+  static TexelFormat choose_texel_format(uint32_t channels,
+                                         bool highPrecision);
+  // Copy of the pixels as RGBA8, for code that only handles that layout
+  std::vector<unsigned char> get_rgba8_pixels();
+  // Same for a rectangle, empty if it leaves the image
+  std::vector<unsigned char> get_rgba8_pixels(uint32_t x, uint32_t y,
+                                              uint32_t regionWidth,
+                                              uint32_t regionHeight);
+  // Calls reader with the pixels as RGBA8 while holding the image lock, so
+  // they can't be released underneath it. Only converted when stored in
+  // another format, false if the pixels couldn't be brought back
+  bool with_rgba8_pixels(
+      const std::function<void(std::span<const unsigned char>)> &reader);
 
   VkImage get_image(uint32_t deviceIndex = 0) const;
   vk::raii::ImageView &get_image_view(uint32_t deviceIndex = 0);
-  vk::raii::Sampler &get_sampler(uint32_t deviceIndex = 0);
+  vk::Sampler get_sampler(uint32_t deviceIndex = 0) const;
 };
 
 } // namespace render
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "gpu_profiler.h"
 #include "physical_device.h"
 #include "swap_chain.h"
 #include "vulkan/vulkan.hpp"
@@ -10,7 +11,9 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <span>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_raii.hpp>
@@ -32,22 +35,69 @@ private:
   vk::raii::Queue graphicsQueue;
   uint32_t graphicsQueueIndex;
 
+  // Async compute runs on its own queue next to the graphics one, from a
+  // compute-only family when there is one, else a second graphics family
+  // queue. Without either, compute work is recorded on the graphics queue
+  vk::raii::Queue computeQueue;
+  uint32_t computeQueueIndex;
+  bool asyncCompute;
+  vk::raii::CommandPool computeCommandPool;
+  std::vector<vk::raii::CommandBuffer> computeCommandBuffers;
+  // Signaled with the value of every compute submit, graphics submits wait
+  // on the value of the frame they draw
+  vk::raii::Semaphore computeTimeline;
+  uint64_t computeTimelineValue;
+  std::vector<uint64_t> computeSlotValues; // Last value of each buffer
+
+  // VK_KHR_present_id and VK_KHR_present_wait, enabled when the device
+  // supports both so presents can be waited on
+  bool presentWait;
+
   VmaAllocator allocator;
 
   std::unique_ptr<SwapChain> swapChain;
   vk::raii::CommandPool commandPool;
   std::vector<vk::raii::CommandBuffer> commandBuffers;
-  vk::raii::DescriptorPool descriptorPool;
+  // Sets come from the newest pool, a full pool is followed by one twice its
+  // size so scenes aren't capped by the first one. Pools live as long as the
+  // device, freed sets return to the pool they came from
+  std::mutex descriptorPoolMutex;
+  std::vector<vk::raii::DescriptorPool> descriptorPools;
+  uint32_t descriptorPoolSets; // Capacity of the newest pool
+  // Shared by every pipeline creation, materials of the same shader variant
+  // and state reuse the compiled pipeline instead of building it again
+  vk::raii::PipelineCache pipelineCache;
+
+  // Samplers are immutable state objects, so images with identical sampler
+  // state share a single handle instead of creating one each
+  struct SamplerCreateInfoHash {
+    size_t operator()(const vk::SamplerCreateInfo &createInfo) const;
+  };
+  mutable std::mutex samplerMutex;
+  std::unordered_map<vk::SamplerCreateInfo, vk::raii::Sampler,
+                     SamplerCreateInfoHash>
+      samplerCache;
 
   // Synchronization primitives
   std::vector<vk::raii::Semaphore> imageAvailableSemaphores;
   std::vector<vk::raii::Semaphore> renderFinishedSemaphores;
-  std::vector<vk::raii::Fence> inFlightFences;
+  // Signaled with the frame number by every frame submit, so any system
+  // can wait on or query the completion of a frame
+  vk::raii::Semaphore frameTimeline;
+  uint64_t submittedFrame;
+  std::vector<uint64_t> frameSlotValues; // Last frame of each slot
+
+  // Timestamp queries of every frame slot
+  std::unique_ptr<GpuProfiler> profiler;
 
   void thread_loop();
   void initialize_vma_allocator(vk::raii::Instance &instance);
-  void create_descriptor_pool();
+  void create_descriptor_pool(uint32_t maxSets);
   void create_sync_objects();
+  // Family and index in it of the async compute queue, false if only the
+  // graphics queue can run compute
+  bool select_compute_queue(uint32_t &family, uint32_t &index) const;
+  bool supports_present_wait() const;
 
 public:
   LogicalDevice(vk::raii::Instance &instance, PhysicalDevice *physicalDevice,
@@ -56,7 +106,9 @@ public:
 
   void create_swapchain_semaphores();
 
-  void initialize_swap_chain(GLFWwindow *window, vk::raii::SurfaceKHR &surface);
+  void initialize_swap_chain(GLFWwindow *window, vk::raii::SurfaceKHR &surface,
+                             SwapChain::PresentPolicy presentPolicy =
+                                 SwapChain::PresentPolicy::MAILBOX);
   void initialize_swap_chain(vk::SurfaceFormatKHR format, vk::Extent2D extent);
 
   void initialize_command_pool(vk::CommandPoolCreateInfo &createInfo);
@@ -65,23 +117,59 @@ public:
   void wait_idle();
   template <typename F> void submit_task(F &&task);
 
-  // Frame rendering methods
-  bool wait_for_fence(uint32_t frameIndex);
-  void reset_fence(uint32_t frameIndex);
+  // Frame rendering methods. A slot can be recorded again once the frame
+  // that last used it completed, which bounds the frames in flight
+  bool wait_for_frame_slot(uint32_t frameIndex);
   void begin_command_buffer(uint32_t frameIndex);
   void end_command_buffer(uint32_t frameIndex);
+  // Signals frameNumber on the frame timeline, frame numbers start at 1 and
+  // grow with every submit. A non-zero computeWaitValue makes the vertex and
+  // fragment work of the frame wait for that compute timeline value
   void submit_command_buffer(uint32_t frameIndex, uint32_t imageIndex,
-                             bool withSemaphores);
+                             bool withSemaphores, uint64_t frameNumber,
+                             uint64_t computeWaitValue = 0);
+
+  // Frame timeline queries, cheap enough for every frame
+  bool wait_for_frame(uint64_t frameNumber, uint64_t timeout = UINT64_MAX);
+  bool is_frame_complete(uint64_t frameNumber) const;
+  uint64_t get_completed_frame() const;
+  uint64_t get_submitted_frame() const;
+
+  // Async compute. Beginning a slot waits for its previous submit, the
+  // submit signals the compute timeline with the returned value
+  bool has_async_compute() const;
+  bool has_present_wait() const;
+  vk::raii::CommandBuffer &begin_compute_command_buffer(uint32_t frameIndex);
+  uint64_t submit_compute_command_buffer(uint32_t frameIndex);
+  bool wait_for_compute(uint64_t value);
+  const vk::raii::Semaphore &get_compute_timeline() const;
+  uint64_t get_compute_timeline_value() const;
 
   PhysicalDevice *get_physical_device() const;
   const vk::raii::Device &get_device() const;
   vk::raii::Queue &get_graphics_queue();
   uint32_t get_graphics_queue_index() const;
+  vk::raii::Queue &get_compute_queue();
+  uint32_t get_compute_queue_index() const;
+  // Families resources used by both queues are shared between, resources
+  // with more than one are created concurrent instead of transferring
+  // ownership on every hand-off
+  std::vector<uint32_t> get_queue_family_indices() const;
   SwapChain &get_swap_chain();
 
   VmaAllocator get_allocator() const;
   const vk::raii::CommandPool &get_command_pool() const;
-  const vk::raii::DescriptorPool &get_descriptor_pool() const;
+  // One set per layout, from a new pool when the current one is full.
+  // Throws like vk::raii::DescriptorSets on any other failure
+  vk::raii::DescriptorSets
+  allocate_descriptor_sets(std::span<const vk::DescriptorSetLayout> layouts);
+  const vk::raii::PipelineCache &get_pipeline_cache() const;
+  GpuProfiler &get_profiler() const;
+
+  // Returns a shared sampler matching createInfo, creating it on first use.
+  // The sampler lives as long as the logical device
+  vk::Sampler get_or_create_sampler(const vk::SamplerCreateInfo &createInfo);
+  size_t get_sampler_count() const;
   std::vector<vk::raii::CommandBuffer> &get_command_buffers();
 
   // Synchronization getters
@@ -89,7 +177,7 @@ public:
   get_image_available_semaphore(uint32_t frameIndex) const;
   const vk::raii::Semaphore &
   get_render_finished_semaphore(uint32_t imageIndex) const;
-  const vk::raii::Fence &get_in_flight_fence(uint32_t frameIndex) const;
+  const vk::raii::Semaphore &get_frame_timeline() const;
 };
 
 template <typename F> void LogicalDevice::submit_task(F &&task) {
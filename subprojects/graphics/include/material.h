@@ -25,9 +25,12 @@ public:
     Shader *shader =
         nullptr; // Use existing Shader object (raw pointer, not owned)
 
-    // Layout info
+    // Layout info, reflected from the shader when left empty
     std::vector<vk::DescriptorSetLayoutBinding> descriptorBindings;
 
+    // Texture sampled when neither the object nor its submesh names one
+    std::string defaultTexture;
+
     // pipeline states
     vk::PipelineRasterizationStateCreateInfo rasterizationState;
     vk::PipelineDepthStencilStateCreateInfo depthStencilState;
@@ -59,6 +62,8 @@ private:
 
   // Shader reference (not owned by material)
   Shader *shader;
+  // Resources the shader uses, layouts and object resources follow it
+  ShaderReflection reflection;
 
   // shared properties
   glm::vec4 color;
@@ -72,6 +77,10 @@ private:
   bool create_pipeline(device::LogicalDevice *device,
                        DeviceMaterialResources &resources,
                        const MaterialCreateInfo &createInfo);
+  // Only the pipeline, the layouts in resources must already exist
+  bool create_graphics_pipeline(device::LogicalDevice *device,
+                                DeviceMaterialResources &resources,
+                                const MaterialCreateInfo &createInfo);
 
 public:
   Material(const std::vector<device::LogicalDevice *> &devices,
@@ -81,6 +90,9 @@ public:
   // Thread-safe initialization
   bool initialize();
   bool reinitialize();
+  // Recreate the pipelines from the current shader modules, keeping the
+  // layouts. The devices must not be using the old pipelines
+  bool rebuild_pipelines();
 
   // Multi-device support
   void bind(vk::raii::CommandBuffer &commandBuffer, uint32_t deviceIndex = 0,
@@ -101,6 +113,8 @@ public:
 
   const std::string &get_identifier() const;
   Shader *get_shader() const;
+  const ShaderReflection &get_reflection() const;
+  const std::string &get_default_texture() const;
 };
 
 } // namespace render
@@ -2,8 +2,11 @@
 
 #include "device_manager.h"
 #include "material.h"
+#include "shader.h"
+#include "shader_watcher.h"
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace render {
@@ -13,11 +16,25 @@ class MaterialManager {
 private:
   const device::DeviceManager *deviceManager;
 
+  // Shader permutations keyed by source and specialization constants, shared
+  // by every material using the same variant. Declared before the materials
+  // so the shaders outlive them
+  std::unordered_map<std::string, std::unique_ptr<Shader>> shaderVariants;
   std::vector<std::unique_ptr<Material>> materials;
 
+  static std::string
+  shader_variant_key(const std::string &filePath,
+                     std::vector<Shader::SpecializationConstant> constants);
+
   void initialize_material();
 
 public:
+  // One permutation of a vertMain/fragMain source file
+  struct ShaderVariant {
+    std::string filePath;
+    std::vector<Shader::SpecializationConstant> constants;
+  };
+
   MaterialManager(device::DeviceManager *deviceManager);
   ~MaterialManager();
 
@@ -25,6 +42,21 @@ public:
   void remove_material(std::string identifier);
   void reload_materials();
 
+  // Shader of a variant, created uncompiled when it is new, in which case
+  // created is set and the caller builds it. Every permutation shares the
+  // SPIR-V of its source, only the pipelines differ
+  Shader *get_shader_variant(const ShaderVariant &variant, bool &created);
+  // Drop a variant whose build failed so the next request retries it
+  void discard_shader_variant(const Shader *shader);
+
+  // Source modules of every live material shader, without code
+  std::vector<ShaderWatcher::ModuleUpdate> get_shader_sources() const;
+  // Swap recompiled modules into the shaders using them and rebuild only the
+  // affected pipelines, returns the number of rebuilt materials. The devices
+  // must be idle
+  size_t apply_shader_updates(
+      const std::vector<ShaderWatcher::ModuleUpdate> &updates);
+
   Material *get_material(const std::string &identifier) const;
   const std::vector<Material *> &get_materials() const;
 
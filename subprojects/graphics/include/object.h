@@ -4,6 +4,7 @@
 #include "material.h"
 #include "material_manager.h"
 #include "texture_manager.h"
+#include <array>
 #include <cstdint>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/vector_float2.hpp>
@@ -12,9 +13,15 @@
 #include <string>
 #include <vector>
 
+namespace bench {
+class Microbench;
+} // namespace bench
+
 namespace render {
 
 class Object {
+  friend class bench::Microbench;
+
 public:
   struct Vertex2D {
     glm::vec2 pos;
@@ -71,15 +78,17 @@ public:
     TRANSFORM_3D  // CPU/GPU 3D rotation (X, Y, Z axes)
   };
 
+  using VertexData =
+      std::variant<std::vector<Vertex2D>, std::vector<Vertex2DTextured>,
+                   std::vector<Vertex3D>, std::vector<Vertex3DTextured>>;
+
   // Unified ObjectCreateInfo that works for all vertex types
   struct ObjectCreateInfo {
     std::string identifier;
     ObjectType type;
 
     // Geometry data
-    std::variant<std::vector<Vertex2D>, std::vector<Vertex2DTextured>,
-                 std::vector<Vertex3D>, std::vector<Vertex3DTextured>>
-        vertices;
+    VertexData vertices;
     std::vector<uint16_t> indices;
 
     // Material (shared across instances)
@@ -100,6 +109,13 @@ public:
     bool visible = true;
   };
 
+  // State the renderer draws with, copied from the simulation state so a
+  // simulation thread can update the next frame while this one is recorded
+  struct RenderSnapshot {
+    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    bool visible = true;
+  };
+
 private:
   std::string identifier;
   ObjectType type;
@@ -143,17 +159,49 @@ private:
       materialDescriptorSets;
   std::vector<device::LogicalDevice *> logicalDevices;
 
+  // Texture bound per material, with the image generation each frame's
+  // descriptor set was written with (device index -> frame index). Sets are
+  // rewritten lazily once their frame comes around again, when the image got
+  // a new view or sampler, for example after a streamed mip arrived
+  struct TextureBinding {
+    std::string textureIdentifier;
+    Image *image = nullptr;
+    uint32_t binding = 1;
+    std::vector<std::vector<uint64_t>> generations;
+  };
+  std::map<std::string, TextureBinding> textureBindings;
+
   RotationMode rotationMode;
 
+  // Double-buffered render state: draw reads snapshots[snapshotIndex] while
+  // write_snapshot fills the other slot
+  std::array<RenderSnapshot, 2> snapshots;
+  uint32_t snapshotIndex;
+
   void update_model_matrix();
   void setup_materials_for_submeshes(std::vector<Submesh> &submeshes);
   std::string get_ubo_buffer_name(const std::string &matIdentifier) const;
+  // Per-object UBO of a material, created on first use. nullptr when the
+  // material's shader has no uniform block
+  device::Buffer *create_uniform_buffer(const std::string &matIdentifier);
+
+  std::string
+  resolve_texture_identifier(const std::string &matIdentifier,
+                             const std::vector<Submesh> &submeshList) const;
+  void remap_view_texcoords(VertexData &vertexData,
+                            const std::vector<uint16_t> &indices,
+                            const std::vector<Submesh> &submeshList) const;
 
   void create_descriptor_sets();
   void create_descriptor_sets_for_material(const std::string &matIdentifier);
   void bind_texture_to_descriptor_sets(const std::string &matIdentifier,
                                        Image *image, uint32_t binding,
                                        uint32_t deviceIndex);
+  void write_texture_descriptor(vk::raii::DescriptorSet &descriptorSet,
+                                Image *image, uint32_t binding,
+                                uint32_t deviceIndex);
+  void refresh_texture_binding(const std::string &matIdentifier,
+                               uint32_t deviceIndex, uint32_t frameIndex);
   void bind_buffer_to_descriptor_sets(const std::string &matIdentifier,
                                       device::Buffer *buffer, uint32_t binding,
                                       uint32_t deviceIndex);
@@ -179,13 +227,23 @@ public:
   void set_visible(bool vis);
   void set_rotation_mode(RotationMode mode);
 
+  // Copy the current transform and visibility into the snapshot not being
+  // drawn, safe while a frame is recorded. swap_snapshot makes it the one
+  // drawn and must only run between frames
+  void write_snapshot();
+  void swap_snapshot();
+
   // Getters
   const std::string &get_identifier() const;
   ObjectType get_type() const;
   bool is_visible() const;
   const glm::mat4 &get_model_matrix();
+  const RenderSnapshot &get_snapshot() const;
   Material *get_material() const;
   RotationMode get_rotation_mode() const;
+
+  // Textures sampled by this object's materials
+  std::vector<std::string> get_texture_identifiers() const;
 };
 
 } // namespace render
@@ -10,9 +10,16 @@
 #include <unordered_map>
 #include <vector>
 
+namespace bench {
+class Microbench;
+} // namespace bench
+
 namespace render {
 
 class ObjectManager {
+  // Rebuilds and sorts the render queue without creating objects
+  friend class bench::Microbench;
+
 public:
   // Multi-GPU rendering strategies
   enum class RenderStrategy {
@@ -53,7 +60,9 @@ public:
     uint32_t streamingBufferCount = 3;
     bool enableAsyncTransfer = true;
 
-    // Multi-queue support
+    // Multi-queue support. MULTI_QUEUE_STREAMING overlaps the renderer's
+    // compute passes with graphics on the device's async compute queue, a
+    // single one per device for now
     bool useMultiQueue = true;
     uint32_t transferQueueCount = 1;
     uint32_t computeQueueCount = 1;
@@ -69,6 +78,7 @@ private:
 
   std::unordered_map<std::string, std::unique_ptr<Object>> objects;
   std::vector<Object *> renderQueue;
+  bool batching; // Queue rebuilds wait for end_batch
 
   // Material instance tracking (for shared materials)
   std::unordered_map<std::string, uint32_t>
@@ -95,9 +105,28 @@ public:
   void remove_object(const std::string &identifier);
   Object *get_object(const std::string &identifier);
 
+  // Creating or removing many objects between begin_batch and end_batch
+  // rebuilds the render queue once at the end instead of after every call.
+  // The queue is empty meanwhile, so removed objects are never drawn
+  void begin_batch();
+  void end_batch();
+
   // Rendering
   void render_all_objects(vk::raii::CommandBuffer &commandBuffer,
                           uint32_t deviceIndex, uint32_t frameIndex);
+
+  // Report every streamed texture's importance to the texture manager, from
+  // the screen-space size and distance of the objects sampling it
+  void update_streaming_priorities();
+
+  // Double-buffered object state for simulating ahead of rendering:
+  // write_snapshots may run on another thread while a frame is recorded,
+  // swap_snapshots only between frames. publish_snapshots does both, for
+  // scene updates on the render thread
+  void write_snapshots();
+  void swap_snapshots();
+  void publish_snapshots();
+
   // Synchronization
   void wait_idle();
 
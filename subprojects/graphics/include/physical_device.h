@@ -22,6 +22,7 @@ public:
 
   int calculate_score(vk::raii::SurfaceKHR &surface) const;
   bool supports_required_features();
+  // Without a surface (headless rendering) any graphics queue qualifies
   bool has_graphic_queue(vk::raii::SurfaceKHR &surface,
                          uint32_t *queueIndex = nullptr) const;
 
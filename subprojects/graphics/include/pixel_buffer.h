@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace render {
+
+// CPU copy of an image's pixels. The memory is either a vector owned here,
+// a buffer handed over by the decoder so it doesn't have to be copied, or a
+// private mapping of a pixel cache file whose pages are read back on first
+// access and copied on write
+class PixelBuffer {
+public:
+  enum class Storage { NONE, HEAP, DECODER, MAPPED };
+
+private:
+  std::vector<unsigned char> heap;
+  unsigned char *pixels;
+  size_t byteSize;
+  Storage storage;
+  void (*releaseFunction)(void *);
+
+  void reset();
+
+public:
+  PixelBuffer();
+  ~PixelBuffer();
+
+  PixelBuffer(PixelBuffer &&other) noexcept;
+  PixelBuffer &operator=(PixelBuffer &&other) noexcept;
+  PixelBuffer(const PixelBuffer &) = delete;
+  PixelBuffer &operator=(const PixelBuffer &) = delete;
+
+  static PixelBuffer allocate(size_t size);
+  static PixelBuffer copy_of(const unsigned char *data, size_t size);
+  static PixelBuffer take(std::vector<unsigned char> &&data);
+
+  // Take ownership of decoder output, freed with its release function
+  static PixelBuffer adopt(unsigned char *data, size_t size,
+                           void (*release)(void *));
+
+  // Write the pixels to a file and map it back. The file is unlinked once
+  // mapped so nothing is left behind. Returns an empty buffer on failure
+  static PixelBuffer spill_to_file(std::span<const unsigned char> data,
+                                   const std::string &path);
+
+  unsigned char *data();
+  const unsigned char *data() const;
+  size_t size() const;
+  bool empty() const;
+
+  unsigned char &operator[](size_t index);
+  const unsigned char &operator[](size_t index) const;
+
+  std::span<const unsigned char> view() const;
+  Storage get_storage() const;
+
+  void clear();
+};
+
+} // namespace render
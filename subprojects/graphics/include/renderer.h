@@ -5,21 +5,51 @@
 #include "logical_device.h"
 #include "material_manager.h"
 #include "object_manager.h"
+#include "shader_watcher.h"
 #include "texture_manager.h"
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <future>
 #include <memory>
 #include <sys/types.h>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace render {
 
 class Renderer {
+public:
+  // Frame a compute pass records work for. Passes index per-frame resources
+  // with frameIndex, and dispatch with computeOnlyQueue so barriers only
+  // name stages the queue supports
+  struct ComputeFrame {
+    uint32_t deviceIndex;
+    uint32_t frameIndex;
+    bool computeOnlyQueue;
+  };
+  using ComputePass =
+      std::function<void(vk::raii::CommandBuffer &, const ComputeFrame &)>;
+
+  // Input-to-present latency of the last report window, in milliseconds.
+  // With present wait it runs until the frame was shown, observed at the
+  // start of a later frame unless the low-latency mode waits for it.
+  // Without it, only until the present call returned
+  struct PresentLatency {
+    double lastMs = 0.0;
+    double averageMs = 0.0;
+    double maxMs = 0.0;
+    uint32_t samples = 0;
+    bool untilShown = false;
+  };
 
 private:
+  using Clock = std::chrono::steady_clock;
   GLFWwindow *window;
+  vk::Extent2D headlessExtent; // Offscreen target size without a window
   vk::detail::DynamicLoader dl;
 
   vk::raii::Context context;
@@ -38,9 +68,41 @@ private:
   std::unique_ptr<ObjectManager> objectManager;
 
   uint32_t currentFrame;
-  uint32_t frameCount; // total frames rendered
+  uint64_t frameCount; // total frames rendered, the next frame number - 1
   uint32_t currentSemaphoreIndex;
 
+  // Edited shaders are recompiled in the background and swapped in between
+  // frames, without the full reload
+  std::unique_ptr<ShaderWatcher> shaderWatcher;
+  std::future<std::vector<ShaderWatcher::ModuleUpdate>> shaderRecompile;
+
+  // Compute work of every frame. MULTI_QUEUE_STREAMING submits it one frame
+  // ahead on the async compute queue, other strategies record it before
+  // rendering in the graphics command buffer
+  std::vector<ComputePass> computePasses;
+  uint64_t computeAheadFrame; // Frame the compute submitted ahead is for
+  uint64_t computeAheadValue; // Its compute timeline value, 0 when none
+
+  // Presentation pacing
+  device::SwapChain::PresentPolicy presentPolicy;
+  double targetFrameRate; // 0 for unlimited
+  Clock::time_point nextFrameTime;
+  bool lowLatency;
+  bool framePaced;             // pace_frame ran for the coming frame
+  Clock::time_point inputTime; // When input for the coming frame was read
+
+  struct PendingPresent {
+    uint64_t presentId;
+    Clock::time_point inputTime;
+  };
+  std::deque<PendingPresent> pendingPresents;
+
+  PresentLatency presentLatency;
+  double latencySumMs;
+  double latencyMaxMs;
+  uint32_t latencySamples;
+  Clock::time_point lastLatencyReport;
+
   std::function<void()> preReloadCallback;
   std::function<void()> postReloadCallback;
 
@@ -51,6 +113,20 @@ private:
 
   void init_debug();
 
+  void process_shader_changes();
+
+  // Record the latency of presents that were shown, waiting for the newest
+  // one first when waitLatest is set
+  void collect_present_latencies(bool waitLatest);
+  void record_present_latency(Clock::duration latency, bool untilShown);
+
+  void record_compute_passes(vk::raii::CommandBuffer &commandBuffer,
+                             const ComputeFrame &frame);
+  // Record and submit the passes on the async compute queue, returns the
+  // timeline value the graphics of that frame waits for
+  uint64_t submit_compute_passes(device::LogicalDevice *device,
+                                 uint32_t frameIndex, uint64_t frameNumber);
+
   // Helper methods for drawFrame
   bool acquire_next_image(device::LogicalDevice *device, uint32_t &imageIndex,
                           uint32_t &semaphoreIndex);
@@ -58,22 +134,54 @@ private:
                      uint32_t semaphoreIndex);
 
   // Strategy-specific rendering
-  void draw_frame_single_gpu(device::LogicalDevice *device);
+  // With a computeWaitValue the frame's compute already runs on the async
+  // queue, otherwise it is recorded inline. False if nothing was submitted
+  bool draw_frame_single_gpu(device::LogicalDevice *device,
+                             uint64_t computeWaitValue = 0);
   void draw_frame_afr();
   void draw_frame_sfr(uint32_t imageIndex, uint32_t semaphoreIndex);
   void draw_frame_hybrid();
   void draw_frame_multi_queue_streaming();
 
+  Renderer(GLFWwindow *window, vk::Extent2D headlessExtent);
+
 public:
   Renderer(GLFWwindow *window);
+  // Headless: no window, surface or presentation, frames render into an
+  // offscreen swap chain of the given size
+  explicit Renderer(vk::Extent2D extent);
   ~Renderer();
 
   void reload();
   void draw_frame();
+  // Frames drawn so far, also the number of the last one
+  uint64_t get_frame_count() const;
 
   void set_render_strategy(ObjectManager::RenderStrategy strategy);
   void set_gpu_config(const ObjectManager::MultiGPUConfig &config);
 
+  // Presentation. The policy is applied by recreating the swap chain, a
+  // target frame rate of 0 leaves the frame rate unlimited
+  void set_present_policy(device::SwapChain::PresentPolicy policy);
+  device::SwapChain::PresentPolicy get_present_policy() const;
+  void set_target_frame_rate(double framesPerSecond);
+  double get_target_frame_rate() const;
+
+  // Low-latency mode: pace_frame waits for the previous frame to be shown
+  // (with present wait, else for its GPU work) so input is read as late as
+  // possible instead of queueing frames behind the display
+  void set_low_latency(bool enabled);
+  bool is_low_latency() const;
+
+  // Call right before reading input for the next frame. Applies the
+  // low-latency wait and the frame limiter and starts the latency
+  // measurement, which otherwise starts in draw_frame
+  void pace_frame();
+  const PresentLatency &get_present_latency() const;
+
+  void add_compute_pass(ComputePass pass);
+  void clear_compute_passes();
+
   void set_pre_reload_callback(std::function<void()> callback);
   void set_post_reload_callback(std::function<void()> callback);
 
@@ -82,6 +190,11 @@ public:
   TextureManager &get_texture_manager();
   device::BufferManager &get_buffer_manager();
   ObjectManager *get_object_manager();
+
+  // GPU timings of a device, with a zone per frame (named after the render
+  // strategy), swapchain transition, compute pass batch and material batch.
+  // nullptr for an unknown device index
+  device::GpuProfiler *get_gpu_profiler(uint32_t deviceIndex = 0);
 };
 
 } // namespace render
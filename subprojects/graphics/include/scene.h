@@ -26,8 +26,18 @@ protected:
   std::vector<Object *> sceneObjects;
   std::unordered_set<std::string>
       sceneTextures; // Track textures created by this scene
-  std::vector<std::unique_ptr<Shader>>
-      sceneShaders; // Track shaders created by this scene
+  std::vector<TextureManager::TextureRequest>
+      textureRequests; // Declared textures waiting for load_textures
+
+  // Material declared with request_*_material, created by load_materials
+  struct MaterialRequest {
+    std::string identifier;
+    std::string defaultTexture; // Textured materials only, may be empty
+    bool textured = false;
+    bool is2D = false;
+    bool is3DTextured = false;
+  };
+  std::vector<MaterialRequest> materialRequests;
 
   // Helper methods for creating objects with automatic index generation
   // These methods handle the common patterns of object creation
@@ -82,9 +92,35 @@ protected:
   // Helper to create a textured material
   void create_textured_material(MaterialId materialId, bool is2D);
 
+  // Batched material creation: declare every material first, then
+  // load_materials compiles all of their shaders concurrently
+  void request_basic_material(MaterialId materialId, bool is2D,
+                              bool is3DTextured = false);
+  void request_textured_material(MaterialId materialId, bool is2D);
+  // For materials generated at runtime, which have no MaterialId
+  void request_basic_material(const std::string &identifier, bool is2D,
+                              bool is3DTextured = false);
+  void request_textured_material(const std::string &identifier, bool is2D,
+                                 const std::string &defaultTexture = "");
+  void load_materials();
+
+  // Shader permutation a requested material is drawn with
+  static MaterialManager::ShaderVariant
+  material_shader_variant(const MaterialRequest &request);
+  void finish_basic_material(const MaterialRequest &request, Shader *shader);
+  // White 1x1 texture for the untextured permutation of textured.slang. Its
+  // sampler is still in the interface and must have an image bound
+  std::string fallback_texture();
+  void finish_textured_material(const MaterialRequest &request,
+                                Shader *shader);
+
   // Helper to create a texture
   void create_texture(TextureId textureId, const std::string &path);
 
+  // Helper to create a texture packed into a shared atlas page, for small
+  // images that are never modified after loading
+  void create_packed_texture(TextureId textureId, const std::string &path);
+
   // Helper to create a texture atlas
   void create_texture_atlas(TextureId textureId, const std::string &path,
                             uint32_t rows, uint32_t cols);
@@ -100,6 +136,26 @@ protected:
                               const std::vector<glm::vec4> &tints = {},
                               const std::vector<float> &rotations = {});
 
+  // Batched texture loading: declare every texture first, then load_textures
+  // decodes them in parallel and uploads them together in one wait
+  void request_texture(TextureId textureId, const std::string &path);
+  void request_texture(const std::string &identifier, const std::string &path);
+  void request_packed_texture(TextureId textureId, const std::string &path);
+  // Usable immediately at low resolution, detail streams in over frames
+  void request_streamed_texture(TextureId textureId, const std::string &path);
+  void request_texture_atlas(TextureId textureId, const std::string &path,
+                             uint32_t rows, uint32_t cols);
+  void request_layered_texture(TextureId textureId,
+                               const std::vector<std::string> &imagePaths,
+                               const std::vector<glm::vec4> &tints = {},
+                               const std::vector<float> &rotations = {});
+  void load_textures();
+
+  static std::vector<Texture::Layer>
+  build_layers(const std::vector<std::string> &imagePaths,
+               const std::vector<glm::vec4> &tints,
+               const std::vector<float> &rotations);
+
 public:
   Scene(MaterialManager *matMgr, TextureManager *texMgr,
         device::BufferManager *bufMgr, ObjectManager *objMgr);
@@ -1,11 +1,11 @@
 #pragma once
 
 #include "logical_device.h"
+#include "shader_reflection.h"
 #include "vulkan/vulkan.hpp"
 #include <memory>
 #include <mutex>
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
@@ -33,12 +33,33 @@ public:
     CALLABLE
   };
 
+  // Value of a [vk::constant_id(id)] constant, baked in at pipeline creation
+  // so the driver can remove the branches and loops depending on it. Every
+  // scalar constant is 32 bits wide, bools are 0 or 1
+  struct SpecializationConstant {
+    uint32_t id;
+    uint32_t value;
+
+    bool operator==(const SpecializationConstant &) const = default;
+  };
+
   // Information about a specific shader stage
   struct ShaderStageInfo {
     ShaderType type;
     std::string filePath;            // Path to the shader source file
     std::string entryPoint = "main"; // Entry point function name
-    std::vector<char> spirvCode;     // Compiled SPIR-V code
+    std::vector<SpecializationConstant> specializationConstants;
+    bool isCompiled = false;
+  };
+
+  // Stages sharing a source file compile together into one SPIR-V module
+  // holding all of their entry points
+  struct ShaderModuleSource {
+    std::string filePath;
+    std::vector<std::string> entryPoints;
+    std::vector<size_t> stageIndices;
+    std::vector<char> spirvCode; // Compiled SPIR-V code
+    ShaderReflection reflection; // Resources used by the entry points
     bool isCompiled = false;
   };
 
@@ -47,10 +68,16 @@ public:
     std::vector<ShaderStageInfo> stages;
   };
 
-  // Per-device shader resources
+  // Per-device shader resources, one module per source file
   struct DeviceShaderResources {
-    std::unordered_map<ShaderType, std::unique_ptr<vk::raii::ShaderModule>>
-        shaderModules;
+    std::vector<std::unique_ptr<vk::raii::ShaderModule>> shaderModules;
+  };
+
+  // Specialization data of a stage, info points into entries and data
+  struct StageSpecialization {
+    std::vector<vk::SpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+    vk::SpecializationInfo info;
   };
 
 private:
@@ -58,11 +85,15 @@ private:
 
   std::string identifier;
   std::vector<ShaderStageInfo> stages;
+  std::vector<ShaderModuleSource> modules;
+  std::vector<size_t> stageModules; // Module index of each stage
+  std::vector<StageSpecialization> specializations; // One per stage
   std::vector<device::LogicalDevice *> logicalDevices;
   std::vector<std::unique_ptr<DeviceShaderResources>> deviceResources;
 
   // Helper methods
-  bool compile_shader_from_file(ShaderStageInfo &stageInfo);
+  bool compile_module(ShaderModuleSource &moduleSource);
+  static std::string resolve_entry_point(const ShaderStageInfo &stageInfo);
   bool create_shader_module(device::LogicalDevice *device,
                             const std::vector<char> &code,
                             vk::raii::ShaderModule &shaderModule);
@@ -73,15 +104,36 @@ public:
          const ShaderCreateInfo &createInfo);
   ~Shader();
 
-  // Compile all shader stages
+  // Compile all shader stages, concurrently on the task pool
   bool compile();
 
   // Compile a specific stage
   bool compile_stage(ShaderType type);
 
+  // Compile the module at an index without taking the shader lock. Modules
+  // are independent, so different modules may compile concurrently
+  bool compile_module_at(size_t index);
+
+  // Compile one source with the given entry points through the shader
+  // cache, without touching any shader
+  static bool compile_source(const std::string &filePath,
+                             const std::vector<std::string> &entryPoints,
+                             std::vector<char> &spirv);
+
+  // Swap in new code for a module and recreate the shader modules of every
+  // device. Used by hot reload, pipelines must be rebuilt afterwards. The
+  // shader is left untouched when its resources would no longer match
+  // interface, the reflection the pipelines were built against
+  bool replace_module(size_t index, std::vector<char> spirv,
+                      const ShaderReflection &interface);
+
   // Initialize shader modules for all devices
   bool initialize();
 
+  // Create the shader modules of one device without taking the shader lock,
+  // so devices can be initialized concurrently once every stage compiled
+  bool initialize_device(size_t deviceIndex);
+
   // Get shader module for a specific device and stage
   vk::raii::ShaderModule *get_shader_module(ShaderType type,
                                             uint32_t deviceIndex = 0);
@@ -96,11 +148,24 @@ public:
   // Get all shader stages
   const std::vector<ShaderStageInfo> &get_stages() const;
 
+  // Get the source modules the stages compile into
+  const std::vector<ShaderModuleSource> &get_modules() const;
+
+  // Resource interface of all stages, read from the compiled SPIR-V
+  ShaderReflection get_reflection() const;
+
   // Getters
   const std::string &get_identifier() const;
+  size_t get_device_count() const;
 
   // Static helper to convert shader type to string
   static std::string shader_type_to_string(ShaderType type);
+
+  // Fill entries and data for constants, sorted by id with later duplicates
+  // winning, and point info at them
+  static void build_specialization(
+      const std::vector<SpecializationConstant> &constants,
+      StageSpecialization &specialization);
 };
 
 } // namespace render
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "shader.h"
+#include <unordered_set>
+#include <vector>
+
+namespace render {
+
+// Builds many shaders at once. Every module of every added shader is spread
+// over the task pool, modules sharing a source file and entry points compile
+// once and reuse the cached SPIR-V, then shader modules are created for all
+// devices in parallel. No shader lock is held while this runs, so the added
+// shaders must not be used until build returns
+class ShaderBuilder {
+private:
+  std::vector<Shader *> shaders;
+  std::unordered_set<const Shader *> failedShaders;
+
+public:
+  void add(Shader *shader);
+
+  // Compile and initialize everything added, false if any shader failed
+  bool build();
+
+  bool succeeded(const Shader *shader) const;
+  size_t get_shader_count() const;
+};
+
+} // namespace render
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace render {
+
+// Content addressed store for compiled SPIR-V. Entries are keyed by a hash of
+// the source, every file it includes or imports, the full compiler argument
+// list and the compiler version, so an unchanged shader never reaches the
+// compiler and concurrent compiles never share an output file
+class ShaderCache {
+public:
+  struct KeyInfo {
+    std::filesystem::path sourcePath;
+    // Flags and entry points, without the input and output paths
+    std::vector<std::string> arguments;
+    std::string compilerVersion;
+  };
+
+private:
+  mutable std::mutex cacheMutex;
+  std::filesystem::path directory;
+  bool enabled;
+
+  ShaderCache();
+
+  static std::vector<std::filesystem::path>
+  parse_dependencies(const std::filesystem::path &file,
+                     const std::string &contents);
+
+public:
+  ~ShaderCache() = default;
+  ShaderCache(ShaderCache &&) = delete;
+  ShaderCache &operator=(ShaderCache &&) = delete;
+  ShaderCache(const ShaderCache &) = delete;
+  ShaderCache &operator=(const ShaderCache &) = delete;
+  static ShaderCache &get_instance();
+
+  void set_directory(const std::filesystem::path &path);
+  std::filesystem::path get_directory() const;
+  void set_enabled(bool enable);
+  bool is_enabled() const;
+
+  // Source followed by its transitive includes, each file once. Also used
+  // by hot reload to find the shaders an edited include belongs to. False
+  // when a file can't be read, that file is then the last one listed
+  static bool collect_dependencies(const std::filesystem::path &sourcePath,
+                                   std::vector<std::filesystem::path> &files);
+
+  // Hex key, nullopt when the source or one of its includes can't be read
+  std::optional<std::string> compute_key(const KeyInfo &info) const;
+
+  bool load(const std::string &key, std::vector<char> &spirv) const;
+
+  // Written to a unique staging file and renamed into place, so parallel
+  // stores of one key never interleave
+  bool store(const std::string &key, const std::vector<char> &spirv) const;
+};
+
+} // namespace render
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vulkan/vulkan.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace render {
+
+// Resource interface of compiled SPIR-V: descriptor bindings with their
+// types, array sizes, stages and uniform block sizes, plus the push constant
+// range. Read straight from the module, so layouts always match the shader
+class ShaderReflection {
+public:
+  struct Binding {
+    std::string name;
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    vk::DescriptorType type = vk::DescriptorType::eUniformBuffer;
+    uint32_t count = 1;
+    vk::ShaderStageFlags stages;
+    uint32_t size = 0; // Block size of uniform and storage buffers
+    bool readOnly = false; // Storage resource declared NonWritable
+  };
+
+private:
+  std::vector<Binding> bindings;
+  std::vector<vk::PushConstantRange> pushConstantRanges;
+  vk::Extent3D localSize{1, 1, 1}; // Workgroup size of a compute entry point
+
+  void merge_binding(const Binding &binding);
+
+public:
+  // Reflect the resources used by the given entry points, all entry points
+  // when the list is empty. False if the code is not valid SPIR-V
+  static bool reflect(const std::vector<char> &spirv,
+                      const std::vector<std::string> &entryPoints,
+                      ShaderReflection &reflection);
+
+  // Combine the interface of another module, stages of shared bindings are
+  // merged and the push constant ranges joined into one
+  void merge(const ShaderReflection &other);
+
+  const std::vector<Binding> &get_bindings() const;
+  const std::vector<vk::PushConstantRange> &get_push_constant_ranges() const;
+
+  // Layout bindings of one descriptor set, sorted by binding
+  std::vector<vk::DescriptorSetLayoutBinding>
+  get_set_layout_bindings(uint32_t set = 0) const;
+  uint32_t get_set_count() const;
+  vk::Extent3D get_local_size() const;
+
+  const Binding *find_binding(uint32_t set, uint32_t binding) const;
+  // First binding of a type in the lowest set, nullptr if there is none
+  const Binding *find_first(vk::DescriptorType type) const;
+
+  bool operator==(const ShaderReflection &other) const;
+};
+
+} // namespace render
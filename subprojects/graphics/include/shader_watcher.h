@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace render {
+
+// Watches a shader directory with inotify and collects the .slang files that
+// were written, so edited shaders can be recompiled without a full reload.
+// Sub directories are watched as well, including ones created later. On
+// platforms without inotify the watcher stays inactive
+class ShaderWatcher {
+public:
+  // A compiled source, matched against Shader modules by path and entries
+  struct ModuleUpdate {
+    std::string filePath;
+    std::vector<std::string> entryPoints;
+    std::vector<char> spirvCode;
+  };
+
+private:
+  std::filesystem::path directory;
+  int inotifyFd;
+  std::unordered_map<int, std::filesystem::path> watches;
+
+  std::thread watchThread;
+  std::atomic<bool> running;
+
+  mutable std::mutex changeMutex;
+  std::unordered_set<std::string> changedFiles;
+  std::chrono::steady_clock::time_point lastChange;
+
+  bool add_watch(const std::filesystem::path &path);
+  void watch_loop();
+
+public:
+  // Editors save in bursts, changes are held back until this much time
+  // passed without another write
+  static constexpr std::chrono::milliseconds settleTime{100};
+
+  ShaderWatcher(const std::filesystem::path &directory);
+  ~ShaderWatcher();
+  ShaderWatcher(const ShaderWatcher &) = delete;
+  ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+  bool is_active() const;
+
+  // Changed files once the burst settled, empty otherwise
+  std::vector<std::filesystem::path> take_changes();
+
+  // Recompile every module whose source or one of its includes is in
+  // changedFiles. Modules failing to compile are left out, so the running
+  // pipelines stay in place until the source is fixed
+  static std::vector<ModuleUpdate>
+  recompile(std::vector<ModuleUpdate> modules,
+            const std::vector<std::filesystem::path> &changedFiles);
+};
+
+} // namespace render
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace render {
+
+// Compiles Slang shaders to SPIR-V with the slangc shipped in slang-bin.
+// slangc is started directly, without a shell, and gets slang-bin/lib on its
+// library path. One instance is shared by every thread: each compile runs
+// its own slangc and errors are kept per calling thread
+class SlangCompiler {
+private:
+  static thread_local std::string lastError;
+  std::mutex initMutex;
+  bool initialized;
+
+  bool initialize();
+
+  static std::filesystem::path get_slangc_path();
+  // Output collects stdout and stderr, false if slangc couldn't be started
+  // or exited with an error
+  static bool run_slangc(const std::vector<std::string> &arguments,
+                         std::string &output);
+
+public:
+  SlangCompiler();
+  ~SlangCompiler() = default;
+  SlangCompiler(const SlangCompiler &) = delete;
+  SlangCompiler &operator=(const SlangCompiler &) = delete;
+
+  // One module holding every entry point
+  bool compile(const std::filesystem::path &sourcePath,
+               const std::vector<std::string> &entryPoints,
+               std::vector<char> &spirv);
+
+  // Of the calling thread
+  const std::string &get_last_error() const;
+
+  // Version reported by slangc, queried once per process. Part of the shader
+  // cache key, so SPIR-V built by another compiler version is never reused
+  static const std::string &get_version();
+
+  // Every slangc flag and entry point of a compile, without the input and
+  // output paths. Hashed into the shader cache key, so changing any of them
+  // never reuses SPIR-V built with the old ones
+  static std::vector<std::string>
+  get_arguments(const std::vector<std::string> &entryPoints);
+
+  // SPIR-V profile every shader is compiled for
+  static constexpr const char *targetProfile = "spirv_1_4";
+};
+
+} // namespace render
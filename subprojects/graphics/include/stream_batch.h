@@ -0,0 +1,52 @@
+#pragma once
+
+#include "logical_device.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace render {
+
+// One frame's worth of streamed texture copies: a command buffer per device
+// that every image records into, submitted once to the graphics queue
+// without waiting. Each submit signals a fence that is polled, never waited
+// on, so frames keep going while the copies run. Staging buffers live until
+// the copies are complete
+class StreamBatch {
+private:
+  struct DeviceBatch {
+    device::LogicalDevice *device;
+    std::vector<vk::raii::CommandBuffer> commandBuffers; // Empty until used
+    std::vector<std::pair<VkBuffer, VmaAllocation>> stagingBuffers;
+    vk::raii::Fence fence{nullptr}; // Set once submitted
+  };
+
+  std::vector<DeviceBatch> deviceBatches;
+  bool submitted;
+  bool failed; // A device didn't get its copies
+
+public:
+  explicit StreamBatch(const std::vector<device::LogicalDevice *> &devices);
+  ~StreamBatch();
+  StreamBatch(const StreamBatch &) = delete;
+  StreamBatch &operator=(const StreamBatch &) = delete;
+
+  // Begins the device's command buffer on first use, throws like
+  // allocateCommandBuffers when it can't be allocated
+  vk::raii::CommandBuffer &get_command_buffer(size_t deviceIndex);
+  // Freed with the batch, once the copies reading it are complete
+  void add_staging_buffer(size_t deviceIndex, VkBuffer buffer,
+                          VmaAllocation allocation);
+
+  // False if nothing was recorded or a submit failed
+  bool submit();
+  // Polls the fences, doesn't block
+  bool is_submitted() const;
+  bool is_complete() const;
+  bool has_failed() const;
+};
+
+} // namespace render
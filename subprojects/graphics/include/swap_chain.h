@@ -10,6 +10,15 @@ namespace device {
 class LogicalDevice;
 
 class SwapChain {
+public:
+  // How frames reach the screen, modes the surface lacks fall back to FIFO
+  enum class PresentPolicy {
+    VSYNC,     // FIFO, no tearing, waits for the vertical blank
+    MAILBOX,   // Newest frame replaces the queued one, no tearing
+    IMMEDIATE, // No waiting, may tear, else MAILBOX
+    RELAXED    // FIFO that tears instead of waiting when a frame is late
+  };
+
 private:
   LogicalDevice *logicalDevice;
 
@@ -21,9 +30,9 @@ private:
   std::vector<vk::Image> swapChainImages;
   std::vector<vk::raii::ImageView> swapChainImageViews;
 
-  // swap chain without presentation
+  // swap chain without presentation, a single image that is listed as the
+  // only swap chain image so frames record the same way
   vk::raii::Image image;
-  vk::raii::ImageView imageView;
   vk::raii::DeviceMemory imageMemory;
 
   // depth buffer
@@ -35,11 +44,20 @@ private:
   vk::SurfaceFormatKHR surfaceFormat;
   vk::Extent2D extent2D;
 
+  PresentPolicy presentPolicy;
+  vk::PresentModeKHR presentMode;
+  // Id of the last present, restarting with every swap chain. Only used
+  // with present wait
+  uint64_t lastPresentId;
+
   void set_surface_format(std::vector<vk::SurfaceFormatKHR> availableFormats);
+  vk::PresentModeKHR
+  select_present_mode(const std::vector<vk::PresentModeKHR> &available) const;
 
 public:
   SwapChain(LogicalDevice *logicalDevice, GLFWwindow *window,
-            vk::raii::SurfaceKHR &surface);
+            vk::raii::SurfaceKHR &surface,
+            PresentPolicy presentPolicy = PresentPolicy::MAILBOX);
   SwapChain(LogicalDevice *logicalDevice, vk::SurfaceFormatKHR format,
             vk::Extent2D extent2D);
   ~SwapChain();
@@ -54,6 +72,11 @@ public:
   void recreate_swap_chain();
   void recreate_swap_chain(vk::SurfaceFormatKHR format, vk::Extent2D extent);
 
+  // False for the swap chain without presentation, which is never acquired
+  // or presented: acquiring returns its image right away and it ends the
+  // frame ready for transfers instead of presentation
+  bool is_presentable() const;
+
   // Frame rendering helpers
   vk::ResultValue<uint32_t>
   acquire_next_image(const vk::raii::Semaphore &semaphore);
@@ -65,6 +88,19 @@ public:
                        uint32_t imageIndex);
   void end_rendering(vk::raii::CommandBuffer &commandBuffer);
 
+  // Takes effect when the swap chain is next created
+  void set_present_policy(PresentPolicy policy);
+  PresentPolicy get_present_policy() const;
+  vk::PresentModeKHR get_present_mode() const;
+
+  // Present wait: ids to chain into presents with vk::PresentIdKHR and a
+  // wait for their presentation. The wait returns eSuccess once the id was
+  // shown, eTimeout, or eErrorOutOfDateKHR for ids this swap chain never
+  // presented
+  bool supports_present_wait() const;
+  uint64_t next_present_id();
+  vk::Result wait_for_present(uint64_t presentId, uint64_t timeout) const;
+
   vk::SurfaceFormatKHR get_surface_format();
   vk::Extent2D get_extent2D();
   vk::raii::SwapchainKHR &get_swap_chain();
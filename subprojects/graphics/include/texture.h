@@ -6,11 +6,21 @@
 #include <string>
 #include <vector>
 
+namespace bench {
+class Microbench;
+} // namespace bench
+
 namespace render {
 
+class TextureManager;
+
 class Texture {
+  friend class bench::Microbench;
+
 public:
-  enum class TextureType { SINGLE, ATLAS, LAYERED };
+  // VIEW textures reference a rectangle of an image owned elsewhere, such as
+  // a shared atlas page or a region of an ATLAS texture
+  enum class TextureType { SINGLE, ATLAS, LAYERED, VIEW };
 
   struct AtlasRegion {
     std::string name;
@@ -40,6 +50,9 @@ public:
     std::string imagePath; // Path to image file (for SINGLE type)
     std::vector<AtlasRegion> atlasRegions; // For texture atlases
     std::vector<Layer> layers;             // For layered textures
+    Image *viewImage = nullptr;            // For VIEW textures (not owned)
+    AtlasRegion viewRegion = {};           // For VIEW textures
+    Image::Residency residency = Image::Residency::KEEP; // CPU pixel copies
   };
 
 private:
@@ -48,6 +61,7 @@ private:
   std::string identifier;
   TextureType type;
   std::string imagePath;
+  Image::Residency residency;
   std::unique_ptr<Image> image;
   std::vector<AtlasRegion> atlasRegions;
 
@@ -57,9 +71,18 @@ private:
 
   // Layered texture support
   std::vector<Layer> layers;
-  std::unordered_map<std::string, std::unique_ptr<Image>> imageCache;
   std::unique_ptr<Image> compositedImage;
 
+  // Layer images come from the manager's shared cache and are released on
+  // destruction, textures created without a manager own theirs
+  TextureManager *textureManager;
+  std::vector<Image *> acquiredImages;
+  std::unordered_map<std::string, std::unique_ptr<Image>> imageCache;
+
+  // View support, the image belongs to the atlas page or source texture
+  Image *viewImage;
+  AtlasRegion viewRegion;
+
   std::vector<device::LogicalDevice *> logicalDevices;
 
   // Helper methods
@@ -69,21 +92,24 @@ private:
   Image *load_or_get_cached_image(const std::string &imagePath);
   bool composite_layers();
   std::vector<unsigned char>
-  apply_rotation(const std::vector<unsigned char> &pixels, uint32_t width,
+  apply_rotation(std::span<const unsigned char> pixels, uint32_t width,
                  uint32_t height, uint32_t channels, float rotation);
-  std::vector<unsigned char>
-  apply_tint(const std::vector<unsigned char> &pixels, uint32_t channels,
-             const glm::vec4 &tint);
+  std::vector<unsigned char> apply_tint(std::span<const unsigned char> pixels,
+                                        uint32_t channels,
+                                        const glm::vec4 &tint);
   void blend_layer(std::vector<unsigned char> &dst,
-                   const std::vector<unsigned char> &src, uint32_t width,
+                   std::span<const unsigned char> src, uint32_t width,
                    uint32_t height);
 
 public:
   Texture(const std::vector<device::LogicalDevice *> &devices,
-          const TextureCreateInfo &createInfo);
+          const TextureCreateInfo &createInfo,
+          TextureManager *textureManager = nullptr);
   ~Texture();
 
-  // Load texture
+  // Load texture, decode() is the CPU half and can run on a worker thread,
+  // the image is then uploaded with update_gpu or in a batch
+  bool decode();
   bool load();
 
   // For texture atlases
@@ -122,6 +148,11 @@ public:
   Image *get_image() const;
   uint32_t get_width() const;
   uint32_t get_height() const;
+
+  // View helpers, map a 0..1 texture coordinate into the viewed rectangle
+  bool is_view() const;
+  const AtlasRegion &get_view_region() const;
+  glm::vec2 map_uv(const glm::vec2 &uv) const;
 };
 
 } // namespace render
@@ -1,12 +1,27 @@
 #pragma once
 
+#include "atlas_packer.h"
 #include "device_manager.h"
 #include "texture.h"
+#include <future>
 #include <mutex>
 
 namespace render {
 
 class TextureManager {
+public:
+  // A texture declared up front, see create_textures
+  struct TextureRequest {
+    std::string identifier;
+    Texture::TextureType type = Texture::TextureType::SINGLE;
+    std::string imagePath;               // SINGLE and ATLAS
+    uint32_t atlasRows = 0;              // ATLAS
+    uint32_t atlasCols = 0;              // ATLAS
+    std::vector<Texture::Layer> layers;  // LAYERED
+    bool packed = false;                 // SINGLE, pack into an atlas page
+    bool streamed = false;               // SINGLE, see stream_texture
+  };
+
 private:
   mutable std::mutex managerMutex;
 
@@ -14,6 +29,77 @@ private:
 
   std::unordered_map<std::string, std::unique_ptr<Texture>> textures;
 
+  // Shared atlas pages for packed textures. Packed images wait as pending
+  // rectangles until flush_atlas_pages, which uploads a new page in full and
+  // writes later rectangles into the live page in place, so descriptor sets
+  // bound to it stay valid. A page whose last view is removed starts over
+  struct AtlasPage {
+    struct PendingRect {
+      AtlasPacker::Rect rect;
+      std::vector<unsigned char> pixels; // RGBA8, padding included
+    };
+
+    std::unique_ptr<Image> image;
+    AtlasPacker packer;
+    std::vector<PendingRect> pending;
+    bool uploaded = false;
+  };
+
+  static constexpr uint32_t atlasPageSize = 2048;
+  // Border around every packed image, filled by extruding its edge texels.
+  // Allocations are also aligned to it so the first mip levels don't bleed
+  static constexpr uint32_t atlasPadding = 4;
+
+  std::vector<std::unique_ptr<AtlasPage>> atlasPages;
+
+  // What textures created from now on do with their CPU pixels after upload
+  std::atomic<Image::Residency> cpuResidency = Image::Residency::KEEP;
+
+  // Where a source image's content was packed, keyed by content hash
+  struct PackedContent {
+    Image *page;
+    Texture::AtlasRegion region;
+  };
+  std::unordered_map<uint64_t, PackedContent> packedContent;
+
+  // Live view textures per viewed image, pages are reset once theirs drop
+  // to zero
+  std::unordered_map<Image *, uint32_t> viewCounts;
+
+  // Process-wide cache of decoded source images. Files are hashed before
+  // decoding so identical content is decoded once, whichever path, texture or
+  // scene asks for it. Has its own mutex because layered textures acquire
+  // images from worker tasks while managerMutex is held
+  struct CachedImage {
+    std::unique_ptr<Image> image;
+    uint32_t refCount = 0;
+  };
+  mutable std::mutex cacheMutex;
+  std::unordered_map<uint64_t, CachedImage> imageCache;
+  std::unordered_map<std::string, uint64_t> pathHashes;
+
+  // Textures whose mips are still on their way to the GPU. Decoding and mip
+  // generation run on a worker, process_streaming records the copies of a
+  // frame into one batch, most important texture first, until the per-frame
+  // budget is spent. Batches are kept until the GPU is done with them
+  struct StreamingTexture {
+    Texture *texture;
+    std::future<bool> prepared;
+    bool started = false;
+    float priority = 0.0f;
+  };
+  mutable std::mutex streamingMutex;
+  std::unordered_map<std::string, StreamingTexture> streamingTextures;
+  std::vector<std::shared_ptr<StreamBatch>> streamBatches;
+  uint64_t uploadBudget = 4 * 1024 * 1024;
+
+  Texture *create_view_locked(const std::string &identifier, Image *image,
+                              const Texture::AtlasRegion &region);
+  Texture *pack_pixels_locked(const std::string &identifier,
+                              const unsigned char *pixels, uint32_t width,
+                              uint32_t height);
+  void release_view_locked(Image *image);
+
 public:
   TextureManager(const device::DeviceManager *deviceManager);
   ~TextureManager();
@@ -34,7 +120,63 @@ public:
   // Create a texture with custom configuration
   Texture *create_texture(const Texture::TextureCreateInfo &createInfo);
 
-  // Remove a texture
+  // Create a texture packed into a shared atlas page. The result is a view,
+  // texture coordinates of objects using it are remapped into its rectangle,
+  // so it can't rely on repeat addressing or be tinted/rotated afterwards.
+  // It is on the GPU after the next flush_atlas_pages, create_textures
+  // flushes once for its whole batch
+  Texture *create_packed_texture(const std::string &identifier,
+                                 const std::string &filepath);
+  Texture *create_packed_texture(const std::string &identifier,
+                                 const unsigned char *pixels, uint32_t width,
+                                 uint32_t height);
+
+  // Create a view into a region of an existing texture without copying it.
+  // The source can't be removed while views of it exist, and filtering near
+  // the region's edge samples the texels around it
+  Texture *create_texture_view(const std::string &identifier,
+                               const std::string &sourceIdentifier,
+                               const Texture::AtlasRegion &region);
+
+  // Copy a region of an existing texture into an atlas page, padded like
+  // any packed image so filtering never reaches its neighbours
+  Texture *create_packed_region(const std::string &identifier,
+                                const std::string &sourceIdentifier,
+                                const Texture::AtlasRegion &region);
+
+  // Shared decoded images, every acquire must be paired with a release
+  Image *acquire_image(const std::string &filepath,
+                       uint64_t *contentHash = nullptr);
+  void release_image(Image *image);
+  size_t get_cached_image_count() const;
+
+  // CPU residency of the textures and cached images created afterwards.
+  // Anything other than KEEP drops or maps the pixel copies once uploaded
+  void set_cpu_residency(Image::Residency residency);
+
+  // Upload atlas pages that received new images since the last flush
+  bool flush_atlas_pages();
+  size_t get_atlas_page_count() const;
+
+  // Create a set of textures at once: every request is decoded in parallel
+  // on the task pool and the results are uploaded in a single batch. Returns
+  // the textures in request order, nullptr for the ones that failed
+  std::vector<Texture *>
+  create_textures(const std::vector<TextureRequest> &requests);
+
+  // Create a texture that is usable right away and streams in from its
+  // smallest mip to the full resolution over the following frames
+  Texture *stream_texture(const std::string &identifier,
+                          const std::string &filepath);
+  void set_stream_priority(const std::string &identifier, float priority);
+  void set_upload_budget(uint64_t bytesPerFrame);
+
+  // Called once per frame before recording, never waits for the GPU.
+  // Returns the bytes submitted
+  uint64_t process_streaming();
+  size_t get_streaming_count() const;
+
+  // Remove a texture, refused while view textures still use its image
   void remove_texture(const std::string &identifier);
 
   // Get texture by identifier
@@ -3,6 +3,7 @@
 #include "renderer.h"
 #include "scene.h"
 #include <GLFW/glfw3.h>
+#include <future>
 #include <memory>
 #include <string>
 
@@ -25,6 +26,13 @@ private:
   // Scene management
   std::vector<std::unique_ptr<Scene>> scenes;
   size_t currentSceneIndex;
+  bool sceneChanged; // Scenes were switched or recreated this frame
+
+  // Pipelined simulation: Scene::update for the next frame runs on a worker
+  // while the current frame is recorded and submitted from the previous
+  // object snapshots
+  bool pipelinedSimulation;
+  std::future<void> simulation;
 
   static void frame_buffer_resize_callback(GLFWwindow *window, int width,
                                            int height);
@@ -33,13 +41,23 @@ private:
 
   void create_scenes();
   void switch_scene();
+  // Rebuild the stress scene, when active, with factor times the objects
+  void scale_stress_scene(float factor);
   void update_current_scene();
 
+  void start_simulation();
+  // Wait for the simulation stage, false if none was running
+  bool finish_simulation();
+
+  void cycle_present_policy();
+
 public:
   Window(int width, int height, std::string title);
   ~Window();
 
   void run();
+
+  void set_pipelined_simulation(bool enabled);
 };
 
 } // namespace render
@@ -0,0 +1,130 @@
+#include "atlas_packer.h"
+#include <algorithm>
+#include <limits>
+
+render::AtlasPacker::AtlasPacker(uint32_t width, uint32_t height)
+    : width(width), height(height), usedArea(0) {
+  reset();
+}
+
+bool render::AtlasPacker::fits(size_t nodeIndex, uint32_t rectWidth,
+                               uint32_t rectHeight, uint32_t &outY) const {
+  uint32_t x = skyline[nodeIndex].x;
+  if (x + rectWidth > width) {
+    return false;
+  }
+
+  // The rectangle rests on the highest skyline segment it spans
+  uint32_t y = skyline[nodeIndex].y;
+  int64_t widthLeft = rectWidth;
+  size_t i = nodeIndex;
+
+  while (widthLeft > 0) {
+    if (i >= skyline.size()) {
+      return false;
+    }
+
+    y = std::max(y, skyline[i].y);
+    if (y + rectHeight > height) {
+      return false;
+    }
+
+    widthLeft -= skyline[i].width;
+    ++i;
+  }
+
+  outY = y;
+  return true;
+}
+
+void render::AtlasPacker::add_skyline_level(size_t nodeIndex,
+                                            const Rect &rect) {
+  skyline.insert(skyline.begin() + nodeIndex,
+                 {rect.x, rect.y + rect.height, rect.width});
+
+  // Trim or remove the segments now covered by the new level
+  for (size_t i = nodeIndex + 1; i < skyline.size();) {
+    const auto &previous = skyline[i - 1];
+    uint32_t previousEnd = previous.x + previous.width;
+
+    if (skyline[i].x >= previousEnd) {
+      break;
+    }
+
+    uint32_t shrink = previousEnd - skyline[i].x;
+    if (skyline[i].width <= shrink) {
+      skyline.erase(skyline.begin() + i);
+      continue;
+    }
+
+    skyline[i].x += shrink;
+    skyline[i].width -= shrink;
+    break;
+  }
+
+  merge_skylines();
+}
+
+void render::AtlasPacker::merge_skylines() {
+  for (size_t i = 0; i + 1 < skyline.size();) {
+    if (skyline[i].y == skyline[i + 1].y) {
+      skyline[i].width += skyline[i + 1].width;
+      skyline.erase(skyline.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
+std::optional<render::AtlasPacker::Rect>
+render::AtlasPacker::pack(uint32_t rectWidth, uint32_t rectHeight) {
+  if (rectWidth == 0 || rectHeight == 0 || rectWidth > width ||
+      rectHeight > height) {
+    return std::nullopt;
+  }
+
+  // Bottom-left heuristic: lowest resulting top edge, then narrowest segment
+  size_t bestIndex = std::numeric_limits<size_t>::max();
+  uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+  uint32_t bestWidth = std::numeric_limits<uint32_t>::max();
+  Rect best{};
+
+  for (size_t i = 0; i < skyline.size(); ++i) {
+    uint32_t y = 0;
+    if (!fits(i, rectWidth, rectHeight, y)) {
+      continue;
+    }
+
+    uint32_t top = y + rectHeight;
+    if (top < bestTop || (top == bestTop && skyline[i].width < bestWidth)) {
+      bestIndex = i;
+      bestTop = top;
+      bestWidth = skyline[i].width;
+      best = {skyline[i].x, y, rectWidth, rectHeight};
+    }
+  }
+
+  if (bestIndex == std::numeric_limits<size_t>::max()) {
+    return std::nullopt;
+  }
+
+  add_skyline_level(bestIndex, best);
+  usedArea += static_cast<uint64_t>(rectWidth) * rectHeight;
+
+  return best;
+}
+
+void render::AtlasPacker::reset() {
+  skyline.clear();
+  skyline.push_back({0, 0, width});
+  usedArea = 0;
+}
+
+uint32_t render::AtlasPacker::get_width() const { return width; }
+
+uint32_t render::AtlasPacker::get_height() const { return height; }
+
+float render::AtlasPacker::get_occupancy() const {
+  return static_cast<float>(static_cast<double>(usedArea) /
+                            (static_cast<double>(width) * height));
+}
@@ -1,6 +1,7 @@
 #include "buffer.h"
 #include "config.h"
 #include "logical_device.h"
+#include "trace.h"
 #include "vulkan/vulkan.hpp"
 #include <cstddef>
 #include <future>
@@ -98,13 +99,22 @@ device::Buffer::~Buffer() {
 bool device::Buffer::create_buffer(LogicalDevice *device,
                                    BufferResources &resources,
                                    const void *initialData) {
+  TRACE_ZONE("Buffer::create_buffer");
   VmaAllocator allocator = device->get_allocator();
 
+  // Storage buffers are what async compute writes and graphics reads
+  std::vector<uint32_t> families = device->get_queue_family_indices();
+  bool shared = type == BufferType::STORAGE && families.size() > 1;
+
   VkBufferCreateInfo bufferInfo = {
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
       .size = size,
       .usage = static_cast<VkBufferUsageFlags>(get_buffer_usage_flags(type)),
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+      .sharingMode =
+          shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount =
+          shared ? static_cast<uint32_t>(families.size()) : 0,
+      .pQueueFamilyIndices = shared ? families.data() : nullptr};
 
   VmaAllocationCreateInfo allocInfo = {.flags = get_allocation_flags(usage),
                                        .usage = get_memory_usage(usage)};
@@ -238,13 +248,7 @@ bool device::Buffer::create_descriptor_sets_for_buffer(
     std::vector<vk::DescriptorSetLayout> layouts(
         maxFrames, *resources.descriptorSetLayout);
 
-    vk::DescriptorSetAllocateInfo allocInfo{.descriptorPool =
-                                                *device->get_descriptor_pool(),
-                                            .descriptorSetCount = maxFrames,
-                                            .pSetLayouts = layouts.data()};
-
-    resources.descriptorSets =
-        vk::raii::DescriptorSets(device->get_device(), allocInfo);
+    resources.descriptorSets = device->allocate_descriptor_sets(layouts);
 
     // Update descriptor sets to point to this buffer
     for (uint32_t i = 0; i < maxFrames; ++i) {
@@ -320,6 +324,7 @@ device::Buffer::get_allocation_flags(BufferUsage usage) {
 
 bool device::Buffer::update_data(const void *data, vk::DeviceSize dataSize,
                                  vk::DeviceSize offset) {
+  TRACE_ZONE("Buffer::update_data");
   if (usage != BufferUsage::DYNAMIC) {
     std::print("Cannot update static buffer {}\n", identifier);
     return false;
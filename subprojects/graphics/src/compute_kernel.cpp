@@ -0,0 +1,496 @@
+#include "compute_kernel.h"
+#include "vulkan/vulkan.hpp"
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace {
+
+bool is_buffer_type(vk::DescriptorType type) {
+  return type == vk::DescriptorType::eUniformBuffer ||
+         type == vk::DescriptorType::eStorageBuffer;
+}
+
+bool is_image_type(vk::DescriptorType type) {
+  return type == vk::DescriptorType::eStorageImage ||
+         type == vk::DescriptorType::eSampledImage ||
+         type == vk::DescriptorType::eCombinedImageSampler;
+}
+
+vk::ImageSubresourceRange color_range() {
+  return {.aspectMask = vk::ImageAspectFlagBits::eColor,
+          .baseMipLevel = 0,
+          .levelCount = vk::RemainingMipLevels,
+          .baseArrayLayer = 0,
+          .layerCount = vk::RemainingArrayLayers};
+}
+
+} // namespace
+
+render::ComputeKernel::Bindings::Bindings(const ComputeKernel *kernel)
+    : kernel(kernel) {}
+
+bool render::ComputeKernel::Bindings::set_buffer(uint32_t binding,
+                                                 device::Buffer *buffer) {
+  const auto *reflected = kernel->reflection.find_binding(0, binding);
+  if (!reflected || !is_buffer_type(reflected->type) || !buffer) {
+    std::print(stderr, "ComputeKernel - {} - no buffer at binding {}\n",
+               kernel->identifier, binding);
+    return false;
+  }
+
+  for (size_t i = 0; i < descriptorSets.size(); ++i) {
+    vk::DescriptorBufferInfo bufferInfo{
+        .buffer = buffer->get_buffer(static_cast<uint32_t>(i)),
+        .offset = 0,
+        .range = vk::WholeSize};
+
+    vk::WriteDescriptorSet descriptorWrite{.dstSet = *descriptorSets[i],
+                                           .dstBinding = binding,
+                                           .dstArrayElement = 0,
+                                           .descriptorCount = 1,
+                                           .descriptorType = reflected->type,
+                                           .pBufferInfo = &bufferInfo};
+
+    kernel->logicalDevices[i]->get_device().updateDescriptorSets(
+        descriptorWrite, nullptr);
+  }
+
+  std::erase_if(buffers, [binding](const BufferResource &resource) {
+    return resource.binding == binding;
+  });
+  buffers.push_back({.binding = binding, .buffer = buffer});
+  return true;
+}
+
+bool render::ComputeKernel::Bindings::set_image(uint32_t binding, Image *image,
+                                                vk::ImageLayout layout) {
+  const auto *reflected = kernel->reflection.find_binding(0, binding);
+  if (!reflected || !is_image_type(reflected->type) || !image) {
+    std::print(stderr, "ComputeKernel - {} - no image at binding {}\n",
+               kernel->identifier, binding);
+    return false;
+  }
+
+  bool storage = reflected->type == vk::DescriptorType::eStorageImage;
+
+  for (size_t i = 0; i < descriptorSets.size(); ++i) {
+    auto *device = kernel->logicalDevices[i];
+    uint32_t deviceIndex = static_cast<uint32_t>(i);
+
+    // sRGB and most compressed formats can't be written from a shader
+    if (storage && !(device->get_physical_device()
+                         ->get_device()
+                         .getFormatProperties(image->get_format())
+                         .optimalTilingFeatures &
+                     vk::FormatFeatureFlagBits::eStorageImage)) {
+      std::print(stderr,
+                 "ComputeKernel - {} - format {} of {} has no storage "
+                 "support\n",
+                 kernel->identifier, vk::to_string(image->get_format()),
+                 image->get_identifier());
+      return false;
+    }
+
+    vk::DescriptorImageInfo imageInfo{
+        .sampler = reflected->type == vk::DescriptorType::eCombinedImageSampler
+                       ? image->get_sampler(deviceIndex)
+                       : nullptr,
+        .imageView = *image->get_image_view(deviceIndex),
+        .imageLayout = storage ? vk::ImageLayout::eGeneral : layout};
+
+    vk::WriteDescriptorSet descriptorWrite{.dstSet = *descriptorSets[i],
+                                           .dstBinding = binding,
+                                           .dstArrayElement = 0,
+                                           .descriptorCount = 1,
+                                           .descriptorType = reflected->type,
+                                           .pImageInfo = &imageInfo};
+
+    device->get_device().updateDescriptorSets(descriptorWrite, nullptr);
+  }
+
+  std::erase_if(images, [binding](const ImageResource &resource) {
+    return resource.binding == binding;
+  });
+  images.push_back({.binding = binding, .image = image, .layout = layout});
+  return true;
+}
+
+bool render::ComputeKernel::Bindings::is_valid() const {
+  return descriptorSets.size() == kernel->logicalDevices.size();
+}
+
+render::ComputeKernel::ComputeKernel(
+    const std::vector<device::LogicalDevice *> &devices,
+    const ComputeKernelCreateInfo &createInfo)
+    : initialized(false), identifier(createInfo.identifier),
+      shader(createInfo.shader), logicalDevices(devices) {
+
+  deviceResources.reserve(logicalDevices.size());
+  for (size_t i = 0; i < logicalDevices.size(); ++i) {
+    deviceResources.push_back(std::make_unique<DeviceKernelResources>());
+  }
+
+  if (shader) {
+    reflection = shader->get_reflection();
+    if (reflection.get_set_count() > 1) {
+      std::print(stderr,
+                 "ComputeKernel - {} - shader uses {} descriptor sets, only "
+                 "set 0 is bound\n",
+                 identifier, reflection.get_set_count());
+    }
+  }
+
+  initialize();
+}
+
+render::ComputeKernel::~ComputeKernel() {
+
+  std::lock_guard lock(kernelMutex);
+
+  deviceResources.clear();
+
+  std::print("ComputeKernel - {} - destructor executed\n", identifier);
+}
+
+bool render::ComputeKernel::create_pipeline(device::LogicalDevice *device,
+                                            uint32_t deviceIndex,
+                                            DeviceKernelResources &resources) {
+  try {
+    auto layoutBindings = reflection.get_set_layout_bindings(0);
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{
+        .bindingCount = static_cast<uint32_t>(layoutBindings.size()),
+        .pBindings = layoutBindings.data()};
+    resources.descriptorLayout =
+        device->get_device().createDescriptorSetLayout(layoutInfo);
+
+    const auto &pushConstantRanges = reflection.get_push_constant_ranges();
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{
+        .setLayoutCount = 1,
+        .pSetLayouts = &*resources.descriptorLayout,
+        .pushConstantRangeCount =
+            static_cast<uint32_t>(pushConstantRanges.size()),
+        .pPushConstantRanges = pushConstantRanges.data()};
+    resources.pipelineLayout =
+        device->get_device().createPipelineLayout(pipelineLayoutInfo);
+
+    vk::PipelineShaderStageCreateInfo stageInfo;
+    for (const auto &candidate :
+         shader->get_pipeline_stage_infos(deviceIndex)) {
+      if (candidate.stage == vk::ShaderStageFlagBits::eCompute) {
+        stageInfo = candidate;
+      }
+    }
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo{
+        .stage = stageInfo, .layout = *resources.pipelineLayout};
+
+    resources.pipeline = device->get_device().createComputePipeline(
+        device->get_pipeline_cache(), pipelineCreateInfo);
+
+    return true;
+  } catch (const std::exception &e) {
+    std::print(
+        stderr, "ComputeKernel - {} - failed to create pipeline for {}: {}\n",
+        identifier,
+        device->get_physical_device()->get_properties().deviceName.data(),
+        e.what());
+    return false;
+  }
+}
+
+bool render::ComputeKernel::initialize() {
+  std::lock_guard lock(kernelMutex);
+
+  if (initialized) {
+    return true;
+  }
+
+  if (!shader || !shader->has_stage(Shader::ShaderType::COMPUTE)) {
+    std::print(stderr, "ComputeKernel - {} - no compute shader provided\n",
+               identifier);
+    return false;
+  }
+
+  std::vector<std::future<bool>> futures;
+
+  for (size_t i = 0; i < logicalDevices.size(); ++i) {
+    auto *device = logicalDevices[i];
+    auto &resources = *deviceResources[i];
+    uint32_t deviceIndex = static_cast<uint32_t>(i);
+
+    auto promise = std::make_shared<std::promise<bool>>();
+    futures.push_back(promise->get_future());
+
+    device->submit_task([this, device, deviceIndex, &resources, promise]() {
+      promise->set_value(create_pipeline(device, deviceIndex, resources));
+    });
+  }
+
+  bool allSuccess = true;
+  for (auto &future : futures) {
+    if (!future.get()) {
+      allSuccess = false;
+    }
+  }
+
+  if (!allSuccess) {
+    std::print(stderr, "ComputeKernel - {} - failed to initialize\n",
+               identifier);
+    return false;
+  }
+
+  initialized = true;
+  std::print("ComputeKernel - {} - initialized with workgroup {}x{}x{}\n",
+             identifier, reflection.get_local_size().width,
+             reflection.get_local_size().height,
+             reflection.get_local_size().depth);
+  return true;
+}
+
+std::unique_ptr<render::ComputeKernel::Bindings>
+render::ComputeKernel::create_bindings() const {
+  auto bindings = std::unique_ptr<Bindings>(new Bindings(this));
+  if (!initialized) {
+    return bindings;
+  }
+
+  try {
+    for (size_t i = 0; i < logicalDevices.size(); ++i) {
+      auto *device = logicalDevices[i];
+      vk::DescriptorSetLayout layout = *deviceResources[i]->descriptorLayout;
+
+      vk::raii::DescriptorSets sets =
+          device->allocate_descriptor_sets({&layout, 1});
+      bindings->descriptorSets.push_back(std::move(sets.front()));
+    }
+  } catch (const std::exception &e) {
+    std::print(stderr,
+               "ComputeKernel - {} - failed to allocate descriptor sets: {}\n",
+               identifier, e.what());
+    bindings->descriptorSets.clear();
+  }
+
+  return bindings;
+}
+
+void render::ComputeKernel::record_barriers(
+    vk::raii::CommandBuffer &commandBuffer, const Bindings &bindings,
+    const DispatchInfo &info, bool afterDispatch) const {
+  // Stages a compute-only queue can't name are left out of the masks
+  vk::PipelineStageFlags otherStages =
+      vk::PipelineStageFlagBits::eTransfer |
+      vk::PipelineStageFlagBits::eDrawIndirect |
+      vk::PipelineStageFlagBits::eComputeShader;
+  vk::AccessFlags otherReads = vk::AccessFlagBits::eShaderRead |
+                               vk::AccessFlagBits::eTransferRead |
+                               vk::AccessFlagBits::eIndirectCommandRead;
+  if (!info.computeOnlyQueue) {
+    otherStages |= vk::PipelineStageFlagBits::eVertexInput |
+                   vk::PipelineStageFlagBits::eVertexShader |
+                   vk::PipelineStageFlagBits::eFragmentShader;
+    otherReads |= vk::AccessFlagBits::eVertexAttributeRead |
+                  vk::AccessFlagBits::eIndexRead |
+                  vk::AccessFlagBits::eUniformRead;
+  }
+  vk::AccessFlags writes =
+      vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+  vk::AccessFlags kernelAccess =
+      vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+  std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+  for (const auto &resource : bindings.buffers) {
+    const auto *reflected = reflection.find_binding(0, resource.binding);
+    bool written = reflected &&
+                   reflected->type == vk::DescriptorType::eStorageBuffer &&
+                   !reflected->readOnly;
+    if (afterDispatch && !written) {
+      continue;
+    }
+
+    bufferBarriers.push_back(
+        {.srcAccessMask = afterDispatch ? vk::AccessFlagBits::eShaderWrite
+                                        : writes,
+         .dstAccessMask = afterDispatch ? otherReads | writes : kernelAccess,
+         .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+         .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+         .buffer = resource.buffer->get_buffer(info.deviceIndex),
+         .offset = 0,
+         .size = vk::WholeSize});
+  }
+
+  std::vector<vk::ImageMemoryBarrier> imageBarriers;
+  for (const auto &resource : bindings.images) {
+    const auto *reflected = reflection.find_binding(0, resource.binding);
+    if (!reflected || reflected->type != vk::DescriptorType::eStorageImage) {
+      continue;
+    }
+
+    // The previous contents are kept, the layout only changes around the
+    // dispatch
+    imageBarriers.push_back(
+        {.srcAccessMask = afterDispatch ? vk::AccessFlagBits::eShaderWrite
+                                        : writes,
+         .dstAccessMask = afterDispatch ? otherReads | writes : kernelAccess,
+         .oldLayout =
+             afterDispatch ? vk::ImageLayout::eGeneral : resource.layout,
+         .newLayout =
+             afterDispatch ? resource.layout : vk::ImageLayout::eGeneral,
+         .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+         .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+         .image = resource.image->get_image(info.deviceIndex),
+         .subresourceRange = color_range()});
+  }
+
+  if (bufferBarriers.empty() && imageBarriers.empty()) {
+    return;
+  }
+
+  commandBuffer.pipelineBarrier(
+      afterDispatch ? vk::PipelineStageFlags(
+                          vk::PipelineStageFlagBits::eComputeShader)
+                    : otherStages,
+      afterDispatch ? otherStages
+                    : vk::PipelineStageFlags(
+                          vk::PipelineStageFlagBits::eComputeShader),
+      {}, nullptr, bufferBarriers, imageBarriers);
+}
+
+void render::ComputeKernel::dispatch(vk::raii::CommandBuffer &commandBuffer,
+                                     const Bindings &bindings,
+                                     const DispatchInfo &info) const {
+  if (!initialized) {
+    std::print("Warning: Cannot dispatch uninitialized kernel '{}'\n",
+               identifier);
+    return;
+  }
+
+  if (info.deviceIndex >= deviceResources.size() || !bindings.is_valid() ||
+      bindings.kernel != this) {
+    std::print("Warning: Invalid bindings or device index {} for kernel "
+               "'{}'\n",
+               info.deviceIndex, identifier);
+    return;
+  }
+
+  const DeviceKernelResources &resources = *deviceResources[info.deviceIndex];
+
+  record_barriers(commandBuffer, bindings, info, false);
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             *resources.pipeline);
+  commandBuffer.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, *resources.pipelineLayout, 0,
+      {*bindings.descriptorSets[info.deviceIndex]}, {});
+
+  const auto &pushConstantRanges = reflection.get_push_constant_ranges();
+  if (!info.pushConstants.empty() && !pushConstantRanges.empty()) {
+    const auto &range = pushConstantRanges.front();
+    uint32_t size = std::min(static_cast<uint32_t>(info.pushConstants.size()),
+                             range.size);
+    commandBuffer.pushConstants<std::byte>(
+        *resources.pipelineLayout, range.stageFlags, range.offset,
+        vk::ArrayProxy<const std::byte>(size, info.pushConstants.data()));
+  }
+
+  commandBuffer.dispatch(info.groups.width, info.groups.height,
+                         info.groups.depth);
+
+  record_barriers(commandBuffer, bindings, info, true);
+}
+
+vk::Extent3D
+render::ComputeKernel::get_group_count(vk::Extent3D threads) const {
+  vk::Extent3D localSize = reflection.get_local_size();
+  return {(threads.width + localSize.width - 1) / localSize.width,
+          (threads.height + localSize.height - 1) / localSize.height,
+          (threads.depth + localSize.depth - 1) / localSize.depth};
+}
+
+bool render::ComputeKernel::run(const Bindings &bindings,
+                                const DispatchInfo &info) {
+  if (!initialized || info.deviceIndex >= logicalDevices.size()) {
+    return false;
+  }
+
+  auto *device = logicalDevices[info.deviceIndex];
+
+  // Runs on the async compute queue when the device has one, with its own
+  // pool so it never touches the command buffers of the frames in flight
+  uint32_t family = device->get_compute_queue_index();
+  DispatchInfo queueInfo = info;
+  queueInfo.computeOnlyQueue =
+      !(device->get_physical_device()->get_queue_families()[family].queueFlags &
+        vk::QueueFlagBits::eGraphics);
+
+  try {
+    vk::raii::CommandPool commandPool(
+        device->get_device(),
+        {.flags = vk::CommandPoolCreateFlagBits::eTransient,
+         .queueFamilyIndex = family});
+
+    vk::CommandBufferAllocateInfo allocateInfo{
+        .commandPool = *commandPool,
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1};
+
+    auto commandBuffers =
+        device->get_device().allocateCommandBuffers(allocateInfo);
+    auto &commandBuffer = commandBuffers[0];
+
+    commandBuffer.begin(
+        {.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    dispatch(commandBuffer, bindings, queueInfo);
+    commandBuffer.end();
+
+    // A fence waits for this submit only, not for the frames in flight
+    vk::raii::Fence fence = device->get_device().createFence({});
+    vk::SubmitInfo submitInfo{.commandBufferCount = 1,
+                              .pCommandBuffers = &*commandBuffer};
+    device->get_compute_queue().submit(submitInfo, *fence);
+
+    if (device->get_device().waitForFences(*fence, vk::True, UINT64_MAX) !=
+        vk::Result::eSuccess) {
+      std::print(stderr, "ComputeKernel - {} - wait for dispatch failed\n",
+                 identifier);
+      return false;
+    }
+    return true;
+  } catch (const std::exception &e) {
+    std::print(stderr, "ComputeKernel - {} - dispatch failed: {}\n",
+               identifier, e.what());
+    return false;
+  }
+}
+
+bool render::ComputeKernel::is_initialized() const { return initialized; }
+
+vk::raii::Pipeline &render::ComputeKernel::get_pipeline(uint32_t deviceIndex) {
+  return deviceResources[deviceIndex]->pipeline;
+}
+
+vk::raii::PipelineLayout &
+render::ComputeKernel::get_pipeline_layout(uint32_t deviceIndex) {
+  return deviceResources[deviceIndex]->pipelineLayout;
+}
+
+vk::raii::DescriptorSetLayout &
+render::ComputeKernel::get_descriptor_set_layout(uint32_t deviceIndex) {
+  return deviceResources[deviceIndex]->descriptorLayout;
+}
+
+const std::string &render::ComputeKernel::get_identifier() const {
+  return identifier;
+}
+
+render::Shader *render::ComputeKernel::get_shader() const { return shader; }
+
+const render::ShaderReflection &
+render::ComputeKernel::get_reflection() const {
+  return reflection;
+}
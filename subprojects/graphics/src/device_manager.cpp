@@ -221,10 +221,11 @@ void device::DeviceManager::wait_idle() {
   }
 }
 
-void device::DeviceManager::create_swap_chains() {
+void device::DeviceManager::create_swap_chains(
+    SwapChain::PresentPolicy presentPolicy) {
   std::print("Creating swap chains...\n");
 
-  primaryDevice->initialize_swap_chain(window, surface);
+  primaryDevice->initialize_swap_chain(window, surface, presentPolicy);
   std::print("✓ Primary device swap chain created\n");
 
   if (multiGPUEnabled) {
@@ -248,6 +249,31 @@ void device::DeviceManager::create_swap_chains() {
   }
 }
 
+void device::DeviceManager::create_swap_chains(vk::SurfaceFormatKHR format,
+                                               vk::Extent2D extent) {
+  std::print("Creating offscreen swap chains ({}x{})...\n", extent.width,
+             extent.height);
+
+  primaryDevice->initialize_swap_chain(format, extent);
+  std::print("✓ Primary device swap chain created\n");
+
+  if (multiGPUEnabled) {
+    for (auto &device : secondaryDevices) {
+      try {
+        device->initialize_swap_chain(format, extent);
+        std::print(
+            "✓ Secondary device swap chain created: {}\n",
+            device->get_physical_device()->get_properties().deviceName.data());
+      } catch (const std::exception &e) {
+        std::fprintf(
+            stderr, "✗ Failed to create swap chain for %s: %s\n",
+            device->get_physical_device()->get_properties().deviceName.data(),
+            e.what());
+      }
+    }
+  }
+}
+
 void device::DeviceManager::recreate_swap_chain() {
 
   std::print("Recreating swap chains...\n");
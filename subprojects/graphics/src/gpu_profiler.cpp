@@ -0,0 +1,227 @@
+#include "gpu_profiler.h"
+#include "logical_device.h"
+#include "physical_device.h"
+#include "vulkan/vulkan.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <print>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+device::GpuProfiler::Zone::Zone(GpuProfiler *profiler,
+                                const vk::raii::CommandBuffer &commandBuffer,
+                                std::string name)
+    : profiler(profiler), commandBuffer(commandBuffer), index(-1) {
+  if (profiler) {
+    index = profiler->begin_zone(commandBuffer, std::move(name));
+  }
+}
+
+device::GpuProfiler::Zone::~Zone() { end(); }
+
+void device::GpuProfiler::Zone::end() {
+  if (index >= 0) {
+    profiler->end_zone(commandBuffer, index);
+    index = -1;
+  }
+}
+
+device::GpuProfiler::GpuProfiler(LogicalDevice *logicalDevice,
+                                 uint32_t frameSlots)
+    : queryPool(nullptr), frameSlots(frameSlots), validBits({0, 0}),
+      timestampPeriod(0.0f), enabled(true), historySize(120) {
+  const PhysicalDevice *physicalDevice = logicalDevice->get_physical_device();
+  const auto &families = physicalDevice->get_queue_families();
+  validBits[static_cast<size_t>(Queue::GRAPHICS)] =
+      families[logicalDevice->get_graphics_queue_index()].timestampValidBits;
+  validBits[static_cast<size_t>(Queue::COMPUTE)] =
+      families[logicalDevice->get_compute_queue_index()].timestampValidBits;
+  timestampPeriod = physicalDevice->get_properties().limits.timestampPeriod;
+
+  if (!is_supported()) {
+    std::print("GpuProfiler - {} - no timestamp support, profiling disabled\n",
+               physicalDevice->get_properties().deviceName.data());
+    return;
+  }
+
+  regions.resize(frameSlots * 2);
+  queryPool = logicalDevice->get_device().createQueryPool(
+      {.queryType = vk::QueryType::eTimestamp,
+       .queryCount = frameSlots * 2 * queriesPerRegion});
+}
+
+device::GpuProfiler::~GpuProfiler() { queryPool.clear(); }
+
+uint32_t device::GpuProfiler::region_index(uint32_t frameIndex,
+                                           Queue queue) const {
+  return frameIndex * 2 + static_cast<uint32_t>(queue);
+}
+
+device::GpuProfiler::Region *
+device::GpuProfiler::find_region(const vk::raii::CommandBuffer &commandBuffer) {
+  auto it = std::ranges::find(regions,
+                              static_cast<VkCommandBuffer>(*commandBuffer),
+                              &Region::commandBuffer);
+  return it != regions.end() ? &*it : nullptr;
+}
+
+void device::GpuProfiler::read_back(uint32_t regionIndex, Queue queue) {
+  Region &region = regions[regionIndex];
+  if (region.frameNumber == 0 || region.zones.empty()) {
+    return;
+  }
+
+  const uint32_t count = static_cast<uint32_t>(region.zones.size() * 2);
+  // No wait flag: a frame that was never submitted stays not ready and is
+  // dropped instead of blocking
+  auto [result, timestamps] = queryPool.getResults<uint64_t>(
+      regionIndex * queriesPerRegion, count, count * sizeof(uint64_t),
+      sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+  if (result != vk::Result::eSuccess) {
+    return;
+  }
+
+  // Unused high bits are undefined, masking also handles wrap-around
+  const uint32_t bits = validBits[static_cast<size_t>(queue)];
+  const uint64_t mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+
+  std::vector<ZoneTiming> zones;
+  zones.reserve(region.zones.size());
+  for (size_t i = 0; i < region.zones.size(); ++i) {
+    const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & mask;
+    zones.push_back({.name = std::move(region.zones[i].name),
+                     .milliseconds = static_cast<double>(ticks) *
+                                     timestampPeriod / 1e6,
+                     .depth = region.zones[i].depth});
+  }
+
+  std::lock_guard lock(historyMutex);
+  auto it = std::ranges::find_if(history, [&region](const auto &frame) {
+    return frame.frameNumber >= region.frameNumber;
+  });
+  if (it == history.end() || it->frameNumber != region.frameNumber) {
+    // Older than everything kept, the frame was already trimmed
+    if (it == history.begin() && history.size() >= historySize) {
+      return;
+    }
+    it = history.insert(it, FrameTiming{.frameNumber = region.frameNumber});
+  }
+  std::ranges::move(zones, std::back_inserter(it->zones));
+
+  while (history.size() > historySize) {
+    history.pop_front();
+  }
+}
+
+void device::GpuProfiler::begin_frame(
+    const vk::raii::CommandBuffer &commandBuffer, uint32_t frameIndex,
+    uint64_t frameNumber, Queue queue) {
+  if (!is_supported() || frameIndex >= frameSlots) {
+    return;
+  }
+
+  const uint32_t index = region_index(frameIndex, queue);
+  read_back(index, queue);
+
+  Region &region = regions[index];
+  region.zones.clear();
+  region.depth = 0;
+
+  if (!enabled || validBits[static_cast<size_t>(queue)] == 0) {
+    region.commandBuffer = VK_NULL_HANDLE;
+    region.frameNumber = 0;
+    return;
+  }
+
+  commandBuffer.resetQueryPool(*queryPool, index * queriesPerRegion,
+                               queriesPerRegion);
+  region.commandBuffer = static_cast<VkCommandBuffer>(*commandBuffer);
+  region.frameNumber = frameNumber;
+}
+
+int32_t
+device::GpuProfiler::begin_zone(const vk::raii::CommandBuffer &commandBuffer,
+                                std::string name) {
+  Region *region = find_region(commandBuffer);
+  if (!region || region->zones.size() * 2 >= queriesPerRegion) {
+    return -1;
+  }
+
+  const auto zone = static_cast<uint32_t>(region->zones.size());
+  const uint32_t first =
+      static_cast<uint32_t>(region - regions.data()) * queriesPerRegion;
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                               *queryPool, first + zone * 2);
+  region->zones.push_back({.name = std::move(name), .depth = region->depth});
+  ++region->depth;
+
+  return static_cast<int32_t>(zone);
+}
+
+void device::GpuProfiler::end_zone(const vk::raii::CommandBuffer &commandBuffer,
+                                   int32_t index) {
+  Region *region = find_region(commandBuffer);
+  if (!region || static_cast<size_t>(index) >= region->zones.size()) {
+    return;
+  }
+
+  const uint32_t first =
+      static_cast<uint32_t>(region - regions.data()) * queriesPerRegion;
+  commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                               *queryPool, first + index * 2 + 1);
+  --region->depth;
+}
+
+bool device::GpuProfiler::is_supported() const {
+  return validBits[static_cast<size_t>(Queue::GRAPHICS)] > 0;
+}
+
+void device::GpuProfiler::set_enabled(bool enable) { enabled = enable; }
+
+bool device::GpuProfiler::is_enabled() const { return enabled; }
+
+void device::GpuProfiler::set_history_size(size_t frames) {
+  std::lock_guard lock(historyMutex);
+  historySize = std::max<size_t>(frames, 1);
+  while (history.size() > historySize) {
+    history.pop_front();
+  }
+}
+
+std::vector<device::GpuProfiler::FrameTiming>
+device::GpuProfiler::get_frames(size_t count) const {
+  std::lock_guard lock(historyMutex);
+  const size_t first = history.size() - std::min(count, history.size());
+  return {history.begin() + first, history.end()};
+}
+
+std::vector<std::pair<std::string, double>>
+device::GpuProfiler::get_zone_averages(size_t count) const {
+  const auto frames = get_frames(count);
+  if (frames.empty()) {
+    return {};
+  }
+
+  // Keep the order zones first appeared in
+  std::vector<std::pair<std::string, double>> averages;
+  std::unordered_map<std::string, size_t> indices;
+  for (const auto &frame : frames) {
+    for (const auto &zone : frame.zones) {
+      auto [it, inserted] = indices.try_emplace(zone.name, averages.size());
+      if (inserted) {
+        averages.emplace_back(zone.name, 0.0);
+      }
+      averages[it->second].second += zone.milliseconds;
+    }
+  }
+
+  for (auto &[name, milliseconds] : averages) {
+    milliseconds /= static_cast<double>(frames.size());
+  }
+  return averages;
+}
@@ -155,36 +155,38 @@ TextureId texture_id_from_string(const std::string &str) {
   throw std::runtime_error("Unknown texture identifier: " + str);
 }
 
-bool material_needs_per_object_ubo(const std::string &materialIdentifier) {
-  // Materials that need per-object UBOs are those with transform uniforms
-  // This includes all materials in our current system except for potential
-  // future materials that might not need transforms
-  //
-  // The naming convention is:
-  // - Materials starting with "simple_shaders" need UBOs (basic colored
-  // materials)
-  // - Materials starting with "Textured" or "TEXTURED" need UBOs (textured
-  // materials)
-  //
-  // This function centralizes the logic so adding new materials following
-  // these naming conventions automatically works without code changes
-
-  if (materialIdentifier.empty()) {
-    return false;
-  }
-
-  // Check for simple_shaders prefix (case-sensitive)
-  if (materialIdentifier.rfind("simple_shaders", 0) == 0) {
-    return true;
-  }
-
-  // Check for Textured prefix (handles both "Textured" and "TEXTURED")
-  if (materialIdentifier.rfind("Textured", 0) == 0 ||
-      materialIdentifier.rfind("TEXTURED", 0) == 0) {
-    return true;
+std::optional<TextureId> material_default_texture(MaterialId id) {
+  switch (id) {
+  case MaterialId::TEXTURED_CHECKERBOARD:
+  case MaterialId::TEXTURED_3D_CHECKERBOARD:
+    return TextureId::CHECKERBOARD;
+  case MaterialId::TEXTURED_GRADIENT:
+  case MaterialId::TEXTURED_3D_GRADIENT:
+    return TextureId::GRADIENT;
+  case MaterialId::TEXTURED_ATLAS:
+  case MaterialId::TEXTURED_3D_ATLAS:
+    return TextureId::ATLAS;
+  case MaterialId::TEXTURED_3D_ATLAS_0_0:
+    return TextureId::ATLAS_0_0;
+  case MaterialId::TEXTURED_3D_ATLAS_0_1:
+    return TextureId::ATLAS_0_1;
+  case MaterialId::TEXTURED_3D_ATLAS_1_0:
+    return TextureId::ATLAS_1_0;
+  case MaterialId::TEXTURED_3D_ATLAS_1_1:
+    return TextureId::ATLAS_1_1;
+  case MaterialId::TEXTURED_3D_LAYERED_CUBE_1:
+    return TextureId::LAYERED_CUBE_1;
+  case MaterialId::TEXTURED_3D_LAYERED_CUBE_2:
+    return TextureId::LAYERED_CUBE_2;
+  case MaterialId::TEXTURED_3D_LAYERED_CUBE_3:
+    return TextureId::LAYERED_CUBE_3;
+  case MaterialId::TEXTURED_3D_LAYERED_CUBE_4:
+    return TextureId::LAYERED_CUBE_4;
+  case MaterialId::TEXTURED_3D_LAYERED_CUBE_5:
+    return TextureId::LAYERED_CUBE_5;
+  default:
+    return std::nullopt;
   }
-
-  return false;
 }
 
 bool material_uses_textured_vertices(MaterialId id) {
@@ -1,22 +1,170 @@
 #include "image.h"
 #include "tasks.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
 #include <future>
+#include <glm/gtc/packing.hpp>
 #include <print>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+namespace {
+
+using TexelFormat = render::Image::TexelFormat;
+
+uint32_t channel_count(TexelFormat format) {
+  switch (format) {
+  case TexelFormat::R8:
+    return 1;
+  case TexelFormat::RG8:
+    return 2;
+  case TexelFormat::RGB9E5:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+bool is_float_format(TexelFormat format) {
+  return format == TexelFormat::RGBA16F || format == TexelFormat::RGB9E5;
+}
+
+float srgb_to_linear(float value) {
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linear_to_srgb(float value) {
+  value = std::clamp(value, 0.0f, 1.0f);
+  return value <= 0.0031308f ? value * 12.92f
+                             : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+float luminance(const glm::vec4 &value) {
+  return 0.299f * value.r + 0.587f * value.g + 0.114f * value.b;
+}
+
+unsigned char to_unorm8(float value) {
+  return static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f +
+                                    0.5f);
+}
+
+// 8-bit layouts return their stored values normalised, float layouts linear
+// values. Grey layouts expand to (v, v, v, a)
+glm::vec4 read_texel(TexelFormat format, const unsigned char *texel) {
+  switch (format) {
+  case TexelFormat::R8: {
+    float v = texel[0] / 255.0f;
+    return {v, v, v, 1.0f};
+  }
+  case TexelFormat::RG8: {
+    float v = texel[0] / 255.0f;
+    return {v, v, v, texel[1] / 255.0f};
+  }
+  case TexelFormat::RGBA16F: {
+    uint16_t halves[4];
+    std::memcpy(halves, texel, sizeof(halves));
+    return {glm::unpackHalf1x16(halves[0]), glm::unpackHalf1x16(halves[1]),
+            glm::unpackHalf1x16(halves[2]), glm::unpackHalf1x16(halves[3])};
+  }
+  case TexelFormat::RGB9E5: {
+    uint32_t packed;
+    std::memcpy(&packed, texel, sizeof(packed));
+    return glm::vec4(glm::unpackF3x9_E1x5(packed), 1.0f);
+  }
+  default:
+    return glm::vec4(texel[0], texel[1], texel[2], texel[3]) / 255.0f;
+  }
+}
+
+void write_texel(TexelFormat format, const glm::vec4 &value,
+                 unsigned char *texel) {
+  switch (format) {
+  case TexelFormat::R8:
+    texel[0] = to_unorm8(luminance(value));
+    break;
+  case TexelFormat::RG8:
+    texel[0] = to_unorm8(luminance(value));
+    texel[1] = to_unorm8(value.a);
+    break;
+  case TexelFormat::RGBA16F: {
+    uint16_t halves[4] = {
+        glm::packHalf1x16(value.r), glm::packHalf1x16(value.g),
+        glm::packHalf1x16(value.b), glm::packHalf1x16(value.a)};
+    std::memcpy(texel, halves, sizeof(halves));
+    break;
+  }
+  case TexelFormat::RGB9E5: {
+    uint32_t packed =
+        glm::packF3x9_E1x5(glm::max(glm::vec3(value), glm::vec3(0.0f)));
+    std::memcpy(texel, &packed, sizeof(packed));
+    break;
+  }
+  default:
+    for (int c = 0; c < 4; ++c) {
+      texel[c] = to_unorm8(value[c]);
+    }
+    break;
+  }
+}
+
+// Crossing between 8-bit and float layouts goes through the sRGB transfer
+// function when the 8-bit data is sRGB encoded
+std::vector<unsigned char> convert_texels(std::span<const unsigned char> src,
+                                          TexelFormat from, TexelFormat to,
+                                          size_t texelCount, bool srgb) {
+  const uint32_t srcSize = render::Image::get_texel_size(from);
+  const uint32_t dstSize = render::Image::get_texel_size(to);
+  const bool linearise = srgb && !is_float_format(from) && is_float_format(to);
+  const bool encode = srgb && is_float_format(from) && !is_float_format(to);
+
+  std::vector<unsigned char> dst(texelCount * dstSize);
+  for (size_t i = 0; i < texelCount; ++i) {
+    glm::vec4 value = read_texel(from, src.data() + i * srcSize);
+    for (int c = 0; c < 3; ++c) {
+      if (linearise) {
+        value[c] = srgb_to_linear(value[c]);
+      } else if (encode) {
+        value[c] = linear_to_srgb(value[c]);
+      }
+    }
+    write_texel(to, value, dst.data() + i * dstSize);
+  }
+  return dst;
+}
+
+} // namespace
+
 render::Image::Image(const std::vector<device::LogicalDevice *> &devices,
                      const ImageCreateInfo &createInfo)
     : identifier(createInfo.identifier), width(createInfo.width),
       height(createInfo.height), channels(createInfo.channels), mipLevels(1),
-      format(createInfo.format), logicalDevices(devices) {
+      generateMipmaps(createInfo.generateMipmaps),
+      requestedFormat(createInfo.texelFormat),
+      texelFormat(TexelFormat::RGBA8), colorFormat(createInfo.format),
+      format(createInfo.format), filter(createInfo.filter),
+      addressMode(createInfo.addressMode),
+      residentMip(0), streaming(false), recordedMip(0), generation(0),
+      residency(createInfo.residency),
+      pixelsModified(false), pixelsReleased(false), logicalDevices(devices) {
 
   deviceResources.reserve(logicalDevices.size());
   for (size_t i = 0; i < logicalDevices.size(); ++i) {
     deviceResources.push_back(std::make_unique<ImageResources>());
   }
 
+  if (requestedFormat != TexelFormat::AUTO) {
+    set_texel_format(sampleable_texel_format(requestedFormat));
+  }
+
   // Calculate mip levels if needed
   if (createInfo.generateMipmaps && width > 0 && height > 0) {
     mipLevels =
@@ -25,15 +173,34 @@ render::Image::Image(const std::vector<device::LogicalDevice *> &devices,
   }
 }
 
+std::mutex render::Image::pixelCacheMutex;
+std::string render::Image::pixelCacheDirectory;
+
 render::Image::~Image() {
   std::lock_guard lock(imageMutex);
 
+  // Streamed copies may still be writing to the image
+  if (!streamedLevels.empty()) {
+    for (auto *device : logicalDevices) {
+      device->get_graphics_queue().waitIdle();
+    }
+  }
+
   for (size_t i = 0; i < logicalDevices.size(); ++i) {
     if (deviceResources[i]) {
       destroy_image(logicalDevices[i], *deviceResources[i]);
     }
+    if (i < streamingResources.size() && streamingResources[i]) {
+      destroy_image(logicalDevices[i], *streamingResources[i]);
+    }
   }
   deviceResources.clear();
+  streamingResources.clear();
+
+  for (auto &retired : retiredResources) {
+    destroy_image(logicalDevices[retired.deviceIndex], *retired.resources);
+  }
+  retiredResources.clear();
 
   std::print("Image - {} - destructor executed\n", identifier);
 }
@@ -41,7 +208,13 @@ render::Image::~Image() {
 bool render::Image::create_image(device::LogicalDevice *device,
                                  ImageResources &resources,
                                  const ImageCreateInfo &createInfo) {
+  TRACE_ZONE("Image::create_image");
   try {
+    // Storage images may be written by async compute and sampled by graphics
+    std::vector<uint32_t> families = device->get_queue_family_indices();
+    bool shared = (createInfo.usage & vk::ImageUsageFlagBits::eStorage) &&
+                  families.size() > 1;
+
     VkImageCreateInfo imageInfo{
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
@@ -52,7 +225,11 @@ bool render::Image::create_image(device::LogicalDevice *device,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = static_cast<VkImageUsageFlags>(createInfo.usage),
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .sharingMode =
+            shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount =
+            shared ? static_cast<uint32_t>(families.size()) : 0,
+        .pQueueFamilyIndices = shared ? families.data() : nullptr,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
 
@@ -78,10 +255,21 @@ bool render::Image::create_image_view(device::LogicalDevice *device,
                                       ImageResources &resources,
                                       const ImageCreateInfo &createInfo) {
   try {
+    // Grey layouts read back as (v, v, v, a)
+    vk::ComponentMapping components;
+    if (texelFormat == TexelFormat::R8) {
+      components = {vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR,
+                    vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eOne};
+    } else if (texelFormat == TexelFormat::RG8) {
+      components = {vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR,
+                    vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eG};
+    }
+
     vk::ImageViewCreateInfo viewInfo{
         .image = resources.image,
         .viewType = vk::ImageViewType::e2D,
         .format = createInfo.format,
+        .components = components,
         .subresourceRange = {createInfo.aspect, 0, mipLevels, 0, 1}};
 
     resources.imageView = device->get_device().createImageView(viewInfo);
@@ -95,7 +283,8 @@ bool render::Image::create_image_view(device::LogicalDevice *device,
 
 bool render::Image::create_sampler(device::LogicalDevice *device,
                                    ImageResources &resources,
-                                   const ImageCreateInfo &createInfo) {
+                                   const ImageCreateInfo &createInfo,
+                                   uint32_t minLevel) {
   try {
     vk::SamplerCreateInfo samplerInfo{
         .magFilter = createInfo.filter,
@@ -109,13 +298,15 @@ bool render::Image::create_sampler(device::LogicalDevice *device,
         .maxAnisotropy = 16.0f,
         .compareEnable = VK_FALSE,
         .compareOp = vk::CompareOp::eAlways,
-        .minLod = 0.0f,
-        .maxLod = static_cast<float>(mipLevels),
+        .minLod = static_cast<float>(minLevel),
+        // Unclamped so every image shares the sampler regardless of its mip
+        // count, the view already limits the accessible levels
+        .maxLod = VK_LOD_CLAMP_NONE,
         .borderColor = vk::BorderColor::eIntOpaqueBlack,
         .unnormalizedCoordinates = VK_FALSE,
     };
 
-    resources.sampler = device->get_device().createSampler(samplerInfo);
+    resources.sampler = device->get_or_create_sampler(samplerInfo);
 
     return true;
   } catch (const std::exception &e) {
@@ -124,34 +315,119 @@ bool render::Image::create_sampler(device::LogicalDevice *device,
   }
 }
 
-bool render::Image::upload_data(device::LogicalDevice *device,
-                                ImageResources &resources, const void *data,
-                                uint32_t dataSize) {
-  try {
-    // Create staging buffer
-    VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                                  .size = dataSize,
-                                  .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                  .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+bool render::Image::create_staging_buffer(device::LogicalDevice *device,
+                                          const UploadLevels &data,
+                                          VkBuffer &stagingBuffer,
+                                          VmaAllocation &stagingAllocation) {
+  VkDeviceSize dataSize = 0;
+  for (const auto &chunk : data) {
+    dataSize += chunk.size();
+  }
+
+  VkBufferCreateInfo bufferInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                                .size = dataSize,
+                                .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+
+  VmaAllocationCreateInfo allocInfo{.usage = VMA_MEMORY_USAGE_CPU_ONLY};
 
-    VmaAllocationCreateInfo allocInfo{.usage = VMA_MEMORY_USAGE_CPU_ONLY};
+  if (vmaCreateBuffer(device->get_allocator(), &bufferInfo, &allocInfo,
+                      &stagingBuffer, &stagingAllocation,
+                      nullptr) != VK_SUCCESS) {
+    std::print(stderr, "Failed to create staging buffer\n");
+    return false;
+  }
 
+  // Copy data to staging buffer, chunks are packed back to back
+  void *mappedData;
+  vmaMapMemory(device->get_allocator(), stagingAllocation, &mappedData);
+  auto *dst = static_cast<unsigned char *>(mappedData);
+  for (const auto &chunk : data) {
+    std::memcpy(dst, chunk.data(), chunk.size());
+    dst += chunk.size();
+  }
+  vmaUnmapMemory(device->get_allocator(), stagingAllocation);
+
+  return true;
+}
+
+void render::Image::record_upload(vk::raii::CommandBuffer &commandBuffer,
+                                  ImageResources &resources,
+                                  VkBuffer stagingBuffer, uint32_t firstLevel,
+                                  uint32_t levelCount,
+                                  vk::ImageLayout oldLayout) {
+  // Transition image layout to transfer destination. Undefined contents can
+  // be discarded, so the whole chain is brought into a known layout at once
+  bool initial = oldLayout == vk::ImageLayout::eUndefined;
+  vk::AccessFlags previousAccess;
+  if (!initial) {
+    previousAccess = vk::AccessFlagBits::eShaderRead;
+  }
+
+  vk::ImageMemoryBarrier barrier{
+      .srcAccessMask = previousAccess,
+      .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+      .oldLayout = oldLayout,
+      .newLayout = vk::ImageLayout::eTransferDstOptimal,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = resources.image,
+      .subresourceRange = {vk::ImageAspectFlagBits::eColor,
+                           initial ? 0 : firstLevel,
+                           initial ? mipLevels : levelCount, 0, 1}};
+
+  commandBuffer.pipelineBarrier(
+      initial ? vk::PipelineStageFlagBits::eTopOfPipe
+              : vk::PipelineStageFlagBits::eFragmentShader,
+      vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+  // Copy buffer to image, one region per level
+  std::vector<vk::BufferImageCopy> regions;
+  regions.reserve(levelCount);
+  VkDeviceSize offset = 0;
+  for (uint32_t level = firstLevel; level < firstLevel + levelCount; ++level) {
+    vk::Extent3D extent = get_level_extent(level);
+    regions.push_back(
+        {.bufferOffset = offset,
+         .bufferRowLength = 0,
+         .bufferImageHeight = 0,
+         .imageSubresource = {vk::ImageAspectFlagBits::eColor, level, 0, 1},
+         .imageOffset = vk::Offset3D{0, 0, 0},
+         .imageExtent = extent});
+    offset += static_cast<VkDeviceSize>(extent.width) * extent.height *
+              get_texel_size(texelFormat);
+  }
+
+  commandBuffer.copyBufferToImage(stagingBuffer, resources.image,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  regions);
+
+  // Transition image layout to shader read-only
+  barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+  barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eFragmentShader, {},
+                                {}, {}, barrier);
+}
+
+bool render::Image::upload_data(device::LogicalDevice *device,
+                                ImageResources &resources,
+                                const UploadLevels &levels,
+                                uint32_t firstLevel,
+                                vk::ImageLayout oldLayout) {
+  TRACE_ZONE("Image::upload_data");
+  try {
     VkBuffer stagingBuffer;
     VmaAllocation stagingAllocation;
 
-    if (vmaCreateBuffer(device->get_allocator(), &bufferInfo, &allocInfo,
-                        &stagingBuffer, &stagingAllocation,
-                        nullptr) != VK_SUCCESS) {
-      std::print(stderr, "Failed to create staging buffer\n");
+    if (!create_staging_buffer(device, levels, stagingBuffer,
+                               stagingAllocation)) {
       return false;
     }
 
-    // Copy data to staging buffer
-    void *mappedData;
-    vmaMapMemory(device->get_allocator(), stagingAllocation, &mappedData);
-    std::memcpy(mappedData, data, dataSize);
-    vmaUnmapMemory(device->get_allocator(), stagingAllocation);
-
     // Create command buffer for transfer
     vk::CommandBufferAllocateInfo allocateInfo{
         .commandPool = *device->get_command_pool(),
@@ -166,44 +442,8 @@ bool render::Image::upload_data(device::LogicalDevice *device,
         .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
     commandBuffer.begin(beginInfo);
 
-    // Transition image layout to transfer destination
-    vk::ImageMemoryBarrier barrier{
-        .srcAccessMask = {},
-        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
-        .oldLayout = vk::ImageLayout::eUndefined,
-        .newLayout = vk::ImageLayout::eTransferDstOptimal,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = resources.image,
-        .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0,
-                             1}};
-
-    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
-                                  vk::PipelineStageFlagBits::eTransfer, {}, {},
-                                  {}, barrier);
-
-    // Copy buffer to image
-    vk::BufferImageCopy region{
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
-        .imageOffset = vk::Offset3D{0, 0, 0},
-        .imageExtent = vk::Extent3D{width, height, 1}};
-
-    commandBuffer.copyBufferToImage(stagingBuffer, resources.image,
-                                    vk::ImageLayout::eTransferDstOptimal,
-                                    region);
-
-    // Transition image layout to shader read-only
-    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-
-    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
-                                  vk::PipelineStageFlagBits::eFragmentShader,
-                                  {}, {}, {}, barrier);
+    record_upload(commandBuffer, resources, stagingBuffer, firstLevel,
+                  static_cast<uint32_t>(levels.size()), oldLayout);
 
     commandBuffer.end();
 
@@ -226,7 +466,7 @@ bool render::Image::upload_data(device::LogicalDevice *device,
 
 void render::Image::destroy_image(device::LogicalDevice *device,
                                   ImageResources &resources) {
-  resources.sampler.clear();
+  resources.sampler = nullptr;
   resources.imageView.clear();
 
   if (resources.image != VK_NULL_HANDLE) {
@@ -239,18 +479,53 @@ void render::Image::destroy_image(device::LogicalDevice *device,
   resources.descriptorSets.clear();
 }
 
-void render::Image::apply_color_tint(const glm::vec4 &tint) {
+void render::Image::apply_color_tint(const glm::vec4 &tint, bool parallel) {
   if (pixelData.empty()) {
     return;
   }
 
+  // Grey layouts only hold a grey tint, anything else needs colour
+  bool greyTint = tint.r == tint.g && tint.g == tint.b;
+  if (!greyTint &&
+      (texelFormat == TexelFormat::R8 || texelFormat == TexelFormat::RG8)) {
+    convert_pixels(TexelFormat::RGBA8);
+  }
+
+  const TexelFormat layout = texelFormat;
+  const uint32_t texelSize = get_texel_size(layout);
+
+  auto tintRange = [this, tint, layout, texelSize](size_t startPixel,
+                                                   size_t endPixel) {
+    for (size_t pixel = startPixel; pixel < endPixel; ++pixel) {
+      unsigned char *texel = pixelData.data() + pixel * texelSize;
+      switch (layout) {
+      case TexelFormat::R8:
+        texel[0] = static_cast<unsigned char>(texel[0] * tint.r);
+        break;
+      case TexelFormat::RG8:
+        texel[0] = static_cast<unsigned char>(texel[0] * tint.r);
+        texel[1] = static_cast<unsigned char>(texel[1] * tint.a);
+        break;
+      case TexelFormat::RGBA8:
+        texel[0] = static_cast<unsigned char>(texel[0] * tint.r); // R
+        texel[1] = static_cast<unsigned char>(texel[1] * tint.g); // G
+        texel[2] = static_cast<unsigned char>(texel[2] * tint.b); // B
+        texel[3] = static_cast<unsigned char>(texel[3] * tint.a); // A
+        break;
+      default:
+        write_texel(layout, read_texel(layout, texel) * tint, texel);
+        break;
+      }
+    }
+  };
+
   // CPU auxiliary work: Apply color tint to image data
   // This can be parallelized for large images
-  const size_t totalPixels = pixelData.size() / channels;
+  const size_t totalPixels = pixelData.size() / texelSize;
   const size_t minPixelsPerTask = 10000; // Process at least 10k pixels per task
 
   // Only parallelize if the image is large enough
-  if (totalPixels > minPixelsPerTask * 2) {
+  if (parallel && totalPixels > minPixelsPerTask * 2) {
     const size_t numTasks =
         std::min(static_cast<size_t>(std::thread::hardware_concurrency()),
                  (totalPixels + minPixelsPerTask - 1) / minPixelsPerTask);
@@ -263,22 +538,8 @@ void render::Image::apply_color_tint(const glm::vec4 &tint) {
           (taskId == numTasks - 1) ? totalPixels : (taskId + 1) * pixelsPerTask;
 
       futures.push_back(device::Tasks::get_instance().add_task(
-          [this, tint, startPixel, endPixel]() {
-            for (size_t pixel = startPixel; pixel < endPixel; ++pixel) {
-              size_t i = pixel * channels;
-              if (channels >= 3) {
-                pixelData[i + 0] =
-                    static_cast<unsigned char>(pixelData[i + 0] * tint.r); // R
-                pixelData[i + 1] =
-                    static_cast<unsigned char>(pixelData[i + 1] * tint.g); // G
-                pixelData[i + 2] =
-                    static_cast<unsigned char>(pixelData[i + 2] * tint.b); // B
-              }
-              if (channels == 4) {
-                pixelData[i + 3] =
-                    static_cast<unsigned char>(pixelData[i + 3] * tint.a); // A
-              }
-            }
+          [&tintRange, startPixel, endPixel]() {
+            tintRange(startPixel, endPixel);
           }));
     }
     // Wait for all tasks to complete
@@ -287,20 +548,7 @@ void render::Image::apply_color_tint(const glm::vec4 &tint) {
     }
   } else {
     // For small images, just process sequentially
-    for (size_t i = 0; i < pixelData.size(); i += channels) {
-      if (channels >= 3) {
-        pixelData[i + 0] =
-            static_cast<unsigned char>(pixelData[i + 0] * tint.r); // R
-        pixelData[i + 1] =
-            static_cast<unsigned char>(pixelData[i + 1] * tint.g); // G
-        pixelData[i + 2] =
-            static_cast<unsigned char>(pixelData[i + 2] * tint.b); // B
-      }
-      if (channels == 4) {
-        pixelData[i + 3] =
-            static_cast<unsigned char>(pixelData[i + 3] * tint.a); // A
-      }
-    }
+    tintRange(0, totalPixels);
   }
 }
 
@@ -309,11 +557,12 @@ void render::Image::rotate_image_90(bool clockwise) {
     return;
   }
 
-  std::vector<unsigned char> rotated(pixelData.size());
+  PixelBuffer rotated = PixelBuffer::allocate(pixelData.size());
+  const uint32_t texelSize = get_texel_size(texelFormat);
 
   for (uint32_t y = 0; y < height; ++y) {
     for (uint32_t x = 0; x < width; ++x) {
-      uint32_t srcIndex = (y * width + x) * channels;
+      uint32_t srcIndex = (y * width + x) * texelSize;
 
       uint32_t newX, newY;
       if (clockwise) {
@@ -324,9 +573,9 @@ void render::Image::rotate_image_90(bool clockwise) {
         newY = width - 1 - x;
       }
 
-      uint32_t dstIndex = (newY * height + newX) * channels;
+      uint32_t dstIndex = (newY * height + newX) * texelSize;
 
-      for (uint32_t c = 0; c < channels; ++c) {
+      for (uint32_t c = 0; c < texelSize; ++c) {
         rotated[dstIndex + c] = pixelData[srcIndex + c];
       }
     }
@@ -336,50 +585,272 @@ void render::Image::rotate_image_90(bool clockwise) {
   std::swap(width, height);
 }
 
-bool render::Image::load_from_file(const std::string &filepath) {
-  std::lock_guard lock(imageMutex);
+bool render::Image::decode_pixels(const std::string &path,
+                                  const unsigned char *data, size_t size) {
+  const int dataSize = static_cast<int>(size);
 
   int w, h, c;
-  unsigned char *data = stbi_load(filepath.c_str(), &w, &h, &c, STBI_rgb_alpha);
-
-  if (!data) {
-    std::print(stderr, "Failed to load image: {}\n", filepath);
+  bool valid = data ? stbi_info_from_memory(data, dataSize, &w, &h, &c)
+                    : stbi_info(path.c_str(), &w, &h, &c);
+  if (!valid) {
     return false;
   }
 
+  bool hdr = data ? stbi_is_hdr_from_memory(data, dataSize)
+                  : stbi_is_hdr(path.c_str());
+  bool wide = data ? stbi_is_16_bit_from_memory(data, dataSize)
+                   : stbi_is_16_bit(path.c_str());
+
+  TexelFormat target = sampleable_texel_format(
+      requestedFormat != TexelFormat::AUTO
+          ? requestedFormat
+          : choose_texel_format(c, hdr || wide));
+  const size_t texelCount = static_cast<size_t>(w) * h;
+
+  if (!is_float_format(target)) {
+    // 8-bit layouts keep the decoder's buffer instead of copying it
+    int desired = static_cast<int>(channel_count(target));
+    unsigned char *decoded =
+        data ? stbi_load_from_memory(data, dataSize, &w, &h, &c, desired)
+             : stbi_load(path.c_str(), &w, &h, &c, desired);
+    if (!decoded) {
+      return false;
+    }
+    pixelData = PixelBuffer::adopt(decoded, texelCount * desired,
+                                   stbi_image_free);
+  } else {
+    // Float layouts hold linear values, HDR sources already are
+    std::vector<float> linear(texelCount * 4);
+    if (hdr) {
+      float *decoded = data ? stbi_loadf_from_memory(data, dataSize, &w, &h,
+                                                     &c, STBI_rgb_alpha)
+                            : stbi_loadf(path.c_str(), &w, &h, &c,
+                                         STBI_rgb_alpha);
+      if (!decoded) {
+        return false;
+      }
+      std::copy(decoded, decoded + linear.size(), linear.begin());
+      stbi_image_free(decoded);
+    } else if (wide) {
+      stbi_us *decoded = data ? stbi_load_16_from_memory(data, dataSize, &w,
+                                                         &h, &c, STBI_rgb_alpha)
+                              : stbi_load_16(path.c_str(), &w, &h, &c,
+                                             STBI_rgb_alpha);
+      if (!decoded) {
+        return false;
+      }
+      for (size_t i = 0; i < linear.size(); ++i) {
+        linear[i] = decoded[i] / 65535.0f;
+      }
+      stbi_image_free(decoded);
+    } else {
+      unsigned char *decoded =
+          data ? stbi_load_from_memory(data, dataSize, &w, &h, &c,
+                                       STBI_rgb_alpha)
+               : stbi_load(path.c_str(), &w, &h, &c, STBI_rgb_alpha);
+      if (!decoded) {
+        return false;
+      }
+      for (size_t i = 0; i < linear.size(); ++i) {
+        linear[i] = decoded[i] / 255.0f;
+      }
+      stbi_image_free(decoded);
+    }
+
+    if (!hdr && is_srgb()) {
+      for (size_t i = 0; i < linear.size(); ++i) {
+        if (i % 4 != 3) {
+          linear[i] = srgb_to_linear(linear[i]);
+        }
+      }
+    }
+
+    const uint32_t texelSize = get_texel_size(target);
+    std::vector<unsigned char> packed(texelCount * texelSize);
+    for (size_t i = 0; i < texelCount; ++i) {
+      glm::vec4 value(linear[i * 4], linear[i * 4 + 1], linear[i * 4 + 2],
+                      linear[i * 4 + 3]);
+      write_texel(target, value, packed.data() + i * texelSize);
+    }
+    pixelData = PixelBuffer::take(std::move(packed));
+  }
+
   width = static_cast<uint32_t>(w);
   height = static_cast<uint32_t>(h);
-  channels = 4; // Force RGBA
+  set_texel_format(target);
+  return true;
+}
 
-  // Copy pixel data
-  size_t dataSize = width * height * channels;
-  pixelData.resize(dataSize);
-  std::memcpy(pixelData.data(), data, dataSize);
+bool render::Image::assign_pixels(std::vector<unsigned char> &&data,
+                                  uint32_t w, uint32_t h, uint32_t c) {
+  const size_t texelCount = static_cast<size_t>(w) * h;
+
+  TexelFormat source = TexelFormat::RGBA8;
+  if (c == 1) {
+    source = TexelFormat::R8;
+  } else if (c == 2) {
+    source = TexelFormat::RG8;
+  } else if (c == 3) {
+    // No 3-byte layout, pad to RGBA8
+    std::vector<unsigned char> padded(texelCount * 4);
+    for (size_t i = 0; i < texelCount; ++i) {
+      padded[i * 4] = data[i * 3];
+      padded[i * 4 + 1] = data[i * 3 + 1];
+      padded[i * 4 + 2] = data[i * 3 + 2];
+      padded[i * 4 + 3] = 255;
+    }
+    data = std::move(padded);
+  } else if (c != 4) {
+    return false;
+  }
 
-  stbi_image_free(data);
+  TexelFormat target = sampleable_texel_format(
+      requestedFormat != TexelFormat::AUTO ? requestedFormat : source);
+  if (target != source) {
+    data = convert_texels(data, source, target, texelCount, is_srgb());
+  }
 
-  std::print("Image - {} - loaded from file: {} ({}x{}, {} channels)\n",
-             identifier, filepath, width, height, channels);
+  width = w;
+  height = h;
+  pixelData = PixelBuffer::take(std::move(data));
+  set_texel_format(target);
+  return true;
+}
+
+void render::Image::set_texel_format(TexelFormat newFormat) {
+  texelFormat = newFormat;
+  channels = channel_count(newFormat);
+  format = resolve_format();
+}
+
+void render::Image::convert_pixels(TexelFormat target) {
+  if (target == texelFormat || pixelData.empty()) {
+    return;
+  }
+
+  pixelData = PixelBuffer::take(
+      convert_texels(pixelData.view(), texelFormat, target,
+                     static_cast<size_t>(width) * height, is_srgb()));
+  set_texel_format(target);
+}
+
+render::Image::TexelFormat
+render::Image::sampleable_texel_format(TexelFormat target) const {
+  // sRGB single channel formats are optional. Sampling sRGB encoded texels
+  // through UNORM would skip the decode, so they widen to RGBA8 instead
+  if (is_srgb() &&
+      ((target == TexelFormat::R8 &&
+        !supports_sampling(vk::Format::eR8Srgb)) ||
+       (target == TexelFormat::RG8 &&
+        !supports_sampling(vk::Format::eR8G8Srgb)))) {
+    return TexelFormat::RGBA8;
+  }
+  return target;
+}
+
+vk::Format render::Image::resolve_format() const {
+  switch (texelFormat) {
+  case TexelFormat::R8:
+    return is_srgb() ? vk::Format::eR8Srgb : vk::Format::eR8Unorm;
+  case TexelFormat::RG8:
+    return is_srgb() ? vk::Format::eR8G8Srgb : vk::Format::eR8G8Unorm;
+  case TexelFormat::RGBA16F:
+    return vk::Format::eR16G16B16A16Sfloat;
+  case TexelFormat::RGB9E5:
+    return vk::Format::eE5B9G9R9UfloatPack32;
+  default:
+    return colorFormat;
+  }
+}
 
+bool render::Image::supports_sampling(vk::Format candidate) const {
+  const auto required = vk::FormatFeatureFlagBits::eSampledImage |
+                        vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+  for (auto *device : logicalDevices) {
+    vk::FormatProperties properties =
+        device->get_physical_device()->get_device().getFormatProperties(
+            candidate);
+    if ((properties.optimalTilingFeatures & required) != required) {
+      return false;
+    }
+  }
   return true;
 }
 
-bool render::Image::load_from_memory(const unsigned char *data, uint32_t w,
-                                     uint32_t h, uint32_t c) {
+bool render::Image::is_srgb() const {
+  return colorFormat == vk::Format::eR8G8B8A8Srgb ||
+         colorFormat == vk::Format::eB8G8R8A8Srgb;
+}
+
+bool render::Image::load_from_file(const std::string &filepath) {
   std::lock_guard lock(imageMutex);
 
+  if (!decode_pixels(filepath, nullptr, 0)) {
+    std::print(stderr, "Failed to load image: {}\n", filepath);
+    return false;
+  }
+
+  sourcePath = filepath;
+  pixelsModified = false;
+  pixelsReleased = false;
+
+  std::print("Image - {} - loaded from file: {} ({}x{}, {} bytes per "
+             "texel)\n",
+             identifier, filepath, width, height, get_texel_size(texelFormat));
+
+  return true;
+}
+
+bool render::Image::load_from_encoded(const unsigned char *data, size_t size,
+                                      const std::string &sourceName) {
+  std::lock_guard lock(imageMutex);
+
+  if (!data || !decode_pixels(sourceName, data, size)) {
+    std::print(stderr, "Failed to decode image: {}\n", sourceName);
+    return false;
+  }
+
+  std::error_code error;
+  sourcePath = std::filesystem::is_regular_file(sourceName, error)
+                   ? sourceName
+                   : std::string();
+  pixelsModified = false;
+  pixelsReleased = false;
+
+  std::print("Image - {} - decoded from {} ({}x{}, {} bytes per texel)\n",
+             identifier, sourceName, width, height,
+             get_texel_size(texelFormat));
+
+  return true;
+}
+
+bool render::Image::load_from_memory(const unsigned char *data, uint32_t w,
+                                     uint32_t h, uint32_t c) {
   if (!data || w == 0 || h == 0 || c == 0) {
     std::print(stderr, "Invalid image data\n");
     return false;
   }
 
-  width = w;
-  height = h;
-  channels = c;
+  return load_from_memory(
+      std::vector<unsigned char>(data, data + static_cast<size_t>(w) * h * c),
+      w, h, c);
+}
+
+bool render::Image::load_from_memory(std::vector<unsigned char> &&data,
+                                     uint32_t w, uint32_t h, uint32_t c) {
+  std::lock_guard lock(imageMutex);
+
+  if (w == 0 || h == 0 || c == 0 ||
+      data.size() != static_cast<size_t>(w) * h * c ||
+      !assign_pixels(std::move(data), w, h, c)) {
+    std::print(stderr, "Invalid image data\n");
+    return false;
+  }
 
-  size_t dataSize = width * height * channels;
-  pixelData.resize(dataSize);
-  std::memcpy(pixelData.data(), data, dataSize);
+  sourcePath.clear();
+  pixelsModified = false;
+  pixelsReleased = false;
 
   std::print("Image - {} - loaded from memory ({}x{}, {} channels)\n",
              identifier, width, height, channels);
@@ -389,93 +860,782 @@ bool render::Image::load_from_memory(const unsigned char *data, uint32_t w,
 
 void render::Image::set_color_tint(const glm::vec4 &tint) {
   std::lock_guard lock(imageMutex);
+  if (!ensure_pixels()) {
+    return;
+  }
   apply_color_tint(tint);
+  pixelsModified = true;
   std::print("Image - {} - applied color tint ({}, {}, {}, {})\n", identifier,
              tint.r, tint.g, tint.b, tint.a);
 }
 
 void render::Image::rotate_90_clockwise() {
   std::lock_guard lock(imageMutex);
+  if (!ensure_pixels()) {
+    return;
+  }
   rotate_image_90(true);
+  pixelsModified = true;
   std::print("Image - {} - rotated 90 degrees clockwise\n", identifier);
 }
 
 void render::Image::rotate_90_counter_clockwise() {
   std::lock_guard lock(imageMutex);
+  if (!ensure_pixels()) {
+    return;
+  }
   rotate_image_90(false);
+  pixelsModified = true;
   std::print("Image - {} - rotated 90 degrees counter-clockwise\n", identifier);
 }
 
 void render::Image::rotate_180() {
   std::lock_guard lock(imageMutex);
-  if (pixelData.empty()) {
+  if (!ensure_pixels()) {
     return;
   }
+  pixelsModified = true;
 
   size_t pixelCount = width * height;
+  const uint32_t texelSize = get_texel_size(texelFormat);
   for (size_t i = 0; i < pixelCount / 2; ++i) {
     size_t j = pixelCount - 1 - i;
-    for (uint32_t c = 0; c < channels; ++c) {
-      std::swap(pixelData[i * channels + c], pixelData[j * channels + c]);
+    for (uint32_t c = 0; c < texelSize; ++c) {
+      std::swap(pixelData[i * texelSize + c], pixelData[j * texelSize + c]);
     }
   }
   std::print("Image - {} - rotated 180 degrees\n", identifier);
 }
 
+bool render::Image::recreate_resources(size_t deviceIndex) {
+  ImageCreateInfo createInfo = {.identifier = identifier,
+                                .width = width,
+                                .height = height,
+                                .channels = channels,
+                                .format = format,
+                                .filter = filter,
+                                .addressMode = addressMode};
+
+  auto *device = logicalDevices[deviceIndex];
+  auto &resources = deviceResources[deviceIndex];
+
+  // Destroy old image resources
+  destroy_image(device, *resources);
+
+  return create_image(device, *resources, createInfo) &&
+         create_image_view(device, *resources, createInfo) &&
+         create_sampler(device, *resources, createInfo, residentMip);
+}
+
+void render::Image::build_mip_chain() {
+  mipLevels =
+      static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +
+      1;
+  mipChain.assign(mipLevels - 1, {});
+
+  const uint32_t texelSize = get_texel_size(texelFormat);
+  const bool floatTexels = is_float_format(texelFormat);
+
+  // 2x2 box filter, the last row or column is reused for odd sizes
+  for (uint32_t level = 1; level < mipLevels; ++level) {
+    std::span<const unsigned char> src = get_level_data(level - 1);
+    vk::Extent3D srcExtent = get_level_extent(level - 1);
+    vk::Extent3D dstExtent = get_level_extent(level);
+
+    auto &dst = mipChain[level - 1];
+    dst.resize(static_cast<size_t>(dstExtent.width) * dstExtent.height *
+               texelSize);
+
+    for (uint32_t y = 0; y < dstExtent.height; ++y) {
+      uint32_t y0 = std::min(y * 2, srcExtent.height - 1);
+      uint32_t y1 = std::min(y * 2 + 1, srcExtent.height - 1);
+
+      for (uint32_t x = 0; x < dstExtent.width; ++x) {
+        uint32_t x0 = std::min(x * 2, srcExtent.width - 1);
+        uint32_t x1 = std::min(x * 2 + 1, srcExtent.width - 1);
+
+        size_t i00 = (y0 * srcExtent.width + x0) * texelSize;
+        size_t i01 = (y0 * srcExtent.width + x1) * texelSize;
+        size_t i10 = (y1 * srcExtent.width + x0) * texelSize;
+        size_t i11 = (y1 * srcExtent.width + x1) * texelSize;
+        unsigned char *out = &dst[(y * dstExtent.width + x) * texelSize];
+
+        // Packed float texels are averaged as values, not bytes
+        if (floatTexels) {
+          glm::vec4 sum = read_texel(texelFormat, &src[i00]) +
+                          read_texel(texelFormat, &src[i01]) +
+                          read_texel(texelFormat, &src[i10]) +
+                          read_texel(texelFormat, &src[i11]);
+          write_texel(texelFormat, sum * 0.25f, out);
+          continue;
+        }
+
+        for (uint32_t c = 0; c < texelSize; ++c) {
+          uint32_t sum = src[i00 + c] + src[i01 + c] + src[i10 + c] +
+                         src[i11 + c];
+          out[c] = static_cast<unsigned char>((sum + 2) / 4);
+        }
+      }
+    }
+  }
+}
+
+std::span<const unsigned char>
+render::Image::get_level_data(uint32_t level) const {
+  if (level == 0) {
+    return pixelData.view();
+  }
+  return mipChain[level - 1];
+}
+
+vk::Extent3D render::Image::get_level_extent(uint32_t level) const {
+  return {std::max(width >> level, 1u), std::max(height >> level, 1u), 1};
+}
+
+render::Image::UploadLevels render::Image::prepare_upload_levels() {
+  if (generateMipmaps) {
+    build_mip_chain();
+  } else {
+    mipLevels = 1;
+    mipChain.clear();
+  }
+  residentMip = 0;
+
+  UploadLevels levels;
+  for (uint32_t level = 0; level < mipLevels; ++level) {
+    levels.push_back(get_level_data(level));
+  }
+  return levels;
+}
+
 bool render::Image::update_gpu_data() {
   std::lock_guard lock(imageMutex);
 
-  if (pixelData.empty()) {
+  if (!ensure_pixels()) {
     std::print(stderr, "No pixel data to upload\n");
     return false;
   }
 
-  ImageCreateInfo createInfo = {.identifier = identifier,
-                                .width = width,
-                                .height = height,
-                                .channels = channels,
-                                .format = format};
+  UploadLevels levels = prepare_upload_levels();
 
   bool success = true;
   for (size_t i = 0; i < logicalDevices.size(); ++i) {
-    auto &resources = deviceResources[i];
-
-    // Destroy old image resources
-    destroy_image(logicalDevices[i], *resources);
-
-    // Create new image
-    if (!create_image(logicalDevices[i], *resources, createInfo)) {
+    if (!recreate_resources(i)) {
       success = false;
       continue;
     }
 
-    // Create image view
-    if (!create_image_view(logicalDevices[i], *resources, createInfo)) {
+    // Upload data
+    if (!upload_data(logicalDevices[i], *deviceResources[i], levels, 0,
+                     vk::ImageLayout::eUndefined)) {
       success = false;
       continue;
     }
+  }
+  ++generation;
+
+  if (success) {
+    finish_upload();
+    std::print("Image - {} - updated GPU data\n", identifier);
+  }
+
+  return success;
+}
+
+bool render::Image::update_gpu_data_batch(const std::vector<Image *> &images) {
+  if (images.empty()) {
+    return true;
+  }
+
+  // All images of a batch belong to the same set of devices
+  const auto &devices = images.front()->logicalDevices;
+
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(images.size());
+  for (Image *image : images) {
+    locks.emplace_back(image->imageMutex);
+  }
+
+  std::unordered_map<Image *, UploadLevels> levels;
+  // Devices whose copy of the image completed, and images whose old
+  // resources are gone on at least one device
+  std::unordered_map<Image *, size_t> completed;
+  std::unordered_set<Image *> replaced;
+
+  bool success = true;
+  for (size_t deviceIdx = 0; deviceIdx < devices.size(); ++deviceIdx) {
+    auto *device = devices[deviceIdx];
+
+    std::vector<std::pair<VkBuffer, VmaAllocation>> stagingBuffers;
+    stagingBuffers.reserve(images.size());
+    std::vector<Image *> recorded;
+    recorded.reserve(images.size());
+
+    try {
+      vk::CommandBufferAllocateInfo allocateInfo{
+          .commandPool = *device->get_command_pool(),
+          .level = vk::CommandBufferLevel::ePrimary,
+          .commandBufferCount = 1};
+
+      auto commandBuffers =
+          device->get_device().allocateCommandBuffers(allocateInfo);
+      auto &commandBuffer = commandBuffers[0];
+
+      vk::CommandBufferBeginInfo beginInfo{
+          .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+      commandBuffer.begin(beginInfo);
+
+      // Record every copy into the same command buffer
+      for (Image *image : images) {
+        if (!image->ensure_pixels()) {
+          std::print(stderr, "Image - {} - skipped in upload batch\n",
+                     image->identifier);
+          success = false;
+          continue;
+        }
+
+        // The mip chain is device independent, build it once
+        auto levelsIt = levels.find(image);
+        if (levelsIt == levels.end()) {
+          levelsIt =
+              levels.emplace(image, image->prepare_upload_levels()).first;
+        }
+
+        // Staging first, so a skipped image keeps its old resources
+        VkBuffer stagingBuffer;
+        VmaAllocation stagingAllocation;
+        if (!create_staging_buffer(device, levelsIt->second, stagingBuffer,
+                                   stagingAllocation)) {
+          success = false;
+          continue;
+        }
+        stagingBuffers.emplace_back(stagingBuffer, stagingAllocation);
+
+        replaced.insert(image);
+        if (!image->recreate_resources(deviceIdx)) {
+          std::print(stderr, "Image - {} - skipped in upload batch\n",
+                     image->identifier);
+          success = false;
+          continue;
+        }
+
+        image->record_upload(commandBuffer,
+                             *image->deviceResources[deviceIdx], stagingBuffer,
+                             0, image->mipLevels, vk::ImageLayout::eUndefined);
+        recorded.push_back(image);
+      }
+
+      commandBuffer.end();
+
+      // One submit and one wait for the whole batch
+      vk::SubmitInfo submitInfo{.commandBufferCount = 1,
+                                .pCommandBuffers = &*commandBuffer};
+
+      device->get_graphics_queue().submit(submitInfo);
+      device->get_graphics_queue().waitIdle();
+
+      for (Image *image : recorded) {
+        ++completed[image];
+      }
+    } catch (const std::exception &e) {
+      std::print(stderr, "Failed to upload image batch: {}\n", e.what());
+      device->get_graphics_queue().waitIdle();
+      success = false;
+    }
+
+    for (auto &[buffer, allocation] : stagingBuffers) {
+      vmaDestroyBuffer(device->get_allocator(), buffer, allocation);
+    }
+  }
+
+  for (Image *image : images) {
+    auto it = completed.find(image);
+    if (it != completed.end() && it->second == devices.size()) {
+      ++image->generation;
+      image->finish_upload();
+    } else if (replaced.contains(image)) {
+      // The old view was destroyed, descriptor sets must not keep it, but
+      // the pixels stay so the next upload can fill the new image
+      ++image->generation;
+    }
+  }
+
+  std::print("Image - uploaded batch of {} images\n", images.size());
+  return success;
+}
+
+bool render::Image::update_gpu_region(const unsigned char *pixels,
+                                      uint32_t x, uint32_t y,
+                                      uint32_t regionWidth,
+                                      uint32_t regionHeight) {
+  std::lock_guard lock(imageMutex);
+
+  if (!pixels || regionWidth == 0 || regionHeight == 0 ||
+      x + regionWidth > width || y + regionHeight > height ||
+      mipLevels != 1) {
+    std::print(stderr, "Image - {} - invalid region update\n", identifier);
+    return false;
+  }
+
+  const size_t texelSize = get_texel_size(texelFormat);
+  const size_t rowSize = regionWidth * texelSize;
+
+  // Keep the CPU copy in step, it is what a later full upload sends
+  if (ensure_pixels()) {
+    for (uint32_t row = 0; row < regionHeight; ++row) {
+      std::memcpy(pixelData.data() +
+                      ((static_cast<size_t>(y) + row) * width + x) * texelSize,
+                  pixels + row * rowSize, rowSize);
+    }
+    pixelsModified = true;
+  }
+
+  const UploadLevels region = {
+      std::span<const unsigned char>(pixels, rowSize * regionHeight)};
 
-    // Create sampler
-    if (!create_sampler(logicalDevices[i], *resources, createInfo)) {
+  bool success = true;
+  for (size_t i = 0; i < logicalDevices.size(); ++i) {
+    auto *device = logicalDevices[i];
+    auto &resources = *deviceResources[i];
+    if (resources.image == VK_NULL_HANDLE) {
       success = false;
       continue;
     }
 
-    // Upload data
-    if (!upload_data(logicalDevices[i], *resources, pixelData.data(),
-                     static_cast<uint32_t>(pixelData.size()))) {
+    VkBuffer stagingBuffer;
+    VmaAllocation stagingAllocation;
+    if (!create_staging_buffer(device, region, stagingBuffer,
+                               stagingAllocation)) {
       success = false;
       continue;
     }
+
+    try {
+      vk::CommandBufferAllocateInfo allocateInfo{
+          .commandPool = *device->get_command_pool(),
+          .level = vk::CommandBufferLevel::ePrimary,
+          .commandBufferCount = 1};
+
+      auto commandBuffers =
+          device->get_device().allocateCommandBuffers(allocateInfo);
+      auto &commandBuffer = commandBuffers[0];
+
+      vk::CommandBufferBeginInfo beginInfo{
+          .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+      commandBuffer.begin(beginInfo);
+
+      // Frames still sampling the image were submitted earlier on the same
+      // queue, the barrier orders the copy after their reads
+      vk::ImageMemoryBarrier barrier{
+          .srcAccessMask = vk::AccessFlagBits::eShaderRead,
+          .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+          .oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+          .newLayout = vk::ImageLayout::eTransferDstOptimal,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = resources.image,
+          .subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1}};
+
+      commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader,
+                                    vk::PipelineStageFlagBits::eTransfer, {},
+                                    {}, {}, barrier);
+
+      vk::BufferImageCopy copy{
+          .bufferOffset = 0,
+          .bufferRowLength = 0,
+          .bufferImageHeight = 0,
+          .imageSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1},
+          .imageOffset = vk::Offset3D{static_cast<int32_t>(x),
+                                      static_cast<int32_t>(y), 0},
+          .imageExtent = vk::Extent3D{regionWidth, regionHeight, 1}};
+
+      commandBuffer.copyBufferToImage(stagingBuffer, resources.image,
+                                      vk::ImageLayout::eTransferDstOptimal,
+                                      copy);
+
+      barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+      barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+      barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+      barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+      commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                    vk::PipelineStageFlagBits::eFragmentShader,
+                                    {}, {}, {}, barrier);
+
+      commandBuffer.end();
+
+      vk::SubmitInfo submitInfo{.commandBufferCount = 1,
+                                .pCommandBuffers = &*commandBuffer};
+
+      device->get_graphics_queue().submit(submitInfo);
+      device->get_graphics_queue().waitIdle();
+    } catch (const std::exception &e) {
+      std::print(stderr, "Image - {} - region update failed: {}\n",
+                 identifier, e.what());
+      device->get_graphics_queue().waitIdle();
+      success = false;
+    }
+
+    vmaDestroyBuffer(device->get_allocator(), stagingBuffer,
+                     stagingAllocation);
   }
 
-  if (success) {
-    std::print("Image - {} - updated GPU data\n", identifier);
+  if (residency != Residency::KEEP) {
+    release_pixels();
   }
 
   return success;
 }
 
+bool render::Image::prepare_streaming() {
+  std::lock_guard lock(imageMutex);
+
+  if (!ensure_pixels()) {
+    std::print(stderr, "Image - {} - no pixel data to stream\n", identifier);
+    return false;
+  }
+
+  generateMipmaps = true;
+  build_mip_chain();
+  return true;
+}
+
+bool render::Image::begin_streaming(
+    const std::shared_ptr<StreamBatch> &batch) {
+  std::lock_guard lock(imageMutex);
+
+  if (streaming) {
+    std::print(stderr, "Image - {} - already streaming\n", identifier);
+    return false;
+  }
+
+  if (!ensure_pixels()) {
+    std::print(stderr, "Image - {} - no pixel data to stream\n", identifier);
+    return false;
+  }
+
+  if (mipChain.size() + 1 != mipLevels || !generateMipmaps) {
+    generateMipmaps = true;
+    build_mip_chain();
+  }
+
+  // Only the smallest level is resident to start with
+  const uint32_t lastLevel = mipLevels - 1;
+  std::span<const unsigned char> data = get_level_data(lastLevel);
+  ImageCreateInfo createInfo = {.identifier = identifier,
+                                .width = width,
+                                .height = height,
+                                .channels = channels,
+                                .format = format,
+                                .filter = filter,
+                                .addressMode = addressMode};
+
+  // The current image stays bound until the new chain has its first level
+  bool success = true;
+  for (size_t i = 0; i < logicalDevices.size() && success; ++i) {
+    auto *device = logicalDevices[i];
+    auto &resources = streamingResources.emplace_back(
+        std::make_unique<ImageResources>());
+
+    VkBuffer stagingBuffer;
+    VmaAllocation stagingAllocation;
+    success = create_image(device, *resources, createInfo) &&
+              create_image_view(device, *resources, createInfo) &&
+              create_sampler(device, *resources, createInfo, lastLevel) &&
+              create_staging_buffer(device, {data}, stagingBuffer,
+                                    stagingAllocation);
+    if (!success) {
+      break;
+    }
+    batch->add_staging_buffer(i, stagingBuffer, stagingAllocation);
+
+    try {
+      record_upload(batch->get_command_buffer(i), *resources, stagingBuffer,
+                    lastLevel, 1, vk::ImageLayout::eUndefined);
+    } catch (const std::exception &e) {
+      std::print(stderr, "Image - {} - failed to record streaming: {}\n",
+                 identifier, e.what());
+      success = false;
+    }
+  }
+
+  if (!success) {
+    // Devices recorded so far still submit their copies with the batch
+    for (size_t i = 0; i < streamingResources.size(); ++i) {
+      retiredResources.push_back(
+          {.deviceIndex = i,
+           .frame = logicalDevices[i]->get_submitted_frame() + 1,
+           .resources = std::move(streamingResources[i])});
+    }
+    streamingResources.clear();
+    return false;
+  }
+
+  streaming = true;
+  recordedMip = lastLevel;
+  streamedLevels.push_back({.batch = batch, .level = lastLevel});
+
+  std::print("Image - {} - streaming {} mip levels\n", identifier, mipLevels);
+  return true;
+}
+
+uint64_t
+render::Image::stream_next_mip(const std::shared_ptr<StreamBatch> &batch) {
+  std::lock_guard lock(imageMutex);
+
+  if (!streaming || recordedMip == 0 || mipChain.size() + 1 != mipLevels) {
+    return 0;
+  }
+
+  uint32_t level = recordedMip - 1;
+  std::span<const unsigned char> data = get_level_data(level);
+  uint64_t levelSize = data.size();
+
+  // Copy into the chain that is visible by the time the batch completes
+  auto &targets =
+      streamingResources.empty() ? deviceResources : streamingResources;
+
+  for (size_t i = 0; i < logicalDevices.size(); ++i) {
+    VkBuffer stagingBuffer;
+    VmaAllocation stagingAllocation;
+    if (!create_staging_buffer(logicalDevices[i], {data}, stagingBuffer,
+                               stagingAllocation)) {
+      std::print(stderr, "Image - {} - failed to stream mip {}\n",
+                 identifier, level);
+      return 0;
+    }
+    batch->add_staging_buffer(i, stagingBuffer, stagingAllocation);
+
+    try {
+      record_upload(batch->get_command_buffer(i), *targets[i], stagingBuffer,
+                    level, 1, vk::ImageLayout::eShaderReadOnlyOptimal);
+    } catch (const std::exception &e) {
+      std::print(stderr, "Image - {} - failed to stream mip {}: {}\n",
+                 identifier, level, e.what());
+      return 0;
+    }
+  }
+
+  recordedMip = level;
+  streamedLevels.push_back({.batch = batch, .level = level});
+
+  return levelSize * logicalDevices.size();
+}
+
+bool render::Image::update_streaming() {
+  std::lock_guard lock(imageMutex);
+
+  // Swapped out resources go once no submitted frame can read them
+  std::erase_if(retiredResources, [this](RetiredResources &retired) {
+    auto *device = logicalDevices[retired.deviceIndex];
+    if (device->get_completed_frame() < retired.frame) {
+      return false;
+    }
+    destroy_image(device, *retired.resources);
+    return true;
+  });
+
+  bool failed = false;
+  bool advanced = false;
+  while (!streamedLevels.empty()) {
+    const StreamedLevel &front = streamedLevels.front();
+    if (front.batch->has_failed()) {
+      failed = true;
+      break;
+    }
+    if (!front.batch->is_complete()) {
+      break;
+    }
+
+    if (!streamingResources.empty()) {
+      // Frames submitted up to now were recorded against the old chain,
+      // later ones get the new view through the generation bump below
+      for (size_t i = 0; i < logicalDevices.size(); ++i) {
+        retiredResources.push_back(
+            {.deviceIndex = i,
+             .frame = logicalDevices[i]->get_submitted_frame(),
+             .resources = std::move(deviceResources[i])});
+        deviceResources[i] = std::move(streamingResources[i]);
+      }
+      streamingResources.clear();
+    }
+
+    residentMip = front.level;
+    streamedLevels.pop_front();
+    advanced = true;
+  }
+
+  if (advanced) {
+    // Let the samplers reach the new level
+    ImageCreateInfo createInfo = {.identifier = identifier,
+                                  .format = format,
+                                  .filter = filter,
+                                  .addressMode = addressMode};
+    for (size_t i = 0; i < logicalDevices.size(); ++i) {
+      create_sampler(logicalDevices[i], *deviceResources[i], createInfo,
+                     residentMip);
+    }
+    ++generation;
+  }
+
+  if (failed) {
+    std::print(stderr, "Image - {} - streaming stopped at mip {}\n",
+               identifier, residentMip);
+    for (size_t i = 0; i < streamingResources.size(); ++i) {
+      retiredResources.push_back(
+          {.deviceIndex = i,
+           .frame = logicalDevices[i]->get_submitted_frame() + 1,
+           .resources = std::move(streamingResources[i])});
+    }
+    streamingResources.clear();
+    streamedLevels.clear();
+    recordedMip = residentMip;
+    streaming = false;
+    return false;
+  }
+
+  if (streaming && residentMip == 0) {
+    streaming = false;
+    finish_upload();
+  }
+  return true;
+}
+
+uint64_t render::Image::get_next_mip_size() const {
+  std::lock_guard lock(imageMutex);
+
+  if (!streaming || recordedMip == 0) {
+    return 0;
+  }
+
+  vk::Extent3D extent = get_level_extent(recordedMip - 1);
+  return static_cast<uint64_t>(extent.width) * extent.height *
+         get_texel_size(texelFormat) * logicalDevices.size();
+}
+
+bool render::Image::is_fully_resident() const {
+  std::lock_guard lock(imageMutex);
+  return !streaming && residentMip == 0;
+}
+
+uint32_t render::Image::get_resident_mip() const {
+  std::lock_guard lock(imageMutex);
+  return residentMip;
+}
+
+uint32_t render::Image::get_mip_levels() const {
+  std::lock_guard lock(imageMutex);
+  return mipLevels;
+}
+
+uint64_t render::Image::get_generation() const { return generation; }
+
+bool render::Image::ensure_pixels() {
+  if (!pixelsReleased) {
+    return !pixelData.empty();
+  }
+
+  // Decoding picks the same layout again, the pixels were never edited
+  uint32_t expectedWidth = width;
+  uint32_t expectedHeight = height;
+  if (!decode_pixels(sourcePath, nullptr, 0) || width != expectedWidth ||
+      height != expectedHeight) {
+    std::print(stderr, "Image - {} - failed to reload pixels from {}\n",
+               identifier, sourcePath);
+    pixelData.clear();
+    width = expectedWidth;
+    height = expectedHeight;
+    return false;
+  }
+
+  pixelsReleased = false;
+
+  std::print("Image - {} - reloaded released pixels from {}\n", identifier,
+             sourcePath);
+  return true;
+}
+
+void render::Image::release_pixels() {
+  if (pixelData.empty() ||
+      pixelData.get_storage() == PixelBuffer::Storage::MAPPED) {
+    return;
+  }
+
+  if (residency == Residency::RELEASE && !sourcePath.empty() &&
+      !pixelsModified) {
+    pixelData.clear();
+    pixelsReleased = true;
+    std::print("Image - {} - released CPU pixels\n", identifier);
+    return;
+  }
+
+  // Unique per process and image, the file is unlinked once mapped
+  static const uint32_t processTag = std::random_device{}();
+  static std::atomic<uint64_t> spillCounter = 0;
+
+  std::filesystem::path directory;
+  {
+    std::lock_guard cacheLock(pixelCacheMutex);
+    directory = pixelCacheDirectory;
+  }
+  if (directory.empty()) {
+    directory = std::filesystem::temp_directory_path();
+  }
+  std::filesystem::path path =
+      directory / std::format("sapphiregem-{:08x}-{}.pixels", processTag,
+                              spillCounter++);
+
+  PixelBuffer mapped = PixelBuffer::spill_to_file(pixelData.view(),
+                                                  path.string());
+  if (mapped.empty()) {
+    std::print(stderr, "Image - {} - keeping CPU pixels in memory\n",
+               identifier);
+    return;
+  }
+
+  pixelData = std::move(mapped);
+  std::print("Image - {} - moved CPU pixels to the pixel cache\n",
+             identifier);
+}
+
+void render::Image::finish_upload() {
+  // The mip chain is rebuilt from the pixels on every full upload
+  mipChain.clear();
+  mipChain.shrink_to_fit();
+
+  if (residency != Residency::KEEP) {
+    release_pixels();
+  }
+}
+
+void render::Image::set_residency(Residency mode) {
+  std::lock_guard lock(imageMutex);
+  residency = mode;
+}
+
+render::Image::Residency render::Image::get_residency() const {
+  std::lock_guard lock(imageMutex);
+  return residency;
+}
+
+void render::Image::release_cpu_pixels() {
+  std::lock_guard lock(imageMutex);
+  if (residency != Residency::KEEP) {
+    release_pixels();
+  }
+}
+
+bool render::Image::has_cpu_pixels() const {
+  std::lock_guard lock(imageMutex);
+  return !pixelData.empty() &&
+         pixelData.get_storage() != PixelBuffer::Storage::MAPPED;
+}
+
+void render::Image::set_pixel_cache_directory(const std::string &directory) {
+  std::lock_guard lock(pixelCacheMutex);
+  pixelCacheDirectory = directory;
+}
+
 const std::string &render::Image::get_identifier() const { return identifier; }
 
 uint32_t render::Image::get_width() const { return width; }
@@ -486,8 +1646,99 @@ uint32_t render::Image::get_channels() const { return channels; }
 
 vk::Format render::Image::get_format() const { return format; }
 
-const std::vector<unsigned char> &render::Image::get_pixel_data() const {
-  return pixelData;
+render::Image::TexelFormat render::Image::get_texel_format() const {
+  return texelFormat;
+}
+
+uint32_t render::Image::get_texel_size() const {
+  return get_texel_size(texelFormat);
+}
+
+uint32_t render::Image::get_texel_size(TexelFormat texelFormat) {
+  switch (texelFormat) {
+  case TexelFormat::R8:
+    return 1;
+  case TexelFormat::RG8:
+    return 2;
+  case TexelFormat::RGBA16F:
+    return 8;
+  default:
+    return 4;
+  }
+}
+
+render::Image::TexelFormat
+render::Image::choose_texel_format(uint32_t channels, bool highPrecision) {
+  if (highPrecision) {
+    // RGB9E5 has no alpha, keep it for opaque sources
+    return channels == 2 || channels == 4 ? TexelFormat::RGBA16F
+                                          : TexelFormat::RGB9E5;
+  }
+  if (channels == 1) {
+    return TexelFormat::R8;
+  }
+  if (channels == 2) {
+    return TexelFormat::RG8;
+  }
+  return TexelFormat::RGBA8;
+}
+
+std::vector<unsigned char> render::Image::get_rgba8_pixels() {
+  std::lock_guard lock(imageMutex);
+  if (!ensure_pixels()) {
+    return {};
+  }
+
+  std::span<const unsigned char> pixels = pixelData.view();
+  if (texelFormat == TexelFormat::RGBA8) {
+    return {pixels.begin(), pixels.end()};
+  }
+  return convert_texels(pixels, texelFormat, TexelFormat::RGBA8,
+                        static_cast<size_t>(width) * height, is_srgb());
+}
+
+std::vector<unsigned char>
+render::Image::get_rgba8_pixels(uint32_t x, uint32_t y, uint32_t regionWidth,
+                                uint32_t regionHeight) {
+  std::lock_guard lock(imageMutex);
+  if (regionWidth == 0 || regionHeight == 0 || x + regionWidth > width ||
+      y + regionHeight > height || !ensure_pixels()) {
+    return {};
+  }
+
+  const size_t texelSize = get_texel_size(texelFormat);
+  const size_t rowSize = regionWidth * texelSize;
+  std::vector<unsigned char> region(rowSize * regionHeight);
+  for (uint32_t row = 0; row < regionHeight; ++row) {
+    std::memcpy(region.data() + row * rowSize,
+                pixelData.data() +
+                    ((static_cast<size_t>(y) + row) * width + x) * texelSize,
+                rowSize);
+  }
+
+  if (texelFormat == TexelFormat::RGBA8) {
+    return region;
+  }
+  return convert_texels(region, texelFormat, TexelFormat::RGBA8,
+                        static_cast<size_t>(regionWidth) * regionHeight,
+                        is_srgb());
+}
+
+bool render::Image::with_rgba8_pixels(
+    const std::function<void(std::span<const unsigned char>)> &reader) {
+  std::lock_guard lock(imageMutex);
+  if (!ensure_pixels()) {
+    return false;
+  }
+
+  std::span<const unsigned char> pixels = pixelData.view();
+  if (texelFormat == TexelFormat::RGBA8) {
+    reader(pixels);
+  } else {
+    reader(convert_texels(pixels, texelFormat, TexelFormat::RGBA8,
+                          static_cast<size_t>(width) * height, is_srgb()));
+  }
+  return true;
 }
 
 VkImage render::Image::get_image(uint32_t deviceIndex) const {
@@ -504,7 +1755,7 @@ vk::raii::ImageView &render::Image::get_image_view(uint32_t deviceIndex) {
   return deviceResources[deviceIndex]->imageView;
 }
 
-vk::raii::Sampler &render::Image::get_sampler(uint32_t deviceIndex) {
+vk::Sampler render::Image::get_sampler(uint32_t deviceIndex) const {
   if (deviceIndex >= deviceResources.size()) {
     throw std::out_of_range("Device index out of range");
   }
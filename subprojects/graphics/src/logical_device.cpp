@@ -3,9 +3,15 @@
 #include "config.h"
 #include "physical_device.h"
 #include "swap_chain.h"
+#include "trace.h"
 #include "vulkan/vulkan.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -30,35 +36,77 @@ device::LogicalDevice::LogicalDevice(vk::raii::Instance &instance,
                                      uint32_t graphicsQueueIndex)
     : stopThread(false), physicalDevice(physicalDevice), device(nullptr),
       graphicsQueue(nullptr), graphicsQueueIndex(graphicsQueueIndex),
-      commandPool(nullptr), descriptorPool(nullptr) {
+      computeQueue(nullptr), computeQueueIndex(graphicsQueueIndex),
+      asyncCompute(false), computeCommandPool(nullptr),
+      computeTimeline(nullptr), computeTimelineValue(0), presentWait(false),
+      commandPool(nullptr), descriptorPoolSets(0), pipelineCache(nullptr),
+      frameTimeline(nullptr), submittedFrame(0) {
 
   // Query for required features
   auto featureChain = general::Config::get_features();
 
-  float queuePriority = 0.0f;
-  vk::DeviceQueueCreateInfo deviceQueueCreateInfo{
-      .queueFamilyIndex = graphicsQueueIndex,
-      .queueCount = 1,
-      .pQueuePriorities = &queuePriority};
+  uint32_t computeQueueSlot = 0;
+  asyncCompute = select_compute_queue(computeQueueIndex, computeQueueSlot);
+
+  std::array<float, 2> queuePriorities = {0.0f, 0.0f};
+  std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos = {
+      {.queueFamilyIndex = graphicsQueueIndex,
+       .queueCount = 1,
+       .pQueuePriorities = queuePriorities.data()}};
+  if (asyncCompute && computeQueueIndex == graphicsQueueIndex) {
+    queueCreateInfos[0].queueCount = 2;
+  } else if (asyncCompute) {
+    queueCreateInfos.push_back({.queueFamilyIndex = computeQueueIndex,
+                                .queueCount = 1,
+                                .pQueuePriorities = queuePriorities.data()});
+  }
+
+  // Present wait is optional and per device, so it stays out of the shared
+  // extension list and feature chain
+  std::vector<const char *> extensions =
+      general::Config::get_instance().get_device_extension();
+  vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{
+      .presentWait = true};
+  vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{
+      .pNext = &presentWaitFeatures, .presentId = true};
+  presentWait = supports_present_wait();
+  if (presentWait) {
+    extensions.push_back(vk::KHRPresentIdExtensionName);
+    extensions.push_back(vk::KHRPresentWaitExtensionName);
+    featureChain.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>()
+        .pNext = &presentIdFeatures;
+  }
 
   vk::DeviceCreateInfo deviceCreateInfo{
       .pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>(),
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &deviceQueueCreateInfo,
-      .enabledExtensionCount = static_cast<uint32_t>(
-          general::Config::get_instance().get_device_extension().size()),
-      .ppEnabledExtensionNames =
-          general::Config::get_instance().get_device_extension().data()};
+      .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
+      .pQueueCreateInfos = queueCreateInfos.data(),
+      .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data()};
 
   device = vk::raii::Device(physicalDevice->get_device(), deviceCreateInfo);
   graphicsQueue = vk::raii::Queue(device, graphicsQueueIndex, 0);
+  computeQueue =
+      asyncCompute
+          ? vk::raii::Queue(device, computeQueueIndex, computeQueueSlot)
+          : vk::raii::Queue(device, graphicsQueueIndex, 0);
 
   std::print("Created logical device: {}\n",
              physicalDevice->get_properties().deviceName.data());
+  std::print("Async compute: {}\n",
+             !asyncCompute ? "unavailable, using the graphics queue"
+             : computeQueueIndex == graphicsQueueIndex
+                 ? "second graphics family queue"
+                 : "dedicated compute family");
+  std::print("Present wait: {}\n", presentWait ? "supported" : "unavailable");
 
   initialize_vma_allocator(instance);
-  create_descriptor_pool();
+  create_descriptor_pool(general::Config::get_instance().get_max_frames() *
+                         100);
+  pipelineCache = device.createPipelineCache({});
   create_sync_objects();
+  profiler = std::make_unique<GpuProfiler>(
+      this, general::Config::get_instance().get_max_frames());
 
   thread = std::jthread(&LogicalDevice::thread_loop, this);
 }
@@ -85,6 +133,8 @@ device::LogicalDevice::~LogicalDevice() {
   }
 
   swapChain.reset();
+  profiler.reset();
+  samplerCache.clear();
 
   vmaDestroyAllocator(allocator);
 
@@ -93,6 +143,8 @@ device::LogicalDevice::~LogicalDevice() {
 }
 
 void device::LogicalDevice::thread_loop() {
+  TRACE_THREAD_NAME(std::format(
+      "LogicalDevice {}", physicalDevice->get_properties().deviceName.data()));
   std::unique_lock lock(mutex);
 
   while (!stopThread) {
@@ -107,6 +159,7 @@ void device::LogicalDevice::thread_loop() {
       lock.unlock();
       try {
         if (task) {
+          TRACE_ZONE("LogicalDevice task");
           task();
         }
       } catch (const std::exception &e) {
@@ -147,43 +200,112 @@ void device::LogicalDevice::initialize_vma_allocator(
              physicalDevice->get_properties().deviceName.data());
 }
 
-void device::LogicalDevice::create_descriptor_pool() {
-  uint32_t maxFrames = general::Config::get_instance().get_max_frames();
-
+void device::LogicalDevice::create_descriptor_pool(uint32_t maxSets) {
   // Define pool sizes for different descriptor types
   std::vector<vk::DescriptorPoolSize> poolSizes = {
-      {vk::DescriptorType::eUniformBuffer, maxFrames * 100},
-      {vk::DescriptorType::eStorageBuffer, maxFrames * 100},
-      {vk::DescriptorType::eCombinedImageSampler, maxFrames * 100},
-      {vk::DescriptorType::eSampledImage, maxFrames * 100},
-      {vk::DescriptorType::eStorageImage, maxFrames * 100}};
+      {vk::DescriptorType::eUniformBuffer, maxSets},
+      {vk::DescriptorType::eStorageBuffer, maxSets},
+      {vk::DescriptorType::eCombinedImageSampler, maxSets},
+      {vk::DescriptorType::eSampledImage, maxSets},
+      {vk::DescriptorType::eStorageImage, maxSets}};
 
   vk::DescriptorPoolCreateInfo poolInfo{
       .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-      .maxSets = maxFrames * 100,
+      .maxSets = maxSets,
       .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
       .pPoolSizes = poolSizes.data()};
 
-  descriptorPool = device.createDescriptorPool(poolInfo);
+  descriptorPools.push_back(device.createDescriptorPool(poolInfo));
+  descriptorPoolSets = maxSets;
 
-  std::print("Descriptor pool created for device: {}\n",
+  std::print("Descriptor pool {} ({} sets) created for device: {}\n",
+             descriptorPools.size(), maxSets,
              physicalDevice->get_properties().deviceName.data());
 }
 
-void device::LogicalDevice::create_sync_objects() {
-  uint32_t maxFrames = general::Config::get_instance().get_max_frames();
+vk::raii::DescriptorSets device::LogicalDevice::allocate_descriptor_sets(
+    std::span<const vk::DescriptorSetLayout> layouts) {
+  std::lock_guard lock(descriptorPoolMutex);
 
-  inFlightFences.reserve(maxFrames);
+  vk::DescriptorSetAllocateInfo allocInfo{
+      .descriptorSetCount = static_cast<uint32_t>(layouts.size()),
+      .pSetLayouts = layouts.data()};
 
-  vk::SemaphoreCreateInfo semaphoreInfo{};
-  vk::FenceCreateInfo fenceInfo{.flags = vk::FenceCreateFlagBits::eSignaled};
+  // Newest first, older pools get sets back when objects are removed
+  for (auto pool = descriptorPools.rbegin(); pool != descriptorPools.rend();
+       ++pool) {
+    allocInfo.descriptorPool = **pool;
+    try {
+      return vk::raii::DescriptorSets(device, allocInfo);
+    } catch (const vk::OutOfPoolMemoryError &) {
+    } catch (const vk::FragmentedPoolError &) {
+    }
+  }
 
-  for (uint32_t i = 0; i < maxFrames; ++i) {
-    inFlightFences.push_back(device.createFence(fenceInfo));
+  create_descriptor_pool(
+      std::max(descriptorPoolSets * 2, static_cast<uint32_t>(layouts.size())));
+  allocInfo.descriptorPool = *descriptorPools.back();
+  return vk::raii::DescriptorSets(device, allocInfo);
+}
+
+bool device::LogicalDevice::select_compute_queue(uint32_t &family,
+                                                 uint32_t &index) const {
+  const auto &families = physicalDevice->get_queue_families();
+
+  for (uint32_t i = 0; i < families.size(); ++i) {
+    if ((families[i].queueFlags & vk::QueueFlagBits::eCompute) &&
+        !(families[i].queueFlags & vk::QueueFlagBits::eGraphics)) {
+      family = i;
+      index = 0;
+      return true;
+    }
+  }
+
+  if (families[graphicsQueueIndex].queueCount > 1) {
+    family = graphicsQueueIndex;
+    index = 1;
+    return true;
+  }
+
+  family = graphicsQueueIndex;
+  index = 0;
+  return false;
+}
+
+bool device::LogicalDevice::supports_present_wait() const {
+  const auto available =
+      physicalDevice->get_device().enumerateDeviceExtensionProperties();
+  auto hasExtension = [&available](const char *name) {
+    return std::ranges::any_of(available, [name](const auto &extension) {
+      return strcmp(extension.extensionName, name) == 0;
+    });
+  };
+  if (!hasExtension(vk::KHRPresentIdExtensionName) ||
+      !hasExtension(vk::KHRPresentWaitExtensionName)) {
+    return false;
   }
 
-  std::print("Synchronization objects created for device: {} ({} fences for "
-             "frames in flight)\n",
+  auto features = physicalDevice->get_device()
+                      .getFeatures2<vk::PhysicalDeviceFeatures2,
+                                    vk::PhysicalDevicePresentIdFeaturesKHR,
+                                    vk::PhysicalDevicePresentWaitFeaturesKHR>();
+  return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+         features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+}
+
+void device::LogicalDevice::create_sync_objects() {
+  uint32_t maxFrames = general::Config::get_instance().get_max_frames();
+
+  vk::SemaphoreTypeCreateInfo timelineInfo{
+      .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+  computeTimeline = device.createSemaphore({.pNext = &timelineInfo});
+  computeSlotValues.assign(maxFrames, 0);
+
+  frameTimeline = device.createSemaphore({.pNext = &timelineInfo});
+  frameSlotValues.assign(maxFrames, 0);
+
+  std::print("Synchronization objects created for device: {} (frame "
+             "timeline, {} frames in flight)\n",
              physicalDevice->get_properties().deviceName.data(), maxFrames);
 }
 
@@ -221,8 +343,10 @@ void device::LogicalDevice::create_swapchain_semaphores() {
 }
 
 void device::LogicalDevice::initialize_swap_chain(
-    GLFWwindow *window, vk::raii::SurfaceKHR &surface) {
-  swapChain = std::make_unique<SwapChain>(this, window, surface);
+    GLFWwindow *window, vk::raii::SurfaceKHR &surface,
+    SwapChain::PresentPolicy presentPolicy) {
+  swapChain =
+      std::make_unique<SwapChain>(this, window, surface, presentPolicy);
   swapChain->create_swap_chain();
   swapChain->create_swap_image_views();
   swapChain->create_depth_resources();
@@ -241,6 +365,12 @@ void device::LogicalDevice::initialize_command_pool(
     vk::CommandPoolCreateInfo &createInfo) {
   createInfo.queueFamilyIndex = graphicsQueueIndex;
   commandPool = vk::raii::CommandPool(device, createInfo);
+
+  if (asyncCompute) {
+    vk::CommandPoolCreateInfo computeInfo = createInfo;
+    computeInfo.queueFamilyIndex = computeQueueIndex;
+    computeCommandPool = vk::raii::CommandPool(device, computeInfo);
+  }
 }
 
 void device::LogicalDevice::create_command_buffer() {
@@ -249,6 +379,11 @@ void device::LogicalDevice::create_command_buffer() {
       .level = vk::CommandBufferLevel::ePrimary,
       .commandBufferCount = general::Config::get_instance().get_max_frames()};
   commandBuffers = vk::raii::CommandBuffers(device, allocInfo);
+
+  if (asyncCompute) {
+    allocInfo.commandPool = *computeCommandPool;
+    computeCommandBuffers = vk::raii::CommandBuffers(device, allocInfo);
+  }
 }
 
 void device::LogicalDevice::wait_idle() {
@@ -264,19 +399,41 @@ void device::LogicalDevice::wait_idle() {
   device.waitIdle();
 }
 
-bool device::LogicalDevice::wait_for_fence(uint32_t frameIndex) {
-  auto result =
-      device.waitForFences(*inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+bool device::LogicalDevice::wait_for_frame_slot(uint32_t frameIndex) {
+  return wait_for_frame(frameSlotValues[frameIndex]);
+}
+
+bool device::LogicalDevice::wait_for_frame(uint64_t frameNumber,
+                                           uint64_t timeout) {
+  if (frameNumber == 0) {
+    return true;
+  }
+
+  vk::SemaphoreWaitInfo waitInfo{.semaphoreCount = 1,
+                                 .pSemaphores = &*frameTimeline,
+                                 .pValues = &frameNumber};
+  auto result = device.waitSemaphores(waitInfo, timeout);
+  if (result == vk::Result::eTimeout) {
+    return false;
+  }
   if (result != vk::Result::eSuccess) {
-    std::print("Failed to wait for fence (frame {}): {}\n", frameIndex,
+    std::print("Failed to wait for frame {}: {}\n", frameNumber,
                vk::to_string(result));
     return false;
   }
   return true;
 }
 
-void device::LogicalDevice::reset_fence(uint32_t frameIndex) {
-  device.resetFences(*inFlightFences[frameIndex]);
+bool device::LogicalDevice::is_frame_complete(uint64_t frameNumber) const {
+  return get_completed_frame() >= frameNumber;
+}
+
+uint64_t device::LogicalDevice::get_completed_frame() const {
+  return frameTimeline.getCounterValue();
+}
+
+uint64_t device::LogicalDevice::get_submitted_frame() const {
+  return submittedFrame;
 }
 
 void device::LogicalDevice::begin_command_buffer(uint32_t frameIndex) {
@@ -291,26 +448,124 @@ void device::LogicalDevice::end_command_buffer(uint32_t frameIndex) {
 
 void device::LogicalDevice::submit_command_buffer(uint32_t frameIndex,
                                                   uint32_t imageIndex,
-                                                  bool withSemaphores) {
-  if (withSemaphores) {
-    vk::PipelineStageFlags waitStages[] = {
-        vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::SubmitInfo submitInfo{
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &*imageAvailableSemaphores[frameIndex],
-        .pWaitDstStageMask = waitStages,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &*commandBuffers[frameIndex],
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &*renderFinishedSemaphores[imageIndex]};
-
-    graphicsQueue.submit(submitInfo, *inFlightFences[frameIndex]);
-  } else {
-    vk::SubmitInfo submitInfo{.commandBufferCount = 1,
-                              .pCommandBuffers = &*commandBuffers[frameIndex]};
-
-    graphicsQueue.submit(submitInfo, nullptr);
+                                                  bool withSemaphores,
+                                                  uint64_t frameNumber,
+                                                  uint64_t computeWaitValue) {
+  // Every submit signals the frame timeline, including those of devices
+  // that only render part of the frame and never present. Offscreen swap
+  // chains have nothing to acquire or present, so no binary semaphores
+  const bool presents = withSemaphores && swapChain->is_presentable();
+
+  std::array<vk::Semaphore, 2> waitSemaphores;
+  std::array<uint64_t, 2> waitValues;
+  std::array<vk::PipelineStageFlags, 2> waitStages;
+  uint32_t waitCount = 0;
+  if (presents) {
+    waitSemaphores[waitCount] = *imageAvailableSemaphores[frameIndex];
+    waitValues[waitCount] = 0;
+    waitStages[waitCount] = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    ++waitCount;
+  }
+  if (withSemaphores && computeWaitValue) {
+    waitSemaphores[waitCount] = *computeTimeline;
+    waitValues[waitCount] = computeWaitValue;
+    waitStages[waitCount] = vk::PipelineStageFlagBits::eDrawIndirect |
+                            vk::PipelineStageFlagBits::eVertexInput |
+                            vk::PipelineStageFlagBits::eVertexShader |
+                            vk::PipelineStageFlagBits::eFragmentShader;
+    ++waitCount;
   }
+
+  std::array<vk::Semaphore, 2> signalSemaphores;
+  std::array<uint64_t, 2> signalValues;
+  uint32_t signalCount = 0;
+  if (presents) {
+    signalSemaphores[signalCount] = *renderFinishedSemaphores[imageIndex];
+    signalValues[signalCount] = 0;
+    ++signalCount;
+  }
+  signalSemaphores[signalCount] = *frameTimeline;
+  signalValues[signalCount] = frameNumber;
+  ++signalCount;
+
+  vk::TimelineSemaphoreSubmitInfo timelineInfo{
+      .waitSemaphoreValueCount = waitCount,
+      .pWaitSemaphoreValues = waitValues.data(),
+      .signalSemaphoreValueCount = signalCount,
+      .pSignalSemaphoreValues = signalValues.data()};
+  vk::SubmitInfo submitInfo{.pNext = &timelineInfo,
+                            .waitSemaphoreCount = waitCount,
+                            .pWaitSemaphores = waitSemaphores.data(),
+                            .pWaitDstStageMask = waitStages.data(),
+                            .commandBufferCount = 1,
+                            .pCommandBuffers = &*commandBuffers[frameIndex],
+                            .signalSemaphoreCount = signalCount,
+                            .pSignalSemaphores = signalSemaphores.data()};
+
+  graphicsQueue.submit(submitInfo, nullptr);
+
+  submittedFrame = frameNumber;
+  frameSlotValues[frameIndex] = frameNumber;
+}
+
+bool device::LogicalDevice::has_async_compute() const { return asyncCompute; }
+
+bool device::LogicalDevice::has_present_wait() const { return presentWait; }
+
+vk::raii::CommandBuffer &
+device::LogicalDevice::begin_compute_command_buffer(uint32_t frameIndex) {
+  // The buffer is only reused once its last submit finished
+  wait_for_compute(computeSlotValues[frameIndex]);
+
+  auto &commandBuffer = computeCommandBuffers[frameIndex];
+  commandBuffer.reset();
+  commandBuffer.begin(
+      {.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+  return commandBuffer;
+}
+
+uint64_t device::LogicalDevice::submit_compute_command_buffer(
+    uint32_t frameIndex) {
+  computeCommandBuffers[frameIndex].end();
+
+  uint64_t value = ++computeTimelineValue;
+  vk::TimelineSemaphoreSubmitInfo timelineInfo{
+      .signalSemaphoreValueCount = 1, .pSignalSemaphoreValues = &value};
+  vk::SubmitInfo submitInfo{
+      .pNext = &timelineInfo,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &*computeCommandBuffers[frameIndex],
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &*computeTimeline};
+
+  computeQueue.submit(submitInfo, nullptr);
+  computeSlotValues[frameIndex] = value;
+  return value;
+}
+
+bool device::LogicalDevice::wait_for_compute(uint64_t value) {
+  if (value == 0) {
+    return true;
+  }
+
+  vk::SemaphoreWaitInfo waitInfo{.semaphoreCount = 1,
+                                 .pSemaphores = &*computeTimeline,
+                                 .pValues = &value};
+  auto result = device.waitSemaphores(waitInfo, UINT64_MAX);
+  if (result != vk::Result::eSuccess) {
+    std::print("Failed to wait for compute value {}: {}\n", value,
+               vk::to_string(result));
+    return false;
+  }
+  return true;
+}
+
+const vk::raii::Semaphore &device::LogicalDevice::get_compute_timeline() const {
+  return computeTimeline;
+}
+
+uint64_t device::LogicalDevice::get_compute_timeline_value() const {
+  return computeTimelineValue;
 }
 
 device::PhysicalDevice *device::LogicalDevice::get_physical_device() const {
@@ -325,6 +580,21 @@ vk::raii::Queue &device::LogicalDevice::get_graphics_queue() {
   return graphicsQueue;
 }
 
+vk::raii::Queue &device::LogicalDevice::get_compute_queue() {
+  return computeQueue;
+}
+
+uint32_t device::LogicalDevice::get_compute_queue_index() const {
+  return computeQueueIndex;
+}
+
+std::vector<uint32_t> device::LogicalDevice::get_queue_family_indices() const {
+  if (computeQueueIndex == graphicsQueueIndex) {
+    return {graphicsQueueIndex};
+  }
+  return {graphicsQueueIndex, computeQueueIndex};
+}
+
 uint32_t device::LogicalDevice::get_graphics_queue_index() const {
   return graphicsQueueIndex;
 }
@@ -339,9 +609,74 @@ const vk::raii::CommandPool &device::LogicalDevice::get_command_pool() const {
   return commandPool;
 }
 
-const vk::raii::DescriptorPool &
-device::LogicalDevice::get_descriptor_pool() const {
-  return descriptorPool;
+device::GpuProfiler &device::LogicalDevice::get_profiler() const {
+  return *profiler;
+}
+
+const vk::raii::PipelineCache &
+device::LogicalDevice::get_pipeline_cache() const {
+  return pipelineCache;
+}
+
+size_t device::LogicalDevice::SamplerCreateInfoHash::operator()(
+    const vk::SamplerCreateInfo &createInfo) const {
+  size_t seed = 0;
+  auto combine = [&seed](auto value) {
+    seed ^= std::hash<decltype(value)>{}(value) + 0x9e3779b9 + (seed << 6) +
+            (seed >> 2);
+  };
+  // Equal floats must hash equal, -0.0f compares equal to 0.0f
+  auto combine_float = [&combine](float value) {
+    combine(value == 0.0f ? 0.0f : value);
+  };
+
+  combine(static_cast<VkSamplerCreateFlags>(createInfo.flags));
+  combine(static_cast<int>(createInfo.magFilter));
+  combine(static_cast<int>(createInfo.minFilter));
+  combine(static_cast<int>(createInfo.mipmapMode));
+  combine(static_cast<int>(createInfo.addressModeU));
+  combine(static_cast<int>(createInfo.addressModeV));
+  combine(static_cast<int>(createInfo.addressModeW));
+  combine_float(createInfo.mipLodBias);
+  combine(createInfo.anisotropyEnable);
+  combine_float(createInfo.maxAnisotropy);
+  combine(createInfo.compareEnable);
+  combine(static_cast<int>(createInfo.compareOp));
+  combine_float(createInfo.minLod);
+  combine_float(createInfo.maxLod);
+  combine(static_cast<int>(createInfo.borderColor));
+  combine(createInfo.unnormalizedCoordinates);
+
+  return seed;
+}
+
+vk::Sampler device::LogicalDevice::get_or_create_sampler(
+    const vk::SamplerCreateInfo &createInfo) {
+  if (createInfo.pNext != nullptr) {
+    // Chained structures can't be compared by value, never share these
+    throw std::invalid_argument(
+        "Cached samplers can't have extension structures chained");
+  }
+
+  std::lock_guard lock(samplerMutex);
+
+  auto it = samplerCache.find(createInfo);
+  if (it == samplerCache.end()) {
+    it = samplerCache
+             .try_emplace(createInfo, device.createSampler(createInfo))
+             .first;
+
+    std::print("Sampler created for device: {} ({} cached)\n",
+               physicalDevice->get_properties().deviceName.data(),
+               samplerCache.size());
+  }
+
+  return *it->second;
+}
+
+size_t device::LogicalDevice::get_sampler_count() const {
+  std::lock_guard lock(samplerMutex);
+  return samplerCache.size();
 }
 
 std::vector<vk::raii::CommandBuffer> &
@@ -375,10 +710,6 @@ const vk::raii::Semaphore &device::LogicalDevice::get_render_finished_semaphore(
   return renderFinishedSemaphores[imageIndex];
 }
 
-const vk::raii::Fence &
-device::LogicalDevice::get_in_flight_fence(uint32_t frameIndex) const {
-  if (frameIndex >= inFlightFences.size()) {
-    throw std::out_of_range("Frame index out of range for in-flight fence");
-  }
-  return inFlightFences[frameIndex];
+const vk::raii::Semaphore &device::LogicalDevice::get_frame_timeline() const {
+  return frameTimeline;
 }
@@ -4,7 +4,7 @@
 #include "config.h"
 #include "image.h"
 #include "logical_device.h"
-#include "slang_wasm_compiler.h"
+#include "trace.h"
 #include "vulkan/vulkan.hpp"
 #include <array>
 #include <cstdint>
@@ -30,6 +30,20 @@ render::Material::Material(const std::vector<device::LogicalDevice *> &devices,
     deviceResources.push_back(std::make_unique<DeviceMaterialResources>());
   }
 
+  if (shader) {
+    reflection = shader->get_reflection();
+    if (this->createInfo.descriptorBindings.empty()) {
+      this->createInfo.descriptorBindings =
+          reflection.get_set_layout_bindings(0);
+    }
+    if (reflection.get_set_count() > 1) {
+      std::print(stderr,
+                 "Material - {} - shader uses {} descriptor sets, only set 0 "
+                 "is bound\n",
+                 identifier, reflection.get_set_count());
+    }
+  }
+
   initialize();
 }
 
@@ -49,20 +63,7 @@ bool render::Material::create_pipeline(device::LogicalDevice *device,
                                        DeviceMaterialResources &resources,
                                        const MaterialCreateInfo &createInfo) {
   try {
-    // Get shader stage infos from the Shader object
-    std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
-
-    if (shader) {
-      // Find device index
-      uint32_t deviceIndex = 0;
-      for (size_t i = 0; i < logicalDevices.size(); ++i) {
-        if (logicalDevices[i] == device) {
-          deviceIndex = static_cast<uint32_t>(i);
-          break;
-        }
-      }
-      shaderStages = shader->get_pipeline_stage_infos(deviceIndex);
-    } else {
+    if (!shader) {
       std::print(stderr, "Material - {} - no shader provided\n", identifier);
       return false;
     }
@@ -83,13 +84,43 @@ bool render::Material::create_pipeline(device::LogicalDevice *device,
     }
 
     // Create pipeline layout
+    const auto &pushConstantRanges = reflection.get_push_constant_ranges();
     vk::PipelineLayoutCreateInfo pipelineLayoutInfo{
         .setLayoutCount = 1,
         .pSetLayouts = &*resources.descriptorLayout,
-        .pushConstantRangeCount = 0};
+        .pushConstantRangeCount =
+            static_cast<uint32_t>(pushConstantRanges.size()),
+        .pPushConstantRanges = pushConstantRanges.data()};
 
     resources.pipelineLayout =
         device->get_device().createPipelineLayout(pipelineLayoutInfo);
+  } catch (const std::exception &e) {
+    std::print(
+        "Failed to create pipeline layout for device {}: {}\n",
+        device->get_physical_device()->get_properties().deviceName.data(),
+        e.what());
+    return false;
+  }
+
+  return create_graphics_pipeline(device, resources, createInfo);
+}
+
+bool render::Material::create_graphics_pipeline(
+    device::LogicalDevice *device, DeviceMaterialResources &resources,
+    const MaterialCreateInfo &createInfo) {
+  try {
+    // Find device index
+    uint32_t deviceIndex = 0;
+    for (size_t i = 0; i < logicalDevices.size(); ++i) {
+      if (logicalDevices[i] == device) {
+        deviceIndex = static_cast<uint32_t>(i);
+        break;
+      }
+    }
+
+    // Get shader stage infos from the Shader object
+    std::vector<vk::PipelineShaderStageCreateInfo> shaderStages =
+        shader->get_pipeline_stage_infos(deviceIndex);
 
     // Dynamic state
     vk::PipelineDynamicStateCreateInfo dynamicStateInfo{
@@ -124,7 +155,7 @@ bool render::Material::create_pipeline(device::LogicalDevice *device,
         .basePipelineHandle = VK_NULL_HANDLE};
 
     resources.pipeline = device->get_device().createGraphicsPipeline(
-        nullptr, pipelineCreateInfo);
+        device->get_pipeline_cache(), pipelineCreateInfo);
 
     return true;
   } catch (const std::exception &e) {
@@ -137,6 +168,7 @@ bool render::Material::create_pipeline(device::LogicalDevice *device,
 }
 
 bool render::Material::initialize() {
+  TRACE_ZONE("Material::initialize");
   std::lock_guard lock(materialMutex);
 
   if (initialized) {
@@ -204,6 +236,56 @@ bool render::Material::reinitialize() {
   return initialize();
 }
 
+bool render::Material::rebuild_pipelines() {
+  std::lock_guard lock(materialMutex);
+
+  if (!initialized || !shader) {
+    return false;
+  }
+
+  // Layouts stay alive, a shader with a different interface needs a reload
+  if (!(shader->get_reflection() == reflection)) {
+    std::print(stderr,
+               "Material - {} - shader resources changed, reload to apply\n",
+               identifier);
+    return false;
+  }
+
+  std::vector<std::future<bool>> futures;
+
+  for (size_t i = 0; i < logicalDevices.size(); ++i) {
+    auto *device = logicalDevices[i];
+    auto &resources = *deviceResources[i];
+
+    auto promise = std::make_shared<std::promise<bool>>();
+    futures.push_back(promise->get_future());
+
+    // Layouts stay, so descriptor sets allocated against them remain valid.
+    // The pipeline is only replaced once the new one was created
+    device->submit_task([this, device, &resources, promise]() {
+      try {
+        promise->set_value(
+            create_graphics_pipeline(device, resources, createInfo));
+      } catch (const std::exception &e) {
+        std::print(stderr, "Material - {} - pipeline rebuild failed: {}\n",
+                   identifier, e.what());
+        promise->set_value(false);
+      }
+    });
+  }
+
+  bool allSuccess = true;
+  for (auto &future : futures) {
+    if (!future.get()) {
+      allSuccess = false;
+    }
+  }
+
+  std::print("Material - {} - pipelines {}\n", identifier,
+             allSuccess ? "rebuilt" : "partially rebuilt");
+  return allSuccess;
+}
+
 void render::Material::bind(vk::raii::CommandBuffer &commandBuffer,
                             uint32_t deviceIndex,
                             vk::raii::DescriptorSet *descriptorSet) {
@@ -278,3 +360,11 @@ const std::string &render::Material::get_identifier() const {
 }
 
 render::Shader *render::Material::get_shader() const { return shader; }
+
+const render::ShaderReflection &render::Material::get_reflection() const {
+  return reflection;
+}
+
+const std::string &render::Material::get_default_texture() const {
+  return createInfo.defaultTexture;
+}
@@ -3,9 +3,11 @@
 #include "material.h"
 #include <algorithm>
 #include <cassert>
+#include <format>
 #include <memory>
 #include <print>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 render::MaterialManager::MaterialManager(device::DeviceManager *deviceManager)
@@ -14,6 +16,7 @@ render::MaterialManager::MaterialManager(device::DeviceManager *deviceManager)
 render::MaterialManager::~MaterialManager() {
 
   materials.clear();
+  shaderVariants.clear();
 
   std::print("Material Manager destructor executed\n");
 }
@@ -43,6 +46,110 @@ void render::MaterialManager::reload_materials() {
   }
 }
 
+std::string render::MaterialManager::shader_variant_key(
+    const std::string &filePath,
+    std::vector<Shader::SpecializationConstant> constants) {
+  std::ranges::sort(constants, {}, &Shader::SpecializationConstant::id);
+
+  std::string key = filePath;
+  for (const auto &constant : constants) {
+    key += std::format("#{}={}", constant.id, constant.value);
+  }
+  return key;
+}
+
+render::Shader *
+render::MaterialManager::get_shader_variant(const ShaderVariant &variant,
+                                            bool &created) {
+  std::string key = shader_variant_key(variant.filePath, variant.constants);
+
+  created = false;
+  auto it = shaderVariants.find(key);
+  if (it != shaderVariants.end()) {
+    return it->second.get();
+  }
+
+  std::vector<Shader::ShaderStageInfo> stages = {
+      {.type = Shader::ShaderType::VERTEX,
+       .filePath = variant.filePath,
+       .entryPoint = "vertMain",
+       .specializationConstants = variant.constants},
+      {.type = Shader::ShaderType::FRAGMENT,
+       .filePath = variant.filePath,
+       .entryPoint = "fragMain",
+       .specializationConstants = variant.constants}};
+
+  Shader::ShaderCreateInfo shaderInfo{.identifier = key, .stages = stages};
+
+  auto shader = std::make_unique<Shader>(
+      deviceManager->get_all_logical_devices(), shaderInfo);
+  Shader *result = shader.get();
+  std::print("Material Manager - created shader variant {}\n", key);
+  shaderVariants.emplace(std::move(key), std::move(shader));
+  created = true;
+
+  return result;
+}
+
+void render::MaterialManager::discard_shader_variant(const Shader *shader) {
+  std::erase_if(shaderVariants, [shader](const auto &entry) {
+    return entry.second.get() == shader;
+  });
+}
+
+std::vector<render::ShaderWatcher::ModuleUpdate>
+render::MaterialManager::get_shader_sources() const {
+  std::vector<ShaderWatcher::ModuleUpdate> sources;
+  std::unordered_set<const Shader *> visited;
+
+  for (const auto &material : materials) {
+    const Shader *shader = material->get_shader();
+    if (!shader || !visited.insert(shader).second) {
+      continue;
+    }
+    for (const auto &moduleSource : shader->get_modules()) {
+      sources.push_back({.filePath = moduleSource.filePath,
+                         .entryPoints = moduleSource.entryPoints});
+    }
+  }
+
+  return sources;
+}
+
+size_t render::MaterialManager::apply_shader_updates(
+    const std::vector<ShaderWatcher::ModuleUpdate> &updates) {
+  std::unordered_set<Shader *> updatedShaders;
+
+  for (const auto &material : materials) {
+    Shader *shader = material->get_shader();
+    if (!shader || updatedShaders.contains(shader)) {
+      continue;
+    }
+
+    const auto &modules = shader->get_modules();
+    for (size_t i = 0; i < modules.size(); ++i) {
+      for (const auto &update : updates) {
+        if (update.filePath == modules[i].filePath &&
+            update.entryPoints == modules[i].entryPoints &&
+            shader->replace_module(i, update.spirvCode,
+                                   material->get_reflection())) {
+          updatedShaders.insert(shader);
+        }
+      }
+    }
+  }
+
+  size_t rebuilt = 0;
+  for (const auto &material : materials) {
+    if (updatedShaders.contains(material->get_shader()) &&
+        material->rebuild_pipelines()) {
+      ++rebuilt;
+    }
+  }
+
+  return rebuilt;
+}
+
 render::Material *
 render::MaterialManager::get_material(const std::string &identifier) const {
   for (const auto &material : materials) {
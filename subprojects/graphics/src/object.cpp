@@ -1,11 +1,13 @@
 #include "object.h"
 #include "buffer_manager.h"
 #include "config.h"
-#include "identifiers.h"
 #include "material.h"
 #include "material_manager.h"
 #include "texture_manager.h"
+#include "trace.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 #include <print>
 #include <set>
@@ -94,7 +96,11 @@ render::Object::Object(const ObjectCreateInfo &createInfo,
       visible(createInfo.visible), bufferManager(bufferManager),
       materialManager(materialManager), textureManager(textureManager),
       rotationMode(type == ObjectType::OBJECT_2D ? RotationMode::SHADER_2D
-                                                 : RotationMode::TRANSFORM_3D) {
+                                                 : RotationMode::TRANSFORM_3D),
+      snapshotIndex(0) {
+  update_model_matrix();
+  snapshots.fill({.modelMatrix = modelMatrix, .visible = visible});
+
   // Get logical devices for descriptor set creation
   auto *deviceManager = materialManager->get_device_manager();
   if (deviceManager) {
@@ -108,6 +114,11 @@ render::Object::Object(const ObjectCreateInfo &createInfo,
   vertexBufferName = identifier + "_vertices";
   indexBufferName = identifier + "_indices";
 
+  // Textures that are views into a shared atlas page need their texture
+  // coordinates moved into the view rectangle before upload
+  VertexData vertexData = createInfo.vertices;
+  remap_view_texcoords(vertexData, createInfo.indices, createInfo.submeshes);
+
   // Create vertex buffer based on vertex type
   std::visit(
       [&](auto &&vertices) {
@@ -124,7 +135,7 @@ render::Object::Object(const ObjectCreateInfo &createInfo,
 
         bufferManager->create_buffer(vertInfo);
       },
-      createInfo.vertices);
+      vertexData);
 
   // Create index buffer
   device::Buffer::BufferCreateInfo indInfo = {
@@ -159,59 +170,12 @@ render::Object::Object(const ObjectCreateInfo &createInfo,
                materialIdentifier, identifier);
   }
 
-  // Create per-object UBO for materials that need separate transforms per
-  // object Use centralized function to check if material needs UBO based on
-  // naming convention
-  bool needsPerObjectUBO =
-      render::material_needs_per_object_ubo(materialIdentifier);
-
-  if (needsPerObjectUBO) {
-    device::Buffer::TransformUBO uboData = {.model = glm::mat4(1.0f),
-                                            .view = glm::mat4(1.0f),
-                                            .proj = glm::mat4(1.0f)};
-
-    std::string uboBufferName = materialIdentifier + "_" + identifier + "_ubo";
-    device::Buffer::BufferCreateInfo uboInfo = {
-        .identifier = uboBufferName,
-        .type = device::Buffer::BufferType::UNIFORM,
-        .usage = device::Buffer::BufferUsage::DYNAMIC,
-        .size = sizeof(device::Buffer::TransformUBO),
-        .elementSize = sizeof(device::Buffer::TransformUBO),
-        .initialData = &uboData};
-
-    bufferManager->create_buffer(uboInfo);
-  }
-
-  // Create UBOs for submesh materials if needed
+  // Create per-object UBOs, sized for the uniform block of each material's
+  // shader. Materials without one get no buffer
+  create_uniform_buffer(materialIdentifier);
   if (useSubmeshes) {
     for (const auto &submesh : submeshes) {
-      bool submeshNeedsUBO =
-          material_needs_per_object_ubo(submesh.materialIdentifier);
-
-      if (submeshNeedsUBO) {
-        // Only create if different from base material
-        if (submesh.materialIdentifier != materialIdentifier) {
-          device::Buffer::TransformUBO uboData = {.model = glm::mat4(1.0f),
-                                                  .view = glm::mat4(1.0f),
-                                                  .proj = glm::mat4(1.0f)};
-
-          std::string uboBufferName =
-              submesh.materialIdentifier + "_" + identifier + "_ubo";
-
-          // Check if buffer doesn't already exist
-          if (!bufferManager->get_buffer(uboBufferName)) {
-            device::Buffer::BufferCreateInfo uboInfo = {
-                .identifier = uboBufferName,
-                .type = device::Buffer::BufferType::UNIFORM,
-                .usage = device::Buffer::BufferUsage::DYNAMIC,
-                .size = sizeof(device::Buffer::TransformUBO),
-                .elementSize = sizeof(device::Buffer::TransformUBO),
-                .initialData = &uboData};
-
-            bufferManager->create_buffer(uboInfo);
-          }
-        }
-      }
+      create_uniform_buffer(submesh.materialIdentifier);
     }
   }
 
@@ -278,13 +242,120 @@ void render::Object::setup_materials_for_submeshes(
 
 std::string
 render::Object::get_ubo_buffer_name(const std::string &matIdentifier) const {
-  // Use centralized function to check if material needs UBO
-  if (material_needs_per_object_ubo(matIdentifier)) {
+  // Only materials whose shader declares a uniform block need one
+  Material *mat = materialManager->get_material(matIdentifier);
+  if (mat && mat->get_reflection().find_first(
+                 vk::DescriptorType::eUniformBuffer)) {
     return matIdentifier + "_" + identifier + "_ubo";
   }
   return "";
 }
 
+device::Buffer *
+render::Object::create_uniform_buffer(const std::string &matIdentifier) {
+  std::string uboName = get_ubo_buffer_name(matIdentifier);
+  if (uboName.empty()) {
+    return nullptr;
+  }
+  if (auto *existing = bufferManager->get_buffer(uboName)) {
+    return existing;
+  }
+
+  const auto *uboBinding =
+      materialManager->get_material(matIdentifier)
+          ->get_reflection()
+          .find_first(vk::DescriptorType::eUniformBuffer);
+
+  // The block starts with the transform, anything after it starts zeroed
+  device::Buffer::TransformUBO transform = {.model = glm::mat4(1.0f),
+                                            .view = glm::mat4(1.0f),
+                                            .proj = glm::mat4(1.0f)};
+  std::vector<char> uboData(std::max<size_t>(uboBinding->size, 1), 0);
+  std::memcpy(uboData.data(), &transform,
+              std::min(sizeof(transform), uboData.size()));
+
+  device::Buffer::BufferCreateInfo uboInfo = {
+      .identifier = uboName,
+      .type = device::Buffer::BufferType::UNIFORM,
+      .usage = device::Buffer::BufferUsage::DYNAMIC,
+      .size = uboData.size(),
+      .elementSize = uboData.size(),
+      .initialData = uboData.data()};
+
+  bufferManager->create_buffer(uboInfo);
+  return bufferManager->get_buffer(uboName);
+}
+
+std::string render::Object::resolve_texture_identifier(
+    const std::string &matIdentifier,
+    const std::vector<Submesh> &submeshList) const {
+  // Only materials whose shader samples a texture need one
+  Material *mat = materialManager->get_material(matIdentifier);
+  if (!mat || !mat->get_reflection().find_first(
+                  vk::DescriptorType::eCombinedImageSampler)) {
+    return "";
+  }
+
+  // Priority: submesh texture > object texture > material name
+  for (const auto &submesh : submeshList) {
+    if (submesh.materialIdentifier == matIdentifier &&
+        !submesh.textureIdentifier.empty()) {
+      return submesh.textureIdentifier;
+    }
+  }
+
+  if (!textureIdentifier.empty()) {
+    return textureIdentifier;
+  }
+
+  return mat->get_default_texture();
+}
+
+void render::Object::remap_view_texcoords(
+    VertexData &vertexData, const std::vector<uint16_t> &indices,
+    const std::vector<Submesh> &submeshList) const {
+  if (!textureManager) {
+    return;
+  }
+
+  std::visit(
+      [&](auto &vertices) {
+        using VertexType =
+            typename std::decay_t<decltype(vertices)>::value_type;
+        if constexpr (requires(VertexType v) { v.texCoord; }) {
+          std::vector<bool> remapped(vertices.size(), false);
+
+          auto remap_range = [&](uint32_t indexStart, uint32_t count,
+                                 const std::string &matIdentifier) {
+            Texture *texture = textureManager->get_texture(
+                resolve_texture_identifier(matIdentifier, submeshList));
+            if (!texture || !texture->is_view()) {
+              return;
+            }
+
+            uint32_t indexEnd = std::min<uint32_t>(indexStart + count,
+                                                   indices.size());
+            for (uint32_t i = indexStart; i < indexEnd; ++i) {
+              uint16_t vertex = indices[i];
+              if (vertex < vertices.size() && !remapped[vertex]) {
+                vertices[vertex].texCoord =
+                    texture->map_uv(vertices[vertex].texCoord);
+                remapped[vertex] = true;
+              }
+            }
+          };
+
+          // Submesh ranges first, the base material covers the remainder
+          for (const auto &submesh : submeshList) {
+            remap_range(submesh.indexStart, submesh.indexCount,
+                        submesh.materialIdentifier);
+          }
+          remap_range(0, indices.size(), materialIdentifier);
+        }
+      },
+      vertexData);
+}
+
 void render::Object::create_descriptor_sets() {
   if (!material) {
     std::print("Warning: Cannot create descriptor sets for object '{}' - no "
@@ -343,12 +414,8 @@ void render::Object::create_descriptor_sets_for_material(
     uint32_t maxFrames = general::Config::get_instance().get_max_frames();
     std::vector<vk::DescriptorSetLayout> layouts(maxFrames, layout);
 
-    vk::DescriptorSetAllocateInfo allocInfo{.descriptorPool =
-                                                *device->get_descriptor_pool(),
-                                            .descriptorSetCount = maxFrames,
-                                            .pSetLayouts = layouts.data()};
-
-    descriptorSetsForMaterial.emplace_back(device->get_device(), allocInfo);
+    descriptorSetsForMaterial.push_back(
+        device->allocate_descriptor_sets(layouts));
     std::print("Allocated {} descriptor sets for device {}\n", maxFrames,
                deviceIdx);
   }
@@ -356,95 +423,27 @@ void render::Object::create_descriptor_sets_for_material(
   // Store the descriptor sets for this material
   materialDescriptorSets[matIdentifier] = std::move(descriptorSetsForMaterial);
 
-  // Bind uniform buffer (binding 0)
-  for (size_t deviceIdx = 0; deviceIdx < logicalDevices.size(); ++deviceIdx) {
-    std::string uboName = get_ubo_buffer_name(matIdentifier);
-    if (uboName.empty()) {
-      std::print("Warning: No UBO name for material '{}'\n", matIdentifier);
-      continue;
-    }
-
-    auto *uboBuffer = bufferManager->get_buffer(uboName);
+  // Bind the uniform buffer at the binding the shader declares
+  const ShaderReflection &reflection = mat->get_reflection();
+  if (const auto *uboBinding =
+          reflection.find_first(vk::DescriptorType::eUniformBuffer)) {
+    auto *uboBuffer = create_uniform_buffer(matIdentifier);
     if (!uboBuffer) {
-      // UBO doesn't exist, create it now
-      std::print("Creating missing UBO buffer '{}' for material '{}'\n",
-                 uboName, matIdentifier);
-
-      device::Buffer::TransformUBO uboData = {.model = glm::mat4(1.0f),
-                                              .view = glm::mat4(1.0f),
-                                              .proj = glm::mat4(1.0f)};
-
-      device::Buffer::BufferCreateInfo uboInfo = {
-          .identifier = uboName,
-          .type = device::Buffer::BufferType::UNIFORM,
-          .usage = device::Buffer::BufferUsage::DYNAMIC,
-          .size = sizeof(device::Buffer::TransformUBO),
-          .elementSize = sizeof(device::Buffer::TransformUBO),
-          .initialData = &uboData};
-
-      bufferManager->create_buffer(uboInfo);
-      uboBuffer = bufferManager->get_buffer(uboName);
-
-      if (!uboBuffer) {
-        std::print("Error: Failed to create UBO buffer '{}'\n", uboName);
-        continue;
-      }
+      std::print("Error: Failed to create UBO buffer for material '{}'\n",
+                 matIdentifier);
     }
-
-    bind_buffer_to_descriptor_sets(matIdentifier, uboBuffer, 0, deviceIdx);
-  }
-
-  // Bind texture if this material needs it (binding 1)
-  // For textured materials, extract texture name from material identifier
-  if (matIdentifier.find("Textured") == 0) {
-    // Extract texture name from material identifier
-    // e.g., "Textured_checkerboard" -> "checkerboard"
-    // e.g., "Textured3D_gradient" -> "gradient"
-    // e.g., "Textured3D_atlas_0_0" -> "atlas_0_0" (atlas region texture)
-    std::string textureName;
-    if (matIdentifier.find("Textured3D_") == 0) {
-      textureName = matIdentifier.substr(11); // Skip "Textured3D_" prefix
-    } else if (matIdentifier.find("Textured_") == 0) {
-      textureName = matIdentifier.substr(9); // Skip "Textured_" prefix
-    }
-
-    std::print(
-        "=== Processing material '{}' - extracted texture name: '{}' ===\n",
-        matIdentifier, textureName);
-
-    // Check if this material belongs to a submesh and use submesh texture
-    std::string submeshTexture;
-    if (useSubmeshes) {
-      std::print("    Object has submeshes, checking for matching "
-                 "material...\n");
-      for (const auto &submesh : submeshes) {
-        if (submesh.materialIdentifier == matIdentifier &&
-            !submesh.textureIdentifier.empty()) {
-          submeshTexture = submesh.textureIdentifier;
-          std::print("    FOUND submesh with material '{}' and "
-                     "texture '{}'\n",
-                     matIdentifier, submeshTexture);
-          break;
-        }
-      }
-      if (submeshTexture.empty()) {
-        std::print("    No matching submesh found for material '{}'\n",
-                   matIdentifier);
-      }
+    for (size_t deviceIdx = 0; uboBuffer && deviceIdx < logicalDevices.size();
+         ++deviceIdx) {
+      bind_buffer_to_descriptor_sets(matIdentifier, uboBuffer,
+                                     uboBinding->binding, deviceIdx);
     }
+  }
 
-    // Priority: submesh texture > object texture > material name
-    std::string textureToUse;
-    if (!submeshTexture.empty()) {
-      textureToUse = submeshTexture;
-      std::print("    Using SUBMESH texture: '{}'\n", textureToUse);
-    } else if (!textureIdentifier.empty()) {
-      textureToUse = textureIdentifier;
-      std::print("    Using OBJECT texture: '{}'\n", textureToUse);
-    } else {
-      textureToUse = textureName;
-      std::print("    Using EXTRACTED texture: '{}'\n", textureToUse);
-    }
+  // Bind texture if this material's shader samples one
+  if (const auto *samplerBinding =
+          reflection.find_first(vk::DescriptorType::eCombinedImageSampler)) {
+    std::string textureToUse =
+        resolve_texture_identifier(matIdentifier, submeshes);
 
     std::print("Final texture to use for material '{}': '{}'\n", matIdentifier,
                textureToUse);
@@ -462,10 +461,11 @@ void render::Object::create_descriptor_sets_for_material(
       } else {
         std::print("=== BINDING TEXTURE '{}' for material '{}' ===\n",
                    textureToUse, matIdentifier);
+        textureBindings[matIdentifier].textureIdentifier = textureToUse;
         for (size_t deviceIdx = 0; deviceIdx < logicalDevices.size();
              ++deviceIdx) {
           bind_texture_to_descriptor_sets(matIdentifier, texture->get_image(),
-                                          1, deviceIdx);
+                                          samplerBinding->binding, deviceIdx);
         }
       }
     } else {
@@ -502,30 +502,70 @@ void render::Object::bind_texture_to_descriptor_sets(
              matIdentifier, binding, deviceIndex,
              descriptorSets[deviceIndex].size());
 
-  // Update all frames for this device
-  for (size_t frameIdx = 0; frameIdx < descriptorSets[deviceIndex].size();
-       ++frameIdx) {
-    vk::DescriptorImageInfo imageInfo{
-        .sampler = *image->get_sampler(deviceIndex),
-        .imageView = *image->get_image_view(deviceIndex),
-        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal};
+  auto &textureBinding = textureBindings[matIdentifier];
+  textureBinding.image = image;
+  textureBinding.binding = binding;
+  textureBinding.generations.resize(logicalDevices.size());
+  textureBinding.generations[deviceIndex].assign(
+      descriptorSets[deviceIndex].size(), image->get_generation());
 
-    vk::WriteDescriptorSet descriptorWrite{
-        .dstSet = *descriptorSets[deviceIndex][frameIdx],
-        .dstBinding = binding,
-        .dstArrayElement = 0,
-        .descriptorCount = 1,
-        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-        .pImageInfo = &imageInfo};
-
-    logicalDevices[deviceIndex]->get_device().updateDescriptorSets(
-        descriptorWrite, nullptr);
+  // Update all frames for this device
+  for (auto &descriptorSet : descriptorSets[deviceIndex]) {
+    write_texture_descriptor(descriptorSet, image, binding, deviceIndex);
   }
 
   std::print("Successfully updated {} descriptor sets for texture binding\n",
              descriptorSets[deviceIndex].size());
 }
 
+void render::Object::write_texture_descriptor(
+    vk::raii::DescriptorSet &descriptorSet, Image *image, uint32_t binding,
+    uint32_t deviceIndex) {
+  vk::DescriptorImageInfo imageInfo{
+      .sampler = image->get_sampler(deviceIndex),
+      .imageView = *image->get_image_view(deviceIndex),
+      .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal};
+
+  vk::WriteDescriptorSet descriptorWrite{
+      .dstSet = *descriptorSet,
+      .dstBinding = binding,
+      .dstArrayElement = 0,
+      .descriptorCount = 1,
+      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+      .pImageInfo = &imageInfo};
+
+  logicalDevices[deviceIndex]->get_device().updateDescriptorSets(
+      descriptorWrite, nullptr);
+}
+
+void render::Object::refresh_texture_binding(const std::string &matIdentifier,
+                                             uint32_t deviceIndex,
+                                             uint32_t frameIndex) {
+  auto bindingIt = textureBindings.find(matIdentifier);
+  if (bindingIt == textureBindings.end() || !bindingIt->second.image) {
+    return;
+  }
+
+  auto &textureBinding = bindingIt->second;
+  if (deviceIndex >= textureBinding.generations.size() ||
+      frameIndex >= textureBinding.generations[deviceIndex].size()) {
+    return;
+  }
+
+  // This frame's fence has been waited on, so its set is no longer in use
+  uint64_t current = textureBinding.image->get_generation();
+  uint64_t &written = textureBinding.generations[deviceIndex][frameIndex];
+  if (written == current) {
+    return;
+  }
+
+  auto &descriptorSets = materialDescriptorSets[matIdentifier];
+  write_texture_descriptor(descriptorSets[deviceIndex][frameIndex],
+                           textureBinding.image, textureBinding.binding,
+                           deviceIndex);
+  written = current;
+}
+
 void render::Object::bind_buffer_to_descriptor_sets(
     const std::string &matIdentifier, device::Buffer *buffer, uint32_t binding,
     uint32_t deviceIndex) {
@@ -584,15 +624,13 @@ void render::Object::bind_buffer_to_descriptor_sets(
 
 void render::Object::draw(vk::raii::CommandBuffer &commandBuffer,
                           uint32_t deviceIndex, uint32_t frameIndex) {
-  if (!visible) {
+  TRACE_ZONE("Object::draw");
+  // Only the snapshot is read here, the simulation state may be changing
+  const RenderSnapshot &snapshot = snapshots[snapshotIndex];
+  if (!snapshot.visible) {
     return;
   }
 
-  // Update model matrix if needed (GPU will use this via shaders)
-  if (transformDirty) {
-    update_model_matrix();
-  }
-
   // Bind vertex buffer (shared across all submeshes)
   device::Buffer *vertexBuffer = bufferManager->get_buffer(vertexBufferName);
   if (vertexBuffer) {
@@ -656,16 +694,20 @@ void render::Object::draw(vk::raii::CommandBuffer &commandBuffer,
       if (!uboBufferName.empty()) {
         device::Buffer *uboBuffer = bufferManager->get_buffer(uboBufferName);
         if (uboBuffer) {
-          device::Buffer::TransformUBO uboData = {.model = modelMatrix,
-                                                  .view = glm::mat4(1.0f),
-                                                  .proj = glm::mat4(1.0f)};
-
-          uboBuffer->update_data(&uboData, sizeof(device::Buffer::TransformUBO),
-                                 0);
+          device::Buffer::TransformUBO uboData = {
+              .model = snapshot.modelMatrix,
+              .view = glm::mat4(1.0f),
+              .proj = glm::mat4(1.0f)};
+
+          uboBuffer->update_data(
+              &uboData,
+              std::min<vk::DeviceSize>(sizeof(uboData), uboBuffer->get_size()),
+              0);
         }
       }
 
       // Get descriptor set for this material
+      refresh_texture_binding(useMaterialId, deviceIndex, frameIndex);
       vk::raii::DescriptorSet *descriptorSet = nullptr;
       auto descIt = materialDescriptorSets.find(useMaterialId);
       if (descIt != materialDescriptorSets.end() &&
@@ -700,16 +742,20 @@ void render::Object::draw(vk::raii::CommandBuffer &commandBuffer,
     if (!uboBufferName.empty()) {
       device::Buffer *uboBuffer = bufferManager->get_buffer(uboBufferName);
       if (uboBuffer) {
-        device::Buffer::TransformUBO uboData = {.model = modelMatrix,
-                                                .view = glm::mat4(1.0f),
-                                                .proj = glm::mat4(1.0f)};
-
-        uboBuffer->update_data(&uboData, sizeof(device::Buffer::TransformUBO),
-                               0);
+        device::Buffer::TransformUBO uboData = {
+            .model = snapshot.modelMatrix,
+            .view = glm::mat4(1.0f),
+            .proj = glm::mat4(1.0f)};
+
+        uboBuffer->update_data(
+            &uboData,
+            std::min<vk::DeviceSize>(sizeof(uboData), uboBuffer->get_size()),
+            0);
       }
     }
 
     // Get descriptor set for the base material
+    refresh_texture_binding(materialIdentifier, deviceIndex, frameIndex);
     vk::raii::DescriptorSet *descriptorSet = nullptr;
     auto it = materialDescriptorSets.find(materialIdentifier);
     if (it != materialDescriptorSets.end() && deviceIndex < it->second.size() &&
@@ -741,6 +787,16 @@ void render::Object::set_scale(const glm::vec3 &scl) {
 
 void render::Object::set_visible(bool vis) { visible = vis; }
 
+void render::Object::write_snapshot() {
+  if (transformDirty) {
+    update_model_matrix();
+  }
+  snapshots[snapshotIndex ^ 1] = {.modelMatrix = modelMatrix,
+                                  .visible = visible};
+}
+
+void render::Object::swap_snapshot() { snapshotIndex ^= 1; }
+
 void render::Object::set_rotation_mode(Object::RotationMode mode) {
   if (rotationMode == mode) {
     return;
@@ -791,8 +847,22 @@ const glm::mat4 &render::Object::get_model_matrix() {
   return modelMatrix;
 }
 
+const render::Object::RenderSnapshot &render::Object::get_snapshot() const {
+  return snapshots[snapshotIndex];
+}
+
 render::Material *render::Object::get_material() const { return material; }
 
 render::Object::RotationMode render::Object::get_rotation_mode() const {
   return rotationMode;
 }
+
+std::vector<std::string> render::Object::get_texture_identifiers() const {
+  std::vector<std::string> identifiers;
+  for (const auto &[matId, textureBinding] : textureBindings) {
+    if (!textureBinding.textureIdentifier.empty()) {
+      identifiers.push_back(textureBinding.textureIdentifier);
+    }
+  }
+  return identifiers;
+}
@@ -4,9 +4,13 @@
 #include "material_manager.h"
 #include "object.h"
 #include "texture_manager.h"
+#include "trace.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <glm/geometric.hpp>
 #include <memory>
+#include <optional>
 #include <print>
 #include <string>
 #include <vulkan/vulkan_raii.hpp>
@@ -16,7 +20,8 @@ render::ObjectManager::ObjectManager(device::DeviceManager *deviceManager,
                                      device::BufferManager *bufferManager,
                                      TextureManager *textureManager)
     : deviceManager(deviceManager), materialManager(materialManager),
-      bufferManager(bufferManager), textureManager(textureManager) {}
+      bufferManager(bufferManager), textureManager(textureManager),
+      batching(false) {}
 
 render::ObjectManager::~ObjectManager() {
   objects.clear();
@@ -88,7 +93,9 @@ render::Object *render::ObjectManager::create_object(
   objects[createInfo.identifier] = std::move(object);
 
   // Rebuild render queue
-  rebuild_render_queue();
+  if (!batching) {
+    rebuild_render_queue();
+  }
 
   return objPtr;
 }
@@ -113,6 +120,18 @@ void render::ObjectManager::remove_object(const std::string &identifier) {
   objects.erase(it);
 
   // Rebuild render queue
+  if (!batching) {
+    rebuild_render_queue();
+  }
+}
+
+void render::ObjectManager::begin_batch() {
+  batching = true;
+  renderQueue.clear();
+}
+
+void render::ObjectManager::end_batch() {
+  batching = false;
   rebuild_render_queue();
 }
 
@@ -128,14 +147,25 @@ render::ObjectManager::get_object(const std::string &identifier) {
 void render::ObjectManager::render_all_objects(
     vk::raii::CommandBuffer &commandBuffer, uint32_t deviceIndex,
     uint32_t frameIndex) {
+  TRACE_ZONE("ObjectManager::render_all_objects");
   Material *currentMaterial = nullptr;
 
+  // One GPU zone per material batch, the queue is sorted by material
+  const auto &devices = deviceManager->get_all_logical_devices();
+  device::GpuProfiler *profiler =
+      deviceIndex < devices.size() ? &devices[deviceIndex]->get_profiler()
+                                   : nullptr;
+  std::optional<device::GpuProfiler::Zone> materialZone;
+
   for (auto *object : renderQueue) {
     // Only bind material pipeline if it changed (optimization)
     // Objects will bind their own descriptor sets during draw()
     Material *objMaterial = object->get_material();
     if (objMaterial != currentMaterial) {
       if (objMaterial) {
+        materialZone.reset();
+        materialZone.emplace(profiler, commandBuffer,
+                             objMaterial->get_identifier());
         // Bind only the pipeline, not descriptor sets (objects manage
         // those)
         objMaterial->bind(commandBuffer, deviceIndex);
@@ -148,6 +178,56 @@ void render::ObjectManager::render_all_objects(
   }
 }
 
+void render::ObjectManager::update_streaming_priorities() {
+  if (!textureManager) {
+    return;
+  }
+
+  std::unordered_map<std::string, float> priorities;
+  for (auto &[id, object] : objects) {
+    // Read the drawn snapshot, the simulation may be updating the objects
+    const Object::RenderSnapshot &snapshot = object->get_snapshot();
+    if (!snapshot.visible) {
+      continue;
+    }
+
+    // Objects are drawn with identity view and projection, so the model
+    // matrix maps straight to clip space: its basis gives the projected size
+    // and its translation the distance from the viewer
+    const glm::mat4 &model = snapshot.modelMatrix;
+    float coverage = glm::length(glm::vec2(model[0])) *
+                     glm::length(glm::vec2(model[1]));
+    float distance = glm::length(glm::vec3(model[3]));
+    float priority = coverage / (1.0f + distance);
+
+    for (const auto &textureId : object->get_texture_identifiers()) {
+      float &current = priorities[textureId];
+      current = std::max(current, priority);
+    }
+  }
+
+  for (const auto &[textureId, priority] : priorities) {
+    textureManager->set_stream_priority(textureId, priority);
+  }
+}
+
+void render::ObjectManager::write_snapshots() {
+  for (auto &[id, object] : objects) {
+    object->write_snapshot();
+  }
+}
+
+void render::ObjectManager::swap_snapshots() {
+  for (auto &[id, object] : objects) {
+    object->swap_snapshot();
+  }
+}
+
+void render::ObjectManager::publish_snapshots() {
+  write_snapshots();
+  swap_snapshots();
+}
+
 void render::ObjectManager::wait_idle() {
   if (deviceManager) {
     deviceManager->wait_idle();
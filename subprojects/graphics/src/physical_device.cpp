@@ -67,7 +67,8 @@ bool device::PhysicalDevice::has_graphic_queue(vk::raii::SurfaceKHR &surface,
                                                uint32_t *queueIndex) const {
   for (uint32_t i = 0; i < queueFamilies.size(); i++) {
     if ((queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics) &&
-        device.getSurfaceSupportKHR(i, *surface)) {
+        (*surface == VK_NULL_HANDLE ||
+         device.getSurfaceSupportKHR(i, *surface))) {
       if (queueIndex)
         *queueIndex = i;
       return true;
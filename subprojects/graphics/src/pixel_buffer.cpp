@@ -0,0 +1,167 @@
+#include "pixel_buffer.h"
+#include <cstring>
+#include <print>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+render::PixelBuffer::PixelBuffer()
+    : pixels(nullptr), byteSize(0), storage(Storage::NONE),
+      releaseFunction(nullptr) {}
+
+render::PixelBuffer::~PixelBuffer() { reset(); }
+
+render::PixelBuffer::PixelBuffer(PixelBuffer &&other) noexcept
+    : heap(std::move(other.heap)), pixels(std::exchange(other.pixels, nullptr)),
+      byteSize(std::exchange(other.byteSize, 0)),
+      storage(std::exchange(other.storage, Storage::NONE)),
+      releaseFunction(std::exchange(other.releaseFunction, nullptr)) {}
+
+render::PixelBuffer &
+render::PixelBuffer::operator=(PixelBuffer &&other) noexcept {
+  if (this != &other) {
+    reset();
+    heap = std::move(other.heap);
+    pixels = std::exchange(other.pixels, nullptr);
+    byteSize = std::exchange(other.byteSize, 0);
+    storage = std::exchange(other.storage, Storage::NONE);
+    releaseFunction = std::exchange(other.releaseFunction, nullptr);
+  }
+  return *this;
+}
+
+void render::PixelBuffer::reset() {
+  switch (storage) {
+  case Storage::DECODER:
+    if (releaseFunction) {
+      releaseFunction(pixels);
+    }
+    break;
+  case Storage::MAPPED:
+#ifndef _WIN32
+    munmap(pixels, byteSize);
+#endif
+    break;
+  default:
+    break;
+  }
+
+  heap.clear();
+  heap.shrink_to_fit();
+  pixels = nullptr;
+  byteSize = 0;
+  storage = Storage::NONE;
+  releaseFunction = nullptr;
+}
+
+render::PixelBuffer render::PixelBuffer::allocate(size_t size) {
+  return take(std::vector<unsigned char>(size));
+}
+
+render::PixelBuffer render::PixelBuffer::copy_of(const unsigned char *data,
+                                                 size_t size) {
+  return take(std::vector<unsigned char>(data, data + size));
+}
+
+render::PixelBuffer
+render::PixelBuffer::take(std::vector<unsigned char> &&data) {
+  PixelBuffer buffer;
+  buffer.heap = std::move(data);
+  buffer.pixels = buffer.heap.data();
+  buffer.byteSize = buffer.heap.size();
+  buffer.storage = buffer.heap.empty() ? Storage::NONE : Storage::HEAP;
+  return buffer;
+}
+
+render::PixelBuffer render::PixelBuffer::adopt(unsigned char *data,
+                                               size_t size,
+                                               void (*release)(void *)) {
+  PixelBuffer buffer;
+  if (!data) {
+    return buffer;
+  }
+
+  buffer.pixels = data;
+  buffer.byteSize = size;
+  buffer.storage = Storage::DECODER;
+  buffer.releaseFunction = release;
+  return buffer;
+}
+
+render::PixelBuffer
+render::PixelBuffer::spill_to_file(std::span<const unsigned char> data,
+                                   const std::string &path) {
+  PixelBuffer buffer;
+  if (data.empty()) {
+    return buffer;
+  }
+
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    std::print(stderr, "Failed to create pixel cache file: {}\n", path);
+    return buffer;
+  }
+
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result <= 0) {
+      std::print(stderr, "Failed to write pixel cache file: {}\n", path);
+      close(fd);
+      unlink(path.c_str());
+      return buffer;
+    }
+    written += static_cast<size_t>(result);
+  }
+
+  // Private mapping: edits are copy-on-write and never reach the file
+  void *mapped = mmap(nullptr, data.size(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+  close(fd);
+  unlink(path.c_str());
+
+  if (mapped == MAP_FAILED) {
+    std::print(stderr, "Failed to map pixel cache file: {}\n", path);
+    return buffer;
+  }
+
+  buffer.pixels = static_cast<unsigned char *>(mapped);
+  buffer.byteSize = data.size();
+  buffer.storage = Storage::MAPPED;
+#else
+  (void)path;
+#endif
+
+  return buffer;
+}
+
+unsigned char *render::PixelBuffer::data() { return pixels; }
+
+const unsigned char *render::PixelBuffer::data() const { return pixels; }
+
+size_t render::PixelBuffer::size() const { return byteSize; }
+
+bool render::PixelBuffer::empty() const { return byteSize == 0; }
+
+unsigned char &render::PixelBuffer::operator[](size_t index) {
+  return pixels[index];
+}
+
+const unsigned char &render::PixelBuffer::operator[](size_t index) const {
+  return pixels[index];
+}
+
+std::span<const unsigned char> render::PixelBuffer::view() const {
+  return {pixels, byteSize};
+}
+
+render::PixelBuffer::Storage render::PixelBuffer::get_storage() const {
+  return storage;
+}
+
+void render::PixelBuffer::clear() { reset(); }
@@ -5,12 +5,17 @@
 #include "logical_device.h"
 #include "material_manager.h"
 #include "object_manager.h"
+#include "tasks.h"
 #include "texture_manager.h"
+#include "trace.h"
 #include "vulkan/vulkan.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <print>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -19,11 +24,52 @@
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
+namespace {
+
+// Bound on the low-latency wait, a hidden window may never present
+constexpr uint64_t lowLatencyTimeout = 100'000'000; // 100 ms
+
+// Presents waiting for their display to be observed
+constexpr size_t maxPendingPresents = 16;
+
+constexpr auto latencyReportInterval = std::chrono::seconds(5);
+
+// Outermost GPU zone of a frame, named after the strategy drawing it so
+// timings of strategies can be told apart
+const char *frame_zone_name(render::ObjectManager::RenderStrategy strategy) {
+  using Strategy = render::ObjectManager::RenderStrategy;
+  switch (strategy) {
+  case Strategy::SINGLE_GPU:
+    return "frame (SINGLE_GPU)";
+  case Strategy::AFR:
+    return "frame (AFR)";
+  case Strategy::SFR:
+    return "frame (SFR)";
+  case Strategy::HYBRID:
+    return "frame (HYBRID)";
+  case Strategy::MULTI_QUEUE_STREAMING:
+    return "frame (MULTI_QUEUE_STREAMING)";
+  }
+  return "frame";
+}
+
+} // namespace
+
 render::Renderer::Renderer(GLFWwindow *window)
-    : window(window), instance(nullptr), surface(nullptr),
-      debugMessanger(nullptr), deviceManager(nullptr), textureManager(nullptr),
-      bufferManager(nullptr), objectManager(nullptr), currentFrame(0),
-      frameCount(0), currentSemaphoreIndex(0) {
+    : Renderer(window, vk::Extent2D{}) {}
+
+render::Renderer::Renderer(vk::Extent2D extent) : Renderer(nullptr, extent) {}
+
+render::Renderer::Renderer(GLFWwindow *window, vk::Extent2D headlessExtent)
+    : window(window), headlessExtent(headlessExtent), instance(nullptr),
+      surface(nullptr), debugMessanger(nullptr), deviceManager(nullptr),
+      textureManager(nullptr), bufferManager(nullptr), objectManager(nullptr),
+      currentFrame(0), frameCount(0), currentSemaphoreIndex(0),
+      computeAheadFrame(0), computeAheadValue(0),
+      presentPolicy(device::SwapChain::PresentPolicy::MAILBOX),
+      targetFrameRate(0.0), lowLatency(false), framePaced(false),
+      latencySumMs(0.0), latencyMaxMs(0.0), latencySamples(0),
+      lastLatencyReport(Clock::now()) {
   PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr =
       dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
   VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
@@ -43,6 +89,8 @@ render::Renderer::Renderer(GLFWwindow *window)
   materialManager = std::make_unique<MaterialManager>(deviceManager.get());
 
   textureManager = std::make_unique<TextureManager>(deviceManager.get());
+  // Pixels are on the GPU after upload, CPU copies come back on demand
+  textureManager->set_cpu_residency(Image::Residency::RELEASE);
 
   bufferManager = std::make_unique<device::BufferManager>(deviceManager.get());
 
@@ -50,9 +98,17 @@ render::Renderer::Renderer(GLFWwindow *window)
       deviceManager.get(), materialManager.get(), bufferManager.get(),
       textureManager.get());
   objectManager->set_gpu_config(gpuConfig);
+
+  shaderWatcher = std::make_unique<ShaderWatcher>("assets/shaders");
 }
 
 render::Renderer::~Renderer() {
+  // The recompile only works on copies, waiting keeps its output quiet
+  if (shaderRecompile.valid()) {
+    shaderRecompile.wait();
+  }
+  shaderWatcher.reset();
+
   deviceManager->wait_idle();
 
   objectManager.reset();
@@ -114,6 +170,11 @@ void render::Renderer::init_instance() {
 }
 
 void render::Renderer::init_surface() {
+  // Headless rendering needs no surface, nor the GLFW instance extensions
+  if (!window) {
+    return;
+  }
+
   VkSurfaceKHR rawSurface = nullptr;
 
   if (glfwCreateWindowSurface(*instance, window, nullptr, &rawSurface) !=
@@ -132,7 +193,15 @@ void render::Renderer::init_device() {
 }
 
 void render::Renderer::init_swap_chain() {
-  deviceManager->create_swap_chains();
+  if (window) {
+    deviceManager->create_swap_chains(presentPolicy);
+  } else {
+    // The format a window surface gets too, so pipelines are the same
+    deviceManager->create_swap_chains(
+        {.format = vk::Format::eB8G8R8A8Srgb,
+         .colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear},
+        headlessExtent);
+  }
   deviceManager->create_command_pool();
 }
 
@@ -176,7 +245,20 @@ bool render::Renderer::acquire_next_image(device::LogicalDevice *device,
 void render::Renderer::present_frame(device::LogicalDevice *device,
                                      uint32_t imageIndex,
                                      uint32_t semaphoreIndex) {
+  auto &swapChain = device->get_swap_chain();
+  // Offscreen frames are done once submitted
+  if (!swapChain.is_presentable()) {
+    return;
+  }
+
+  // With present wait every present gets an id, to time when it is shown
+  const bool tracked = swapChain.supports_present_wait();
+  uint64_t presentId = tracked ? swapChain.next_present_id() : 0;
+  vk::PresentIdKHR presentIdInfo{.swapchainCount = 1,
+                                 .pPresentIds = &presentId};
+
   vk::PresentInfoKHR presentInfo{
+      .pNext = tracked ? &presentIdInfo : nullptr,
       .waitSemaphoreCount = 1,
       .pWaitSemaphores =
           &*device->get_render_finished_semaphore(semaphoreIndex),
@@ -192,24 +274,69 @@ void render::Renderer::present_frame(device::LogicalDevice *device,
     return;
   }
 
+  if (tracked) {
+    // Ids restart with a recreated swap chain, older ones are never shown
+    if (!pendingPresents.empty() &&
+        pendingPresents.back().presentId >= presentId) {
+      pendingPresents.clear();
+    }
+    pendingPresents.push_back({.presentId = presentId, .inputTime = inputTime});
+    if (pendingPresents.size() > maxPendingPresents) {
+      pendingPresents.pop_front();
+    }
+  } else {
+    record_present_latency(Clock::now() - inputTime, false);
+  }
+
   if (presentResult == vk::Result::eSuboptimalKHR) {
     deviceManager->recreate_swap_chain();
   }
 }
 
-void render::Renderer::draw_frame_single_gpu(device::LogicalDevice *device) {
+void render::Renderer::record_compute_passes(
+    vk::raii::CommandBuffer &commandBuffer, const ComputeFrame &frame) {
+  for (const auto &pass : computePasses) {
+    pass(commandBuffer, frame);
+  }
+}
+
+uint64_t
+render::Renderer::submit_compute_passes(device::LogicalDevice *device,
+                                        uint32_t frameIndex,
+                                        uint64_t frameNumber) {
+  const auto &families = device->get_physical_device()->get_queue_families();
+  ComputeFrame frame{
+      .deviceIndex = 0,
+      .frameIndex = frameIndex,
+      .computeOnlyQueue =
+          !(families[device->get_compute_queue_index()].queueFlags &
+            vk::QueueFlagBits::eGraphics)};
+
+  auto &commandBuffer = device->begin_compute_command_buffer(frameIndex);
+  auto &profiler = device->get_profiler();
+  profiler.begin_frame(commandBuffer, frameIndex, frameNumber,
+                       device::GpuProfiler::Queue::COMPUTE);
+  {
+    device::GpuProfiler::Zone zone(&profiler, commandBuffer,
+                                   "async compute passes");
+    record_compute_passes(commandBuffer, frame);
+  }
+  return device->submit_compute_command_buffer(frameIndex);
+}
+
+bool render::Renderer::draw_frame_single_gpu(device::LogicalDevice *device,
+                                             uint64_t computeWaitValue) {
   if (!device) {
-    return;
+    return false;
   }
 
-  if (!device->wait_for_fence(currentFrame)) {
-    return;
+  if (!device->wait_for_frame_slot(currentFrame)) {
+    return false;
   }
-  device->reset_fence(currentFrame);
 
   uint32_t imageIndex, semaphoreIndex;
   if (!acquire_next_image(device, imageIndex, semaphoreIndex)) {
-    return;
+    return false;
   }
 
   device->begin_command_buffer(currentFrame);
@@ -220,22 +347,45 @@ void render::Renderer::draw_frame_single_gpu(device::LogicalDevice *device) {
                "ERROR: Frame index {} out of range for command buffers "
                "(size: {})\n",
                currentFrame, commandBuffers.size());
-    return;
+    return false;
   }
   vk::raii::CommandBuffer &commandBuffer = commandBuffers[currentFrame];
 
-  device->get_swap_chain().transition_image_for_rendering(commandBuffer,
-                                                          imageIndex);
+  auto &profiler = device->get_profiler();
+  profiler.begin_frame(commandBuffer, currentFrame, frameCount + 1);
+  device::GpuProfiler::Zone frameZone(&profiler, commandBuffer,
+                                      frame_zone_name(gpuConfig.strategy));
+
+  if (!computeWaitValue && !computePasses.empty()) {
+    device::GpuProfiler::Zone zone(&profiler, commandBuffer, "compute passes");
+    record_compute_passes(commandBuffer, {.deviceIndex = 0,
+                                          .frameIndex = currentFrame,
+                                          .computeOnlyQueue = false});
+  }
+
+  {
+    device::GpuProfiler::Zone zone(&profiler, commandBuffer,
+                                   "swapchain transition");
+    device->get_swap_chain().transition_image_for_rendering(commandBuffer,
+                                                            imageIndex);
+  }
   device->get_swap_chain().begin_rendering(commandBuffer, imageIndex);
 
   objectManager->render_all_objects(commandBuffer, 0, currentFrame);
 
   device->get_swap_chain().end_rendering(commandBuffer);
-  device->get_swap_chain().transition_image_for_present(commandBuffer,
-                                                        imageIndex);
+  {
+    device::GpuProfiler::Zone zone(&profiler, commandBuffer,
+                                   "present transition");
+    device->get_swap_chain().transition_image_for_present(commandBuffer,
+                                                          imageIndex);
+  }
+  frameZone.end();
   device->end_command_buffer(currentFrame);
-  device->submit_command_buffer(currentFrame, semaphoreIndex, true);
+  device->submit_command_buffer(currentFrame, semaphoreIndex, true,
+                                frameCount + 1, computeWaitValue);
   present_frame(device, imageIndex, semaphoreIndex);
+  return true;
 }
 
 void render::Renderer::draw_frame_afr() {
@@ -271,12 +421,27 @@ void render::Renderer::draw_frame_sfr(uint32_t imageIndex,
     device::LogicalDevice *device =
         const_cast<device::LogicalDevice *>(allDevices[i]);
 
+    // The primary device waited before acquiring, the others wait for their
+    // own last use of the slot
+    if (i != 0 && !device->wait_for_frame_slot(currentFrame)) {
+      continue;
+    }
+
     device->begin_command_buffer(currentFrame);
     vk::raii::CommandBuffer &commandBuffer =
         device->get_command_buffers()[currentFrame];
 
-    device->get_swap_chain().transition_image_for_rendering(commandBuffer,
-                                                            imageIndex);
+    auto &profiler = device->get_profiler();
+    profiler.begin_frame(commandBuffer, currentFrame, frameCount + 1);
+    device::GpuProfiler::Zone frameZone(&profiler, commandBuffer,
+                                        frame_zone_name(gpuConfig.strategy));
+
+    {
+      device::GpuProfiler::Zone zone(&profiler, commandBuffer,
+                                     "swapchain transition");
+      device->get_swap_chain().transition_image_for_rendering(commandBuffer,
+                                                              imageIndex);
+    }
     device->get_swap_chain().begin_rendering(commandBuffer, imageIndex);
 
     // Adjust viewport for this GPU's portion
@@ -299,12 +464,16 @@ void render::Renderer::draw_frame_sfr(uint32_t imageIndex,
     device->get_swap_chain().end_rendering(commandBuffer);
 
     if (i == 0) {
+      device::GpuProfiler::Zone zone(&profiler, commandBuffer,
+                                     "present transition");
       device->get_swap_chain().transition_image_for_present(commandBuffer,
                                                             imageIndex);
     }
 
+    frameZone.end();
     device->end_command_buffer(currentFrame);
-    device->submit_command_buffer(currentFrame, semaphoreIndex, i == 0);
+    device->submit_command_buffer(currentFrame, semaphoreIndex, i == 0,
+                                  frameCount + 1);
   }
 
   present_frame(
@@ -319,10 +488,38 @@ void render::Renderer::draw_frame_hybrid() {
 }
 
 void render::Renderer::draw_frame_multi_queue_streaming() {
-  // Multi-queue with resource streaming
-  // This is an advanced feature that would use async compute/transfer queues
-  // For now, fall back to AFR
-  draw_frame_afr();
+  // Compute for frame N+1 runs on the async queue while frame N draws, the
+  // graphics of each frame waits on the compute timeline value of its own
+  device::LogicalDevice *device =
+      const_cast<device::LogicalDevice *>(deviceManager->get_primary_device());
+  if (!gpuConfig.useMultiQueue || !device->has_async_compute() ||
+      computePasses.empty()) {
+    computeAheadValue = 0;
+    draw_frame_single_gpu(device);
+    return;
+  }
+
+  // Nothing was submitted ahead on the first frame or after a skipped one
+  if (computeAheadValue == 0 || computeAheadFrame != frameCount) {
+    computeAheadValue =
+        submit_compute_passes(device, currentFrame, frameCount + 1);
+  }
+  uint64_t computeWaitValue = computeAheadValue;
+  computeAheadValue = 0;
+
+  if (!draw_frame_single_gpu(device, computeWaitValue)) {
+    return;
+  }
+
+  // The next frame's slot is free once the graphics that last read it
+  // finished, the next frame waits for it anyway
+  const uint32_t maxFrames = general::Config::get_instance().get_max_frames();
+  const uint32_t nextFrame = (currentFrame + 1) % maxFrames;
+  if (device->wait_for_frame_slot(nextFrame)) {
+    computeAheadValue =
+        submit_compute_passes(device, nextFrame, frameCount + 2);
+    computeAheadFrame = frameCount + 1;
+  }
 }
 
 void render::Renderer::reload() {
@@ -341,11 +538,22 @@ void render::Renderer::reload() {
     }
   }
 
+  // Results of a running recompile would target shaders about to go away
+  if (shaderRecompile.valid()) {
+    shaderRecompile.wait();
+    shaderRecompile = {};
+  }
+
   // Wait for all devices to be idle
   if (deviceManager) {
     deviceManager->wait_idle();
   }
 
+  // Timeline values and present ids belong to the devices about to be
+  // recreated
+  computeAheadValue = 0;
+  pendingPresents.clear();
+
   // Cleanup in reverse order
   objectManager.reset();
   bufferManager.reset();
@@ -385,6 +593,8 @@ void render::Renderer::reload() {
   materialManager = std::make_unique<MaterialManager>(deviceManager.get());
 
   textureManager = std::make_unique<TextureManager>(deviceManager.get());
+  // Pixels are on the GPU after upload, CPU copies come back on demand
+  textureManager->set_cpu_residency(Image::Residency::RELEASE);
 
   bufferManager = std::make_unique<device::BufferManager>(deviceManager.get());
 
@@ -407,7 +617,58 @@ void render::Renderer::reload() {
   }
 }
 
+void render::Renderer::process_shader_changes() {
+  if (shaderRecompile.valid()) {
+    if (shaderRecompile.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return;
+    }
+
+    auto updates = shaderRecompile.get();
+    if (!updates.empty()) {
+      // Buffers, textures, objects and descriptor sets stay, only the
+      // affected pipelines are replaced once nothing uses the old ones
+      auto start = std::chrono::steady_clock::now();
+      deviceManager->wait_idle();
+      size_t rebuilt = materialManager->apply_shader_updates(updates);
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+      std::print("Hot reload - {} modules, {} materials swapped in {} ms\n",
+                 updates.size(), rebuilt, elapsed.count());
+    }
+  }
+
+  auto changes = shaderWatcher->take_changes();
+  if (changes.empty()) {
+    return;
+  }
+
+  for (const auto &change : changes) {
+    std::print("Hot reload - {} changed\n", change.string());
+  }
+
+  // Compiling works on a snapshot of the sources, so scene switches while it
+  // runs are harmless
+  shaderRecompile = device::Tasks::get_instance().add_task(
+      [sources = materialManager->get_shader_sources(),
+       changes = std::move(changes)]() mutable {
+        return ShaderWatcher::recompile(std::move(sources), changes);
+      });
+}
+
 void render::Renderer::draw_frame() {
+  TRACE_ZONE("Renderer::draw_frame");
+  // Without pace_frame the latency is measured from here
+  if (!framePaced) {
+    inputTime = Clock::now();
+  }
+
+  process_shader_changes();
+
+  // Refine streamed textures before recording, the most visible ones first
+  objectManager->update_streaming_priorities();
+  textureManager->process_streaming();
+
   // Dispatch to strategy-specific implementation
   switch (gpuConfig.strategy) {
   case ObjectManager::RenderStrategy::SINGLE_GPU:
@@ -425,8 +686,7 @@ void render::Renderer::draw_frame() {
         device::LogicalDevice *primaryDevice =
             const_cast<device::LogicalDevice *>(
                 deviceManager->get_primary_device());
-        if (primaryDevice->wait_for_fence(currentFrame)) {
-          primaryDevice->reset_fence(currentFrame);
+        if (primaryDevice->wait_for_frame_slot(currentFrame)) {
           uint32_t imageIndex, semaphoreIndex;
           if (acquire_next_image(primaryDevice, imageIndex, semaphoreIndex)) {
             draw_frame_sfr(imageIndex, semaphoreIndex);
@@ -451,8 +711,11 @@ void render::Renderer::draw_frame() {
   const uint32_t maxFrames = general::Config::get_instance().get_max_frames();
   currentFrame = (currentFrame + 1) % maxFrames;
   frameCount++;
+  framePaced = false;
 }
 
+uint64_t render::Renderer::get_frame_count() const { return frameCount; }
+
 void render::Renderer::set_render_strategy(
     ObjectManager::RenderStrategy strategy) {
   gpuConfig.strategy = strategy;
@@ -466,6 +729,143 @@ void render::Renderer::set_gpu_config(
   objectManager->set_gpu_config(config);
 }
 
+void render::Renderer::collect_present_latencies(bool waitLatest) {
+  if (pendingPresents.empty()) {
+    return;
+  }
+
+  auto &swapChain = const_cast<device::LogicalDevice *>(
+                        deviceManager->get_primary_device())
+                        ->get_swap_chain();
+
+  // Presents are shown in order, once the newest is the older ones are too
+  if (waitLatest) {
+    swapChain.wait_for_present(pendingPresents.back().presentId,
+                               lowLatencyTimeout);
+  }
+
+  while (!pendingPresents.empty()) {
+    const PendingPresent &pending = pendingPresents.front();
+    vk::Result result = swapChain.wait_for_present(pending.presentId, 0);
+    if (result == vk::Result::eTimeout) {
+      break;
+    }
+    if (result == vk::Result::eSuccess ||
+        result == vk::Result::eSuboptimalKHR) {
+      record_present_latency(Clock::now() - pending.inputTime, true);
+    }
+    pendingPresents.pop_front();
+  }
+}
+
+void render::Renderer::record_present_latency(Clock::duration latency,
+                                              bool untilShown) {
+  const double latencyMs =
+      std::chrono::duration<double, std::milli>(latency).count();
+  presentLatency.lastMs = latencyMs;
+  latencySumMs += latencyMs;
+  latencyMaxMs = std::max(latencyMaxMs, latencyMs);
+  ++latencySamples;
+
+  const auto now = Clock::now();
+  if (now - lastLatencyReport < latencyReportInterval) {
+    return;
+  }
+
+  auto *device =
+      const_cast<device::LogicalDevice *>(deviceManager->get_primary_device());
+  presentLatency.averageMs = latencySumMs / latencySamples;
+  presentLatency.maxMs = latencyMaxMs;
+  presentLatency.samples = latencySamples;
+  presentLatency.untilShown = untilShown;
+
+  std::print("Renderer - input to {} latency: avg {:.2f} ms, max {:.2f} ms "
+             "over {} frames ({}{})\n",
+             untilShown ? "display" : "present call", presentLatency.averageMs,
+             presentLatency.maxMs, presentLatency.samples,
+             vk::to_string(device->get_swap_chain().get_present_mode()),
+             lowLatency ? ", low latency" : "");
+
+  latencySumMs = 0.0;
+  latencyMaxMs = 0.0;
+  latencySamples = 0;
+  lastLatencyReport = now;
+}
+
+void render::Renderer::pace_frame() {
+  auto *device =
+      const_cast<device::LogicalDevice *>(deviceManager->get_primary_device());
+
+  if (lowLatency) {
+    if (device->get_swap_chain().supports_present_wait()) {
+      collect_present_latencies(true);
+    } else {
+      // The previous frame's GPU work is the closest point to its present
+      // that can be waited on
+      device->wait_for_frame(device->get_submitted_frame(),
+                             lowLatencyTimeout);
+    }
+  }
+  collect_present_latencies(false);
+
+  if (targetFrameRate > 0.0) {
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / targetFrameRate));
+    // Restart the schedule after a stall instead of rushing to catch up
+    if (nextFrameTime + period < Clock::now()) {
+      nextFrameTime = Clock::now();
+    }
+    std::this_thread::sleep_until(nextFrameTime);
+    nextFrameTime += period;
+  }
+
+  inputTime = Clock::now();
+  framePaced = true;
+}
+
+void render::Renderer::set_present_policy(
+    device::SwapChain::PresentPolicy policy) {
+  presentPolicy = policy;
+  const_cast<device::LogicalDevice *>(deviceManager->get_primary_device())
+      ->get_swap_chain()
+      .set_present_policy(policy);
+  deviceManager->recreate_swap_chain();
+  pendingPresents.clear();
+}
+
+device::SwapChain::PresentPolicy render::Renderer::get_present_policy() const {
+  return presentPolicy;
+}
+
+void render::Renderer::set_target_frame_rate(double framesPerSecond) {
+  targetFrameRate = std::max(framesPerSecond, 0.0);
+  nextFrameTime = Clock::now();
+}
+
+double render::Renderer::get_target_frame_rate() const {
+  return targetFrameRate;
+}
+
+void render::Renderer::set_low_latency(bool enabled) { lowLatency = enabled; }
+
+bool render::Renderer::is_low_latency() const { return lowLatency; }
+
+const render::Renderer::PresentLatency &
+render::Renderer::get_present_latency() const {
+  return presentLatency;
+}
+
+void render::Renderer::add_compute_pass(ComputePass pass) {
+  computePasses.push_back(std::move(pass));
+}
+
+void render::Renderer::clear_compute_passes() {
+  // Passes may own resources used by compute still in flight
+  deviceManager->wait_idle();
+  computePasses.clear();
+  computeAheadValue = 0;
+}
+
 void render::Renderer::set_pre_reload_callback(std::function<void()> callback) {
   preReloadCallback = std::move(callback);
 }
@@ -494,3 +894,11 @@ device::BufferManager &render::Renderer::get_buffer_manager() {
 render::ObjectManager *render::Renderer::get_object_manager() {
   return objectManager.get();
 }
+
+device::GpuProfiler *render::Renderer::get_gpu_profiler(uint32_t deviceIndex) {
+  const auto &devices = deviceManager->get_all_logical_devices();
+  if (deviceIndex >= devices.size()) {
+    return nullptr;
+  }
+  return &devices[deviceIndex]->get_profiler();
+}
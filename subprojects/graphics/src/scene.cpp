@@ -1,10 +1,21 @@
 #include "scene.h"
 #include "material_manager.h"
 #include "object.h"
+#include "shader_builder.h"
 #include "texture.h"
 #include <print>
+#include <unordered_set>
 #include <vector>
 
+namespace {
+
+// [vk::constant_id] of the TEXTURED switch in textured.slang
+constexpr uint32_t texturedConstantId = 0;
+
+constexpr const char *fallbackTextureId = "fallback_white";
+
+} // namespace
+
 render::Scene::Scene(MaterialManager *matMgr, TextureManager *texMgr,
                      device::BufferManager *bufMgr, ObjectManager *objMgr)
     : materialManager(matMgr), textureManager(texMgr), bufferManager(bufMgr),
@@ -374,39 +385,122 @@ render::Object *render::Scene::create_cube_3d(
 
 void render::Scene::create_basic_material(MaterialId materialId, bool is2D,
                                           bool is3DTextured) {
-  // Check if material already exists
-  if (materialManager->get_material(to_string(materialId))) {
-    return;
+  request_basic_material(materialId, is2D, is3DTextured);
+  load_materials();
+}
+
+void render::Scene::create_textured_material(MaterialId materialId, bool is2D) {
+  request_textured_material(materialId, is2D);
+  load_materials();
+}
+
+void render::Scene::request_basic_material(MaterialId materialId, bool is2D,
+                                           bool is3DTextured) {
+  request_basic_material(to_string(materialId), is2D, is3DTextured);
+}
+
+void render::Scene::request_textured_material(MaterialId materialId,
+                                              bool is2D) {
+  request_textured_material(
+      to_string(materialId), is2D,
+      material_default_texture(materialId)
+          .transform([](TextureId textureId) { return to_string(textureId); })
+          .value_or(""));
+}
+
+void render::Scene::request_basic_material(const std::string &identifier,
+                                           bool is2D, bool is3DTextured) {
+  materialRequests.push_back({.identifier = identifier,
+                              .textured = false,
+                              .is2D = is2D,
+                              .is3DTextured = is3DTextured});
+}
+
+void render::Scene::request_textured_material(
+    const std::string &identifier, bool is2D,
+    const std::string &defaultTexture) {
+  materialRequests.push_back({.identifier = identifier,
+                              .defaultTexture = defaultTexture,
+                              .textured = true,
+                              .is2D = is2D});
+}
+
+render::MaterialManager::ShaderVariant
+render::Scene::material_shader_variant(const MaterialRequest &request) {
+  // textured.slang takes 2D positions through its float3 input, the missing
+  // z is filled with 0, so one source covers every textured vertex layout
+  if (request.textured) {
+    return {.filePath = "assets/shaders/textured.slang",
+            .constants = {{.id = texturedConstantId, .value = 1}}};
+  }
+  if (request.is3DTextured) {
+    return {.filePath = "assets/shaders/textured.slang",
+            .constants = {{.id = texturedConstantId, .value = 0}}};
   }
+  return {.filePath = "assets/shaders/shader.slang"};
+}
 
-  // Create shader for this material
-  std::vector<Shader::ShaderStageInfo> stages = {
-      {.type = Shader::ShaderType::VERTEX,
-       .filePath = "assets/shaders/shader.slang",
-       .entryPoint = "vertMain"},
-      {.type = Shader::ShaderType::FRAGMENT,
-       .filePath = "assets/shaders/shader.slang",
-       .entryPoint = "fragMain"}};
-
-  Shader::ShaderCreateInfo shaderInfo{
-      .identifier = to_string(materialId) + "_shader", .stages = stages};
-
-  auto shader = std::make_unique<Shader>(
-      materialManager->get_device_manager()->get_all_logical_devices(),
-      shaderInfo);
-
-  if (!shader->compile() || !shader->initialize()) {
-    std::print(stderr, "Failed to create shader for material {}\n",
-               to_string(materialId));
+void render::Scene::load_materials() {
+  if (materialRequests.empty()) {
     return;
   }
 
-  vk::DescriptorSetLayoutBinding uboBinding = {
-      .binding = 0,
-      .descriptorType = vk::DescriptorType::eUniformBuffer,
-      .descriptorCount = 1,
-      .stageFlags = vk::ShaderStageFlagBits::eVertex};
+  // Every new variant is compiled in one build so stages run concurrently,
+  // materials sharing a permutation share its shader
+  ShaderBuilder builder;
+  std::vector<Shader *> shaders(materialRequests.size(), nullptr);
+  std::unordered_set<std::string> requested;
+  std::unordered_set<Shader *> created;
+
+  for (size_t i = 0; i < materialRequests.size(); ++i) {
+    const auto &request = materialRequests[i];
+    if (materialManager->get_material(request.identifier) ||
+        !requested.insert(request.identifier).second) {
+      continue;
+    }
+
+    bool isNew = false;
+    shaders[i] = materialManager->get_shader_variant(
+        material_shader_variant(request), isNew);
+    if (isNew) {
+      created.insert(shaders[i]);
+      builder.add(shaders[i]);
+    }
+  }
+
+  builder.build();
+
+  for (size_t i = 0; i < materialRequests.size(); ++i) {
+    const auto &request = materialRequests[i];
+    if (!shaders[i]) {
+      continue;
+    }
+
+    if (created.contains(shaders[i]) && !builder.succeeded(shaders[i])) {
+      std::print(stderr, "Failed to create shader for material {}\n",
+                 request.identifier);
+      continue;
+    }
+
+    if (request.textured) {
+      finish_textured_material(request, shaders[i]);
+    } else {
+      finish_basic_material(request, shaders[i]);
+    }
+  }
+  materialRequests.clear();
+
+  // Failed variants are dropped so a later load retries them
+  for (Shader *shader : created) {
+    if (!builder.succeeded(shader)) {
+      materialManager->discard_shader_variant(shader);
+    }
+  }
+}
 
+void render::Scene::finish_basic_material(const MaterialRequest &request,
+                                          Shader *shader) {
+  const bool is2D = request.is2D;
   vk::PipelineColorBlendAttachmentState colorBlendAttachment{
       .blendEnable = vk::False,
       .colorWriteMask =
@@ -416,7 +510,7 @@ void render::Scene::create_basic_material(MaterialId materialId, bool is2D,
   vk::VertexInputBindingDescription bindingDescription;
   std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
 
-  if (is3DTextured) {
+  if (request.is3DTextured) {
     bindingDescription = Object::Vertex3DTextured::getBindingDescription();
     auto attrs = Object::Vertex3DTextured::getAttributeDescriptions();
     attributeDescriptions.assign(attrs.begin(), attrs.end());
@@ -427,9 +521,9 @@ void render::Scene::create_basic_material(MaterialId materialId, bool is2D,
   }
 
   Material::MaterialCreateInfo createInfo{
-      .identifier = to_string(materialId),
-      .shader = shader.get(),
-      .descriptorBindings = {uboBinding},
+      .identifier = request.identifier,
+      .shader = shader,
+      .defaultTexture = request.is3DTextured ? fallback_texture() : "",
       .rasterizationState = {.depthClampEnable = is2D ? vk::False : vk::True,
                              .rasterizerDiscardEnable = vk::False,
                              .polygonMode = vk::PolygonMode::eFill,
@@ -466,70 +560,13 @@ void render::Scene::create_basic_material(MaterialId materialId, bool is2D,
                         .sampleShadingEnable = vk::False},
       .dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor}};
 
-  // Store shader for lifecycle management
-  sceneShaders.push_back(std::move(shader));
-
+  // Descriptor layouts come from the shader, objects create their own UBOs
   materialManager->add_material(createInfo);
-
-  // Create associated UBO buffer
-  device::Buffer::TransformUBO uboData = {.model = glm::mat4(1.0f),
-                                          .view = glm::mat4(1.0f),
-                                          .proj = glm::mat4(1.0f)};
-
-  device::Buffer::BufferCreateInfo uboInfo = {
-      .identifier = to_string(materialId) + "_ubo",
-      .type = device::Buffer::BufferType::UNIFORM,
-      .usage = device::Buffer::BufferUsage::DYNAMIC,
-      .size = sizeof(device::Buffer::TransformUBO),
-      .elementSize = sizeof(device::Buffer::TransformUBO),
-      .initialData = &uboData};
-
-  bufferManager->create_buffer(uboInfo);
 }
 
-void render::Scene::create_textured_material(MaterialId materialId, bool is2D) {
-  // Check if material already exists
-  if (materialManager->get_material(to_string(materialId))) {
-    return;
-  }
-
-  // Create shader for this material
-  std::string shaderPath = is2D ? "assets/shaders/textured.slang"
-                                : "assets/shaders/textured3d.slang";
-
-  std::vector<Shader::ShaderStageInfo> stages = {
-      {.type = Shader::ShaderType::VERTEX,
-       .filePath = shaderPath,
-       .entryPoint = "vertMain"},
-      {.type = Shader::ShaderType::FRAGMENT,
-       .filePath = shaderPath,
-       .entryPoint = "fragMain"}};
-
-  Shader::ShaderCreateInfo shaderInfo{
-      .identifier = to_string(materialId) + "_shader", .stages = stages};
-
-  auto shader = std::make_unique<Shader>(
-      materialManager->get_device_manager()->get_all_logical_devices(),
-      shaderInfo);
-
-  if (!shader->compile() || !shader->initialize()) {
-    std::print(stderr, "Failed to create shader for material {}\n",
-               to_string(materialId));
-    return;
-  }
-
-  vk::DescriptorSetLayoutBinding uboBinding = {
-      .binding = 0,
-      .descriptorType = vk::DescriptorType::eUniformBuffer,
-      .descriptorCount = 1,
-      .stageFlags = vk::ShaderStageFlagBits::eVertex};
-
-  vk::DescriptorSetLayoutBinding samplerBinding = {
-      .binding = 1,
-      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-      .descriptorCount = 1,
-      .stageFlags = vk::ShaderStageFlagBits::eFragment};
-
+void render::Scene::finish_textured_material(const MaterialRequest &request,
+                                             Shader *shader) {
+  const bool is2D = request.is2D;
   vk::VertexInputBindingDescription bindingDescription;
   std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
 
@@ -550,9 +587,9 @@ void render::Scene::create_textured_material(MaterialId materialId, bool is2D) {
           vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA};
 
   Material::MaterialCreateInfo createInfo{
-      .identifier = to_string(materialId),
-      .shader = shader.get(),
-      .descriptorBindings = {uboBinding, samplerBinding},
+      .identifier = request.identifier,
+      .shader = shader,
+      .defaultTexture = request.defaultTexture,
       .rasterizationState = {.depthClampEnable = is2D ? vk::False : vk::True,
                              .rasterizerDiscardEnable = vk::False,
                              .polygonMode = vk::PolygonMode::eFill,
@@ -588,25 +625,8 @@ void render::Scene::create_textured_material(MaterialId materialId, bool is2D) {
                         .sampleShadingEnable = vk::False},
       .dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor}};
 
-  // Store shader for lifecycle management
-  sceneShaders.push_back(std::move(shader));
-
+  // Descriptor layouts come from the shader, objects create their own UBOs
   materialManager->add_material(createInfo);
-
-  // Create associated UBO buffer
-  device::Buffer::TransformUBO uboData = {.model = glm::mat4(1.0f),
-                                          .view = glm::mat4(1.0f),
-                                          .proj = glm::mat4(1.0f)};
-
-  device::Buffer::BufferCreateInfo uboInfo = {
-      .identifier = to_string(materialId) + "_ubo",
-      .type = device::Buffer::BufferType::UNIFORM,
-      .usage = device::Buffer::BufferUsage::DYNAMIC,
-      .size = sizeof(device::Buffer::TransformUBO),
-      .elementSize = sizeof(device::Buffer::TransformUBO),
-      .initialData = &uboData};
-
-  bufferManager->create_buffer(uboInfo);
 }
 
 void render::Scene::create_texture(TextureId textureId,
@@ -624,6 +644,32 @@ void render::Scene::create_texture(TextureId textureId,
   sceneTextures.insert(texId);
 }
 
+void render::Scene::create_packed_texture(TextureId textureId,
+                                          const std::string &path) {
+  std::string texId = to_string(textureId);
+
+  // Check if texture already exists
+  if (textureManager->get_texture(texId)) {
+    sceneTextures.insert(texId);
+    return;
+  }
+
+  // Packed images only reach the GPU when their page is flushed
+  textureManager->create_packed_texture(texId, path);
+  textureManager->flush_atlas_pages();
+  sceneTextures.insert(texId);
+}
+
+std::string render::Scene::fallback_texture() {
+  if (!textureManager->get_texture(fallbackTextureId)) {
+    const unsigned char white[] = {255, 255, 255, 255};
+    textureManager->create_packed_texture(fallbackTextureId, white, 1, 1);
+    textureManager->flush_atlas_pages();
+  }
+  sceneTextures.insert(fallbackTextureId);
+  return fallbackTextureId;
+}
+
 void render::Scene::create_texture_atlas(TextureId textureId,
                                          const std::string &path, uint32_t rows,
                                          uint32_t cols) {
@@ -673,47 +719,10 @@ void render::Scene::create_atlas_region_texture(TextureId textureId,
     return;
   }
 
-  // Create texture that will store just this region
-  Texture::TextureCreateInfo createInfo{.identifier = texId,
-                                        .type = Texture::TextureType::SINGLE,
-                                        .imagePath = ""};
-
-  textureManager->create_texture(createInfo);
-
-  Texture *regionTexture = textureManager->get_texture(texId);
-  if (regionTexture && atlasTexture->get_image()) {
-    auto atlasImage = atlasTexture->get_image();
-    const auto &atlasPixels = atlasImage->get_pixel_data();
-    uint32_t atlasWidth = atlasImage->get_width();
-    uint32_t atlasChannels = atlasImage->get_channels();
-
-    // Calculate pixel coordinates from UV coordinates
-    uint32_t startX = static_cast<uint32_t>(region->uvMin.x * atlasWidth);
-    uint32_t startY =
-        static_cast<uint32_t>(region->uvMin.y * atlasImage->get_height());
-    uint32_t regionWidth = region->width;
-    uint32_t regionHeight = region->height;
-
-    // Extract the region pixels
-    std::vector<unsigned char> regionPixels(regionWidth * regionHeight *
-                                            atlasChannels);
-    for (uint32_t y = 0; y < regionHeight; ++y) {
-      for (uint32_t x = 0; x < regionWidth; ++x) {
-        uint32_t srcOffset =
-            ((startY + y) * atlasWidth + (startX + x)) * atlasChannels;
-        uint32_t dstOffset = (y * regionWidth + x) * atlasChannels;
-        for (uint32_t c = 0; c < atlasChannels; ++c) {
-          regionPixels[dstOffset + c] = atlasPixels[srcOffset + c];
-        }
-      }
-    }
-
-    // Load the extracted region into the new texture
-    regionTexture->get_image()->load_from_memory(
-        regionPixels.data(), regionWidth, regionHeight, atlasChannels);
-
-    regionTexture->update_gpu();
-  }
+  // Tiles touch in the atlas, so the region is packed with a padded border
+  // instead of viewed in place, where filtering would pick up neighbours
+  textureManager->create_packed_region(texId, atlasId, *region);
+  textureManager->flush_atlas_pages();
 
   sceneTextures.insert(texId);
 }
@@ -729,7 +738,15 @@ void render::Scene::create_layered_texture(
     return;
   }
 
-  // Build layers
+  textureManager->create_layered_texture(
+      texId, build_layers(imagePaths, tints, rotations));
+  sceneTextures.insert(texId);
+}
+
+std::vector<render::Texture::Layer>
+render::Scene::build_layers(const std::vector<std::string> &imagePaths,
+                            const std::vector<glm::vec4> &tints,
+                            const std::vector<float> &rotations) {
   std::vector<Texture::Layer> layers;
   for (size_t i = 0; i < imagePaths.size(); ++i) {
     Texture::Layer layer(imagePaths[i]);
@@ -744,9 +761,69 @@ void render::Scene::create_layered_texture(
 
     layers.push_back(layer);
   }
+  return layers;
+}
 
-  textureManager->create_layered_texture(texId, layers);
-  sceneTextures.insert(texId);
+void render::Scene::request_texture(TextureId textureId,
+                                    const std::string &path) {
+  request_texture(to_string(textureId), path);
+}
+
+void render::Scene::request_texture(const std::string &identifier,
+                                    const std::string &path) {
+  textureRequests.push_back({.identifier = identifier,
+                             .type = Texture::TextureType::SINGLE,
+                             .imagePath = path});
+}
+
+void render::Scene::request_packed_texture(TextureId textureId,
+                                           const std::string &path) {
+  textureRequests.push_back({.identifier = to_string(textureId),
+                             .type = Texture::TextureType::SINGLE,
+                             .imagePath = path,
+                             .packed = true});
+}
+
+void render::Scene::request_streamed_texture(TextureId textureId,
+                                             const std::string &path) {
+  textureRequests.push_back({.identifier = to_string(textureId),
+                             .type = Texture::TextureType::SINGLE,
+                             .imagePath = path,
+                             .streamed = true});
+}
+
+void render::Scene::request_texture_atlas(TextureId textureId,
+                                          const std::string &path,
+                                          uint32_t rows, uint32_t cols) {
+  textureRequests.push_back({.identifier = to_string(textureId),
+                             .type = Texture::TextureType::ATLAS,
+                             .imagePath = path,
+                             .atlasRows = rows,
+                             .atlasCols = cols});
+}
+
+void render::Scene::request_layered_texture(
+    TextureId textureId, const std::vector<std::string> &imagePaths,
+    const std::vector<glm::vec4> &tints, const std::vector<float> &rotations) {
+  textureRequests.push_back({.identifier = to_string(textureId),
+                             .type = Texture::TextureType::LAYERED,
+                             .layers = build_layers(imagePaths, tints,
+                                                    rotations)});
+}
+
+void render::Scene::load_textures() {
+  if (textureRequests.empty()) {
+    return;
+  }
+
+  auto textures = textureManager->create_textures(textureRequests);
+
+  for (size_t i = 0; i < textures.size(); ++i) {
+    if (textures[i]) {
+      sceneTextures.insert(textureRequests[i].identifier);
+    }
+  }
+  textureRequests.clear();
 }
 
 void render::Scene::cleanup() {
@@ -772,10 +849,14 @@ void render::Scene::cleanup() {
   // Remove all scene objects from the object manager
   // This frees GPU resources while keeping the Scene object in RAM
   size_t objectsFreed = sceneObjects.size();
-  for (Object *obj : sceneObjects) {
-    if (obj && objectManager) {
-      objectManager->remove_object(obj->get_identifier());
+  if (objectManager) {
+    objectManager->begin_batch();
+    for (Object *obj : sceneObjects) {
+      if (obj) {
+        objectManager->remove_object(obj->get_identifier());
+      }
     }
+    objectManager->end_batch();
   }
   sceneObjects.clear();
 
@@ -1,6 +1,11 @@
 #include "shader.h"
-#include "slang_wasm_compiler.h"
-#include <fstream>
+#include "shader_cache.h"
+#include "slang_compiler.h"
+#include "tasks.h"
+#include "trace.h"
+#include <algorithm>
+#include <future>
+#include <optional>
 #include <print>
 
 render::Shader::Shader(const std::vector<device::LogicalDevice *> &devices,
@@ -13,8 +18,72 @@ render::Shader::Shader(const std::vector<device::LogicalDevice *> &devices,
     deviceResources.push_back(std::make_unique<DeviceShaderResources>());
   }
 
-  std::print("Shader - {} - created with {} stages\n", identifier,
-             stages.size());
+  // Group stages by source file, each file is compiled once with all of its
+  // entry points
+  stageModules.resize(stages.size());
+  for (size_t i = 0; i < stages.size(); ++i) {
+    stages[i].entryPoint = resolve_entry_point(stages[i]);
+
+    auto it = std::find_if(modules.begin(), modules.end(),
+                           [&](const ShaderModuleSource &moduleSource) {
+                             return moduleSource.filePath == stages[i].filePath;
+                           });
+    if (it == modules.end()) {
+      modules.push_back({.filePath = stages[i].filePath});
+      it = modules.end() - 1;
+    }
+
+    if (std::find(it->entryPoints.begin(), it->entryPoints.end(),
+                  stages[i].entryPoint) == it->entryPoints.end()) {
+      it->entryPoints.push_back(stages[i].entryPoint);
+    }
+    it->stageIndices.push_back(i);
+    stageModules[i] = static_cast<size_t>(it - modules.begin());
+  }
+
+  // Specialization data must outlive every pipeline created from the
+  // returned stage infos, so it is built once here
+  specializations.resize(stages.size());
+  for (size_t i = 0; i < stages.size(); ++i) {
+    build_specialization(stages[i].specializationConstants,
+                         specializations[i]);
+  }
+
+  std::print("Shader - {} - created with {} stages in {} modules\n",
+             identifier, stages.size(), modules.size());
+}
+
+void render::Shader::build_specialization(
+    const std::vector<SpecializationConstant> &constants,
+    StageSpecialization &specialization) {
+  std::vector<SpecializationConstant> sorted;
+  for (const auto &constant : constants) {
+    auto it = std::ranges::find(sorted, constant.id,
+                                &SpecializationConstant::id);
+    if (it != sorted.end()) {
+      it->value = constant.value;
+    } else {
+      sorted.push_back(constant);
+    }
+  }
+  std::ranges::sort(sorted, {}, &SpecializationConstant::id);
+
+  specialization.entries.clear();
+  specialization.data.clear();
+  for (const auto &constant : sorted) {
+    specialization.entries.push_back(
+        {.constantID = constant.id,
+         .offset = static_cast<uint32_t>(specialization.data.size() *
+                                         sizeof(uint32_t)),
+         .size = sizeof(uint32_t)});
+    specialization.data.push_back(constant.value);
+  }
+
+  specialization.info = vk::SpecializationInfo{
+      .mapEntryCount = static_cast<uint32_t>(specialization.entries.size()),
+      .pMapEntries = specialization.entries.data(),
+      .dataSize = specialization.data.size() * sizeof(uint32_t),
+      .pData = specialization.data.data()};
 }
 
 render::Shader::~Shader() {
@@ -28,78 +97,137 @@ render::Shader::~Shader() {
   std::print("Shader - {} - destructor executed\n", identifier);
 }
 
-bool render::Shader::compile_shader_from_file(ShaderStageInfo &stageInfo) {
-  if (stageInfo.filePath.empty()) {
-    std::print(stderr, "Shader - {} - no file path for stage {}\n", identifier,
-               shader_type_to_string(stageInfo.type));
-    return false;
-  }
-
+std::string
+render::Shader::resolve_entry_point(const ShaderStageInfo &stageInfo) {
   // Get the appropriate entry point based on stage type
-  std::string entryPoint;
   switch (stageInfo.type) {
   case ShaderType::VERTEX:
-    entryPoint = "vertMain";
-    break;
+    return "vertMain";
   case ShaderType::FRAGMENT:
-    entryPoint = "fragMain";
-    break;
+    return "fragMain";
   case ShaderType::GEOMETRY:
-    entryPoint = "geomMain";
-    break;
+    return "geomMain";
   case ShaderType::COMPUTE:
-    entryPoint = "computeMain";
-    break;
+    return "computeMain";
   case ShaderType::TESSELLATION_CONTROL:
-    entryPoint = "tessControlMain";
-    break;
+    return "tessControlMain";
   case ShaderType::TESSELLATION_EVALUATION:
-    entryPoint = "tessEvalMain";
-    break;
+    return "tessEvalMain";
   default:
-    entryPoint = stageInfo.entryPoint;
-    break;
+    return stageInfo.entryPoint;
   }
+}
 
-  // Compile using Slang WASM compiler
-  thread_local wasm::SlangWasmCompiler compiler;
-
-  std::filesystem::path inputPath(stageInfo.filePath);
-  std::filesystem::path outputPath = inputPath;
-  outputPath.replace_extension(".spv");
+bool render::Shader::compile_module(ShaderModuleSource &moduleSource) {
+  if (moduleSource.filePath.empty()) {
+    std::print(stderr, "Shader - {} - no file path for module\n", identifier);
+    return false;
+  }
 
-  // Compile the shader to a temporary SPIR-V file
-  if (!compiler.compileShaderToSpirv(inputPath, outputPath, {entryPoint})) {
-    std::print(stderr,
-               "Shader - {} - failed to compile {} from {} (entry: {}): {}\n",
-               identifier, shader_type_to_string(stageInfo.type),
-               stageInfo.filePath, entryPoint, compiler.getLastError());
+  if (!compile_source(moduleSource.filePath, moduleSource.entryPoints,
+                      moduleSource.spirvCode)) {
+    std::print(stderr, "Shader - {} - failed to compile {}\n", identifier,
+               moduleSource.filePath);
     return false;
   }
 
-  // Read the compiled SPIR-V file
-  std::ifstream file(outputPath, std::ios::binary | std::ios::ate);
-  if (!file.is_open()) {
-    std::print(stderr, "Shader - {} - failed to open compiled SPIR-V file {}\n",
-               identifier, outputPath.string());
+  if (!ShaderReflection::reflect(moduleSource.spirvCode,
+                                 moduleSource.entryPoints,
+                                 moduleSource.reflection)) {
+    std::print(stderr, "Shader - {} - failed to reflect {}\n", identifier,
+               moduleSource.filePath);
     return false;
   }
 
-  size_t fileSize = file.tellg();
-  stageInfo.spirvCode.resize(fileSize);
-  file.seekg(0);
-  file.read(stageInfo.spirvCode.data(), fileSize);
-  file.close();
+  moduleSource.isCompiled = true;
+  for (size_t index : moduleSource.stageIndices) {
+    stages[index].isCompiled = true;
+  }
 
-  stageInfo.entryPoint = entryPoint;
-  stageInfo.isCompiled = true;
+  return true;
+}
 
-  std::print("Shader - {} - compiled {} from {}\n", identifier,
-             shader_type_to_string(stageInfo.type), stageInfo.filePath);
+bool render::Shader::compile_source(const std::string &filePath,
+                                    const std::vector<std::string> &entryPoints,
+                                    std::vector<char> &spirv) {
+  TRACE_ZONE("Shader::compile_source");
+  auto &cache = ShaderCache::get_instance();
+  std::filesystem::path inputPath(filePath);
 
+  std::string entryPointList;
+  for (const auto &entryPoint : entryPoints) {
+    entryPointList += entryPointList.empty() ? entryPoint : "," + entryPoint;
+  }
+
+  // Unchanged sources load straight from the cache
+  std::optional<std::string> key = cache.compute_key(
+      {.sourcePath = inputPath,
+       .arguments = SlangCompiler::get_arguments(entryPoints),
+       .compilerVersion = SlangCompiler::get_version()});
+
+  if (key && cache.load(*key, spirv)) {
+    std::print("Shader - {} ({}) - loaded from cache ({})\n", filePath,
+               entryPointList, *key);
+    return true;
+  }
+
+  // Shared by every thread. One compile emits every entry point of the file
+  // into a single module
+  static SlangCompiler compiler;
+
+  if (!compiler.compile(inputPath, entryPoints, spirv)) {
+    std::print(stderr, "Shader - {} ({}) - compilation failed: {}\n",
+               filePath, entryPointList, compiler.get_last_error());
+    return false;
+  }
+
+  if (key) {
+    cache.store(*key, spirv);
+  }
+
+  std::print("Shader - {} ({}) - compiled\n", filePath, entryPointList);
   return true;
 }
 
+bool render::Shader::replace_module(size_t index, std::vector<char> spirv,
+                                    const ShaderReflection &interface) {
+  std::lock_guard lock(shaderMutex);
+
+  ShaderReflection reflection;
+  if (index >= modules.size() ||
+      !ShaderReflection::reflect(spirv, modules[index].entryPoints,
+                                 reflection)) {
+    return false;
+  }
+
+  // Pipelines are rebuilt against the layouts they already have, so a
+  // module changing the interface is rejected before anything is swapped
+  ShaderReflection merged;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    merged.merge(i == index ? reflection : modules[i].reflection);
+  }
+  if (!(merged == interface)) {
+    std::print(stderr,
+               "Shader - {} - resources of {} changed, reload to apply\n",
+               identifier, modules[index].filePath);
+    return false;
+  }
+
+  modules[index].spirvCode = std::move(spirv);
+  modules[index].reflection = std::move(reflection);
+  modules[index].isCompiled = true;
+
+  // Pipelines keep their own copy of the code, so the old modules can go
+  bool success = true;
+  for (size_t deviceIdx = 0; deviceIdx < logicalDevices.size(); ++deviceIdx) {
+    success = initialize_device(deviceIdx) && success;
+  }
+
+  std::print("Shader - {} - replaced module {}\n", identifier,
+             modules[index].filePath);
+  return success;
+}
+
 bool render::Shader::create_shader_module(
     device::LogicalDevice *device, const std::vector<char> &code,
     vk::raii::ShaderModule &shaderModule) {
@@ -153,16 +281,24 @@ render::Shader::get_vulkan_shader_stage(ShaderType type) const {
 }
 
 bool render::Shader::compile() {
-  std::lock_guard lock(shaderMutex);
-
-  for (auto &stage : stages) {
-    if (!stage.isCompiled) {
-      if (!compile_shader_from_file(stage)) {
-        return false;
-      }
+  // Each module owns its state, no lock is held while they compile
+  std::vector<std::future<bool>> futures;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    if (!modules[i].isCompiled) {
+      futures.push_back(device::Tasks::get_instance().add_task(
+          [this, i]() { return compile_module_at(i); }));
     }
   }
 
+  bool success = true;
+  for (auto &future : futures) {
+    success = future.get() && success;
+  }
+
+  if (!success) {
+    return false;
+  }
+
   std::print("Shader - {} - all stages compiled successfully\n", identifier);
   return true;
 }
@@ -170,49 +306,70 @@ bool render::Shader::compile() {
 bool render::Shader::compile_stage(ShaderType type) {
   std::lock_guard lock(shaderMutex);
 
-  for (auto &stage : stages) {
-    if (stage.type == type && !stage.isCompiled) {
-      return compile_shader_from_file(stage);
+  for (size_t i = 0; i < stages.size(); ++i) {
+    if (stages[i].type == type && !stages[i].isCompiled) {
+      return compile_module(modules[stageModules[i]]);
     }
   }
 
   return false;
 }
 
+bool render::Shader::compile_module_at(size_t index) {
+  if (index >= modules.size()) {
+    return false;
+  }
+  if (modules[index].isCompiled) {
+    return true;
+  }
+  return compile_module(modules[index]);
+}
+
 bool render::Shader::initialize() {
   std::lock_guard lock(shaderMutex);
 
-  // Make sure all stages are compiled
-  for (const auto &stage : stages) {
-    if (!stage.isCompiled) {
+  for (size_t deviceIdx = 0; deviceIdx < logicalDevices.size(); ++deviceIdx) {
+    if (!initialize_device(deviceIdx)) {
+      return false;
+    }
+  }
+
+  std::print("Shader - {} - initialized for {} devices\n", identifier,
+             logicalDevices.size());
+  return true;
+}
+
+bool render::Shader::initialize_device(size_t deviceIndex) {
+  if (deviceIndex >= logicalDevices.size()) {
+    return false;
+  }
+
+  // Make sure all modules are compiled
+  for (const auto &moduleSource : modules) {
+    if (!moduleSource.isCompiled) {
       std::print(stderr,
-                 "Shader - {} - cannot initialize: stage {} not compiled\n",
-                 identifier, shader_type_to_string(stage.type));
+                 "Shader - {} - cannot initialize: {} not compiled\n",
+                 identifier, moduleSource.filePath);
       return false;
     }
   }
 
-  // Create shader modules for each device
-  for (size_t deviceIdx = 0; deviceIdx < logicalDevices.size(); ++deviceIdx) {
-    auto *device = logicalDevices[deviceIdx];
-    auto &resources = deviceResources[deviceIdx];
-
-    for (const auto &stage : stages) {
-      vk::raii::ShaderModule shaderModule{nullptr};
-      if (!create_shader_module(device, stage.spirvCode, shaderModule)) {
-        std::print(stderr,
-                   "Shader - {} - failed to create shader module for "
-                   "stage {}\n",
-                   identifier, shader_type_to_string(stage.type));
-        return false;
-      }
-      resources->shaderModules[stage.type] =
-          std::make_unique<vk::raii::ShaderModule>(std::move(shaderModule));
+  auto *device = logicalDevices[deviceIndex];
+  auto &resources = deviceResources[deviceIndex];
+
+  resources->shaderModules.clear();
+  for (const auto &moduleSource : modules) {
+    vk::raii::ShaderModule shaderModule{nullptr};
+    if (!create_shader_module(device, moduleSource.spirvCode, shaderModule)) {
+      std::print(stderr,
+                 "Shader - {} - failed to create shader module for {}\n",
+                 identifier, moduleSource.filePath);
+      return false;
     }
+    resources->shaderModules.push_back(
+        std::make_unique<vk::raii::ShaderModule>(std::move(shaderModule)));
   }
 
-  std::print("Shader - {} - initialized for {} devices\n", identifier,
-             logicalDevices.size());
   return true;
 }
 
@@ -225,9 +382,11 @@ render::Shader::get_shader_module(ShaderType type, uint32_t deviceIndex) {
   }
 
   auto &resources = deviceResources[deviceIndex];
-  auto it = resources->shaderModules.find(type);
-  if (it != resources->shaderModules.end()) {
-    return it->second.get();
+  for (size_t i = 0; i < stages.size(); ++i) {
+    if (stages[i].type == type &&
+        stageModules[i] < resources->shaderModules.size()) {
+      return resources->shaderModules[stageModules[i]].get();
+    }
   }
 
   return nullptr;
@@ -245,15 +404,19 @@ render::Shader::get_pipeline_stage_infos(uint32_t deviceIndex) const {
 
   auto &resources = deviceResources[deviceIndex];
 
-  for (const auto &stage : stages) {
-    auto it = resources->shaderModules.find(stage.type);
-    if (it != resources->shaderModules.end()) {
-      vk::PipelineShaderStageCreateInfo stageInfo{
-          .stage = get_vulkan_shader_stage(stage.type),
-          .module = **it->second,
-          .pName = stage.entryPoint.c_str()};
-      stageInfos.push_back(stageInfo);
+  // Stages from one source share its module and differ by entry point
+  for (size_t i = 0; i < stages.size(); ++i) {
+    if (stageModules[i] >= resources->shaderModules.size()) {
+      continue;
     }
+    vk::PipelineShaderStageCreateInfo stageInfo{
+        .stage = get_vulkan_shader_stage(stages[i].type),
+        .module = **resources->shaderModules[stageModules[i]],
+        .pName = stages[i].entryPoint.c_str(),
+        .pSpecializationInfo = specializations[i].entries.empty()
+                                   ? nullptr
+                                   : &specializations[i].info};
+    stageInfos.push_back(stageInfo);
   }
 
   return stageInfos;
@@ -275,8 +438,27 @@ render::Shader::get_stages() const {
   return stages;
 }
 
+const std::vector<render::Shader::ShaderModuleSource> &
+render::Shader::get_modules() const {
+  return modules;
+}
+
+render::ShaderReflection render::Shader::get_reflection() const {
+  std::lock_guard lock(shaderMutex);
+
+  ShaderReflection reflection;
+  for (const auto &moduleSource : modules) {
+    reflection.merge(moduleSource.reflection);
+  }
+  return reflection;
+}
+
 const std::string &render::Shader::get_identifier() const { return identifier; }
 
+size_t render::Shader::get_device_count() const {
+  return logicalDevices.size();
+}
+
 std::string render::Shader::shader_type_to_string(ShaderType type) {
   switch (type) {
   case ShaderType::VERTEX:
@@ -0,0 +1,93 @@
+#include "shader_builder.h"
+#include "tasks.h"
+#include <chrono>
+#include <future>
+#include <map>
+#include <print>
+
+void render::ShaderBuilder::add(Shader *shader) {
+  if (shader) {
+    shaders.push_back(shader);
+  }
+}
+
+bool render::ShaderBuilder::build() {
+  auto start = std::chrono::steady_clock::now();
+  auto &tasks = device::Tasks::get_instance();
+  failedShaders.clear();
+
+  // Modules with the same source and entry points produce the same SPIR-V.
+  // They share one task: the first compiles, the rest load it from the cache
+  std::map<std::string, std::vector<std::pair<Shader *, size_t>>> groups;
+  for (Shader *shader : shaders) {
+    const auto &modules = shader->get_modules();
+    for (size_t i = 0; i < modules.size(); ++i) {
+      if (modules[i].isCompiled) {
+        continue;
+      }
+      std::string key = modules[i].filePath;
+      for (const auto &entryPoint : modules[i].entryPoints) {
+        key += "#" + entryPoint;
+      }
+      groups[key].emplace_back(shader, i);
+    }
+  }
+
+  std::vector<std::future<std::vector<Shader *>>> compileFutures;
+  compileFutures.reserve(groups.size());
+  for (auto &[key, group] : groups) {
+    compileFutures.push_back(tasks.add_task([&group]() {
+      std::vector<Shader *> failures;
+      for (auto [shader, index] : group) {
+        if (!shader->compile_module_at(index)) {
+          failures.push_back(shader);
+        }
+      }
+      return failures;
+    }));
+  }
+
+  for (auto &future : compileFutures) {
+    for (Shader *shader : future.get()) {
+      failedShaders.insert(shader);
+    }
+  }
+
+  // Module creation per shader and device is independent as well
+  std::vector<std::pair<Shader *, std::future<bool>>> moduleFutures;
+  for (Shader *shader : shaders) {
+    if (failedShaders.contains(shader)) {
+      continue;
+    }
+    for (size_t device = 0; device < shader->get_device_count(); ++device) {
+      moduleFutures.emplace_back(
+          shader, tasks.add_task([shader, device]() {
+            return shader->initialize_device(device);
+          }));
+    }
+  }
+
+  for (auto &[shader, future] : moduleFutures) {
+    if (!future.get()) {
+      failedShaders.insert(shader);
+    }
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::print("ShaderBuilder - built {} shaders from {} module groups in {} ms "
+             "({} failed)\n",
+             shaders.size(), groups.size(), elapsed.count(),
+             failedShaders.size());
+
+  shaders.clear();
+  return failedShaders.empty();
+}
+
+bool render::ShaderBuilder::succeeded(const Shader *shader) const {
+  return !failedShaders.contains(shader);
+}
+
+size_t render::ShaderBuilder::get_shader_count() const {
+  return shaders.size();
+}
@@ -0,0 +1,244 @@
+#include "shader_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <fstream>
+#include <print>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+
+constexpr uint64_t fnvOffset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnvPrime = 0x100000001b3ull;
+
+// FNV-1a, each field is followed by its length so fields can't run together
+void hash_field(uint64_t &hash, std::string_view field) {
+  for (unsigned char c : field) {
+    hash = (hash ^ c) * fnvPrime;
+  }
+  uint64_t length = field.size();
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash ^ ((length >> (i * 8)) & 0xff)) * fnvPrime;
+  }
+}
+
+bool read_file(const std::filesystem::path &path, std::string &contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  contents = stream.str();
+  return true;
+}
+
+std::string trim(std::string_view text) {
+  size_t begin = text.find_first_not_of(" \t\r");
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  size_t end = text.find_last_not_of(" \t\r;");
+  return std::string(text.substr(begin, end - begin + 1));
+}
+
+} // namespace
+
+render::ShaderCache &render::ShaderCache::get_instance() {
+  static ShaderCache instance;
+  return instance;
+}
+
+render::ShaderCache::ShaderCache()
+    : directory(std::filesystem::current_path() / "shader-cache"),
+      enabled(true) {}
+
+void render::ShaderCache::set_directory(const std::filesystem::path &path) {
+  std::lock_guard lock(cacheMutex);
+  directory = path;
+}
+
+std::filesystem::path render::ShaderCache::get_directory() const {
+  std::lock_guard lock(cacheMutex);
+  return directory;
+}
+
+void render::ShaderCache::set_enabled(bool enable) {
+  std::lock_guard lock(cacheMutex);
+  enabled = enable;
+}
+
+bool render::ShaderCache::is_enabled() const {
+  std::lock_guard lock(cacheMutex);
+  return enabled;
+}
+
+std::vector<std::filesystem::path>
+render::ShaderCache::parse_dependencies(const std::filesystem::path &file,
+                                        const std::string &contents) {
+  std::vector<std::filesystem::path> dependencies;
+  std::filesystem::path base = file.parent_path();
+
+  std::istringstream lines(contents);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::string text = trim(line);
+
+    // #include "file", __include "file" and import "file"
+    size_t quote = text.find('"');
+    if (quote != std::string::npos &&
+        (text.starts_with("#include") || text.starts_with("__include") ||
+         text.starts_with("import"))) {
+      size_t close = text.find('"', quote + 1);
+      if (close != std::string::npos) {
+        dependencies.push_back(base /
+                               text.substr(quote + 1, close - quote - 1));
+      }
+      continue;
+    }
+
+    // import module.name resolves to module/name.slang
+    if (text.starts_with("import ") || text.starts_with("__include ")) {
+      std::string module = trim(text.substr(text.find(' ') + 1));
+      std::replace(module.begin(), module.end(), '.', '/');
+      std::replace(module.begin(), module.end(), '_', '-');
+      std::filesystem::path candidate = base / (module + ".slang");
+      if (!std::filesystem::exists(candidate)) {
+        // Slang accepts both spellings for module file names
+        std::replace(module.begin(), module.end(), '-', '_');
+        candidate = base / (module + ".slang");
+      }
+      dependencies.push_back(candidate);
+    }
+  }
+
+  return dependencies;
+}
+
+bool render::ShaderCache::collect_dependencies(
+    const std::filesystem::path &sourcePath,
+    std::vector<std::filesystem::path> &files) {
+  std::unordered_set<std::string> visited;
+  std::vector<std::filesystem::path> pending = {sourcePath};
+
+  while (!pending.empty()) {
+    std::filesystem::path file = pending.back().lexically_normal();
+    pending.pop_back();
+
+    if (!visited.insert(file.string()).second) {
+      continue;
+    }
+
+    files.push_back(file);
+
+    std::string contents;
+    if (!read_file(file, contents)) {
+      std::print(stderr, "ShaderCache - failed to read {}\n", file.string());
+      return false;
+    }
+
+    for (auto &dependency : parse_dependencies(file, contents)) {
+      pending.push_back(std::move(dependency));
+    }
+  }
+
+  return true;
+}
+
+std::optional<std::string>
+render::ShaderCache::compute_key(const KeyInfo &info) const {
+  std::vector<std::filesystem::path> files;
+  if (!collect_dependencies(info.sourcePath, files)) {
+    return std::nullopt;
+  }
+
+  uint64_t hash = fnvOffset;
+  // Counted, so the list can never run into the fields after it
+  hash_field(hash, std::to_string(info.arguments.size()));
+  for (const auto &argument : info.arguments) {
+    hash_field(hash, argument);
+  }
+  hash_field(hash, info.compilerVersion);
+
+  // Include paths relative to the source take part, so moving an include
+  // changes the key but moving the whole shader directory doesn't
+  std::filesystem::path root = files.front().parent_path();
+  for (const auto &file : files) {
+    std::string contents;
+    if (!read_file(file, contents)) {
+      return std::nullopt;
+    }
+    hash_field(hash, file.lexically_relative(root).generic_string());
+    hash_field(hash, contents);
+  }
+
+  return std::format("{:016x}", hash);
+}
+
+bool render::ShaderCache::load(const std::string &key,
+                               std::vector<char> &spirv) const {
+  if (!is_enabled()) {
+    return false;
+  }
+
+  std::filesystem::path path = get_directory() / (key + ".spv");
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  size_t fileSize = file.tellg();
+  // SPIR-V is a stream of 32-bit words, anything else is a torn entry
+  if (fileSize == 0 || fileSize % 4 != 0) {
+    return false;
+  }
+
+  spirv.resize(fileSize);
+  file.seekg(0);
+  file.read(spirv.data(), fileSize);
+  return static_cast<bool>(file);
+}
+
+bool render::ShaderCache::store(const std::string &key,
+                                const std::vector<char> &spirv) const {
+  if (!is_enabled() || spirv.empty()) {
+    return false;
+  }
+
+  // Unique per process and store so parallel builds never share a file
+  static const uint32_t processTag = std::random_device{}();
+  static std::atomic<uint64_t> stagingCounter = 0;
+
+  std::filesystem::path cacheDirectory = get_directory();
+  std::error_code error;
+  std::filesystem::create_directories(cacheDirectory, error);
+
+  std::filesystem::path stagingPath =
+      cacheDirectory /
+      std::format("{}.{:08x}-{}.tmp", key, processTag, stagingCounter++);
+
+  {
+    std::ofstream file(stagingPath, std::ios::binary);
+    file.write(spirv.data(), spirv.size());
+    if (!file) {
+      std::print(stderr, "ShaderCache - failed to write {}\n",
+                 stagingPath.string());
+      file.close();
+      std::filesystem::remove(stagingPath, error);
+      return false;
+    }
+  }
+
+  // Rename is atomic, readers see either no entry or a complete one
+  std::filesystem::rename(stagingPath, cacheDirectory / (key + ".spv"), error);
+  if (error) {
+    std::print(stderr, "ShaderCache - failed to store {}: {}\n", key,
+               error.message());
+    std::filesystem::remove(stagingPath, error);
+    return false;
+  }
+
+  return true;
+}
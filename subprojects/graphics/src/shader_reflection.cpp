@@ -0,0 +1,520 @@
+#include "shader_reflection.h"
+#include <algorithm>
+#include <cstring>
+#include <print>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// The subset of the SPIR-V grammar needed to find resources
+constexpr uint32_t spirvMagic = 0x07230203;
+
+constexpr uint32_t opName = 5;
+constexpr uint32_t opEntryPoint = 15;
+constexpr uint32_t opExecutionMode = 16;
+constexpr uint32_t opTypeBool = 20;
+constexpr uint32_t opTypeInt = 21;
+constexpr uint32_t opTypeFloat = 22;
+constexpr uint32_t opTypeVector = 23;
+constexpr uint32_t opTypeMatrix = 24;
+constexpr uint32_t opTypeImage = 25;
+constexpr uint32_t opTypeSampler = 26;
+constexpr uint32_t opTypeSampledImage = 27;
+constexpr uint32_t opTypeArray = 28;
+constexpr uint32_t opTypeRuntimeArray = 29;
+constexpr uint32_t opTypeStruct = 30;
+constexpr uint32_t opTypePointer = 32;
+constexpr uint32_t opConstant = 43;
+constexpr uint32_t opVariable = 59;
+constexpr uint32_t opDecorate = 71;
+constexpr uint32_t opMemberDecorate = 72;
+constexpr uint32_t opTypeAccelerationStructure = 5341;
+
+constexpr uint32_t decorationBufferBlock = 3;
+constexpr uint32_t decorationArrayStride = 6;
+constexpr uint32_t decorationMatrixStride = 7;
+constexpr uint32_t decorationNonWritable = 24;
+constexpr uint32_t decorationBinding = 33;
+constexpr uint32_t decorationDescriptorSet = 34;
+constexpr uint32_t decorationOffset = 35;
+
+constexpr uint32_t storageUniformConstant = 0;
+constexpr uint32_t storageUniform = 2;
+constexpr uint32_t storagePushConstant = 9;
+constexpr uint32_t storageStorageBuffer = 12;
+
+constexpr uint32_t executionModeLocalSize = 17;
+
+constexpr uint32_t dimBuffer = 5;
+constexpr uint32_t dimSubpassData = 6;
+
+// Entry point interfaces list every global variable from SPIR-V 1.4 on
+constexpr uint32_t fullInterfaceVersion = 0x00010400;
+
+vk::ShaderStageFlags execution_model_stage(uint32_t model) {
+  switch (model) {
+  case 0:
+    return vk::ShaderStageFlagBits::eVertex;
+  case 1:
+    return vk::ShaderStageFlagBits::eTessellationControl;
+  case 2:
+    return vk::ShaderStageFlagBits::eTessellationEvaluation;
+  case 3:
+    return vk::ShaderStageFlagBits::eGeometry;
+  case 4:
+    return vk::ShaderStageFlagBits::eFragment;
+  case 5:
+    return vk::ShaderStageFlagBits::eCompute;
+  case 5267:
+  case 5364:
+    return vk::ShaderStageFlagBits::eTaskEXT;
+  case 5268:
+  case 5365:
+    return vk::ShaderStageFlagBits::eMeshEXT;
+  case 5313:
+    return vk::ShaderStageFlagBits::eRaygenKHR;
+  case 5314:
+    return vk::ShaderStageFlagBits::eIntersectionKHR;
+  case 5315:
+    return vk::ShaderStageFlagBits::eAnyHitKHR;
+  case 5316:
+    return vk::ShaderStageFlagBits::eClosestHitKHR;
+  case 5317:
+    return vk::ShaderStageFlagBits::eMissKHR;
+  case 5318:
+    return vk::ShaderStageFlagBits::eCallableKHR;
+  default:
+    return {};
+  }
+}
+
+// Literal strings are null terminated and padded to whole words
+std::string read_string(const uint32_t *words, size_t wordCount,
+                        size_t &consumed) {
+  const char *text = reinterpret_cast<const char *>(words);
+  size_t length = strnlen(text, wordCount * 4);
+  consumed = length / 4 + 1;
+  return std::string(text, length);
+}
+
+struct Module {
+  std::unordered_map<uint32_t, std::vector<uint32_t>> types;
+  std::unordered_map<uint32_t, uint32_t> constants;
+  std::unordered_map<uint32_t, std::string> names;
+  std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>>
+      decorations;
+  std::unordered_map<uint64_t, std::unordered_map<uint32_t, uint32_t>>
+      memberDecorations;
+
+  uint32_t decoration(uint32_t id, uint32_t kind, uint32_t fallback) const {
+    auto it = decorations.find(id);
+    if (it == decorations.end() || !it->second.contains(kind)) {
+      return fallback;
+    }
+    return it->second.at(kind);
+  }
+
+  bool has_decoration(uint32_t id, uint32_t kind) const {
+    auto it = decorations.find(id);
+    return it != decorations.end() && it->second.contains(kind);
+  }
+
+  uint32_t member_decoration(uint32_t id, uint32_t member, uint32_t kind,
+                             uint32_t fallback) const {
+    auto it = memberDecorations.find((uint64_t(id) << 32) | member);
+    if (it == memberDecorations.end() || !it->second.contains(kind)) {
+      return fallback;
+    }
+    return it->second.at(kind);
+  }
+
+  // Byte size with the explicit layout decorations of the module
+  uint32_t type_size(uint32_t id, uint32_t matrixStride = 0) const {
+    auto it = types.find(id);
+    if (it == types.end()) {
+      return 0;
+    }
+    const auto &words = it->second;
+
+    switch (words[0]) {
+    case opTypeBool:
+      return 4;
+    case opTypeInt:
+    case opTypeFloat:
+      return words[2] / 8;
+    case opTypeVector:
+      return words[3] * type_size(words[2]);
+    case opTypeMatrix:
+      return words[3] * (matrixStride ? matrixStride : type_size(words[2]));
+    case opTypeArray: {
+      uint32_t length = constants.contains(words[3]) ? constants.at(words[3])
+                                                     : 0;
+      uint32_t stride = decoration(words[1], decorationArrayStride,
+                                   type_size(words[2]));
+      return length * stride;
+    }
+    case opTypeStruct: {
+      uint32_t size = 0;
+      for (uint32_t member = 0; member + 2 < words.size(); ++member) {
+        uint32_t offset =
+            member_decoration(words[1], member, decorationOffset, size);
+        uint32_t stride =
+            member_decoration(words[1], member, decorationMatrixStride, 0);
+        size = std::max(size, offset + type_size(words[member + 2], stride));
+      }
+      return size;
+    }
+    default:
+      return 0;
+    }
+  }
+
+  // Smallest member offset, where a push constant block starts
+  uint32_t first_offset(uint32_t structId) const {
+    auto it = types.find(structId);
+    if (it == types.end() || it->second.size() <= 2) {
+      return 0;
+    }
+    uint32_t offset = UINT32_MAX;
+    for (uint32_t member = 0; member + 2 < it->second.size(); ++member) {
+      offset = std::min(
+          offset, member_decoration(structId, member, decorationOffset, 0));
+    }
+    return offset;
+  }
+};
+
+} // namespace
+
+bool render::ShaderReflection::reflect(
+    const std::vector<char> &spirv, const std::vector<std::string> &entryPoints,
+    ShaderReflection &reflection) {
+  reflection = {};
+
+  if (spirv.size() < 20 || spirv.size() % 4 != 0) {
+    return false;
+  }
+  std::vector<uint32_t> code(spirv.size() / 4);
+  std::memcpy(code.data(), spirv.data(), spirv.size());
+  if (code[0] != spirvMagic) {
+    std::print(stderr, "ShaderReflection - not a SPIR-V module\n");
+    return false;
+  }
+  const uint32_t version = code[1];
+
+  Module parsed;
+  vk::ShaderStageFlags allStages;
+  std::unordered_map<uint32_t, vk::ShaderStageFlags> variableStages;
+  std::unordered_set<uint32_t> entryPointIds;
+  std::vector<std::vector<uint32_t>> variables;
+
+  for (size_t offset = 5; offset < code.size();) {
+    uint32_t wordCount = code[offset] >> 16;
+    uint32_t opcode = code[offset] & 0xffff;
+    if (wordCount == 0 || offset + wordCount > code.size()) {
+      std::print(stderr, "ShaderReflection - truncated instruction\n");
+      return false;
+    }
+    std::vector<uint32_t> words(code.begin() + offset,
+                                code.begin() + offset + wordCount);
+    words[0] = opcode;
+    offset += wordCount;
+
+    switch (opcode) {
+    case opEntryPoint: {
+      size_t consumed = 0;
+      std::string name = read_string(&words[3], wordCount - 3, consumed);
+      if (!entryPoints.empty() &&
+          std::ranges::find(entryPoints, name) == entryPoints.end()) {
+        break;
+      }
+      vk::ShaderStageFlags stage = execution_model_stage(words[1]);
+      allStages |= stage;
+      entryPointIds.insert(words[2]);
+      for (size_t i = 3 + consumed; i < words.size(); ++i) {
+        variableStages[words[i]] |= stage;
+      }
+      break;
+    }
+    case opExecutionMode:
+      // Execution modes follow every entry point in the module layout
+      if (wordCount >= 6 && words[2] == executionModeLocalSize &&
+          entryPointIds.contains(words[1])) {
+        reflection.localSize = vk::Extent3D{words[3], words[4], words[5]};
+      }
+      break;
+    case opName: {
+      size_t consumed = 0;
+      parsed.names[words[1]] =
+          read_string(&words[2], wordCount - 2, consumed);
+      break;
+    }
+    case opDecorate:
+      if (wordCount >= 3) {
+        parsed.decorations[words[1]][words[2]] =
+            wordCount >= 4 ? words[3] : 0;
+      }
+      break;
+    case opMemberDecorate:
+      if (wordCount >= 4) {
+        parsed.memberDecorations[(uint64_t(words[1]) << 32) | words[2]]
+                                [words[3]] = wordCount >= 5 ? words[4] : 0;
+      }
+      break;
+    case opConstant:
+      if (wordCount >= 4) {
+        parsed.constants[words[2]] = words[3];
+      }
+      break;
+    case opVariable:
+      variables.push_back(std::move(words));
+      break;
+    default:
+      if ((opcode >= opTypeBool && opcode <= opTypePointer) ||
+          opcode == opTypeAccelerationStructure) {
+        parsed.types[words[1]] = std::move(words);
+      }
+      break;
+    }
+  }
+
+  for (const auto &variable : variables) {
+    uint32_t storage = variable[3];
+    if (storage != storageUniformConstant && storage != storageUniform &&
+        storage != storagePushConstant && storage != storageStorageBuffer) {
+      continue;
+    }
+
+    // Older modules only list inputs and outputs in their interfaces
+    vk::ShaderStageFlags stages = allStages;
+    if (version >= fullInterfaceVersion) {
+      auto used = variableStages.find(variable[2]);
+      if (used == variableStages.end()) {
+        continue;
+      }
+      stages = used->second;
+    }
+
+    auto pointer = parsed.types.find(variable[1]);
+    if (pointer == parsed.types.end() || pointer->second[0] != opTypePointer) {
+      continue;
+    }
+    uint32_t typeId = pointer->second[3];
+
+    if (storage == storagePushConstant) {
+      uint32_t begin = parsed.first_offset(typeId);
+      reflection.pushConstantRanges.push_back(
+          {.stageFlags = stages,
+           .offset = begin,
+           .size = parsed.type_size(typeId) - begin});
+      continue;
+    }
+
+    // Arrays of resources become the descriptor count
+    uint32_t count = 1;
+    auto type = parsed.types.find(typeId);
+    while (type != parsed.types.end() &&
+           (type->second[0] == opTypeArray ||
+            type->second[0] == opTypeRuntimeArray)) {
+      if (type->second[0] == opTypeArray) {
+        count *= parsed.constants.contains(type->second[3])
+                     ? parsed.constants.at(type->second[3])
+                     : 1;
+      }
+      typeId = type->second[2];
+      type = parsed.types.find(typeId);
+    }
+    if (type == parsed.types.end()) {
+      continue;
+    }
+    const auto &words = type->second;
+
+    Binding binding{
+        .name = parsed.names.contains(variable[2])
+                    ? parsed.names.at(variable[2])
+                    : parsed.names[typeId],
+        .set = parsed.decoration(variable[2], decorationDescriptorSet, 0),
+        .binding = parsed.decoration(variable[2], decorationBinding, 0),
+        .count = count,
+        .stages = stages,
+        .readOnly =
+            parsed.has_decoration(variable[2], decorationNonWritable)};
+
+    switch (words[0]) {
+    case opTypeStruct:
+      binding.type = storage == storageStorageBuffer ||
+                             parsed.has_decoration(typeId,
+                                                   decorationBufferBlock)
+                         ? vk::DescriptorType::eStorageBuffer
+                         : vk::DescriptorType::eUniformBuffer;
+      binding.size = parsed.type_size(typeId);
+      break;
+    case opTypeSampledImage:
+      binding.type = vk::DescriptorType::eCombinedImageSampler;
+      break;
+    case opTypeSampler:
+      binding.type = vk::DescriptorType::eSampler;
+      break;
+    case opTypeImage:
+      // Sampled is 1 for sampled images and 2 for storage images
+      if (words[3] == dimSubpassData) {
+        binding.type = vk::DescriptorType::eInputAttachment;
+      } else if (words[3] == dimBuffer) {
+        binding.type = words[7] == 2 ? vk::DescriptorType::eStorageTexelBuffer
+                                     : vk::DescriptorType::eUniformTexelBuffer;
+      } else {
+        binding.type = words[7] == 2 ? vk::DescriptorType::eStorageImage
+                                     : vk::DescriptorType::eSampledImage;
+      }
+      break;
+    case opTypeAccelerationStructure:
+      binding.type = vk::DescriptorType::eAccelerationStructureKHR;
+      break;
+    default:
+      continue;
+    }
+
+    reflection.merge_binding(binding);
+  }
+
+  // One range covering every stage, as the engine binds a single block
+  if (reflection.pushConstantRanges.size() > 1) {
+    ShaderReflection joined;
+    joined.merge(reflection);
+    reflection.pushConstantRanges = joined.pushConstantRanges;
+  }
+
+  return true;
+}
+
+void render::ShaderReflection::merge_binding(const Binding &binding) {
+  Binding *existing = nullptr;
+  for (auto &candidate : bindings) {
+    if (candidate.set == binding.set && candidate.binding == binding.binding) {
+      existing = &candidate;
+      break;
+    }
+  }
+
+  if (!existing) {
+    bindings.push_back(binding);
+    return;
+  }
+
+  if (existing->type != binding.type) {
+    std::print(stderr,
+               "ShaderReflection - set {} binding {} is {} in one stage and "
+               "{} in another\n",
+               binding.set, binding.binding, vk::to_string(existing->type),
+               vk::to_string(binding.type));
+  }
+  existing->stages |= binding.stages;
+  existing->count = std::max(existing->count, binding.count);
+  existing->size = std::max(existing->size, binding.size);
+  existing->readOnly = existing->readOnly && binding.readOnly;
+}
+
+void render::ShaderReflection::merge(const ShaderReflection &other) {
+  if (other.localSize != vk::Extent3D{1, 1, 1}) {
+    localSize = other.localSize;
+  }
+
+  for (const auto &binding : other.bindings) {
+    merge_binding(binding);
+  }
+
+  for (const auto &range : other.pushConstantRanges) {
+    if (pushConstantRanges.empty()) {
+      pushConstantRanges.push_back(range);
+      continue;
+    }
+    auto &joined = pushConstantRanges.front();
+    uint32_t end = std::max(joined.offset + joined.size,
+                            range.offset + range.size);
+    joined.offset = std::min(joined.offset, range.offset);
+    joined.size = end - joined.offset;
+    joined.stageFlags |= range.stageFlags;
+  }
+}
+
+const std::vector<render::ShaderReflection::Binding> &
+render::ShaderReflection::get_bindings() const {
+  return bindings;
+}
+
+const std::vector<vk::PushConstantRange> &
+render::ShaderReflection::get_push_constant_ranges() const {
+  return pushConstantRanges;
+}
+
+std::vector<vk::DescriptorSetLayoutBinding>
+render::ShaderReflection::get_set_layout_bindings(uint32_t set) const {
+  std::vector<vk::DescriptorSetLayoutBinding> layoutBindings;
+  for (const auto &binding : bindings) {
+    if (binding.set == set) {
+      layoutBindings.push_back({.binding = binding.binding,
+                                .descriptorType = binding.type,
+                                .descriptorCount = binding.count,
+                                .stageFlags = binding.stages});
+    }
+  }
+
+  std::ranges::sort(layoutBindings, {},
+                    &vk::DescriptorSetLayoutBinding::binding);
+  return layoutBindings;
+}
+
+uint32_t render::ShaderReflection::get_set_count() const {
+  uint32_t count = 0;
+  for (const auto &binding : bindings) {
+    count = std::max(count, binding.set + 1);
+  }
+  return count;
+}
+
+vk::Extent3D render::ShaderReflection::get_local_size() const {
+  return localSize;
+}
+
+const render::ShaderReflection::Binding *
+render::ShaderReflection::find_binding(uint32_t set, uint32_t binding) const {
+  for (const auto &candidate : bindings) {
+    if (candidate.set == set && candidate.binding == binding) {
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
+
+const render::ShaderReflection::Binding *
+render::ShaderReflection::find_first(vk::DescriptorType type) const {
+  const Binding *first = nullptr;
+  for (const auto &candidate : bindings) {
+    if (candidate.type == type &&
+        (!first || std::tie(candidate.set, candidate.binding) <
+                       std::tie(first->set, first->binding))) {
+      first = &candidate;
+    }
+  }
+  return first;
+}
+
+bool render::ShaderReflection::operator==(
+    const ShaderReflection &other) const {
+  if (bindings.size() != other.bindings.size() ||
+      pushConstantRanges != other.pushConstantRanges ||
+      localSize != other.localSize) {
+    return false;
+  }
+  for (const auto &binding : bindings) {
+    const Binding *match = other.find_binding(binding.set, binding.binding);
+    if (!match || match->type != binding.type ||
+        match->count != binding.count || match->stages != binding.stages ||
+        match->size != binding.size || match->readOnly != binding.readOnly) {
+      return false;
+    }
+  }
+  return true;
+}
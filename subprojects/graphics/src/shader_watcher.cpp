@@ -0,0 +1,187 @@
+#include "shader_watcher.h"
+#include "shader.h"
+#include "shader_cache.h"
+#include <print>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string canonical_path(const std::filesystem::path &path) {
+  std::error_code error;
+  std::filesystem::path canonical =
+      std::filesystem::weakly_canonical(path, error);
+  return error ? path.lexically_normal().string() : canonical.string();
+}
+
+} // namespace
+
+render::ShaderWatcher::ShaderWatcher(const std::filesystem::path &directory)
+    : directory(directory), inotifyFd(-1), running(false) {
+#ifdef __linux__
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0) {
+    std::print(stderr, "ShaderWatcher - failed to initialize inotify\n");
+    return;
+  }
+
+  std::error_code error;
+  if (!add_watch(directory)) {
+    close(inotifyFd);
+    inotifyFd = -1;
+    return;
+  }
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(directory, error)) {
+    if (entry.is_directory()) {
+      add_watch(entry.path());
+    }
+  }
+
+  running = true;
+  watchThread = std::thread(&ShaderWatcher::watch_loop, this);
+  std::print("ShaderWatcher - watching {} ({} directories)\n",
+             directory.string(), watches.size());
+#else
+  std::print("ShaderWatcher - hot reload is not supported on this platform\n");
+#endif
+}
+
+render::ShaderWatcher::~ShaderWatcher() {
+  running = false;
+  if (watchThread.joinable()) {
+    watchThread.join();
+  }
+#ifdef __linux__
+  if (inotifyFd >= 0) {
+    close(inotifyFd);
+  }
+#endif
+}
+
+bool render::ShaderWatcher::add_watch(const std::filesystem::path &path) {
+#ifdef __linux__
+  int descriptor =
+      inotify_add_watch(inotifyFd, path.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+  if (descriptor < 0) {
+    std::print(stderr, "ShaderWatcher - failed to watch {}\n", path.string());
+    return false;
+  }
+  watches[descriptor] = path;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void render::ShaderWatcher::watch_loop() {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+
+  while (running) {
+    // Wake up regularly so the destructor never waits long
+    pollfd descriptor{.fd = inotifyFd, .events = POLLIN, .revents = 0};
+    if (poll(&descriptor, 1, 100) <= 0) {
+      continue;
+    }
+
+    ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < length;) {
+      const auto *event = reinterpret_cast<const inotify_event *>(
+          buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      auto it = watches.find(event->wd);
+      if (it == watches.end() || event->len == 0) {
+        continue;
+      }
+      std::filesystem::path path = it->second / event->name;
+
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          add_watch(path);
+        }
+        continue;
+      }
+
+      // Creation alone is followed by a close, deletion only matters for
+      // sources that include the file and fail on the next compile
+      if (path.extension() != ".slang" || (event->mask & IN_CREATE)) {
+        continue;
+      }
+
+      std::lock_guard lock(changeMutex);
+      changedFiles.insert(path.string());
+      lastChange = std::chrono::steady_clock::now();
+    }
+  }
+#endif
+}
+
+bool render::ShaderWatcher::is_active() const { return running; }
+
+std::vector<std::filesystem::path> render::ShaderWatcher::take_changes() {
+  std::lock_guard lock(changeMutex);
+
+  if (changedFiles.empty() ||
+      std::chrono::steady_clock::now() - lastChange < settleTime) {
+    return {};
+  }
+
+  std::vector<std::filesystem::path> changes(changedFiles.begin(),
+                                             changedFiles.end());
+  changedFiles.clear();
+  return changes;
+}
+
+std::vector<render::ShaderWatcher::ModuleUpdate>
+render::ShaderWatcher::recompile(
+    std::vector<ModuleUpdate> modules,
+    const std::vector<std::filesystem::path> &changedFiles) {
+  std::unordered_set<std::string> changed;
+  for (const auto &file : changedFiles) {
+    changed.insert(canonical_path(file));
+  }
+
+  std::vector<ModuleUpdate> updates;
+  std::unordered_set<std::string> visited;
+
+  for (auto &moduleUpdate : modules) {
+    std::string key = moduleUpdate.filePath;
+    for (const auto &entryPoint : moduleUpdate.entryPoints) {
+      key += "#" + entryPoint;
+    }
+    if (!visited.insert(key).second) {
+      continue;
+    }
+
+    // An include that was just removed is still listed, as the file that
+    // couldn't be read
+    std::vector<std::filesystem::path> files;
+    ShaderCache::collect_dependencies(moduleUpdate.filePath, files);
+    bool affected = changed.contains(canonical_path(moduleUpdate.filePath));
+    for (const auto &file : files) {
+      affected = affected || changed.contains(canonical_path(file));
+    }
+    if (!affected) {
+      continue;
+    }
+
+    if (!Shader::compile_source(moduleUpdate.filePath, moduleUpdate.entryPoints,
+                                moduleUpdate.spirvCode)) {
+      std::print(stderr,
+                 "ShaderWatcher - {} failed to compile, keeping the running "
+                 "version\n",
+                 moduleUpdate.filePath);
+      continue;
+    }
+    updates.push_back(std::move(moduleUpdate));
+  }
+
+  return updates;
+}
@@ -0,0 +1,220 @@
+#include "slang_compiler.h"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <print>
+#include <random>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+thread_local std::string render::SlangCompiler::lastError;
+
+render::SlangCompiler::SlangCompiler() : initialized(false) { initialize(); }
+
+std::filesystem::path render::SlangCompiler::get_slangc_path() {
+  return std::filesystem::current_path() / "slang-bin" / "slangc";
+}
+
+bool render::SlangCompiler::initialize() {
+  std::lock_guard lock(initMutex);
+  if (initialized) {
+    return true;
+  }
+
+  std::filesystem::path slangcPath = get_slangc_path();
+  if (!std::filesystem::exists(slangcPath)) {
+    lastError = "slangc compiler not found at: " + slangcPath.string();
+    std::print(stderr, "SlangCompiler - {}\n", lastError);
+    return false;
+  }
+
+  initialized = true;
+  std::print("SlangCompiler - using slangc at {}\n", slangcPath.string());
+  return true;
+}
+
+bool render::SlangCompiler::run_slangc(
+    const std::vector<std::string> &arguments, std::string &output) {
+  std::string slangcPath = get_slangc_path().string();
+
+  std::vector<char *> argv;
+  argv.push_back(slangcPath.data());
+  for (const auto &argument : arguments) {
+    argv.push_back(const_cast<char *>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  // The caller's environment, with slang-bin/lib in front of the library
+  // path so slangc finds its shared libraries
+  std::string libraryPath =
+      "LD_LIBRARY_PATH=" +
+      (std::filesystem::current_path() / "slang-bin" / "lib").string();
+  std::vector<std::string> environment;
+  for (char **variable = environ; *variable; ++variable) {
+    if (std::strncmp(*variable, "LD_LIBRARY_PATH=", 16) == 0) {
+      libraryPath += std::format(":{}", *variable + 16);
+    } else {
+      environment.emplace_back(*variable);
+    }
+  }
+  environment.push_back(libraryPath);
+
+  std::vector<char *> envp;
+  for (auto &variable : environment) {
+    envp.push_back(variable.data());
+  }
+  envp.push_back(nullptr);
+
+  // Close on exec, so slangc started by another thread doesn't hold this
+  // pipe open
+  std::array<int, 2> pipeFds;
+  if (pipe2(pipeFds.data(), O_CLOEXEC) != 0) {
+    output = std::format("failed to create pipe: {}", std::strerror(errno));
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDERR_FILENO);
+
+  pid_t pid;
+  int result = posix_spawn(&pid, slangcPath.c_str(), &actions, nullptr,
+                           argv.data(), envp.data());
+  posix_spawn_file_actions_destroy(&actions);
+  close(pipeFds[1]);
+
+  if (result != 0) {
+    close(pipeFds[0]);
+    output = std::format("failed to start slangc: {}", std::strerror(result));
+    return false;
+  }
+
+  std::array<char, 256> buffer;
+  ssize_t count;
+  while ((count = read(pipeFds[0], buffer.data(), buffer.size())) != 0) {
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    output.append(buffer.data(), count);
+  }
+  close(pipeFds[0]);
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      output += std::format("\nfailed to wait for slangc: {}",
+                            std::strerror(errno));
+      return false;
+    }
+  }
+
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool render::SlangCompiler::compile(
+    const std::filesystem::path &sourcePath,
+    const std::vector<std::string> &entryPoints, std::vector<char> &spirv) {
+  if (!initialize()) {
+    return false;
+  }
+
+  if (!std::filesystem::exists(sourcePath)) {
+    lastError = "Shader file does not exist: " + sourcePath.string();
+    std::print(stderr, "SlangCompiler - {}\n", lastError);
+    return false;
+  }
+
+  // slangc writes a file, give every compile its own
+  static const uint32_t processTag = std::random_device{}();
+  static std::atomic<uint64_t> outputCounter = 0;
+  std::filesystem::path outputPath =
+      std::filesystem::temp_directory_path() /
+      std::format("slang-{:08x}-{}.spv", processTag, outputCounter++);
+
+  std::vector<std::string> arguments = get_arguments(entryPoints);
+  arguments.push_back("-o");
+  arguments.push_back(outputPath.string());
+  arguments.push_back(sourcePath.string());
+
+  std::print("SlangCompiler - compiling {}\n", sourcePath.string());
+
+  std::string output;
+  bool success = run_slangc(arguments, output);
+  if (!success) {
+    lastError = std::format("slangc failed on {}:\n{}", sourcePath.string(),
+                            output);
+    std::print(stderr, "SlangCompiler - {}\n", lastError);
+  } else {
+    std::ifstream file(outputPath, std::ios::binary);
+    spirv.assign(std::istreambuf_iterator<char>(file),
+                 std::istreambuf_iterator<char>());
+    if (spirv.empty()) {
+      lastError = "slangc produced no SPIR-V for " + sourcePath.string();
+      std::print(stderr, "SlangCompiler - {}\n", lastError);
+      success = false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::remove(outputPath, error);
+  return success;
+}
+
+std::vector<std::string> render::SlangCompiler::get_arguments(
+    const std::vector<std::string> &entryPoints) {
+  std::vector<std::string> arguments = {
+      "-target", "spirv", "-profile", targetProfile, "-emit-spirv-directly",
+      "-fvk-use-entrypoint-name"};
+  for (const auto &entryPoint : entryPoints) {
+    arguments.push_back("-entry");
+    arguments.push_back(entryPoint);
+  }
+  return arguments;
+}
+
+const std::string &render::SlangCompiler::get_last_error() const {
+  return lastError;
+}
+
+const std::string &render::SlangCompiler::get_version() {
+  static std::once_flag versionFlag;
+  static std::string version;
+
+  std::call_once(versionFlag, []() {
+    if (!run_slangc({"-v"}, version)) {
+      version.clear();
+    }
+
+    while (!version.empty() &&
+           (version.back() == '\n' || version.back() == '\r')) {
+      version.pop_back();
+    }
+
+    // Without a version, fall back to the identity of the binary itself
+    std::filesystem::path slangcPath = get_slangc_path();
+    std::error_code error;
+    if (version.empty() && std::filesystem::exists(slangcPath, error)) {
+      version = std::format(
+          "slangc-{}-{}", std::filesystem::file_size(slangcPath, error),
+          std::filesystem::last_write_time(slangcPath, error)
+              .time_since_epoch()
+              .count());
+    }
+
+    std::print("SlangCompiler - compiler version {}\n",
+               version.empty() ? "unknown" : version);
+  });
+
+  return version;
+}
@@ -0,0 +1,101 @@
+#include "stream_batch.h"
+#include <exception>
+#include <print>
+
+render::StreamBatch::StreamBatch(
+    const std::vector<device::LogicalDevice *> &devices)
+    : submitted(false), failed(false) {
+  deviceBatches.reserve(devices.size());
+  for (auto *device : devices) {
+    deviceBatches.push_back({.device = device});
+  }
+}
+
+render::StreamBatch::~StreamBatch() {
+  for (auto &batch : deviceBatches) {
+    // Only teardown drops a batch before its copies are done
+    if (*batch.fence) {
+      (void)batch.device->get_device().waitForFences(*batch.fence, vk::True,
+                                                     UINT64_MAX);
+    }
+
+    for (auto &[buffer, allocation] : batch.stagingBuffers) {
+      vmaDestroyBuffer(batch.device->get_allocator(), buffer, allocation);
+    }
+  }
+}
+
+vk::raii::CommandBuffer &
+render::StreamBatch::get_command_buffer(size_t deviceIndex) {
+  auto &batch = deviceBatches[deviceIndex];
+
+  if (batch.commandBuffers.empty()) {
+    vk::CommandBufferAllocateInfo allocateInfo{
+        .commandPool = *batch.device->get_command_pool(),
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1};
+    batch.commandBuffers =
+        batch.device->get_device().allocateCommandBuffers(allocateInfo);
+
+    vk::CommandBufferBeginInfo beginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+    batch.commandBuffers[0].begin(beginInfo);
+  }
+
+  return batch.commandBuffers[0];
+}
+
+void render::StreamBatch::add_staging_buffer(size_t deviceIndex,
+                                             VkBuffer buffer,
+                                             VmaAllocation allocation) {
+  deviceBatches[deviceIndex].stagingBuffers.emplace_back(buffer, allocation);
+}
+
+bool render::StreamBatch::submit() {
+  bool success = true;
+  bool recorded = false;
+
+  for (auto &batch : deviceBatches) {
+    if (batch.commandBuffers.empty()) {
+      continue;
+    }
+    recorded = true;
+
+    try {
+      auto &commandBuffer = batch.commandBuffers[0];
+      commandBuffer.end();
+
+      vk::SubmitInfo submitInfo{.commandBufferCount = 1,
+                                .pCommandBuffers = &*commandBuffer};
+
+      batch.fence = batch.device->get_device().createFence({});
+      batch.device->get_graphics_queue().submit(submitInfo, *batch.fence);
+    } catch (const std::exception &e) {
+      std::print(stderr, "StreamBatch - failed to submit copies: {}\n",
+                 e.what());
+      batch.fence.clear();
+      failed = true;
+      success = false;
+    }
+  }
+
+  submitted = recorded;
+  return recorded && success;
+}
+
+bool render::StreamBatch::is_submitted() const { return submitted; }
+
+bool render::StreamBatch::has_failed() const { return failed; }
+
+bool render::StreamBatch::is_complete() const {
+  if (!submitted) {
+    return false;
+  }
+
+  for (const auto &batch : deviceBatches) {
+    if (*batch.fence && batch.fence.getStatus() != vk::Result::eSuccess) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -1,25 +1,30 @@
 #include "swap_chain.h"
 #include "logical_device.h"
 #include "vulkan/vulkan.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <print>
 #include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
 device::SwapChain::SwapChain(LogicalDevice *logicalDevice, GLFWwindow *window,
-                             vk::raii::SurfaceKHR &surface)
+                             vk::raii::SurfaceKHR &surface,
+                             PresentPolicy presentPolicy)
     : logicalDevice(logicalDevice), window(window), surface(&surface),
-      swapChain(nullptr), image(nullptr), imageView(nullptr),
-      imageMemory(nullptr), depthImage(nullptr), depthImageView(nullptr),
-      depthImageMemory(nullptr), depthFormat(vk::Format::eD32Sfloat) {}
+      swapChain(nullptr), image(nullptr), imageMemory(nullptr),
+      depthImage(nullptr), depthImageView(nullptr), depthImageMemory(nullptr),
+      depthFormat(vk::Format::eD32Sfloat), presentPolicy(presentPolicy),
+      presentMode(vk::PresentModeKHR::eFifo), lastPresentId(0) {}
 
 device::SwapChain::SwapChain(LogicalDevice *logicalDevice,
                              vk::SurfaceFormatKHR format, vk::Extent2D extent2D)
     : logicalDevice(logicalDevice), window(nullptr), surface(nullptr),
-      swapChain(nullptr), image(nullptr), imageView(nullptr),
-      imageMemory(nullptr), depthImage(nullptr), depthImageView(nullptr),
-      depthImageMemory(nullptr), surfaceFormat(format), extent2D(extent2D),
-      depthFormat(vk::Format::eD32Sfloat) {}
+      swapChain(nullptr), image(nullptr), imageMemory(nullptr),
+      depthImage(nullptr), depthImageView(nullptr), depthImageMemory(nullptr),
+      surfaceFormat(format), extent2D(extent2D),
+      depthFormat(vk::Format::eD32Sfloat),
+      presentPolicy(PresentPolicy::MAILBOX),
+      presentMode(vk::PresentModeKHR::eFifo), lastPresentId(0) {}
 
 device::SwapChain::~SwapChain() {
 
@@ -42,6 +47,36 @@ void device::SwapChain::set_surface_format(
       iterator != availableFormats.end() ? *iterator : availableFormats[0];
 }
 
+vk::PresentModeKHR device::SwapChain::select_present_mode(
+    const std::vector<vk::PresentModeKHR> &available) const {
+  auto supported = [&available](vk::PresentModeKHR mode) {
+    return std::ranges::find(available, mode) != available.end();
+  };
+
+  switch (presentPolicy) {
+  case PresentPolicy::IMMEDIATE:
+    if (supported(vk::PresentModeKHR::eImmediate)) {
+      return vk::PresentModeKHR::eImmediate;
+    }
+    [[fallthrough]];
+  case PresentPolicy::MAILBOX:
+    if (supported(vk::PresentModeKHR::eMailbox)) {
+      return vk::PresentModeKHR::eMailbox;
+    }
+    break;
+  case PresentPolicy::RELAXED:
+    if (supported(vk::PresentModeKHR::eFifoRelaxed)) {
+      return vk::PresentModeKHR::eFifoRelaxed;
+    }
+    break;
+  case PresentPolicy::VSYNC:
+    break;
+  }
+
+  // FIFO is the only mode every surface supports
+  return vk::PresentModeKHR::eFifo;
+}
+
 void device::SwapChain::create_swap_chain() {
 
   if (surface != nullptr) {
@@ -77,13 +112,8 @@ void device::SwapChain::create_swap_chain() {
       return presentMode == vk::PresentModeKHR::eFifo;
     }));
 
-    auto swapChainPresentMode =
-        std::ranges::any_of(availablePresentModes,
-                            [](const vk::PresentModeKHR value) {
-                              return vk::PresentModeKHR::eMailbox == value;
-                            })
-            ? vk::PresentModeKHR::eMailbox
-            : vk::PresentModeKHR::eFifo;
+    presentMode = select_present_mode(availablePresentModes);
+    lastPresentId = 0;
 
     vk::SwapchainCreateInfoKHR swapChainCreateInfo{
         .surface = **surface,
@@ -100,17 +130,18 @@ void device::SwapChain::create_swap_chain() {
         .imageSharingMode = vk::SharingMode::eExclusive,
         .preTransform = surfaceCapabilities.currentTransform,
         .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
-        .presentMode = swapChainPresentMode,
+        .presentMode = presentMode,
         .clipped = true};
 
     swapChain = vk::raii::SwapchainKHR(logicalDevice->get_device(),
                                        swapChainCreateInfo);
     swapChainImages = swapChain.getImages();
 
-    std::print("Created Swap Chain for device: {}\n",
+    std::print("Created Swap Chain for device: {} ({})\n",
                logicalDevice->get_physical_device()
                    ->get_properties()
-                   .deviceName.data());
+                   .deviceName.data(),
+               vk::to_string(presentMode));
     return;
   }
 
@@ -161,17 +192,8 @@ void device::SwapChain::create_swap_chain() {
   VkDeviceMemory vkMemory = *imageMemory;
   vkBindImageMemory(vkDevice, vkImage, vkMemory, 0);
 
-  vk::ImageViewCreateInfo viewInfo{
-      .image = *image,
-      .viewType = vk::ImageViewType::e2D,
-      .format = surfaceFormat.format,
-      .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
-                           .baseMipLevel = 0,
-                           .levelCount = 1,
-                           .baseArrayLayer = 0,
-                           .layerCount = 1}};
-
-  imageView = logicalDevice->get_device().createImageView(viewInfo);
+  // The view comes from create_swap_image_views like the presented ones
+  swapChainImages = {*image};
 
   std::print(
       "Created Swap Image for device: {}\n",
@@ -181,14 +203,14 @@ void device::SwapChain::create_swap_chain() {
 void device::SwapChain::clear_swap_chain() {
   destroy_depth_resources();
 
+  swapChainImageViews.clear();
+  swapChainImages.clear();
+
   if (surface != nullptr) {
-    swapChainImageViews.clear();
-    swapChainImages.clear();
     swapChain.clear();
     return;
   }
 
-  imageView.clear();
   image.clear();
   imageMemory.clear();
 }
@@ -277,6 +299,11 @@ void device::SwapChain::destroy_depth_resources() {
 }
 
 void device::SwapChain::recreate_swap_chain() {
+  if (surface == nullptr) {
+    recreate_swap_chain(surfaceFormat, extent2D);
+    return;
+  }
+
   int width = 0, height = 0;
   glfwGetFramebufferSize(window, &width, &height);
   while (width == 0 || height == 0) {
@@ -300,11 +327,18 @@ void device::SwapChain::recreate_swap_chain(vk::SurfaceFormatKHR format,
 
   clear_swap_chain();
   create_swap_chain();
+  create_swap_image_views();
   create_depth_resources();
 }
 
+bool device::SwapChain::is_presentable() const { return surface != nullptr; }
+
 vk::ResultValue<uint32_t>
 device::SwapChain::acquire_next_image(const vk::raii::Semaphore &semaphore) {
+  // Nothing signals the semaphore, submits of this swap chain don't wait
+  if (surface == nullptr) {
+    return {vk::Result::eSuccess, 0};
+  }
   return swapChain.acquireNextImage(UINT64_MAX, *semaphore, nullptr);
 }
 
@@ -361,11 +395,13 @@ void device::SwapChain::transition_image_for_present(
     throw std::out_of_range("Image index out of range for swapchain images");
   }
 
+  // Offscreen frames end ready to be copied out instead
   vk::ImageMemoryBarrier presentBarrier{
       .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
       .dstAccessMask = vk::AccessFlagBits::eNone,
       .oldLayout = vk::ImageLayout::eColorAttachmentOptimal,
-      .newLayout = vk::ImageLayout::ePresentSrcKHR,
+      .newLayout = surface != nullptr ? vk::ImageLayout::ePresentSrcKHR
+                                      : vk::ImageLayout::eTransferSrcOptimal,
       .image = swapChainImages[imageIndex],
       .subresourceRange = {.aspectMask = vk::ImageAspectFlagBits::eColor,
                            .baseMipLevel = 0,
@@ -430,6 +466,38 @@ void device::SwapChain::end_rendering(vk::raii::CommandBuffer &commandBuffer) {
   commandBuffer.endRendering();
 }
 
+void device::SwapChain::set_present_policy(PresentPolicy policy) {
+  presentPolicy = policy;
+}
+
+device::SwapChain::PresentPolicy device::SwapChain::get_present_policy() const {
+  return presentPolicy;
+}
+
+vk::PresentModeKHR device::SwapChain::get_present_mode() const {
+  return presentMode;
+}
+
+bool device::SwapChain::supports_present_wait() const {
+  return surface != nullptr && logicalDevice->has_present_wait();
+}
+
+uint64_t device::SwapChain::next_present_id() { return ++lastPresentId; }
+
+vk::Result device::SwapChain::wait_for_present(uint64_t presentId,
+                                               uint64_t timeout) const {
+  if (!supports_present_wait() || presentId == 0 ||
+      presentId > lastPresentId) {
+    return vk::Result::eErrorOutOfDateKHR;
+  }
+
+  try {
+    return swapChain.waitForPresent(presentId, timeout);
+  } catch (const vk::SystemError &e) {
+    return static_cast<vk::Result>(e.code().value());
+  }
+}
+
 vk::SurfaceFormatKHR device::SwapChain::get_surface_format() {
   return surfaceFormat;
 }
@@ -1,21 +1,27 @@
 #include "texture.h"
 #include "tasks.h"
+#include "texture_manager.h"
+#include "trace.h"
 #include <future>
 #include <print>
 
 render::Texture::Texture(const std::vector<device::LogicalDevice *> &devices,
-                         const TextureCreateInfo &createInfo)
+                         const TextureCreateInfo &createInfo,
+                         TextureManager *textureManager)
     : identifier(createInfo.identifier), type(createInfo.type),
-      imagePath(createInfo.imagePath), atlasRegions(createInfo.atlasRegions),
-      layers(createInfo.layers), logicalDevices(devices) {
+      imagePath(createInfo.imagePath), residency(createInfo.residency),
+      atlasRegions(createInfo.atlasRegions), layers(createInfo.layers),
+      textureManager(textureManager), viewImage(createInfo.viewImage),
+      viewRegion(createInfo.viewRegion), logicalDevices(devices) {
 
   // For SINGLE and ATLAS types, create the image object
-  if (type != TextureType::LAYERED) {
+  if (type == TextureType::SINGLE || type == TextureType::ATLAS) {
     Image::ImageCreateInfo imageInfo = {
         .identifier = identifier + "_image",
         .format = vk::Format::eR8G8B8A8Srgb,
         .usage = vk::ImageUsageFlagBits::eTransferDst |
-                 vk::ImageUsageFlagBits::eSampled};
+                 vk::ImageUsageFlagBits::eSampled,
+        .residency = residency};
 
     image = std::make_unique<Image>(devices, imageInfo);
   }
@@ -24,9 +30,20 @@ render::Texture::Texture(const std::vector<device::LogicalDevice *> &devices,
     std::print("Texture - {} - created as LAYERED with {} layers\n", identifier,
                layers.size());
   }
+
+  if (type == TextureType::VIEW) {
+    std::print("Texture - {} - created as VIEW ({}x{})\n", identifier,
+               viewRegion.width, viewRegion.height);
+  }
 }
 
 render::Texture::~Texture() {
+  if (textureManager) {
+    for (Image *cached : acquiredImages) {
+      textureManager->release_image(cached);
+    }
+  }
+
   std::print("Texture - {} - destructor executed\n", identifier);
 }
 
@@ -74,6 +91,20 @@ void render::Texture::generate_atlas_regions_grid(uint32_t rows,
 
 render::Image *
 render::Texture::load_or_get_cached_image(const std::string &imagePath) {
+  // Shared cache, identical files are decoded once across all textures
+  if (textureManager) {
+    Image *cached = textureManager->acquire_image(imagePath);
+    if (!cached) {
+      std::print(stderr, "Texture - {} - failed to load image from {}\n",
+                 identifier, imagePath);
+      return nullptr;
+    }
+
+    std::lock_guard lock(textureMutex);
+    acquiredImages.push_back(cached);
+    return cached;
+  }
+
   // Check cache first (with lock)
   {
     std::lock_guard lock(textureMutex);
@@ -90,7 +121,8 @@ render::Texture::load_or_get_cached_image(const std::string &imagePath) {
       .identifier = identifier + "_" + imagePath,
       .format = vk::Format::eR8G8B8A8Srgb,
       .usage = vk::ImageUsageFlagBits::eTransferDst |
-               vk::ImageUsageFlagBits::eSampled};
+               vk::ImageUsageFlagBits::eSampled,
+      .residency = residency};
 
   auto img = std::make_unique<Image>(logicalDevices, imageInfo);
 
@@ -113,6 +145,7 @@ render::Texture::load_or_get_cached_image(const std::string &imagePath) {
 }
 
 bool render::Texture::composite_layers() {
+  TRACE_ZONE("Texture::composite_layers");
   if (layers.empty()) {
     std::print(stderr, "Texture - {} - no layers to composite\n", identifier);
     return false;
@@ -146,6 +179,10 @@ bool render::Texture::composite_layers() {
     composited[i + 3] = 255; // A (opaque)
   }
 
+  // Grey layers over the grey background stay grey, so the result can be
+  // stored as R8
+  bool greyResult = true;
+
   // Composite each visible layer
   for (size_t layerIdx = 0; layerIdx < layers.size(); ++layerIdx) {
     auto &layer = layers[layerIdx];
@@ -153,66 +190,80 @@ bool render::Texture::composite_layers() {
       continue;
     }
 
-    // Get layer pixel data
-    std::vector<unsigned char> layerPixels = layer.image->get_pixel_data();
-    uint32_t layerWidth = layer.image->get_width();
-    uint32_t layerHeight = layer.image->get_height();
-    uint32_t layerChannels = layer.image->get_channels();
-
-    // Apply rotation
-    if (layer.rotation != 0.0f) {
-      layerPixels = apply_rotation(layerPixels, layerWidth, layerHeight,
-                                   layerChannels, layer.rotation);
-      // Swap dimensions if rotated 90 or 270 degrees
-      int rot = static_cast<int>(layer.rotation) % 360;
-      if (rot < 0)
-        rot += 360;
-      rot = ((rot + 45) / 90) * 90;
-      if (rot == 90 || rot == 270) {
-        std::swap(layerWidth, layerHeight);
-      }
-    }
+    // Read under the image lock, the pixels are only copied when the layer
+    // has to be modified or isn't stored as RGBA8
+    auto layerFormat = layer.image->get_texel_format();
+    greyResult = greyResult &&
+                 (layerFormat == Image::TexelFormat::R8 ||
+                  layerFormat == Image::TexelFormat::RG8) &&
+                 layer.tint.r == layer.tint.g && layer.tint.g == layer.tint.b;
+
+    layer.image->with_rgba8_pixels(
+        [&](std::span<const unsigned char> layerPixels) {
+          uint32_t layerWidth = layer.image->get_width();
+          uint32_t layerHeight = layer.image->get_height();
+          uint32_t layerChannels = 4;
+          std::vector<unsigned char> modified;
+
+          // Apply rotation
+          if (layer.rotation != 0.0f) {
+            modified = apply_rotation(layerPixels, layerWidth, layerHeight,
+                                      layerChannels, layer.rotation);
+            layerPixels = modified;
+            // Swap dimensions if rotated 90 or 270 degrees
+            int rot = static_cast<int>(layer.rotation) % 360;
+            if (rot < 0)
+              rot += 360;
+            rot = ((rot + 45) / 90) * 90;
+            if (rot == 90 || rot == 270) {
+              std::swap(layerWidth, layerHeight);
+            }
+          }
 
-    // Apply tint
-    if (layer.tint != glm::vec4(1.0f)) {
-      layerPixels = apply_tint(layerPixels, layerChannels, layer.tint);
-    }
+          // Apply tint
+          if (layer.tint != glm::vec4(1.0f)) {
+            modified = apply_tint(layerPixels, layerChannels, layer.tint);
+            layerPixels = modified;
+          }
 
-    // Convert to RGBA if needed
-    std::vector<unsigned char> layerRGBA;
-    if (layerChannels == 4) {
-      layerRGBA = layerPixels;
-    } else if (layerChannels == 3) {
-      layerRGBA.resize(layerWidth * layerHeight * 4);
-      for (size_t i = 0; i < layerWidth * layerHeight; ++i) {
-        layerRGBA[i * 4 + 0] = layerPixels[i * 3 + 0];
-        layerRGBA[i * 4 + 1] = layerPixels[i * 3 + 1];
-        layerRGBA[i * 4 + 2] = layerPixels[i * 3 + 2];
-        layerRGBA[i * 4 + 3] = 255; // Opaque
-      }
-    }
+          // Resize layer to match composited size if needed
+          std::vector<unsigned char> resized;
+          if (!layerPixels.empty() &&
+              (layerWidth != width || layerHeight != height)) {
+            // Center the layer
+            resized.assign(width * height * 4, 0);
+            uint32_t offsetX = (width - layerWidth) / 2;
+            uint32_t offsetY = (height - layerHeight) / 2;
+
+            for (uint32_t y = 0; y < layerHeight && (y + offsetY) < height;
+                 ++y) {
+              for (uint32_t x = 0; x < layerWidth && (x + offsetX) < width;
+                   ++x) {
+                uint32_t srcIdx = (y * layerWidth + x) * 4;
+                uint32_t dstIdx = ((y + offsetY) * width + (x + offsetX)) * 4;
+                for (int c = 0; c < 4; ++c) {
+                  resized[dstIdx + c] = layerPixels[srcIdx + c];
+                }
+              }
+            }
+            layerPixels = resized;
+          }
 
-    // Resize layer to match composited size if needed
-    if (layerWidth != width || layerHeight != height) {
-      // Center the layer
-      std::vector<unsigned char> resized(width * height * 4, 0);
-      uint32_t offsetX = (width - layerWidth) / 2;
-      uint32_t offsetY = (height - layerHeight) / 2;
-
-      for (uint32_t y = 0; y < layerHeight && (y + offsetY) < height; ++y) {
-        for (uint32_t x = 0; x < layerWidth && (x + offsetX) < width; ++x) {
-          uint32_t srcIdx = (y * layerWidth + x) * 4;
-          uint32_t dstIdx = ((y + offsetY) * width + (x + offsetX)) * 4;
-          for (int c = 0; c < 4; ++c) {
-            resized[dstIdx + c] = layerRGBA[srcIdx + c];
+          // Blend this layer onto the composited image
+          if (!layerPixels.empty()) {
+            blend_layer(composited, layerPixels, width, height);
           }
-        }
+        });
+  }
+
+  // Source images are only needed again when the layers change. Images from
+  // the texture manager are shared, its residency policy decides for those
+  if (!textureManager) {
+    for (auto &layer : layers) {
+      if (layer.image) {
+        layer.image->release_cpu_pixels();
       }
-      layerRGBA = resized;
     }
-
-    // Blend this layer onto the composited image
-    blend_layer(composited, layerRGBA, width, height);
   }
 
   // Create or update composited image
@@ -221,13 +272,24 @@ bool render::Texture::composite_layers() {
         .identifier = identifier + "_composited",
         .format = vk::Format::eR8G8B8A8Srgb,
         .usage = vk::ImageUsageFlagBits::eTransferDst |
-                 vk::ImageUsageFlagBits::eSampled};
+                 vk::ImageUsageFlagBits::eSampled,
+        .residency = residency};
     compositedImage = std::make_unique<Image>(logicalDevices, imageInfo);
   }
 
-  // Load composited data into image
-  if (!compositedImage->load_from_memory(composited.data(), width, height,
-                                         channels)) {
+  // Hand the composited buffer over to the image without copying it
+  uint32_t compositedChannels = channels;
+  if (greyResult) {
+    std::vector<unsigned char> grey(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < grey.size(); ++i) {
+      grey[i] = composited[i * channels];
+    }
+    composited = std::move(grey);
+    compositedChannels = 1;
+  }
+
+  if (!compositedImage->load_from_memory(std::move(composited), width, height,
+                                         compositedChannels)) {
     std::print(stderr, "Texture - {} - failed to load composited data\n",
                identifier);
     return false;
@@ -240,7 +302,7 @@ bool render::Texture::composite_layers() {
 }
 
 std::vector<unsigned char>
-render::Texture::apply_rotation(const std::vector<unsigned char> &pixels,
+render::Texture::apply_rotation(std::span<const unsigned char> pixels,
                                 uint32_t width, uint32_t height,
                                 uint32_t channels, float rotation) {
   // Normalize rotation to 0, 90, 180, 270
@@ -252,7 +314,7 @@ render::Texture::apply_rotation(const std::vector<unsigned char> &pixels,
   rot = ((rot + 45) / 90) * 90;
 
   if (rot == 0) {
-    return pixels; // No rotation needed
+    return {pixels.begin(), pixels.end()}; // No rotation needed
   }
 
   std::vector<unsigned char> rotated;
@@ -308,9 +370,9 @@ render::Texture::apply_rotation(const std::vector<unsigned char> &pixels,
 }
 
 std::vector<unsigned char>
-render::Texture::apply_tint(const std::vector<unsigned char> &pixels,
+render::Texture::apply_tint(std::span<const unsigned char> pixels,
                             uint32_t channels, const glm::vec4 &tint) {
-  std::vector<unsigned char> tinted = pixels;
+  std::vector<unsigned char> tinted(pixels.begin(), pixels.end());
 
   for (size_t i = 0; i < tinted.size(); i += channels) {
     if (channels >= 3) {
@@ -331,7 +393,7 @@ render::Texture::apply_tint(const std::vector<unsigned char> &pixels,
 }
 
 void render::Texture::blend_layer(std::vector<unsigned char> &dst,
-                                  const std::vector<unsigned char> &src,
+                                  std::span<const unsigned char> src,
                                   uint32_t width, uint32_t height) {
   // Alpha blending: dst = src * alpha + dst * (1 - alpha)
   constexpr uint32_t channels = 4; // Assuming RGBA
@@ -359,7 +421,16 @@ void render::Texture::blend_layer(std::vector<unsigned char> &dst,
   }
 }
 
-bool render::Texture::load() {
+bool render::Texture::decode() {
+  if (type == TextureType::VIEW) {
+    // Nothing to load, the viewed image is uploaded by its owner
+    if (!viewImage) {
+      std::print(stderr, "Texture - {} - view has no image\n", identifier);
+      return false;
+    }
+    return true;
+  }
+
   if (type == TextureType::LAYERED) {
     // Load all layer images in parallel using the thread pool
     std::vector<std::future<Image *>> imageFutures;
@@ -390,25 +461,7 @@ bool render::Texture::load() {
     }
 
     // Composite layers
-    if (!composite_layers()) {
-      return false;
-    }
-
-    // Upload to GPU using async
-    if (!logicalDevices.empty() && compositedImage) {
-      auto uploadFuture = std::async(std::launch::async, [this]() {
-        return compositedImage->update_gpu_data();
-      });
-
-      if (!uploadFuture.get()) {
-        std::print(stderr, "Texture - {} - failed to upload to GPU\n",
-                   identifier);
-        return false;
-      }
-    }
-
-    std::print("Texture - {} - loaded successfully\n", identifier);
-    return true;
+    return composite_layers();
   }
 
   // SINGLE or ATLAS texture
@@ -424,14 +477,30 @@ bool render::Texture::load() {
     return false;
   }
 
+  // Regenerate atlas regions if the grid was configured before decoding
+  if (type == TextureType::ATLAS && atlasRows > 0 && atlasCols > 0) {
+    generate_atlas_regions_grid(atlasRows, atlasCols);
+  }
+
+  return true;
+}
+
+bool render::Texture::load() {
+  if (!decode()) {
+    return false;
+  }
+
+  if (type == TextureType::VIEW) {
+    return true;
+  }
+
   // Upload to GPU
-  if (!image->update_gpu_data()) {
+  if (!update_gpu()) {
     std::print(stderr, "Texture - {} - failed to upload to GPU\n", identifier);
     return false;
   }
 
-  std::print("Texture - {} - loaded successfully from {}\n", identifier,
-             imagePath);
+  std::print("Texture - {} - loaded successfully\n", identifier);
   return true;
 }
 
@@ -543,6 +612,10 @@ void render::Texture::rotate_180() {
 }
 
 bool render::Texture::update_gpu() {
+  if (type == TextureType::VIEW) {
+    return viewImage != nullptr;
+  }
+
   if (type == TextureType::LAYERED && compositedImage) {
     bool success = compositedImage->update_gpu_data();
     if (success) {
@@ -562,6 +635,11 @@ bool render::Texture::update_gpu() {
 }
 
 bool render::Texture::reload() {
+  if (type == TextureType::VIEW) {
+    // Views are never modified, so there is nothing to reset
+    return viewImage != nullptr;
+  }
+
   if (imagePath.empty()) {
     std::print(stderr, "Texture - {} - cannot reload: no image path\n",
                identifier);
@@ -608,10 +686,16 @@ render::Image *render::Texture::get_image() const {
   if (type == TextureType::LAYERED) {
     return compositedImage.get();
   }
+  if (type == TextureType::VIEW) {
+    return viewImage;
+  }
   return image.get();
 }
 
 uint32_t render::Texture::get_width() const {
+  if (type == TextureType::VIEW) {
+    return viewRegion.width;
+  }
   if (type == TextureType::LAYERED && compositedImage) {
     return compositedImage->get_width();
   }
@@ -619,8 +703,24 @@ uint32_t render::Texture::get_width() const {
 }
 
 uint32_t render::Texture::get_height() const {
+  if (type == TextureType::VIEW) {
+    return viewRegion.height;
+  }
   if (type == TextureType::LAYERED && compositedImage) {
     return compositedImage->get_height();
   }
   return image ? image->get_height() : 0;
 }
+
+bool render::Texture::is_view() const { return type == TextureType::VIEW; }
+
+const render::Texture::AtlasRegion &render::Texture::get_view_region() const {
+  return viewRegion;
+}
+
+glm::vec2 render::Texture::map_uv(const glm::vec2 &uv) const {
+  if (type != TextureType::VIEW) {
+    return uv;
+  }
+  return viewRegion.uvMin + uv * (viewRegion.uvMax - viewRegion.uvMin);
+}
@@ -1,6 +1,13 @@
 #include "texture_manager.h"
+#include "common.h"
+#include "tasks.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <future>
 #include <print>
+#include <unordered_set>
 
 render::TextureManager::TextureManager(
     const device::DeviceManager *deviceManager)
@@ -10,7 +17,24 @@ render::TextureManager::TextureManager(
 
 render::TextureManager::~TextureManager() {
   std::lock_guard lock(managerMutex);
+
+  // Workers may still be decoding streamed textures
+  {
+    std::lock_guard streamLock(streamingMutex);
+    for (auto &[id, entry] : streamingTextures) {
+      if (entry.prepared.valid()) {
+        entry.prepared.wait();
+      }
+    }
+    streamingTextures.clear();
+    streamBatches.clear();
+  }
+
   textures.clear();
+  atlasPages.clear();
+
+  std::lock_guard cacheLock(cacheMutex);
+  imageCache.clear();
   std::print("TextureManager - destroyed\n");
 }
 
@@ -26,10 +50,11 @@ render::TextureManager::create_texture(const std::string &identifier,
 
   Texture::TextureCreateInfo createInfo = {.identifier = identifier,
                                            .type = Texture::TextureType::SINGLE,
-                                           .imagePath = filepath};
+                                           .imagePath = filepath,
+                                           .residency = cpuResidency};
 
   auto devices = deviceManager->get_all_logical_devices();
-  auto texture = std::make_unique<Texture>(devices, createInfo);
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
 
   // Load the texture
   if (!texture->load()) {
@@ -54,10 +79,11 @@ render::Texture *render::TextureManager::create_layered_texture(
   Texture::TextureCreateInfo createInfo = {.identifier = identifier,
                                            .type =
                                                Texture::TextureType::LAYERED,
-                                           .layers = layers};
+                                           .layers = layers,
+                                           .residency = cpuResidency};
 
   auto devices = deviceManager->get_all_logical_devices();
-  auto texture = std::make_unique<Texture>(devices, createInfo);
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
 
   // Load all layers
   if (!texture->load()) {
@@ -86,10 +112,11 @@ render::TextureManager::create_texture_atlas(const std::string &identifier,
 
   Texture::TextureCreateInfo createInfo = {.identifier = identifier,
                                            .type = Texture::TextureType::ATLAS,
-                                           .imagePath = filepath};
+                                           .imagePath = filepath,
+                                           .residency = cpuResidency};
 
   auto devices = deviceManager->get_all_logical_devices();
-  auto texture = std::make_unique<Texture>(devices, createInfo);
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
 
   // Load the image
   if (!texture->load()) {
@@ -120,7 +147,7 @@ render::Texture *render::TextureManager::create_texture(
   }
 
   auto devices = deviceManager->get_all_logical_devices();
-  auto texture = std::make_unique<Texture>(devices, createInfo);
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
 
   // Load texture (handles all types: SINGLE, ATLAS, LAYERED)
   if (!texture->load()) {
@@ -135,12 +162,761 @@ render::Texture *render::TextureManager::create_texture(
   return ptr;
 }
 
+render::Texture *render::TextureManager::create_view_locked(
+    const std::string &identifier, Image *image,
+    const Texture::AtlasRegion &region) {
+  Texture::TextureCreateInfo createInfo = {.identifier = identifier,
+                                           .type = Texture::TextureType::VIEW,
+                                           .viewImage = image,
+                                           .viewRegion = region};
+
+  auto devices = deviceManager->get_all_logical_devices();
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
+
+  if (!texture->load()) {
+    std::print(stderr, "Failed to create texture view: {}\n", identifier);
+    return nullptr;
+  }
+
+  Texture *ptr = texture.get();
+  textures[identifier] = std::move(texture);
+  ++viewCounts[image];
+  return ptr;
+}
+
+void render::TextureManager::release_view_locked(Image *image) {
+  auto it = viewCounts.find(image);
+  if (it == viewCounts.end() || --it->second > 0) {
+    return;
+  }
+  viewCounts.erase(it);
+
+  auto page = std::ranges::find_if(atlasPages, [image](const auto &candidate) {
+    return candidate->image.get() == image;
+  });
+  if (page == atlasPages.end()) {
+    return;
+  }
+
+  // Nothing samples the page any more, its space and GPU image are reused by
+  // the next packed images instead of opening a new page
+  (*page)->packer.reset();
+  (*page)->pending.clear();
+  std::erase_if(packedContent, [image](const auto &item) {
+    return item.second.page == image;
+  });
+
+  std::print("TextureManager - atlas page {} is empty, reusing it\n",
+             std::distance(atlasPages.begin(), page));
+}
+
+render::Texture *render::TextureManager::pack_pixels_locked(
+    const std::string &identifier, const unsigned char *pixels, uint32_t width,
+    uint32_t height) {
+  auto align = [](uint32_t value) {
+    return (value + atlasPadding - 1) / atlasPadding * atlasPadding;
+  };
+
+  uint32_t paddedWidth = align(width + atlasPadding * 2);
+  uint32_t paddedHeight = align(height + atlasPadding * 2);
+
+  if (paddedWidth > atlasPageSize || paddedHeight > atlasPageSize) {
+    return nullptr;
+  }
+
+  // First fit over the existing pages
+  AtlasPage *page = nullptr;
+  std::optional<AtlasPacker::Rect> rect;
+  for (auto &candidate : atlasPages) {
+    rect = candidate->packer.pack(paddedWidth, paddedHeight);
+    if (rect) {
+      page = candidate.get();
+      break;
+    }
+  }
+
+  if (!page) {
+    Image::ImageCreateInfo imageInfo = {
+        .identifier = "atlas_page_" + std::to_string(atlasPages.size()),
+        .width = atlasPageSize,
+        .height = atlasPageSize,
+        .format = vk::Format::eR8G8B8A8Srgb,
+        .usage = vk::ImageUsageFlagBits::eTransferDst |
+                 vk::ImageUsageFlagBits::eSampled,
+        .addressMode = vk::SamplerAddressMode::eClampToEdge};
+
+    auto devices = deviceManager->get_all_logical_devices();
+    atlasPages.push_back(std::make_unique<AtlasPage>(AtlasPage{
+        .image = std::make_unique<Image>(devices, imageInfo),
+        .packer = AtlasPacker(atlasPageSize, atlasPageSize)}));
+
+    page = atlasPages.back().get();
+    rect = page->packer.pack(paddedWidth, paddedHeight);
+
+    std::print("TextureManager - created atlas page {} ({}x{})\n",
+               atlasPages.size() - 1, atlasPageSize, atlasPageSize);
+  }
+
+  // Copy the image into its rectangle, clamping source coordinates so the
+  // padding repeats the edge texels and filtering never picks up a neighbour
+  uint32_t originX = rect->x + atlasPadding;
+  uint32_t originY = rect->y + atlasPadding;
+
+  AtlasPage::PendingRect &pending = page->pending.emplace_back(
+      AtlasPage::PendingRect{.rect = *rect});
+  pending.pixels.resize(static_cast<size_t>(rect->width) * rect->height * 4);
+
+  for (uint32_t y = 0; y < rect->height; ++y) {
+    int64_t srcY = std::clamp<int64_t>(
+        static_cast<int64_t>(rect->y + y) - originY, 0,
+        static_cast<int64_t>(height) - 1);
+    for (uint32_t x = 0; x < rect->width; ++x) {
+      int64_t srcX = std::clamp<int64_t>(
+          static_cast<int64_t>(rect->x + x) - originX, 0,
+          static_cast<int64_t>(width) - 1);
+
+      size_t srcOffset = (srcY * width + srcX) * 4;
+      size_t dstOffset = (static_cast<size_t>(y) * rect->width + x) * 4;
+      std::copy_n(pixels + srcOffset, 4, pending.pixels.data() + dstOffset);
+    }
+  }
+
+  Texture::AtlasRegion region = {
+      .name = identifier,
+      .uvMin = glm::vec2(static_cast<float>(originX) / atlasPageSize,
+                         static_cast<float>(originY) / atlasPageSize),
+      .uvMax = glm::vec2(static_cast<float>(originX + width) / atlasPageSize,
+                         static_cast<float>(originY + height) / atlasPageSize),
+      .width = width,
+      .height = height};
+
+  return create_view_locked(identifier, page->image.get(), region);
+}
+
+render::Texture *
+render::TextureManager::create_packed_texture(const std::string &identifier,
+                                              const std::string &filepath) {
+  if (has_texture(identifier)) {
+    std::print("Texture with identifier '{}' already exists\n", identifier);
+    return get_texture(identifier);
+  }
+
+  // Decode outside the manager lock, only the page copy needs it
+  uint64_t contentHash = 0;
+  Image *source = acquire_image(filepath, &contentHash);
+  if (!source) {
+    std::print(stderr, "Failed to load texture from file: {}\n", filepath);
+    return nullptr;
+  }
+
+  // Identical content was packed before, share its rectangle
+  auto share_packed_locked = [&]() -> Texture * {
+    auto it = packedContent.find(contentHash);
+    if (it == packedContent.end()) {
+      return nullptr;
+    }
+    Texture::AtlasRegion region = it->second.region;
+    region.name = identifier;
+    return create_view_locked(identifier, it->second.page, region);
+  };
+
+  Texture *texture = nullptr;
+  {
+    std::lock_guard lock(managerMutex);
+    texture = share_packed_locked();
+  }
+
+  if (!texture) {
+    if (source->get_width() + atlasPadding * 2 > atlasPageSize ||
+        source->get_height() + atlasPadding * 2 > atlasPageSize) {
+      // Too large for a page, keep it as a standalone texture
+      release_image(source);
+      return create_texture(identifier, filepath);
+    }
+
+    // Atlas pages are RGBA8, narrower sources are widened on the way in
+    std::vector<unsigned char> pixels = source->get_rgba8_pixels();
+
+    // Another thread may have packed the same content while this one was
+    // converting. Looking up and recording it under one lock packs it once
+    std::lock_guard lock(managerMutex);
+    auto existing = textures.find(identifier);
+    if (existing != textures.end()) {
+      texture = existing->second.get();
+    } else if (!(texture = share_packed_locked())) {
+      texture = pack_pixels_locked(identifier, pixels.data(),
+                                   source->get_width(), source->get_height());
+      if (texture) {
+        packedContent[contentHash] = {.page = texture->get_image(),
+                                      .region = texture->get_view_region()};
+        std::print("TextureManager - packed texture: {} ({}x{})\n",
+                   identifier, source->get_width(), source->get_height());
+      }
+    }
+  }
+
+  // The page holds the pixels now
+  release_image(source);
+  return texture;
+}
+
+render::Texture *render::TextureManager::create_packed_texture(
+    const std::string &identifier, const unsigned char *pixels, uint32_t width,
+    uint32_t height) {
+  std::lock_guard lock(managerMutex);
+
+  if (textures.find(identifier) != textures.end()) {
+    std::print("Texture with identifier '{}' already exists\n", identifier);
+    return textures[identifier].get();
+  }
+
+  if (!pixels || width == 0 || height == 0) {
+    std::print(stderr, "Invalid pixel data for packed texture: {}\n",
+               identifier);
+    return nullptr;
+  }
+
+  Texture *texture = pack_pixels_locked(identifier, pixels, width, height);
+  if (texture) {
+    std::print("TextureManager - packed texture: {} ({}x{})\n", identifier,
+               width, height);
+    return texture;
+  }
+
+  // Too large for a page, fall back to a standalone texture
+  Texture::TextureCreateInfo createInfo = {
+      .identifier = identifier,
+      .type = Texture::TextureType::SINGLE,
+      .residency = cpuResidency};
+
+  auto devices = deviceManager->get_all_logical_devices();
+  auto standalone = std::make_unique<Texture>(devices, createInfo, this);
+
+  if (!standalone->get_image()->load_from_memory(pixels, width, height, 4) ||
+      !standalone->update_gpu()) {
+    std::print(stderr, "Failed to create standalone texture: {}\n",
+               identifier);
+    return nullptr;
+  }
+
+  texture = standalone.get();
+  textures[identifier] = std::move(standalone);
+  return texture;
+}
+
+render::Texture *render::TextureManager::create_texture_view(
+    const std::string &identifier, const std::string &sourceIdentifier,
+    const Texture::AtlasRegion &region) {
+  std::lock_guard lock(managerMutex);
+
+  if (textures.find(identifier) != textures.end()) {
+    std::print("Texture with identifier '{}' already exists\n", identifier);
+    return textures[identifier].get();
+  }
+
+  auto it = textures.find(sourceIdentifier);
+  if (it == textures.end() || !it->second->get_image()) {
+    std::print(stderr, "Source texture '{}' not found for view '{}'\n",
+               sourceIdentifier, identifier);
+    return nullptr;
+  }
+
+  Texture *texture =
+      create_view_locked(identifier, it->second->get_image(), region);
+  if (texture) {
+    std::print("TextureManager - created view: {} of {}\n", identifier,
+               sourceIdentifier);
+  }
+  return texture;
+}
+
+render::Texture *render::TextureManager::create_packed_region(
+    const std::string &identifier, const std::string &sourceIdentifier,
+    const Texture::AtlasRegion &region) {
+  if (has_texture(identifier)) {
+    std::print("Texture with identifier '{}' already exists\n", identifier);
+    return get_texture(identifier);
+  }
+
+  Texture *source = get_texture(sourceIdentifier);
+  if (!source || source->is_view() || !source->get_image()) {
+    std::print(stderr, "Source texture '{}' not found for region '{}'\n",
+               sourceIdentifier, identifier);
+    return nullptr;
+  }
+
+  Image *image = source->get_image();
+  auto x = static_cast<uint32_t>(
+      std::lround(region.uvMin.x * static_cast<float>(image->get_width())));
+  auto y = static_cast<uint32_t>(
+      std::lround(region.uvMin.y * static_cast<float>(image->get_height())));
+
+  std::vector<unsigned char> pixels =
+      image->get_rgba8_pixels(x, y, region.width, region.height);
+  if (pixels.empty()) {
+    std::print(stderr, "Region '{}' is outside of texture '{}'\n", identifier,
+               sourceIdentifier);
+    return nullptr;
+  }
+
+  return create_packed_texture(identifier, pixels.data(), region.width,
+                               region.height);
+}
+
+render::Image *
+render::TextureManager::acquire_image(const std::string &filepath,
+                                      uint64_t *contentHash) {
+  std::vector<char> fileData;
+  if (!general::Common::readFile(filepath, fileData)) {
+    return nullptr;
+  }
+
+  // FNV-1a over the encoded bytes, far cheaper than decoding them
+  uint64_t hash = 14695981039346656037ull;
+  for (char byte : fileData) {
+    hash ^= static_cast<unsigned char>(byte);
+    hash *= 1099511628211ull;
+  }
+
+  if (contentHash) {
+    *contentHash = hash;
+  }
+
+  {
+    std::lock_guard lock(cacheMutex);
+
+    auto previous = pathHashes.find(filepath);
+    if (previous != pathHashes.end() && previous->second != hash) {
+      std::print("TextureManager - {} changed on disk\n", filepath);
+    }
+    pathHashes[filepath] = hash;
+
+    auto it = imageCache.find(hash);
+    if (it != imageCache.end()) {
+      it->second.refCount++;
+      std::print("TextureManager - using cached image for {} (refs: {})\n",
+                 filepath, it->second.refCount);
+      return it->second.image.get();
+    }
+  }
+
+  // Decode without holding the lock so different files decode in parallel
+  Image::ImageCreateInfo imageInfo = {.identifier = filepath,
+                                      .residency = cpuResidency};
+  auto image = std::make_unique<Image>(deviceManager->get_all_logical_devices(),
+                                       imageInfo);
+
+  if (!image->load_from_encoded(
+          reinterpret_cast<const unsigned char *>(fileData.data()),
+          fileData.size(), filepath)) {
+    return nullptr;
+  }
+
+  std::lock_guard lock(cacheMutex);
+
+  // Another thread may have decoded the same content meanwhile
+  auto [it, inserted] = imageCache.try_emplace(hash);
+  if (inserted) {
+    it->second.image = std::move(image);
+  }
+  it->second.refCount++;
+
+  std::print("TextureManager - cached image {} ({} cached)\n", filepath,
+             imageCache.size());
+  return it->second.image.get();
+}
+
+void render::TextureManager::release_image(Image *image) {
+  if (!image) {
+    return;
+  }
+
+  std::lock_guard lock(cacheMutex);
+
+  for (auto it = imageCache.begin(); it != imageCache.end(); ++it) {
+    if (it->second.image.get() != image) {
+      continue;
+    }
+
+    if (--it->second.refCount == 0) {
+      std::print("TextureManager - released cached image {}\n",
+                 image->get_identifier());
+      imageCache.erase(it);
+    }
+    return;
+  }
+}
+
+void render::TextureManager::set_cpu_residency(Image::Residency residency) {
+  cpuResidency = residency;
+}
+
+size_t render::TextureManager::get_cached_image_count() const {
+  std::lock_guard lock(cacheMutex);
+  return imageCache.size();
+}
+
+bool render::TextureManager::flush_atlas_pages() {
+  std::lock_guard lock(managerMutex);
+
+  bool success = true;
+  for (size_t i = 0; i < atlasPages.size(); ++i) {
+    auto &page = atlasPages[i];
+    if (page->pending.empty()) {
+      continue;
+    }
+
+    if (page->uploaded) {
+      // Live page, write the new rectangles in place
+      for (const auto &pending : page->pending) {
+        if (!page->image->update_gpu_region(
+                pending.pixels.data(), pending.rect.x, pending.rect.y,
+                pending.rect.width, pending.rect.height)) {
+          success = false;
+        }
+      }
+    } else {
+      // First upload, assemble the whole page once
+      std::vector<unsigned char> pixels(
+          static_cast<size_t>(atlasPageSize) * atlasPageSize * 4, 0);
+      for (const auto &pending : page->pending) {
+        const size_t rowSize = static_cast<size_t>(pending.rect.width) * 4;
+        for (uint32_t y = 0; y < pending.rect.height; ++y) {
+          std::copy_n(pending.pixels.data() + y * rowSize, rowSize,
+                      pixels.data() +
+                          ((static_cast<size_t>(pending.rect.y) + y) *
+                               atlasPageSize +
+                           pending.rect.x) *
+                              4);
+        }
+      }
+
+      if (!page->image->load_from_memory(std::move(pixels), atlasPageSize,
+                                         atlasPageSize, 4) ||
+          !page->image->update_gpu_data()) {
+        std::print(stderr,
+                   "TextureManager - failed to upload atlas page {}\n", i);
+        success = false;
+        continue;
+      }
+      page->uploaded = true;
+    }
+
+    std::print("TextureManager - uploaded {} images to atlas page {} ({:.1f}% "
+               "used)\n",
+               page->pending.size(), i, page->packer.get_occupancy() * 100.0f);
+    page->pending.clear();
+  }
+
+  return success;
+}
+
+size_t render::TextureManager::get_atlas_page_count() const {
+  std::lock_guard lock(managerMutex);
+  return atlasPages.size();
+}
+
+std::vector<render::Texture *> render::TextureManager::create_textures(
+    const std::vector<TextureRequest> &requests) {
+  std::vector<Texture *> result(requests.size(), nullptr);
+
+  struct PendingTexture {
+    size_t requestIndex;
+    std::unique_ptr<Texture> texture;
+    std::future<bool> decoded;
+  };
+  std::vector<PendingTexture> pending;
+  std::vector<std::future<Texture *>> packed(requests.size());
+
+  auto devices = deviceManager->get_all_logical_devices();
+  std::unordered_set<std::string> requested;
+
+  // Decode everything on worker threads
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const auto &request = requests[i];
+
+    if (Texture *existing = get_texture(request.identifier)) {
+      result[i] = existing;
+      continue;
+    }
+
+    if (!requested.insert(request.identifier).second) {
+      std::print("Texture '{}' requested twice in one batch\n",
+                 request.identifier);
+      continue;
+    }
+
+    if (request.streamed) {
+      result[i] = stream_texture(request.identifier, request.imagePath);
+      continue;
+    }
+
+    if (request.packed) {
+      packed[i] = device::Tasks::get_instance().add_task(
+          [this, &request]() -> Texture * {
+            return create_packed_texture(request.identifier,
+                                         request.imagePath);
+          });
+      continue;
+    }
+
+    Texture::TextureCreateInfo createInfo = {.identifier = request.identifier,
+                                             .type = request.type,
+                                             .imagePath = request.imagePath,
+                                             .layers = request.layers,
+                                             .residency = cpuResidency};
+
+    auto texture = std::make_unique<Texture>(devices, createInfo, this);
+    Texture *texturePtr = texture.get();
+
+    // Layered textures fan out their layers over the pool themselves, so they
+    // are decoded on this thread below instead of blocking a worker
+    std::future<bool> decoded;
+    if (request.type != Texture::TextureType::LAYERED) {
+      decoded = device::Tasks::get_instance().add_task(
+          [texturePtr]() { return texturePtr->decode(); });
+    }
+    pending.push_back({i, std::move(texture), std::move(decoded)});
+  }
+
+  // Wait once for the whole set, then upload the images together
+  std::vector<Image *> uploads;
+  for (auto &entry : pending) {
+    bool decoded = entry.decoded.valid() ? entry.decoded.get()
+                                         : entry.texture->decode();
+    if (!decoded) {
+      std::print(stderr, "Failed to decode texture: {}\n",
+                 requests[entry.requestIndex].identifier);
+      entry.texture.reset();
+      continue;
+    }
+    uploads.push_back(entry.texture->get_image());
+  }
+
+  if (!Image::update_gpu_data_batch(uploads)) {
+    std::print(stderr, "TextureManager - texture batch upload incomplete\n");
+  }
+
+  {
+    std::lock_guard lock(managerMutex);
+    for (auto &entry : pending) {
+      if (!entry.texture) {
+        continue;
+      }
+
+      const auto &request = requests[entry.requestIndex];
+      if (request.type == Texture::TextureType::ATLAS) {
+        entry.texture->generate_grid_atlas(request.atlasRows,
+                                           request.atlasCols);
+      }
+
+      result[entry.requestIndex] = entry.texture.get();
+      textures[request.identifier] = std::move(entry.texture);
+    }
+  }
+
+  for (size_t i = 0; i < packed.size(); ++i) {
+    if (packed[i].valid()) {
+      result[i] = packed[i].get();
+    }
+  }
+  flush_atlas_pages();
+
+  std::print("TextureManager - created batch of {} textures ({} uploaded)\n",
+             requests.size(), uploads.size());
+  return result;
+}
+
+render::Texture *
+render::TextureManager::stream_texture(const std::string &identifier,
+                                       const std::string &filepath) {
+  std::lock_guard lock(managerMutex);
+
+  if (textures.find(identifier) != textures.end()) {
+    std::print("Texture with identifier '{}' already exists\n", identifier);
+    return textures[identifier].get();
+  }
+
+  Texture::TextureCreateInfo createInfo = {.identifier = identifier,
+                                           .type = Texture::TextureType::SINGLE,
+                                           .imagePath = filepath,
+                                           .residency = cpuResidency};
+
+  auto devices = deviceManager->get_all_logical_devices();
+  auto texture = std::make_unique<Texture>(devices, createInfo, this);
+  Texture *texturePtr = texture.get();
+
+  // A single grey texel lets objects bind the texture before its first mip
+  // is decoded
+  const unsigned char placeholder[] = {128, 128, 128, 255};
+  Image *image = texturePtr->get_image();
+  if (!image->load_from_memory(placeholder, 1, 1, 4) ||
+      !image->update_gpu_data()) {
+    std::print(stderr, "Failed to create placeholder for texture: {}\n",
+               identifier);
+    return nullptr;
+  }
+
+  textures[identifier] = std::move(texture);
+
+  std::lock_guard streamLock(streamingMutex);
+  streamingTextures[identifier] = {
+      .texture = texturePtr,
+      .prepared = device::Tasks::get_instance().add_task([texturePtr]() {
+        return texturePtr->decode() &&
+               texturePtr->get_image()->prepare_streaming();
+      })};
+
+  std::print("TextureManager - streaming texture: {} from {}\n", identifier,
+             filepath);
+  return texturePtr;
+}
+
+void render::TextureManager::set_stream_priority(const std::string &identifier,
+                                                 float priority) {
+  std::lock_guard lock(streamingMutex);
+
+  auto it = streamingTextures.find(identifier);
+  if (it != streamingTextures.end()) {
+    it->second.priority = priority;
+  }
+}
+
+void render::TextureManager::set_upload_budget(uint64_t bytesPerFrame) {
+  std::lock_guard lock(streamingMutex);
+  uploadBudget = bytesPerFrame;
+}
+
+uint64_t render::TextureManager::process_streaming() {
+  std::lock_guard lock(streamingMutex);
+
+  // Staging memory of finished batches is freed here
+  std::erase_if(streamBatches, [](const auto &batch) {
+    return batch->is_complete() || batch->has_failed();
+  });
+
+  if (streamingTextures.empty()) {
+    return 0;
+  }
+
+  auto batch =
+      std::make_shared<StreamBatch>(deviceManager->get_all_logical_devices());
+
+  // Apply the copies the GPU finished and start the textures whose mip chain
+  // is ready, their smallest level replaces the placeholder once copied
+  std::vector<StreamingTexture *> active;
+  for (auto it = streamingTextures.begin(); it != streamingTextures.end();) {
+    auto &entry = it->second;
+    Image *image = entry.texture->get_image();
+
+    if (!entry.started) {
+      if (entry.prepared.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        ++it;
+        continue;
+      }
+
+      if (!entry.prepared.get() || !image->begin_streaming(batch)) {
+        std::print(stderr, "TextureManager - failed to stream texture: {}\n",
+                   it->first);
+        it = streamingTextures.erase(it);
+        continue;
+      }
+      entry.started = true;
+    } else if (!image->update_streaming()) {
+      std::print(stderr, "TextureManager - failed to stream texture: {}\n",
+                 it->first);
+      it = streamingTextures.erase(it);
+      continue;
+    }
+
+    active.push_back(&entry);
+    ++it;
+  }
+
+  std::ranges::stable_sort(active, [](const auto *a, const auto *b) {
+    return a->priority > b->priority;
+  });
+
+  // Refine the most important textures first. At least one mip goes into
+  // the batch per frame, even when it is larger than the whole budget
+  uint64_t uploaded = 0;
+  for (auto *entry : active) {
+    Image *image = entry->texture->get_image();
+
+    for (uint64_t nextSize = image->get_next_mip_size(); nextSize > 0;
+         nextSize = image->get_next_mip_size()) {
+      if (uploaded > 0 && uploaded + nextSize > uploadBudget) {
+        break;
+      }
+
+      uint64_t sent = image->stream_next_mip(batch);
+      if (sent == 0) {
+        break;
+      }
+      uploaded += sent;
+    }
+
+    if (uploaded >= uploadBudget) {
+      break;
+    }
+  }
+
+  // One submit per device for the whole frame, nothing waits on it
+  batch->submit();
+  if (batch->is_submitted()) {
+    streamBatches.push_back(std::move(batch));
+  }
+
+  std::erase_if(streamingTextures, [](const auto &item) {
+    const auto &entry = item.second;
+    if (!entry.started || !entry.texture->get_image()->is_fully_resident()) {
+      return false;
+    }
+    std::print("TextureManager - texture fully resident: {}\n", item.first);
+    return true;
+  });
+
+  return uploaded;
+}
+
+size_t render::TextureManager::get_streaming_count() const {
+  std::lock_guard lock(streamingMutex);
+  return streamingTextures.size();
+}
+
 void render::TextureManager::remove_texture(const std::string &identifier) {
   std::lock_guard lock(managerMutex);
 
   auto it = textures.find(identifier);
+  if (it != textures.end() && !it->second->is_view()) {
+    // Views hold the image without owning it
+    auto views = viewCounts.find(it->second->get_image());
+    if (views != viewCounts.end()) {
+      std::print(stderr,
+                 "TextureManager - can't remove texture {}, {} views use it\n",
+                 identifier, views->second);
+      return;
+    }
+  }
+
+  {
+    std::lock_guard streamLock(streamingMutex);
+    auto streamIt = streamingTextures.find(identifier);
+    if (streamIt != streamingTextures.end()) {
+      if (streamIt->second.prepared.valid()) {
+        streamIt->second.prepared.wait();
+      }
+      streamingTextures.erase(streamIt);
+    }
+  }
+
   if (it != textures.end()) {
+    Image *viewed = it->second->is_view() ? it->second->get_image() : nullptr;
     textures.erase(it);
+    if (viewed) {
+      release_view_locked(viewed);
+    }
     std::print("TextureManager - removed texture: {}\n", identifier);
   }
 }
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "buffer_manager.h"
+#include "device_manager.h"
+#include "material_manager.h"
+#include "object_manager.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Options {
+  double minSeconds = 0.5;     // Measured time per case, after one warmup call
+  uint32_t minIterations = 10; // Measured calls per case, however long
+  std::vector<std::string> filters; // Name substrings, empty for all cases
+  std::string output = "microbench.json";
+};
+
+// Nanoseconds per call of one case
+struct CaseResult {
+  std::string name;
+  uint64_t items; // Work of one call: pixels, objects, lookups or tasks
+  size_t iterations;
+  double mean;
+  double min;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+};
+
+// Times the CPU-side hot paths in isolation at realistic sizes and writes
+// the results as JSON. Needs no GPU: the managers sit on a device manager
+// that never enumerates devices, so buffers, materials and objects only
+// carry their CPU state
+class Microbench {
+private:
+  Options options;
+
+  vk::raii::Instance instance;
+  vk::raii::SurfaceKHR surface;
+  std::unique_ptr<device::DeviceManager> deviceManager;
+  std::unique_ptr<device::BufferManager> bufferManager;
+  std::unique_ptr<render::MaterialManager> materialManager;
+  std::unique_ptr<render::ObjectManager> objectManager;
+
+  std::vector<render::Object *> objects;
+  std::vector<CaseResult> results;
+
+  bool selected(const std::string &name) const;
+  // Calls op until both minSeconds and minIterations are reached
+  void measure(const std::string &name, uint64_t items,
+               const std::function<void()> &op);
+
+  // Creates the objects shared by the object and buffer cases once
+  void populate_objects();
+
+  void bench_blend_layer(uint32_t size);
+  void bench_composite_layers(uint32_t size, uint32_t layerCount);
+  void bench_color_tint(uint32_t size, bool parallel);
+  void bench_rotate_image(uint32_t size);
+  void bench_update_model_matrix();
+  void bench_render_queue();
+  void bench_buffer_lookup(uint32_t threadCount);
+  void bench_add_task(uint32_t taskCount);
+
+  std::string to_json() const;
+
+public:
+  explicit Microbench(Options options);
+  ~Microbench();
+
+  // False if no case matched the filters or the report can't be written
+  bool run();
+};
+
+} // namespace bench
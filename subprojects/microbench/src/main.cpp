@@ -0,0 +1,67 @@
+#include "microbench.h"
+#include <cstdint>
+#include <exception>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void print_usage() {
+  std::print(stderr,
+             "Usage: microbench [--min-time SECONDS] [--min-iterations N]"
+             " [--filter TEXT]... [--output FILE]\n"
+             "Times the CPU hot paths without a GPU, or only the cases whose"
+             " name contains\na filter, and writes nanoseconds per call as "
+             "JSON (default microbench.json)\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bench::Options options;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg == "--help" || arg == "-h") {
+        print_usage();
+        return 0;
+      }
+      if (i + 1 >= argc) {
+        throw std::invalid_argument("missing value for " + std::string(arg));
+      }
+      std::string value = argv[++i];
+
+      if (arg == "--min-time") {
+        options.minSeconds = std::stod(value);
+      } else if (arg == "--min-iterations") {
+        options.minIterations = static_cast<uint32_t>(std::stoul(value));
+      } else if (arg == "--filter") {
+        options.filters.push_back(value);
+      } else if (arg == "--output") {
+        options.output = value;
+      } else {
+        throw std::invalid_argument("unknown option " + std::string(arg));
+      }
+    }
+  } catch (const std::exception &e) {
+    std::print(stderr, "Microbench - {}\n", e.what());
+    print_usage();
+    return 1;
+  }
+
+  if (options.minIterations == 0) {
+    std::print(stderr, "Microbench - min-iterations must not be 0\n");
+    return 1;
+  }
+
+  try {
+    bench::Microbench runner(options);
+    return runner.run() ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::print(stderr, "Microbench - {}\n", e.what());
+    return 1;
+  }
+}
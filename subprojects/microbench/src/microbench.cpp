@@ -0,0 +1,397 @@
+#include "microbench.h"
+#include "image.h"
+#include "object.h"
+#include "tasks.h"
+#include "texture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <future>
+#include <latch>
+#include <memory>
+#include <numeric>
+#include <print>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// A busy scene, and enough materials that the sort has groups to form
+constexpr size_t objectCount = 10000;
+constexpr size_t materialCount = 32;
+
+// Large enough that starting the threads stays a small part of a call
+constexpr uint32_t lookupsPerThread = 16384;
+
+std::vector<unsigned char> random_pixels(uint32_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> distribution(0, 255);
+  std::vector<unsigned char> pixels(static_cast<size_t>(size) * size * 4);
+  for (auto &value : pixels) {
+    value = static_cast<unsigned char>(distribution(rng));
+  }
+  return pixels;
+}
+
+// RGBA8 CPU-only image filled with noise, alpha included
+std::unique_ptr<render::Image> random_image(const std::string &identifier,
+                                            uint32_t size, uint32_t seed) {
+  auto image = std::make_unique<render::Image>(
+      std::vector<device::LogicalDevice *>{},
+      render::Image::ImageCreateInfo{
+          .identifier = identifier,
+          .texelFormat = render::Image::TexelFormat::RGBA8});
+  image->load_from_memory(random_pixels(size, seed), size, size, 4);
+  return image;
+}
+
+} // namespace
+
+bench::Microbench::Microbench(Options options)
+    : options(std::move(options)), instance(nullptr), surface(nullptr),
+      deviceManager(std::make_unique<device::DeviceManager>(nullptr, instance,
+                                                            surface)),
+      bufferManager(
+          std::make_unique<device::BufferManager>(deviceManager.get())),
+      materialManager(
+          std::make_unique<render::MaterialManager>(deviceManager.get())),
+      objectManager(std::make_unique<render::ObjectManager>(
+          deviceManager.get(), materialManager.get(), bufferManager.get(),
+          nullptr)) {}
+
+bench::Microbench::~Microbench() = default;
+
+bool bench::Microbench::selected(const std::string &name) const {
+  if (options.filters.empty()) {
+    return true;
+  }
+  return std::ranges::any_of(options.filters, [&name](const auto &filter) {
+    return name.find(filter) != std::string::npos;
+  });
+}
+
+void bench::Microbench::measure(const std::string &name, uint64_t items,
+                                const std::function<void()> &op) {
+  // Faults in pages and lazily created state, such as the Tasks pool
+  op();
+
+  std::vector<double> samples;
+  const auto deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(options.minSeconds));
+  while (samples.size() < options.minIterations || Clock::now() < deadline) {
+    auto start = Clock::now();
+    op();
+    samples.push_back(
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count());
+  }
+  std::ranges::sort(samples);
+
+  // Nearest-rank percentiles
+  auto percentile = [&samples](double p) {
+    const auto rank = static_cast<size_t>(
+        std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+  };
+
+  CaseResult result{.name = name,
+                    .items = items,
+                    .iterations = samples.size(),
+                    .mean = std::accumulate(samples.begin(), samples.end(),
+                                            0.0) /
+                            static_cast<double>(samples.size()),
+                    .min = samples.front(),
+                    .p50 = percentile(50.0),
+                    .p95 = percentile(95.0),
+                    .p99 = percentile(99.0),
+                    .max = samples.back()};
+
+  std::print("Microbench - {} - p50 {:.0f} ns, p99 {:.0f} ns, {:.2f} ns per "
+             "item over {} calls\n",
+             name, result.p50, result.p99,
+             result.p50 / static_cast<double>(items), result.iterations);
+  results.push_back(std::move(result));
+}
+
+void bench::Microbench::populate_objects() {
+  if (!objects.empty()) {
+    return;
+  }
+
+  for (size_t i = 0; i < materialCount; ++i) {
+    materialManager->add_material(
+        {.identifier = std::format("microbench_material_{}", i)});
+  }
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+  objects.reserve(objectCount);
+
+  for (size_t i = 0; i < objectCount; ++i) {
+    render::Object::ObjectCreateInfo createInfo{
+        .identifier = std::format("microbench_object_{}", i),
+        .type = render::Object::ObjectType::OBJECT_3D,
+        .vertices = std::vector<render::Object::Vertex3D>{
+            {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+            {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+            {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+            {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}}},
+        .indices = {0, 1, 2, 2, 3, 0},
+        .materialIdentifier =
+            std::format("microbench_material_{}", i % materialCount),
+        .position = {distribution(rng), distribution(rng), distribution(rng)},
+        .rotation = {distribution(rng), distribution(rng), distribution(rng)}};
+
+    // Inserted directly, create_object rebuilds the queue on every call
+    auto object = std::make_unique<render::Object>(
+        createInfo, bufferManager.get(), materialManager.get());
+    objects.push_back(object.get());
+    objectManager->objects.emplace(createInfo.identifier, std::move(object));
+  }
+  objectManager->rebuild_render_queue();
+}
+
+void bench::Microbench::bench_blend_layer(uint32_t size) {
+  const std::string name = std::format("texture.blend_layer/{}", size);
+  if (!selected(name)) {
+    return;
+  }
+
+  render::Texture texture({}, {.identifier = "microbench_blend",
+                               .type = render::Texture::TextureType::LAYERED});
+  std::vector<unsigned char> dst = random_pixels(size, 1);
+  const std::vector<unsigned char> src = random_pixels(size, 2);
+
+  measure(name, static_cast<uint64_t>(size) * size,
+          [&]() { texture.blend_layer(dst, src, size, size); });
+}
+
+void bench::Microbench::bench_composite_layers(uint32_t size,
+                                               uint32_t layerCount) {
+  const std::string name =
+      std::format("texture.composite_layers/{}x{}", layerCount, size);
+  if (!selected(name)) {
+    return;
+  }
+
+  // Every other layer is tinted and every third rotated, as in the
+  // layered scene, so the copying paths are part of the measurement
+  std::vector<std::unique_ptr<render::Image>> images;
+  std::vector<render::Texture::Layer> layers;
+  for (uint32_t i = 0; i < layerCount; ++i) {
+    images.push_back(
+        random_image(std::format("microbench_layer_{}", i), size, i + 1));
+    render::Texture::Layer layer;
+    layer.image = images.back().get();
+    if (i % 2 == 1) {
+      layer.tint = glm::vec4(0.8f, 0.6f, 1.0f, 1.0f);
+    }
+    if (i % 3 == 2) {
+      layer.rotation = 90.0f;
+    }
+    layers.push_back(layer);
+  }
+
+  render::Texture texture({}, {.identifier = "microbench_composite",
+                               .type = render::Texture::TextureType::LAYERED,
+                               .layers = layers});
+
+  measure(name, static_cast<uint64_t>(size) * size * layerCount,
+          [&]() { texture.composite_layers(); });
+}
+
+void bench::Microbench::bench_color_tint(uint32_t size, bool parallel) {
+  const std::string name = std::format("image.apply_color_tint.{}/{}",
+                                       parallel ? "tasks" : "serial", size);
+  if (!selected(name)) {
+    return;
+  }
+
+  auto image = random_image("microbench_tint", size, 3);
+  // Channels keep their value, repeated calls do the same work
+  const glm::vec4 tint(1.0f);
+
+  measure(name, static_cast<uint64_t>(size) * size,
+          [&]() { image->apply_color_tint(tint, parallel); });
+}
+
+void bench::Microbench::bench_rotate_image(uint32_t size) {
+  const std::string name = std::format("image.rotate_image_90/{}", size);
+  if (!selected(name)) {
+    return;
+  }
+
+  auto image = random_image("microbench_rotate", size, 4);
+
+  measure(name, static_cast<uint64_t>(size) * size,
+          [&]() { image->rotate_image_90(true); });
+}
+
+void bench::Microbench::bench_update_model_matrix() {
+  const std::string name =
+      std::format("object.update_model_matrix/{}", objectCount);
+  if (!selected(name)) {
+    return;
+  }
+
+  populate_objects();
+
+  measure(name, objects.size(), [&]() {
+    for (auto *object : objects) {
+      object->update_model_matrix();
+    }
+  });
+}
+
+void bench::Microbench::bench_render_queue() {
+  const std::string rebuildName =
+      std::format("object_manager.rebuild_render_queue/{}", objectCount);
+  if (selected(rebuildName)) {
+    populate_objects();
+    measure(rebuildName, objects.size(),
+            [&]() { objectManager->rebuild_render_queue(); });
+  }
+
+  const std::string sortName = std::format(
+      "object_manager.sort_render_queue_by_material/{}", objectCount);
+  if (selected(sortName)) {
+    populate_objects();
+
+    // Restoring the unsorted order is a copy, cheap next to the sort
+    std::vector<render::Object *> shuffled = objects;
+    std::ranges::shuffle(shuffled, std::mt19937(11));
+
+    measure(sortName, shuffled.size(), [&]() {
+      objectManager->renderQueue = shuffled;
+      objectManager->sort_render_queue_by_material();
+    });
+  }
+}
+
+void bench::Microbench::bench_buffer_lookup(uint32_t threadCount) {
+  const std::string name =
+      std::format("buffer_manager.get_buffer/{}threads", threadCount);
+  if (!selected(name)) {
+    return;
+  }
+
+  populate_objects();
+
+  std::vector<std::string> names;
+  names.reserve(objects.size() * 2);
+  for (auto *object : objects) {
+    names.push_back(object->vertexBufferName);
+    names.push_back(object->indexBufferName);
+  }
+  std::ranges::shuffle(names, std::mt19937(13));
+
+  // Every thread walks the names from its own offset, released together so
+  // they contend for the manager lock
+  measure(name, static_cast<uint64_t>(threadCount) * lookupsPerThread, [&]() {
+    std::latch start(threadCount);
+    std::vector<std::jthread> threads;
+    threads.reserve(threadCount);
+    for (uint32_t t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&, t]() {
+        start.arrive_and_wait();
+        size_t index = t * (names.size() / threadCount);
+        for (uint32_t i = 0; i < lookupsPerThread; ++i) {
+          if (!bufferManager->get_buffer(names[index])) {
+            std::print(stderr, "Microbench - {} - lookup missed\n",
+                       names[index]);
+          }
+          index = index + 1 == names.size() ? 0 : index + 1;
+        }
+      });
+    }
+  });
+}
+
+void bench::Microbench::bench_add_task(uint32_t taskCount) {
+  const std::string name = std::format("tasks.add_task/{}", taskCount);
+  if (!selected(name)) {
+    return;
+  }
+
+  // Submission and completion of empty jobs, the floor every task pays
+  std::vector<std::future<void>> futures;
+  futures.reserve(taskCount);
+  measure(name, taskCount, [&]() {
+    for (uint32_t i = 0; i < taskCount; ++i) {
+      futures.push_back(device::Tasks::get_instance().add_task([]() {}));
+    }
+    for (auto &future : futures) {
+      future.get();
+    }
+    futures.clear();
+  });
+}
+
+std::string bench::Microbench::to_json() const {
+  std::string json = std::format(
+      "{{\n  \"hardwareThreads\": {},\n  \"minSeconds\": {},\n"
+      "  \"minIterations\": {},\n  \"cases\": [",
+      std::thread::hardware_concurrency(), options.minSeconds,
+      options.minIterations);
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const CaseResult &result = results[i];
+    json += std::format(
+        "{}\n    {{\"name\": \"{}\", \"items\": {}, \"iterations\": {},\n"
+        "     \"ns\": {{\"mean\": {:.1f}, \"min\": {:.1f}, \"p50\": {:.1f}, "
+        "\"p95\": {:.1f}, \"p99\": {:.1f}, \"max\": {:.1f}}},\n"
+        "     \"nsPerItem\": {:.4f}}}",
+        i == 0 ? "" : ",", result.name, result.items, result.iterations,
+        result.mean, result.min, result.p50, result.p95, result.p99,
+        result.max, result.p50 / static_cast<double>(result.items));
+  }
+  json += "\n  ]\n}\n";
+  return json;
+}
+
+bool bench::Microbench::run() {
+  bench_blend_layer(1024);
+  bench_composite_layers(1024, 4);
+  for (uint32_t size : {512u, 2048u}) {
+    bench_color_tint(size, false);
+    bench_color_tint(size, true);
+  }
+  bench_rotate_image(2048);
+  bench_update_model_matrix();
+  bench_render_queue();
+  bench_buffer_lookup(1);
+  bench_buffer_lookup(std::max(2u, std::thread::hardware_concurrency()));
+  bench_add_task(1);
+  bench_add_task(1024);
+
+  if (results.empty()) {
+    std::print(stderr, "Microbench - no case matched the filters\n");
+    return false;
+  }
+
+  std::ofstream file(options.output);
+  if (!file.is_open()) {
+    std::print(stderr, "Microbench - {} - can't open file for writing\n",
+               options.output);
+    return false;
+  }
+  file << to_json();
+  if (!file.good()) {
+    std::print(stderr, "Microbench - {} - failed writing the report\n",
+               options.output);
+    return false;
+  }
+
+  std::print("Microbench - wrote {} cases to {}\n", results.size(),
+             options.output);
+  return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "renderer.h"
+#include "scene.h"
+#include "stress_scene.h"
+#include <memory>
+#include <vector>
+
+namespace scene {
+
+// Every scene in switching order, created on the renderer's managers but
+// not set up yet. The stress scene comes last
+std::vector<std::unique_ptr<render::Scene>>
+create_scenes(render::Renderer &renderer,
+              const StressConfig &stressConfig = {});
+
+} // namespace scene
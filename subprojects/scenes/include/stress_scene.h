@@ -0,0 +1,56 @@
+#pragma once
+
+#include "scene.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace scene {
+
+struct StressConfig {
+  uint32_t objectCount = 10000;  // 1k to 1M
+  uint32_t materialCount = 8;    // For each vertex layout in use
+  uint32_t textureCount = 4;     // 0 draws with vertex colours only
+  float dynamicFraction = 0.25f; // Objects animated on every update
+  // Relative weights of the object kinds, they don't need to sum to 1
+  float weight2D = 0.4f;      // Quads
+  float weight3D = 0.4f;      // Cubes
+  float weightSubmesh = 0.2f; // Cubes drawn with two materials
+};
+
+// Synthetic scene for scaling tests: objects on a grid filling the screen,
+// spread over the materials and textures at random with a fixed seed, so
+// runs with the same config build the same scene. Static objects are never
+// touched after setup, which separates the update cost from the cost of
+// just having objects. Setup prints how long each stage took
+class StressScene : public render::Scene {
+private:
+  struct DynamicObject {
+    render::Object *object;
+    float phase;
+    bool is2D;
+  };
+
+  StressConfig config;
+  std::vector<DynamicObject> dynamicObjects;
+
+  void create_materials(bool use2D, bool use3D);
+  void create_textures();
+  void create_objects();
+
+public:
+  StressScene(render::MaterialManager *matMgr, render::TextureManager *texMgr,
+              device::BufferManager *bufMgr, render::ObjectManager *objMgr,
+              const StressConfig &config = {});
+
+  void setup() override;
+  void cleanup() override;
+  void update(float deltaTime, float totalTime) override;
+  std::string get_name() const override;
+
+  // A new config takes effect on the next setup
+  const StressConfig &get_config() const;
+  void set_config(const StressConfig &config);
+};
+
+} // namespace scene
@@ -12,8 +12,9 @@ void scene::Scene1::setup() {
   std::print("Setting up Scene 1: Basic Shapes\n");
 
   // Create basic materials
-  create_basic_material(render::MaterialId::SIMPLE_SHADERS_2D, true, false);
-  create_basic_material(render::MaterialId::SIMPLE_SHADERS, false, false);
+  request_basic_material(render::MaterialId::SIMPLE_SHADERS_2D, true, false);
+  request_basic_material(render::MaterialId::SIMPLE_SHADERS, false, false);
+  load_materials();
 
   // Create a triangle in the center-left (with RGB colors)
   triangle = create_triangle_2d(
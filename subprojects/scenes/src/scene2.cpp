@@ -13,11 +13,12 @@ void scene::Scene2::setup() {
   std::print("Setting up Scene 2: Textured Objects\n");
 
   // Create textures
-  create_texture(render::TextureId::CHECKERBOARD,
-                 "assets/textures/checkerboard.png");
-  create_texture(render::TextureId::GRADIENT, "assets/textures/gradient.png");
-  create_texture_atlas(render::TextureId::ATLAS, "assets/textures/atlas.png", 2,
-                       2);
+  request_texture(render::TextureId::CHECKERBOARD,
+                  "assets/textures/checkerboard.png");
+  request_texture(render::TextureId::GRADIENT, "assets/textures/gradient.png");
+  request_texture_atlas(render::TextureId::ATLAS, "assets/textures/atlas.png",
+                        2, 2);
+  load_textures();
 
   // Apply texture modifications
   auto *checkerboardTex =
@@ -35,9 +36,10 @@ void scene::Scene2::setup() {
   }
 
   // Create textured materials
-  create_textured_material(render::MaterialId::TEXTURED_CHECKERBOARD, true);
-  create_textured_material(render::MaterialId::TEXTURED_GRADIENT, true);
-  create_textured_material(render::MaterialId::TEXTURED_ATLAS, true);
+  request_textured_material(render::MaterialId::TEXTURED_CHECKERBOARD, true);
+  request_textured_material(render::MaterialId::TEXTURED_GRADIENT, true);
+  request_textured_material(render::MaterialId::TEXTURED_ATLAS, true);
+  load_materials();
 
   // Create textured objects
   texturedSquare = create_quad_2d(
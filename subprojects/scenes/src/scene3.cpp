@@ -13,11 +13,13 @@ void scene::Scene3::setup() {
   std::print("Setting up Scene 3: Multi-Material Objects\n");
 
   // Create textures
-  create_texture(render::TextureId::CHECKERBOARD,
-                 "assets/textures/checkerboard.png");
-  create_texture(render::TextureId::GRADIENT, "assets/textures/gradient.png");
-  create_texture_atlas(render::TextureId::ATLAS, "assets/textures/atlas.png", 2,
-                       2);
+  request_texture(render::TextureId::CHECKERBOARD,
+                  "assets/textures/checkerboard.png");
+  request_streamed_texture(render::TextureId::GRADIENT,
+                           "assets/textures/gradient.png");
+  request_texture_atlas(render::TextureId::ATLAS, "assets/textures/atlas.png",
+                        2, 2);
+  load_textures();
 
   // Create separate texture objects for each atlas region
   // These will be used by the region-specific materials
@@ -31,20 +33,22 @@ void scene::Scene3::setup() {
                               render::TextureId::ATLAS, 1, 1);
 
   // Create textured materials for 2D
-  create_textured_material(render::MaterialId::TEXTURED_CHECKERBOARD, true);
-  create_textured_material(render::MaterialId::TEXTURED_GRADIENT, true);
-  create_textured_material(render::MaterialId::TEXTURED_ATLAS, true);
+  request_textured_material(render::MaterialId::TEXTURED_CHECKERBOARD, true);
+  request_textured_material(render::MaterialId::TEXTURED_GRADIENT, true);
+  request_textured_material(render::MaterialId::TEXTURED_ATLAS, true);
 
   // Create textured materials for 3D
-  create_textured_material(render::MaterialId::TEXTURED_3D_CHECKERBOARD, false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_GRADIENT, false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_ATLAS, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_CHECKERBOARD,
+                            false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_GRADIENT, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_ATLAS, false);
 
   // Create atlas region materials (all use the same atlas texture)
-  create_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_0_0, false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_0_1, false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_1_0, false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_1_1, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_0_0, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_0_1, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_1_0, false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_ATLAS_1_1, false);
+  load_materials();
 
   // Create a 2D quad with two different materials (split horizontally)
   multiMaterialQuad =
@@ -11,9 +11,9 @@ scene::Scene4::Scene4(render::MaterialManager *matMgr,
 void scene::Scene4::setup() {
   std::print("Setting up Scene 4: Layered Textures\n");
 
-  // Create layered textures with transparent images
+  // Declare layered textures with transparent images
   // Quad with 3 layers - using transparent shapes
-  create_layered_texture(
+  request_layered_texture(
       render::TextureId::LAYERED_QUAD,
       {"assets/textures/layer_circle.png", "assets/textures/layer_star.png",
        "assets/textures/layer_triangle.png"},
@@ -23,19 +23,19 @@ void scene::Scene4::setup() {
 
   // Cube textures with incrementing layer counts (1-5 layers)
   // Face 1: 1 layer - single circle
-  create_layered_texture(render::TextureId::LAYERED_CUBE_1,
-                         {"assets/textures/layer_circle.png"},
-                         {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)}, {0.0f});
+  request_layered_texture(render::TextureId::LAYERED_CUBE_1,
+                          {"assets/textures/layer_circle.png"},
+                          {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)}, {0.0f});
 
   // Face 2: 2 layers - circle + star
-  create_layered_texture(
+  request_layered_texture(
       render::TextureId::LAYERED_CUBE_2,
       {"assets/textures/layer_circle.png", "assets/textures/layer_star.png"},
       {glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f)},
       {0.0f, 45.0f});
 
   // Face 3: 3 layers - circle + star + square
-  create_layered_texture(
+  request_layered_texture(
       render::TextureId::LAYERED_CUBE_3,
       {"assets/textures/layer_circle.png", "assets/textures/layer_star.png",
        "assets/textures/layer_square.png"},
@@ -44,7 +44,7 @@ void scene::Scene4::setup() {
       {0.0f, 0.0f, 90.0f});
 
   // Face 4: 4 layers - using atlas region (reused) + individual shapes
-  create_layered_texture(
+  request_layered_texture(
       render::TextureId::LAYERED_CUBE_4,
       {"assets/textures/layer_circle.png", "assets/textures/layer_star.png",
        "assets/textures/layer_triangle.png", "assets/textures/layer_heart.png"},
@@ -53,7 +53,7 @@ void scene::Scene4::setup() {
       {0.0f, 30.0f, 60.0f, 90.0f});
 
   // Face 5: 5 layers - reusing same image with different modifications
-  create_layered_texture(
+  request_layered_texture(
       render::TextureId::LAYERED_CUBE_5,
       {"assets/textures/layer_circle.png", "assets/textures/layer_star.png",
        "assets/textures/layer_square.png", "assets/textures/layer_triangle.png",
@@ -65,29 +65,33 @@ void scene::Scene4::setup() {
        glm::vec4(1.0f, 1.0f, 0.8f, 0.5f)}, // Slight yellow tint
       {0.0f, 36.0f, 72.0f, 108.0f, 144.0f});
 
+  // Decode and composite all layered textures in parallel
+  load_textures();
+
   // NOTE: The layered materials should use the layered.spv shader which needs
   // to be compiled For now, using the standard textured materials as fallback
   // TODO: Compile layered.slang and update materials to use LAYERED_2D and
   // LAYERED_3D
 
-  create_textured_material(render::MaterialId::TEXTURED, true);
+  request_textured_material(render::MaterialId::TEXTURED, true);
 
   // Create separate materials for each layered texture cube face
   // This follows the same pattern as Scene3 with atlas regions
-  create_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_1,
-                           false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_2,
-                           false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_3,
-                           false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_4,
-                           false);
-  create_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_5,
-                           false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_1,
+                            false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_2,
+                            false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_3,
+                            false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_4,
+                            false);
+  request_textured_material(render::MaterialId::TEXTURED_3D_LAYERED_CUBE_5,
+                            false);
   // Create material for face without texture (SIMPLE_SHADERS_3D_TEXTURED)
   // This material works with textured vertices but doesn't require a texture
-  create_textured_material(render::MaterialId::SIMPLE_SHADERS_3D_TEXTURED,
-                           false);
+  request_basic_material(render::MaterialId::SIMPLE_SHADERS_3D_TEXTURED, false,
+                         true);
+  load_materials();
 
   // Create quad with 3-layer texture (on the left)
   quad = create_quad_2d(
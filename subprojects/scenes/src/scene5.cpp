@@ -10,30 +10,33 @@ scene::Scene5::Scene5(render::MaterialManager *matMgr,
 void scene::Scene5::setup() {
   std::print("Setting up Scene 5: Multi-Shader Cube\n");
 
-  // Create textures with different shapes for each face
-  create_texture(render::TextureId::SCENE5_CIRCLE,
-                 "assets/textures/layer_circle.png");
-  create_texture(render::TextureId::SCENE5_STAR,
-                 "assets/textures/layer_star.png");
-  create_texture(render::TextureId::SCENE5_SQUARE,
-                 "assets/textures/layer_square.png");
-  create_texture(render::TextureId::SCENE5_TRIANGLE,
-                 "assets/textures/layer_triangle.png");
-  create_texture(render::TextureId::SCENE5_HEART,
-                 "assets/textures/layer_heart.png");
-  create_texture(
+  // Create textures with different shapes for each face, they are small and
+  // never modified so they share an atlas page
+  request_packed_texture(render::TextureId::SCENE5_CIRCLE,
+                         "assets/textures/layer_circle.png");
+  request_packed_texture(render::TextureId::SCENE5_STAR,
+                         "assets/textures/layer_star.png");
+  request_packed_texture(render::TextureId::SCENE5_SQUARE,
+                         "assets/textures/layer_square.png");
+  request_packed_texture(render::TextureId::SCENE5_TRIANGLE,
+                         "assets/textures/layer_triangle.png");
+  request_packed_texture(render::TextureId::SCENE5_HEART,
+                         "assets/textures/layer_heart.png");
+  request_packed_texture(
       render::TextureId::SCENE5_DIAMOND,
       "assets/textures/layer_circle.png"); // Reuse circle as diamond for now
+  load_textures();
 
   // Create materials for each face with different shaders
-  // Each material uses the same textured3d shader but with different textures
+  // Each material uses the same textured shader but with different textures
   // In a more advanced version, each could use completely different shaders
-  create_textured_material(render::MaterialId::SCENE5_FACE_0, false);
-  create_textured_material(render::MaterialId::SCENE5_FACE_1, false);
-  create_textured_material(render::MaterialId::SCENE5_FACE_2, false);
-  create_textured_material(render::MaterialId::SCENE5_FACE_3, false);
-  create_textured_material(render::MaterialId::SCENE5_FACE_4, false);
-  create_textured_material(render::MaterialId::SCENE5_FACE_5, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_0, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_1, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_2, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_3, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_4, false);
+  request_textured_material(render::MaterialId::SCENE5_FACE_5, false);
+  load_materials();
 
   // Create cube with different materials for each face
   std::vector<render::Scene::SubmeshDef> cubeSubmeshes;
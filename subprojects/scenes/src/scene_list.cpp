@@ -0,0 +1,33 @@
+#include "scene_list.h"
+#include "scene1.h"
+#include "scene2.h"
+#include "scene3.h"
+#include "scene4.h"
+#include "scene5.h"
+#include "stress_scene.h"
+#include <memory>
+#include <vector>
+
+std::vector<std::unique_ptr<render::Scene>>
+scene::create_scenes(render::Renderer &renderer,
+                     const StressConfig &stressConfig) {
+  auto &materialMgr = renderer.get_material_manager();
+  auto &textureMgr = renderer.get_texture_manager();
+  auto &bufferMgr = renderer.get_buffer_manager();
+  auto *objectMgr = renderer.get_object_manager();
+
+  std::vector<std::unique_ptr<render::Scene>> scenes;
+  scenes.push_back(std::make_unique<Scene1>(&materialMgr, &textureMgr,
+                                            &bufferMgr, objectMgr));
+  scenes.push_back(std::make_unique<Scene2>(&materialMgr, &textureMgr,
+                                            &bufferMgr, objectMgr));
+  scenes.push_back(std::make_unique<Scene3>(&materialMgr, &textureMgr,
+                                            &bufferMgr, objectMgr));
+  scenes.push_back(std::make_unique<Scene4>(&materialMgr, &textureMgr,
+                                            &bufferMgr, objectMgr));
+  scenes.push_back(std::make_unique<Scene5>(&materialMgr, &textureMgr,
+                                            &bufferMgr, objectMgr));
+  scenes.push_back(std::make_unique<StressScene>(
+      &materialMgr, &textureMgr, &bufferMgr, objectMgr, stressConfig));
+  return scenes;
+}
@@ -0,0 +1,286 @@
+#include "stress_scene.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <print>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Same seed every setup, so a config always builds the same scene
+constexpr uint32_t seed = 1234;
+
+// Sources the generated textures cycle through
+const std::array<const char *, 9> texturePaths = {
+    "assets/textures/checkerboard.png", "assets/textures/gradient.png",
+    "assets/textures/atlas.png",        "assets/textures/layer_atlas.png",
+    "assets/textures/layer_circle.png", "assets/textures/layer_heart.png",
+    "assets/textures/layer_square.png", "assets/textures/layer_star.png",
+    "assets/textures/layer_triangle.png"};
+
+// Face corners and winding as in Scene::create_cube_3d: front, back, left,
+// right, top, bottom
+const std::array<glm::vec3, 24> cubeCorners = {{
+    {-0.5f, -0.5f, 0.5f},   {0.5f, -0.5f, 0.5f},   {0.5f, 0.5f, 0.5f},
+    {-0.5f, 0.5f, 0.5f},    {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f},
+    {0.5f, 0.5f, -0.5f},    {-0.5f, 0.5f, -0.5f},  {-0.5f, -0.5f, -0.5f},
+    {-0.5f, -0.5f, 0.5f},   {-0.5f, 0.5f, 0.5f},   {-0.5f, 0.5f, -0.5f},
+    {0.5f, -0.5f, -0.5f},   {0.5f, -0.5f, 0.5f},   {0.5f, 0.5f, 0.5f},
+    {0.5f, 0.5f, -0.5f},    {-0.5f, 0.5f, -0.5f},  {0.5f, 0.5f, -0.5f},
+    {0.5f, 0.5f, 0.5f},     {-0.5f, 0.5f, 0.5f},   {-0.5f, -0.5f, -0.5f},
+    {0.5f, -0.5f, -0.5f},   {0.5f, -0.5f, 0.5f},   {-0.5f, -0.5f, 0.5f}}};
+
+const std::vector<uint16_t> cubeIndices = {
+    0,  2,  1,  0,  3,  2,  4,  5,  6,  6,  7,  4,  8,  10, 9,  8,  11, 10,
+    12, 13, 14, 14, 15, 12, 16, 17, 18, 18, 19, 16, 20, 22, 21, 20, 23, 22};
+
+const std::array<glm::vec2, 4> quadCorners = {
+    {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}}};
+const std::array<glm::vec2, 4> faceTexCoords = {
+    {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}}};
+const std::vector<uint16_t> quadIndices = {0, 2, 1, 0, 3, 2};
+
+std::string material_identifier(bool is2D, uint32_t index) {
+  return std::format("stress_{}_{}", is2D ? "2d" : "3d", index);
+}
+
+std::string texture_identifier(uint32_t index) {
+  return std::format("stress_texture_{}", index);
+}
+
+double elapsed_ms(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+scene::StressScene::StressScene(render::MaterialManager *matMgr,
+                                render::TextureManager *texMgr,
+                                device::BufferManager *bufMgr,
+                                render::ObjectManager *objMgr,
+                                const StressConfig &config)
+    : render::Scene(matMgr, texMgr, bufMgr, objMgr), config(config) {}
+
+void scene::StressScene::create_materials(bool use2D, bool use3D) {
+  const bool textured = config.textureCount > 0;
+
+  for (uint32_t i = 0; i < config.materialCount; ++i) {
+    // Materials without an object texture fall back to their own one
+    const std::string defaultTexture =
+        textured ? texture_identifier(i % config.textureCount) : "";
+
+    if (use2D) {
+      if (textured) {
+        request_textured_material(material_identifier(true, i), true,
+                                  defaultTexture);
+      } else {
+        request_basic_material(material_identifier(true, i), true);
+      }
+    }
+    if (use3D) {
+      if (textured) {
+        request_textured_material(material_identifier(false, i), false,
+                                  defaultTexture);
+      } else {
+        request_basic_material(material_identifier(false, i), false);
+      }
+    }
+  }
+  load_materials();
+}
+
+void scene::StressScene::create_textures() {
+  for (uint32_t i = 0; i < config.textureCount; ++i) {
+    request_texture(texture_identifier(i),
+                    texturePaths[i % texturePaths.size()]);
+  }
+  load_textures();
+}
+
+void scene::StressScene::create_objects() {
+  const bool textured = config.textureCount > 0;
+
+  std::mt19937 rng(seed);
+  std::discrete_distribution<int> kindDistribution(
+      {std::max(config.weight2D, 0.0f), std::max(config.weight3D, 0.0f),
+       std::max(config.weightSubmesh, 0.0f)});
+  std::bernoulli_distribution dynamicDistribution(
+      std::clamp(config.dynamicFraction, 0.0f, 1.0f));
+  std::uniform_int_distribution<uint32_t> materialDistribution(
+      0, config.materialCount - 1);
+  std::uniform_int_distribution<uint32_t> textureDistribution(
+      0, std::max(config.textureCount, 1u) - 1);
+  std::uniform_real_distribution<float> colorDistribution(0.3f, 1.0f);
+
+  // Square grid over the whole screen, one object per cell
+  const auto columns = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(config.objectCount))));
+  const float cell = 2.0f / static_cast<float>(columns);
+
+  objectManager->begin_batch();
+  for (uint32_t i = 0; i < config.objectCount; ++i) {
+    const int kind = kindDistribution(rng);
+    const bool is2D = kind == 0;
+    const bool hasSubmeshes = kind == 2;
+    const glm::vec3 color(colorDistribution(rng), colorDistribution(rng),
+                          colorDistribution(rng));
+
+    render::Object::ObjectCreateInfo createInfo{
+        .identifier = std::format("stress_{}", i),
+        .type = is2D ? render::Object::ObjectType::OBJECT_2D
+                     : render::Object::ObjectType::OBJECT_3D,
+        .materialIdentifier =
+            material_identifier(is2D, materialDistribution(rng)),
+        .position = {-1.0f + cell * (static_cast<float>(i % columns) + 0.5f),
+                     -1.0f + cell * (static_cast<float>(i / columns) + 0.5f),
+                     is2D ? 0.0f : 0.5f},
+        .scale = glm::vec3(cell * (is2D ? 0.8f : 0.5f))};
+
+    if (textured) {
+      createInfo.textureIdentifier =
+          texture_identifier(textureDistribution(rng));
+    }
+
+    if (is2D) {
+      createInfo.indices = quadIndices;
+      if (textured) {
+        std::vector<render::Object::Vertex2DTextured> vertices;
+        for (size_t v = 0; v < quadCorners.size(); ++v) {
+          vertices.push_back({quadCorners[v], faceTexCoords[v], color});
+        }
+        createInfo.vertices = std::move(vertices);
+      } else {
+        std::vector<render::Object::Vertex3D> vertices;
+        for (const auto &corner : quadCorners) {
+          vertices.push_back({glm::vec3(corner, 0.0f), color});
+        }
+        createInfo.vertices = std::move(vertices);
+      }
+    } else {
+      createInfo.indices = cubeIndices;
+      if (textured) {
+        std::vector<render::Object::Vertex3DTextured> vertices;
+        for (size_t v = 0; v < cubeCorners.size(); ++v) {
+          vertices.push_back({cubeCorners[v], faceTexCoords[v % 4], color});
+        }
+        createInfo.vertices = std::move(vertices);
+      } else {
+        std::vector<render::Object::Vertex3D> vertices;
+        for (const auto &corner : cubeCorners) {
+          vertices.push_back({corner, color});
+        }
+        createInfo.vertices = std::move(vertices);
+      }
+    }
+
+    // Front, back and left faces keep the base material, the other three
+    // switch to a second one with its own texture
+    if (hasSubmeshes) {
+      const std::string second =
+          material_identifier(false, materialDistribution(rng));
+      const std::string secondTexture =
+          textured ? texture_identifier(textureDistribution(rng)) : "";
+      createInfo.submeshes = {
+          {.indexStart = 0,
+           .indexCount = 18,
+           .materialIdentifier = createInfo.materialIdentifier,
+           .material = nullptr,
+           .textureIdentifier = createInfo.textureIdentifier},
+          {.indexStart = 18,
+           .indexCount = 18,
+           .materialIdentifier = second,
+           .material = nullptr,
+           .textureIdentifier = secondTexture}};
+    }
+
+    render::Object *object = objectManager->create_object(createInfo);
+    if (!object) {
+      continue;
+    }
+    sceneObjects.push_back(object);
+
+    object->set_rotation_mode(
+        is2D ? render::Object::RotationMode::SHADER_2D
+             : render::Object::RotationMode::TRANSFORM_3D);
+    if (dynamicDistribution(rng)) {
+      dynamicObjects.push_back(
+          {.object = object,
+           .phase = static_cast<float>(i % 628) * 0.01f,
+           .is2D = is2D});
+    }
+  }
+
+  auto queueStart = Clock::now();
+  objectManager->end_batch();
+  std::print("StressScene - render queue built in {:.2f} ms\n",
+             elapsed_ms(queueStart));
+}
+
+void scene::StressScene::setup() {
+  std::print("Setting up {}\n", get_name());
+
+  if (config.objectCount == 0 || config.materialCount == 0) {
+    std::print(stderr,
+               "StressScene - objects and materials must not be 0\n");
+    return;
+  }
+  if (config.weight2D <= 0.0f && config.weight3D <= 0.0f &&
+      config.weightSubmesh <= 0.0f) {
+    std::print(stderr, "StressScene - no object kind has a weight\n");
+    return;
+  }
+
+  auto start = Clock::now();
+  create_textures();
+  const double texturesMs = elapsed_ms(start);
+
+  start = Clock::now();
+  create_materials(config.weight2D > 0.0f,
+                   config.weight3D > 0.0f || config.weightSubmesh > 0.0f);
+  const double materialsMs = elapsed_ms(start);
+
+  start = Clock::now();
+  create_objects();
+  const double objectsMs = elapsed_ms(start);
+
+  std::print("StressScene - {} objects ({} dynamic), {} textures in {:.1f} "
+             "ms, materials in {:.1f} ms, objects in {:.1f} ms\n",
+             sceneObjects.size(), dynamicObjects.size(), config.textureCount,
+             texturesMs, materialsMs, objectsMs);
+}
+
+void scene::StressScene::cleanup() {
+  dynamicObjects.clear();
+  render::Scene::cleanup();
+}
+
+void scene::StressScene::update(float deltaTime, float totalTime) {
+  for (const auto &dynamic : dynamicObjects) {
+    const float angle = totalTime + dynamic.phase;
+    if (dynamic.is2D) {
+      dynamic.object->rotate_2d(angle);
+    } else {
+      dynamic.object->rotate(glm::vec3(angle * 0.5f, angle, angle * 0.3f));
+    }
+  }
+}
+
+std::string scene::StressScene::get_name() const {
+  return std::format("Stress: {} objects", config.objectCount);
+}
+
+const scene::StressConfig &scene::StressScene::get_config() const {
+  return config;
+}
+
+void scene::StressScene::set_config(const StressConfig &config) {
+  this->config = config;
+}
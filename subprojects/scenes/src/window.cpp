@@ -1,12 +1,13 @@
 #include "window.h"
 #include "config.h"
 #include "renderer.h"
-#include "scene1.h"
-#include "scene2.h"
-#include "scene3.h"
-#include "scene4.h"
-#include "scene5.h"
+#include "scene_list.h"
+#include "tasks.h"
+#include "trace.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <print>
 #include <stdexcept>
@@ -14,7 +15,7 @@
 render::Window::Window(int width, int height, std::string title)
     : frameBufferResized(false), currentWidth(width), currentHeight(height),
       aspectRatio(static_cast<float>(width) / static_cast<float>(height)),
-      currentSceneIndex(0) {
+      currentSceneIndex(0), sceneChanged(false), pipelinedSimulation(false) {
   glfwInit();
 
   if (!glfwVulkanSupported()) {
@@ -45,6 +46,7 @@ render::Window::Window(int width, int height, std::string title)
 }
 
 render::Window::~Window() {
+  finish_simulation();
   scenes.clear();
   renderer.reset();
 
@@ -83,6 +85,24 @@ void render::Window::key_callback(GLFWwindow *window, int key, int scancode,
   } else if (key == GLFW_KEY_S) {
     std::print("\n\nS key pressed - Switching scene\n");
     win->switch_scene();
+  } else if (key == GLFW_KEY_P) {
+    std::print("\n\nP key pressed - Toggling pipelined simulation\n");
+    win->set_pipelined_simulation(!win->pipelinedSimulation);
+  } else if (key == GLFW_KEY_V) {
+    std::print("\n\nV key pressed - Cycling present policy\n");
+    win->cycle_present_policy();
+  } else if (key == GLFW_KEY_L) {
+    bool enabled = !win->renderer->is_low_latency();
+    std::print("\n\nL key pressed - Low latency mode {}\n",
+               enabled ? "enabled" : "disabled");
+    win->renderer->set_low_latency(enabled);
+  } else if (key == GLFW_KEY_T) {
+    std::print("\n\nT key pressed - Dumping CPU trace\n");
+    general::Trace::get_instance().dump("trace.json", 10.0);
+  } else if (key == GLFW_KEY_EQUAL || key == GLFW_KEY_MINUS) {
+    std::print("\n\n{} key pressed - Scaling stress scene\n",
+               key == GLFW_KEY_EQUAL ? "=" : "-");
+    win->scale_stress_scene(key == GLFW_KEY_EQUAL ? 2.0f : 0.5f);
   }
 }
 
@@ -94,26 +114,11 @@ void render::Window::create_scenes() {
 
   // Clear existing scenes
   scenes.clear();
+  sceneChanged = true;
 
-  // Get managers from renderer
-  auto &materialMgr = renderer->get_material_manager();
-  auto &textureMgr = renderer->get_texture_manager();
-  auto &bufferMgr = renderer->get_buffer_manager();
-  auto *objectMgr = renderer->get_object_manager();
-
-  // Create the five scenes (but don't setup yet - lazy loading)
+  // Create the scenes (but don't setup yet - lazy loading)
   std::print("Creating scene instances...\n");
-
-  scenes.push_back(std::make_unique<scene::Scene1>(&materialMgr, &textureMgr,
-                                                   &bufferMgr, objectMgr));
-  scenes.push_back(std::make_unique<scene::Scene2>(&materialMgr, &textureMgr,
-                                                   &bufferMgr, objectMgr));
-  scenes.push_back(std::make_unique<scene::Scene3>(&materialMgr, &textureMgr,
-                                                   &bufferMgr, objectMgr));
-  scenes.push_back(std::make_unique<scene::Scene4>(&materialMgr, &textureMgr,
-                                                   &bufferMgr, objectMgr));
-  scenes.push_back(std::make_unique<scene::Scene5>(&materialMgr, &textureMgr,
-                                                   &bufferMgr, objectMgr));
+  scenes = scene::create_scenes(*renderer);
 
   // Setup only the first scene (active scene)
   if (!scenes.empty()) {
@@ -131,6 +136,7 @@ void render::Window::switch_scene() {
   // Cleanup/unload current scene to free GPU resources
   std::print("Unloading scene: {}\n", scenes[currentSceneIndex]->get_name());
   scenes[currentSceneIndex]->cleanup();
+  sceneChanged = true;
 
   // Cycle to next scene
   size_t previousSceneIndex = currentSceneIndex;
@@ -142,6 +148,25 @@ void render::Window::switch_scene() {
   scenes[currentSceneIndex]->setup();
 }
 
+void render::Window::scale_stress_scene(float factor) {
+  auto *stress = scenes.empty() ? nullptr
+                                : dynamic_cast<scene::StressScene *>(
+                                      scenes[currentSceneIndex].get());
+  if (!stress) {
+    std::print("The stress scene isn't active\n");
+    return;
+  }
+
+  scene::StressConfig config = stress->get_config();
+  config.objectCount = static_cast<uint32_t>(std::clamp<uint64_t>(
+      static_cast<uint64_t>(config.objectCount * factor), 1000, 1000000));
+
+  stress->cleanup();
+  sceneChanged = true;
+  stress->set_config(config);
+  stress->setup();
+}
+
 void render::Window::update_current_scene() {
   static double lastTime = glfwGetTime();
   double currentTime = glfwGetTime();
@@ -156,8 +181,52 @@ void render::Window::update_current_scene() {
   }
 }
 
+void render::Window::start_simulation() {
+  simulation = device::Tasks::get_instance().add_task(
+      [this]() {
+        update_current_scene();
+        renderer->get_object_manager()->write_snapshots();
+      },
+      BS::pr::high);
+}
+
+bool render::Window::finish_simulation() {
+  if (!simulation.valid()) {
+    return false;
+  }
+  simulation.get();
+  return true;
+}
+
+void render::Window::cycle_present_policy() {
+  using PresentPolicy = device::SwapChain::PresentPolicy;
+  static constexpr std::array<PresentPolicy, 4> policies = {
+      PresentPolicy::VSYNC, PresentPolicy::MAILBOX, PresentPolicy::IMMEDIATE,
+      PresentPolicy::RELAXED};
+  static constexpr std::array<const char *, 4> names = {
+      "vsync", "mailbox", "immediate", "relaxed"};
+
+  size_t next = (static_cast<size_t>(renderer->get_present_policy()) + 1) %
+                policies.size();
+  std::print("Present policy: {}\n", names[next]);
+  renderer->set_present_policy(policies[next]);
+}
+
+void render::Window::set_pipelined_simulation(bool enabled) {
+  pipelinedSimulation = enabled;
+  std::print("Pipelined simulation {}\n", enabled ? "enabled" : "disabled");
+}
+
 void render::Window::run() {
   while (!glfwWindowShouldClose(window)) {
+    // Frame limiter and low-latency wait, right before input is read
+    renderer->pace_frame();
+
+    // Input can switch scenes or reload the managers the simulation stage
+    // works on, so it must be idle first
+    bool simulatedAhead = finish_simulation();
+    sceneChanged = false;
+
     glfwPollEvents();
 
     if (frameBufferResized) {
@@ -165,8 +234,22 @@ void render::Window::run() {
       renderer->get_device_manager().recreate_swap_chain();
     }
 
-    update_current_scene();
+    auto *objectMgr = renderer->get_object_manager();
+    if (simulatedAhead && !sceneChanged) {
+      // Draw the state simulated during the previous frame
+      objectMgr->swap_snapshots();
+    } else {
+      update_current_scene();
+      objectMgr->publish_snapshots();
+    }
+
+    // Simulate the next frame while this one is recorded and submitted
+    if (pipelinedSimulation) {
+      start_simulation();
+    }
 
     renderer->draw_frame();
   };
+
+  finish_simulation();
 }
@@ -3,6 +3,9 @@
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 #include <wasm.h>
@@ -15,7 +18,6 @@ namespace wasm {
  *
  * This class provides a high-level interface for loading and executing
  * WebAssembly modules. It's designed to be used for:
- * - Shader compilation (Slang WASM)
  * - Modding support (sandboxed user code)
  * - Plugin systems
  */
@@ -35,6 +37,16 @@ public:
    */
   bool loadModule(const std::filesystem::path &wasmPath);
 
+  /**
+   * @brief Directory for precompiled modules, empty to disable the cache
+   *
+   * Defaults to wasm-cache in the working directory.
+   * Compiled modules are serialized there keyed by a hash of the module and
+   * the engine configuration, and mapped back on later loads instead of
+   * being compiled again.
+   */
+  static void setModuleCacheDirectory(const std::filesystem::path &directory);
+
   /**
    * @brief Check if a module is currently loaded
    */
@@ -72,7 +84,15 @@ private:
   bool moduleLoaded;
   std::string lastError;
 
+  static std::mutex moduleCacheMutex;
+  static std::optional<std::filesystem::path> moduleCacheDirectory;
+
   bool initializeEngine();
+  static std::string getModuleCacheKey(std::span<const uint8_t> wasmBytes);
+  static std::filesystem::path getModuleCachePath(const std::string &cacheKey);
+  bool loadCachedModule(const std::string &cacheKey);
+  bool compileModule(std::span<const uint8_t> wasmBytes,
+                     const std::string &cacheKey);
   void shutdownEngine();
   void setError(const std::string &error);
 };
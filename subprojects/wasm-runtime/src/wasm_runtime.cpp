@@ -1,7 +1,24 @@
 #include "wasm_runtime.h"
-#include <cstring>
+#include <atomic>
+#include <format>
 #include <fstream>
 #include <print>
+#include <random>
+
+namespace {
+
+#if defined(__x86_64__) || defined(_M_X64)
+constexpr const char *hostTarget = "x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+constexpr const char *hostTarget = "aarch64";
+#else
+constexpr const char *hostTarget = "unknown";
+#endif
+
+} // namespace
+
+std::mutex wasm::WasmRuntime::moduleCacheMutex;
+std::optional<std::filesystem::path> wasm::WasmRuntime::moduleCacheDirectory;
 
 wasm::WasmRuntime::WasmRuntime()
     : engine(nullptr), store(nullptr), context(nullptr), module(nullptr),
@@ -79,29 +96,16 @@ bool wasm::WasmRuntime::loadModule(const std::filesystem::path &wasmPath) {
     return false;
   }
 
-  // Create WASM byte vector
-  wasm_byte_vec_t wasm_bytes;
-  wasm_byte_vec_new_uninitialized(&wasm_bytes, buffer.size());
-  std::memcpy(wasm_bytes.data, buffer.data(), buffer.size());
-
-  // Compile module
-  wasmtime_error_t *error = wasmtime_module_new(
-      engine, (uint8_t *)wasm_bytes.data, wasm_bytes.size, &module);
-  wasm_byte_vec_delete(&wasm_bytes);
-
-  if (error) {
-    wasm_name_t message;
-    wasmtime_error_message(error, &message);
-    setError(std::string("Failed to compile WASM module: ") +
-             std::string(message.data, message.size));
-    wasm_byte_vec_delete(&message);
-    wasmtime_error_delete(error);
+  // Precompiled machine code from an earlier run skips the JIT entirely
+  std::string cacheKey = getModuleCacheKey(buffer);
+  if (!loadCachedModule(cacheKey) && !compileModule(buffer, cacheKey)) {
     return false;
   }
 
   // Instantiate module
   wasm_trap_t *trap = nullptr;
-  error = wasmtime_instance_new(context, module, nullptr, 0, &instance, &trap);
+  wasmtime_error_t *error =
+      wasmtime_instance_new(context, module, nullptr, 0, &instance, &trap);
 
   if (error || trap) {
     if (error) {
@@ -131,6 +135,130 @@ bool wasm::WasmRuntime::loadModule(const std::filesystem::path &wasmPath) {
   return true;
 }
 
+std::string
+wasm::WasmRuntime::getModuleCacheKey(std::span<const uint8_t> wasmBytes) {
+  // FNV-1a over the module, then over the engine it was compiled for. Both
+  // the Wasmtime version and the host change the generated code
+  uint64_t hash = 0xcbf29ce484222325ull;
+  auto mix = [&hash](std::span<const uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+      hash = (hash ^ byte) * 0x100000001b3ull;
+    }
+  };
+
+  mix(wasmBytes);
+  std::string engineConfig =
+      std::format("wasmtime-{}-{}-default", WASMTIME_VERSION, hostTarget);
+  mix({reinterpret_cast<const uint8_t *>(engineConfig.data()),
+       engineConfig.size()});
+
+  return std::format("{:016x}", hash);
+}
+
+std::filesystem::path
+wasm::WasmRuntime::getModuleCachePath(const std::string &cacheKey) {
+  std::lock_guard lock(moduleCacheMutex);
+  std::filesystem::path directory = moduleCacheDirectory.value_or(
+      std::filesystem::current_path() / "wasm-cache");
+  if (directory.empty()) {
+    return {};
+  }
+  return directory / (cacheKey + ".cwasm");
+}
+
+bool wasm::WasmRuntime::loadCachedModule(const std::string &cacheKey) {
+  std::filesystem::path cachePath = getModuleCachePath(cacheKey);
+  if (cachePath.empty() || !std::filesystem::exists(cachePath)) {
+    return false;
+  }
+
+  // Deserializing from a file maps it instead of reading it
+  wasmtime_error_t *error = wasmtime_module_deserialize_file(
+      engine, cachePath.string().c_str(), &module);
+
+  if (error) {
+    // Stale or foreign entry, compile again and overwrite it
+    wasm_name_t message;
+    wasmtime_error_message(error, &message);
+    std::print(stderr, "WasmRuntime: Ignoring cached module {}: {}\n",
+               cachePath.string(), std::string(message.data, message.size));
+    wasm_byte_vec_delete(&message);
+    wasmtime_error_delete(error);
+    module = nullptr;
+    return false;
+  }
+
+  std::print("WasmRuntime: Loaded precompiled module {}\n",
+             cachePath.string());
+  return true;
+}
+
+bool wasm::WasmRuntime::compileModule(std::span<const uint8_t> wasmBytes,
+                                      const std::string &cacheKey) {
+  wasmtime_error_t *error = wasmtime_module_new(engine, wasmBytes.data(),
+                                                wasmBytes.size(), &module);
+
+  if (error) {
+    wasm_name_t message;
+    wasmtime_error_message(error, &message);
+    setError(std::string("Failed to compile WASM module: ") +
+             std::string(message.data, message.size));
+    wasm_byte_vec_delete(&message);
+    wasmtime_error_delete(error);
+    return false;
+  }
+
+  std::filesystem::path cachePath = getModuleCachePath(cacheKey);
+  if (cachePath.empty()) {
+    return true;
+  }
+
+  wasm_byte_vec_t serialized;
+  error = wasmtime_module_serialize(module, &serialized);
+  if (error) {
+    // Not fatal, the module is compiled, it just won't be cached
+    wasmtime_error_delete(error);
+    return true;
+  }
+
+  // Staged and renamed so a concurrent loader never maps a partial file
+  static const uint32_t processTag = std::random_device{}();
+  static std::atomic<uint64_t> stagingCounter = 0;
+  std::filesystem::path stagingPath = cachePath;
+  stagingPath += std::format(".{:08x}-{}.tmp", processTag, stagingCounter++);
+
+  std::error_code fsError;
+  std::filesystem::create_directories(cachePath.parent_path(), fsError);
+  {
+    std::ofstream file(stagingPath, std::ios::binary);
+    file.write(serialized.data, serialized.size);
+    if (file) {
+      file.close();
+      std::filesystem::rename(stagingPath, cachePath, fsError);
+    } else {
+      fsError = std::make_error_code(std::errc::io_error);
+    }
+  }
+  wasm_byte_vec_delete(&serialized);
+
+  if (fsError) {
+    std::print(stderr, "WasmRuntime: Failed to cache module {}: {}\n",
+               cachePath.string(), fsError.message());
+    std::filesystem::remove(stagingPath, fsError);
+  } else {
+    std::print("WasmRuntime: Cached precompiled module {}\n",
+               cachePath.string());
+  }
+
+  return true;
+}
+
+void wasm::WasmRuntime::setModuleCacheDirectory(
+    const std::filesystem::path &directory) {
+  std::lock_guard lock(moduleCacheMutex);
+  moduleCacheDirectory = directory;
+}
+
 void wasm::WasmRuntime::unloadModule() {
   if (module) {
     wasmtime_module_delete(module);